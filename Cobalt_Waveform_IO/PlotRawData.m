@@ -1,22 +1,44 @@
 clear; 
 % PULSES and RECORDING_BLOCK appropriately.
 PULSES = 30;
+% Only used for raw recordings (RECORD_FORMAT = 0); nxrec recordings
+% carry the range line length in their header.
 SAMPLES_PER_RANGE_LINE = 512;%1024;
 
+%% File handles to raw data files
+fida=fopen('../adc0data.dat','r');
+fidb=fopen('../adc1data.dat','r');
+fidc=fopen('../adc2data.dat','r');
 
+%% Read the nxrec header, if there is one (see nxrec.h)
+PREFIX_BYTES = 0;
+magic = fread(fida,8,'*char')';
+if strcmp(magic,'NXRADREC')
+    hdr = fread(fida,7,'uint32');   % version, headerBytes, prefixBytes,
+                                    % lineBytes, recordBytes, samplesPerPri,
+                                    % sampleFormat
+    if hdr(7) ~= 1
+        error('Packed or block floating point recording; decode it with nxrec.c first');
+    end
+    HEADER_BYTES = hdr(2);
+    PREFIX_BYTES = hdr(3);
+    SAMPLES_PER_RANGE_LINE = hdr(6);
+    fprintf('nxrec version %d, %d samples per range line\n', hdr(1), SAMPLES_PER_RANGE_LINE);
+    % skip the header and the first line's prefix
+    fseek(fida,HEADER_BYTES+PREFIX_BYTES,'bof');
+else
+    frewind(fida);
+end
 
 IQ_SAMPLES = SAMPLES_PER_RANGE_LINE*PULSES; %32 bits per sample
 BUF = IQ_SAMPLES; 
 LEN = IQ_SAMPLES*2;
 
-%% File handles to raw data files
-fida=fopen('../adc0data.dat','r');
-fidb=fopen('../adc1data.dat','r');
-fidc=fopen('../adc2data.dat','r');
-
-%% Read raw data and write to a vector
-aa=fread(fida,LEN,'int16');
+%% Read raw data and write to a vector, skipping the line prefixes
+aa=fread(fida,LEN,sprintf('%d*int16',SAMPLES_PER_RANGE_LINE*2),PREFIX_BYTES);
+LEN=length(aa);
 a=aa(1:2:LEN)+j*aa(2:2:LEN);
+BUF=length(a);
 
 %bb=fread(fidb,LEN,'int16');
 %b=bb(1:2:LEN)+j*bb(2:2:LEN);
@@ -0,0 +1,227 @@
+/**************************************************************************
+*
+*   File: adcpoll.c
+*
+*   Description: Busy-poll acquisition.  See adcpoll.h.
+*
+*                Each poll takes a timestamp and then reads the flag
+*                register.  A read that finds the flag clear proves it was
+*                raised after that timestamp, which is what bounds the
+*                latency.  While spinning, the poller issues a pause
+*                instruction between reads so a hyperthread sibling is not
+*                starved.  Once it has spun for spinNs it sleeps in short
+*                steps instead; that trades latency for a free CPU when
+*                the PRI is long.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "adcpoll.h"
+#include "dmaring.h"
+
+
+/**************************************************************************
+ Function:    ADCPOLL_Init()
+
+ Description: Sets up a channel's poller.  Call just before the DMA
+              engine is started, with the flag cleared.
+
+ Parameters:  poll     - pointer to the ADC_POLL to initialize
+              flagReg  - ADC interrupt flag register
+              doneMask - flag bit(s) to wait for (the link-end flag)
+              spinNs   - ns to spin before backing off, 0 = never
+
+ Return:      none
+**************************************************************************/
+void ADCPOLL_Init (ADC_POLL               *poll,
+                   volatile unsigned int  *flagReg,
+                   unsigned int            doneMask,
+                   unsigned long long      spinNs)
+{
+    memset (poll, 0, sizeof(ADC_POLL));
+
+    poll->flagReg   = flagReg;
+    poll->doneMask  = doneMask;
+    poll->spinNs    = spinNs;
+    poll->lastClear = DMARING_TimeNs();
+}
+
+
+/**************************************************************************
+ Function:    ADCPOLL_SetPosition()
+
+ Description: Has ADCPOLL_Completed() count groups from the DMA engine's
+              position rather than one per flag.  Call after
+              ADCPOLL_Init(), before the DMA engine is started at
+              descriptor 0.
+
+ Parameters:  poll         - pointer to the channel's ADC_POLL
+              posReg       - DMA status register
+              posMask      - bits of it holding the descriptor the engine
+                             is filling
+              posShift     - how far those bits are shifted up
+              numLinks     - descriptors in the ring
+              linesPerFlag - descriptors per group (IRQ_COALESCE)
+
+ Return:      0 - success
+              1 - the ring is not a whole number of groups, or is under
+                  two groups deep
+**************************************************************************/
+int ADCPOLL_SetPosition (ADC_POLL               *poll,
+                         volatile unsigned int  *posReg,
+                         unsigned int            posMask,
+                         unsigned int            posShift,
+                         unsigned int            numLinks,
+                         unsigned int            linesPerFlag)
+{
+    if ((linesPerFlag == 0) || ((numLinks % linesPerFlag) != 0) ||
+        (numLinks < 2 * linesPerFlag))
+        return (1);
+
+    poll->posReg       = posReg;
+    poll->posMask      = posMask;
+    poll->posShift     = posShift;
+    poll->numLinks     = numLinks;
+    poll->linesPerFlag = linesPerFlag;
+    poll->lastPos      = 0;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    ADCPOLL_Wait()
+
+ Description: Polls until the done flag is set.  The flag is left set for
+              the caller to clear.
+
+ Parameters:  poll      - pointer to the channel's ADC_POLL
+              timeoutNs - give up after this long
+              flagTime  - receives the last time the flag was seen clear
+                          (or the previous line was seen), in ns; the flag
+                          was raised after it
+
+ Return:      0 - flag seen
+              1 - timed out
+**************************************************************************/
+int ADCPOLL_Wait (ADC_POLL            *poll,
+                  unsigned long long   timeoutNs,
+                  unsigned long long  *flagTime)
+{
+    unsigned long long start = DMARING_TimeNs();
+    unsigned long long now   = start;
+    struct timespec    ts;
+    int                first = 1;
+
+    ts.tv_sec  = 0;
+    ts.tv_nsec = ADCPOLL_SLEEP_NS;
+
+    while (1)
+    {
+        poll->reads++;
+        if (*(poll->flagReg) & poll->doneMask)
+            break;
+
+        poll->lastClear = now;
+        first           = 0;
+
+        now = DMARING_TimeNs();
+        if ((now - start) > timeoutNs)
+            return (1);
+
+        if ((poll->spinNs != 0) && ((now - start) > poll->spinNs))
+        {
+            nanosleep(&ts, NULL);
+            poll->sleeps++;
+            now = DMARING_TimeNs();
+        }
+        else
+        {
+#if defined(__i386__) || defined(__x86_64__)
+            __builtin_ia32_pause();
+#endif
+        }
+    }
+
+    if (first)
+        poll->ready++;
+    poll->lines++;
+
+    *flagTime       = poll->lastClear;
+    poll->lastClear = DMARING_TimeNs();
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    ADCPOLL_Completed()
+
+ Description: Returns the groups completed since the last call.  Call
+              each time ADCPOLL_Wait() has seen the flag, after the flag
+              has been cleared, so that a group completing in between is
+              either counted now or flagged again.  Groups are counted in
+              whole; a group the engine is part way through is left for
+              a later call.
+
+ Parameters:  poll - pointer to the channel's ADC_POLL
+
+ Return:      groups completed, oldest first; 0 if the flag was for
+              groups already counted.  Always 1 without a position
+              register.
+**************************************************************************/
+unsigned int ADCPOLL_Completed (ADC_POLL *poll)
+{
+    unsigned int pos;
+    unsigned int groups;
+
+    if (poll->posReg == NULL)
+    {
+        poll->groups++;
+        return (1);
+    }
+
+    pos = (*(poll->posReg) & poll->posMask) >> poll->posShift;
+    if (pos >= poll->numLinks)
+        pos = poll->lastPos;
+
+    groups = ((pos + poll->numLinks - poll->lastPos) % poll->numLinks) /
+             poll->linesPerFlag;
+    poll->lastPos = (poll->lastPos + groups * poll->linesPerFlag) %
+                    poll->numLinks;
+
+    poll->groups += groups;
+    if (groups == 0)
+        poll->stale++;
+
+    return (groups);
+}
+
+
+/**************************************************************************
+ Function:    ADCPOLL_Report()
+
+ Description: Prints the poll statistics for a channel.
+
+ Parameters:  poll    - pointer to the channel's ADC_POLL
+              chanNum - ADC channel number
+
+ Return:      none
+**************************************************************************/
+void ADCPOLL_Report (ADC_POLL *poll, int chanNum)
+{
+    printf("[dmaThread %d] poll: %lu flag(s) seen, %.1f register reads "
+           "each, %lu backoff sleep(s)\n", chanNum+1, poll->lines,
+           (poll->lines != 0) ? (double)poll->reads / poll->lines : 0.0,
+           poll->sleeps);
+    printf("[dmaThread %d] poll: %lu flag(s) already set on entry; "
+           "irq->wake is an upper bound in poll mode\n", chanNum+1,
+           poll->ready);
+    if (poll->posReg != NULL)
+        printf("[dmaThread %d] poll: %lu group(s), %lu of them with their "
+               "flag lost, counted from the DMA position\n", chanNum+1,
+               poll->groups, poll->groups - (poll->lines - poll->stale));
+}
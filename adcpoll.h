@@ -0,0 +1,113 @@
+/***********************************************************************
+*
+*   File: adcpoll.h
+*
+*   Description: header file for adcpoll.c, busy-poll acquisition: the
+*                acquisition thread spins on the ADC interrupt flag
+*                register for the DMA link-end flag instead of sleeping
+*                on the interrupt semaphore.
+*
+*                Set from NeXtRAD.ini:
+*                    ACQ_POLL     - 1 = poll, 0 = interrupt and semaphore
+*                    POLL_SPIN_US - spin this long before backing off to
+*                                   short sleeps; 0 = never back off
+*
+*                Polling takes the kernel wake-up out of every PRI, at the
+*                cost of a CPU per channel, so it is meant to be used with
+*                ACQ_CPUS.  The poller only reads the register; the caller
+*                clears the flag once it is seen.  Nothing here calls the
+*                PTK716X library, so a plain variable written by another
+*                thread can stand in for the register.
+*
+*                The time a flag was raised is not visible to the poller.
+*                ADCPOLL_Wait() returns the last time the flag was seen
+*                clear instead, so the interrupt-to-wake latency recorded
+*                in poll mode is an upper bound, directly comparable with
+*                the one recorded in interrupt mode.
+*
+*                The flag is a latch, not a counter.  If it is raised again
+*                before the thread has cleared it, one group's flag is
+*                lost, and counting flags would leave the thread a group
+*                behind the DMA engine for the rest of the run.  So each
+*                time the flag is seen and cleared, ADCPOLL_Completed()
+*                reads the descriptor the engine has moved on to from the
+*                DMA status register (ADCPOLL_SetPosition()) and returns
+*                every whole group completed since the last call; the
+*                thread publishes all of them.  A flag raised for a group
+*                already counted that way yields no group.  The count
+*                wraps with the ring, so a thread a whole ring behind
+*                cannot see it; its lines are lost by then in any case.
+*
+************************************************************************/
+
+#ifndef __ADCPOLL_H__
+#define __ADCPOLL_H__
+
+
+/* ADCPOLL_SLEEP_NS - length of each sleep once a poller has backed off */
+#define ADCPOLL_SLEEP_NS   5000
+
+
+/* ADC_POLL - poller for one channel (acquisition thread only)
+ *     flagReg   = ADC interrupt flag register; the flags are in its low
+ *                 32 bits
+ *     doneMask  = flag bit(s) meaning a line (or group) has completed
+ *     spinNs    = time spent spinning before backing off, 0 = never
+ *     lastClear = last time the flag was seen clear, in ns
+ *     posReg    = DMA status register holding the descriptor the engine
+ *                 is filling, or NULL to count one group per flag
+ *     posMask   = bits of posReg holding the descriptor, and
+ *     posShift    how far they are shifted up
+ *     numLinks  = descriptors in the ring
+ *     linesPerFlag = descriptors per group, i.e. per flag
+ *     lastPos   = first descriptor of the next group not yet counted
+ *     lines     = flags seen
+ *     reads     = register reads
+ *     sleeps    = backoff sleeps
+ *     ready     = flags already set on entry to ADCPOLL_Wait(), i.e. the
+ *                 line was not serviced before the next one completed
+ *     groups    = groups counted by ADCPOLL_Completed()
+ *     stale     = flags seen for groups already counted
+ */
+typedef struct ADC_POLL
+        {
+            volatile unsigned int  *flagReg;
+            unsigned int            doneMask;
+            unsigned long long      spinNs;
+            unsigned long long      lastClear;
+            volatile unsigned int  *posReg;
+            unsigned int            posMask;
+            unsigned int            posShift;
+            unsigned int            numLinks;
+            unsigned int            linesPerFlag;
+            unsigned int            lastPos;
+
+            unsigned long           lines;
+            unsigned long           reads;
+            unsigned long           sleeps;
+            unsigned long           ready;
+            unsigned long           groups;
+            unsigned long           stale;
+        } ADC_POLL;
+
+
+/* function prototypes */
+void ADCPOLL_Init   (ADC_POLL               *poll,
+                     volatile unsigned int  *flagReg,
+                     unsigned int            doneMask,
+                     unsigned long long      spinNs);
+int  ADCPOLL_SetPosition (ADC_POLL           *poll,
+                     volatile unsigned int  *posReg,
+                     unsigned int            posMask,
+                     unsigned int            posShift,
+                     unsigned int            numLinks,
+                     unsigned int            linesPerFlag);
+int  ADCPOLL_Wait   (ADC_POLL               *poll,
+                     unsigned long long      timeoutNs,
+                     unsigned long long     *flagTime);
+unsigned int
+     ADCPOLL_Completed (ADC_POLL            *poll);
+void ADCPOLL_Report (ADC_POLL               *poll,
+                     int                     chanNum);
+
+#endif /* __ADCPOLL_H__ */
@@ -0,0 +1,327 @@
+/**************************************************************************
+*
+*   File: adcpolltest.c
+*
+*   Description: Test of busy-poll acquisition (adcpoll.c) against a
+*                simulated ADC register block, away from the radar.
+*
+*                An engine thread stands in for the DMA engine and the
+*                trigger train.  Every period it "fills" the next ring
+*                buffer with the line number, moves the link field of a
+*                DMA status register on to the next descriptor and, at
+*                the end of each group, sets the link-end bit in a flag
+*                register, which latches as the real one does.  Both
+*                registers carry other bits, which must not disturb the
+*                poller.  After the last line the engine stops, as the
+*                trigger train does.
+*
+*                The main thread services the ring the way dmaThread()
+*                does in poll mode, and stalls now and then for longer
+*                than a group so that flags are lost.  The test passes if
+*                every group is serviced once and in order with its own
+*                lines still in the buffers, every known flag time is no
+*                later than the flag was raised, and the loop ends with
+*                the trigger train rather than on a timeout.  The ring
+*                must hold at least four groups: a stall that overruns it
+*                loses whole rings, which no count modulo the ring sees.
+*
+*                Usage:
+*                    adcpolltest [options]
+*                    -n lines   lines in the trigger train (20000)
+*                    -b bufs    NUM_DMA_BUFS (32)
+*                    -c lines   IRQ_COALESCE (4)
+*                    -p us      PRI (100)
+*                    -s groups  stall every this many groups (50)
+*                    -f         count one group per flag, without the
+*                               DMA position; shows the thread falling
+*                               behind when flags are lost
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "adcpoll.h"
+#include "pristats.h"
+#include "dmaring.h"
+
+
+/* simulated registers: the link-end bit, and the link field of the DMA
+ * status register; ADCPOLLTEST_OTHER_* bits are always set
+ */
+#define ADCPOLLTEST_LINK_END     0x00000010
+#define ADCPOLLTEST_OTHER_FLAGS  0x00000101
+#define ADCPOLLTEST_LINK_MASK    0x00003f00
+#define ADCPOLLTEST_LINK_SHIFT   8
+#define ADCPOLLTEST_OTHER_STAT   0x00004000
+
+/* ADCPOLLTEST_TIMEOUT_NS - longest wait for a flag before the thread is
+ * taken to be waiting for one that will never come
+ */
+#define ADCPOLLTEST_TIMEOUT_NS   200000000ULL
+
+
+/* ADC_SIM - the simulated board
+ *     flagReg   = interrupt flag register
+ *     statusReg = DMA status register
+ *     buf       = first word of each ring buffer: the line last put there
+ *     numLinks  = descriptors in the ring
+ *     linesPerFlag = descriptors per link-end flag
+ *     lines     = lines in the trigger train
+ *     periodNs  = PRI
+ *     raised    = time just after each group's flag was set, by group
+ *     doneNs    = time the last line was put in the ring
+ */
+typedef struct ADC_SIM
+        {
+            volatile unsigned int   flagReg;
+            volatile unsigned int   statusReg;
+            volatile unsigned int   buf[64];
+            unsigned int            numLinks;
+            unsigned int            linesPerFlag;
+            unsigned int            lines;
+            unsigned long long      periodNs;
+            unsigned long long     *raised;
+            volatile unsigned long long doneNs;
+        } ADC_SIM;
+
+
+static void  ADCPOLLTEST_Usage  (void);
+static void *ADCPOLLTEST_Engine (void *pParams);
+static void  ADCPOLLTEST_Sleep  (unsigned long long ns);
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Starts the engine and services the ring until the trigger
+              train ends, then checks what was serviced.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - test passed
+              1 - bad command line, or the test failed
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    static ADC_SIM      sim;
+    static PRI_IRQ_LOG  irqLog;
+    ADC_POLL            poll;
+    pthread_t           engine;
+    unsigned int        coalesce   = 4;
+    unsigned int        stallEvery = 50;
+    int                 flagOnly   = 0;
+    unsigned long       irqIndex   = 0;
+    unsigned long       backlog;
+    unsigned long       maxBacklog = 0;
+    unsigned long       group      = 0;
+    unsigned long       numGroups;
+    unsigned long       wrongLines = 0;
+    unsigned long       lateTimes  = 0;
+    unsigned long       untimed    = 0;
+    unsigned long long  flagTime;
+    unsigned long long  intrTime;
+    unsigned long long  endNs      = 0;
+    unsigned int        bufIndex   = 0;
+    unsigned int        doneGroups;
+    unsigned int        line;
+    int                 timedOut   = 0;
+    int                 pass;
+    int                 a;
+
+    sim.numLinks = 32;
+    sim.lines    = 20000;
+    sim.periodNs = 100000;
+    for (a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "-n") == 0) && (a + 1 < argc))
+            sim.lines = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-b") == 0) && (a + 1 < argc))
+            sim.numLinks = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-c") == 0) && (a + 1 < argc))
+            coalesce = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-p") == 0) && (a + 1 < argc))
+            sim.periodNs = (unsigned long long)atoi(argv[++a]) * 1000ULL;
+        else if ((strcmp(argv[a], "-s") == 0) && (a + 1 < argc))
+            stallEvery = (unsigned int)atoi(argv[++a]);
+        else if (strcmp(argv[a], "-f") == 0)
+            flagOnly = 1;
+        else
+        {
+            ADCPOLLTEST_Usage();
+            return (1);
+        }
+    }
+    if ((coalesce == 0) || (sim.numLinks > 64) || (sim.periodNs == 0) ||
+        (stallEvery == 0) || (sim.lines % coalesce != 0) ||
+        (sim.numLinks < 4 * coalesce))
+    {
+        ADCPOLLTEST_Usage();
+        return (1);
+    }
+    sim.linesPerFlag = coalesce;
+    numGroups  = sim.lines / coalesce;
+    sim.raised = (unsigned long long *)calloc(numGroups, sizeof(unsigned long long));
+    if (sim.raised == NULL)
+        return (1);
+    for (line = 0; line < sim.numLinks; line++)
+        sim.buf[line] = 0xffffffff;
+    sim.flagReg   = ADCPOLLTEST_OTHER_FLAGS;
+    sim.statusReg = ADCPOLLTEST_OTHER_STAT;
+
+    ADCPOLL_Init(&poll, &sim.flagReg, ADCPOLLTEST_LINK_END, 20000);
+    if (!flagOnly &&
+        (ADCPOLL_SetPosition(&poll, &sim.statusReg, ADCPOLLTEST_LINK_MASK,
+                             ADCPOLLTEST_LINK_SHIFT, sim.numLinks, coalesce) != 0))
+    {
+        printf("ERROR: NUM_DMA_BUFS must be a multiple of IRQ_COALESCE and at least twice it.\n");
+        return (1);
+    }
+    printf("%u lines, %u buffers, %u lines per flag, PRI %.0f us, a stall of "
+           "1.5 to 2.5 groups every %u groups%s\n", sim.lines, sim.numLinks,
+           coalesce, sim.periodNs / 1e3, stallEvery,
+           flagOnly ? ", flags only" : "");
+
+    if (pthread_create(&engine, NULL, ADCPOLLTEST_Engine, &sim) != 0)
+    {
+        printf("ERROR: engine thread could not be started.\n");
+        return (1);
+    }
+
+    /* as dmaThread() in poll mode */
+    for (group = 0; group < numGroups; group++)
+    {
+        while (PRISTATS_IrqCount(&irqLog) <= irqIndex)
+        {
+            if (ADCPOLL_Wait(&poll, ADCPOLLTEST_TIMEOUT_NS, &flagTime) != 0)
+            {
+                timedOut = 1;
+                break;
+            }
+            __atomic_and_fetch(&sim.flagReg, ~ADCPOLLTEST_LINK_END, __ATOMIC_ACQ_REL);
+            for (doneGroups = ADCPOLL_Completed(&poll); doneGroups > 0; doneGroups--)
+                PRISTATS_IrqStamp(&irqLog, (doneGroups == 1) ? flagTime : 0);
+        }
+        if (timedOut)
+            break;
+
+        intrTime = PRISTATS_IrqTime(&irqLog, irqIndex++, &backlog);
+        if (backlog > maxBacklog)
+            maxBacklog = backlog;
+        if (intrTime == 0)
+            untimed++;
+        else if (intrTime > sim.raised[group])
+            lateTimes++;
+
+        /* the group's own lines must still be in its buffers */
+        for (line = 0; line < coalesce; line++)
+            if (sim.buf[bufIndex + line] != group * coalesce + line)
+                wrongLines++;
+        bufIndex = (bufIndex + coalesce) % sim.numLinks;
+
+        if ((group % stallEvery) == stallEvery - 1)
+            ADCPOLLTEST_Sleep(sim.periodNs * coalesce * (3 + (group / stallEvery) % 3) / 2);
+    }
+    endNs = DMARING_TimeNs();
+    pthread_join(engine, NULL);
+
+    pass = !timedOut && (group == numGroups) && (wrongLines == 0) &&
+           (lateTimes == 0);
+    printf("%lu of %lu groups serviced, %lu line(s) found overwritten, "
+           "max backlog %lu\n", group, numGroups, wrongLines, maxBacklog);
+    printf("%lu group(s) untimed (flag lost), %lu flag time(s) later than "
+           "the flag\n", untimed, lateTimes);
+    if (timedOut)
+        printf("waited %.0f ms for a flag after the trigger train ended\n",
+               ADCPOLLTEST_TIMEOUT_NS / 1e6);
+    else
+        printf("loop ended %.1f us after the last line\n",
+               (endNs - sim.doneNs) / 1e3);
+    ADCPOLL_Report(&poll, 0);
+    printf("%s\n", pass ? "PASS" : "FAIL");
+
+    free(sim.raised);
+
+    return (pass ? 0 : 1);
+}
+
+
+/**************************************************************************
+ Function:    ADCPOLLTEST_Engine()
+
+ Description: The simulated DMA engine: puts one line in the ring every
+              period, as the registers would show it, then stops.  Lines
+              late on the clock are put in back to back.
+
+ Parameters:  pParams - pointer to the ADC_SIM
+
+ Return:      NULL
+**************************************************************************/
+static void *ADCPOLLTEST_Engine (void *pParams)
+{
+    ADC_SIM            *sim = (ADC_SIM *)pParams;
+    unsigned long long  start = DMARING_TimeNs();
+    unsigned long long  due;
+    unsigned long long  now;
+    unsigned int        link;
+    unsigned int        n;
+
+    for (n = 0; n < sim->lines; n++)
+    {
+        due = start + (n + 1) * sim->periodNs;
+        now = DMARING_TimeNs();
+        if (due > now)
+            ADCPOLLTEST_Sleep(due - now);
+
+        link = n % sim->numLinks;
+        sim->buf[link] = n;
+        __atomic_store_n(&sim->statusReg, ADCPOLLTEST_OTHER_STAT |
+                         (((link + 1) % sim->numLinks) << ADCPOLLTEST_LINK_SHIFT),
+                         __ATOMIC_RELEASE);
+        if ((n + 1) % sim->linesPerFlag == 0)
+        {
+            __atomic_or_fetch(&sim->flagReg, ADCPOLLTEST_LINK_END, __ATOMIC_RELEASE);
+            sim->raised[n / sim->linesPerFlag] = DMARING_TimeNs();
+        }
+    }
+    sim->doneNs = DMARING_TimeNs();
+
+    return (NULL);
+}
+
+
+/**************************************************************************
+ Function:    ADCPOLLTEST_Sleep()
+
+ Description: Sleeps for a time.
+
+ Parameters:  ns - time to sleep, in ns
+
+ Return:      none
+**************************************************************************/
+static void ADCPOLLTEST_Sleep (unsigned long long ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec  = ns / 1000000000ULL;
+    ts.tv_nsec = ns % 1000000000ULL;
+    nanosleep(&ts, NULL);
+}
+
+
+/**************************************************************************
+ Function:    ADCPOLLTEST_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void ADCPOLLTEST_Usage (void)
+{
+    printf("usage: adcpolltest [-n lines] [-b bufs] [-c coalesce] [-p pri_us] [-s groups] [-f]\n");
+}
@@ -0,0 +1,580 @@
+/**************************************************************************
+*
+*   File: bfp.c
+*
+*   Description: Block floating point coding of int16 I/Q range lines.
+*                See bfp.h.
+*
+*                For each block the encoder finds the largest magnitude,
+*                picks the exponent from its bit length, then rounds every
+*                value to (x + 2^(e-1)) >> e and clips it to the mantissa
+*                range.  The SSE2 kernels do the rounding add with
+*                saturation; this only changes values that are clipped
+*                anyway, so both paths give the same output.
+*
+*                Mantissas decode to mantissa << e.  Since e never exceeds
+*                16 - bits, that always fits in an int16.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BFP_SSE2             1
+#endif
+
+#include "bfp.h"
+
+
+/* BFP_ALIGN - the exponents and the whole line are padded to this */
+#define BFP_ALIGN            8
+
+
+static unsigned int BFP_Magnitude  (const int16_t *x, unsigned int n);
+static void         BFP_Quantize   (const int16_t *x, unsigned int n,
+                                    unsigned int e, unsigned int bits,
+                                    unsigned char *out);
+static void         BFP_Dequantize (const unsigned char *in, unsigned int n,
+                                    unsigned int e, unsigned int bits,
+                                    int16_t *x);
+
+
+/**************************************************************************
+ Function:    BFP_ParseBits()
+
+ Description: Reads the mantissa widths of BFP_BITS from NeXtRAD.ini text:
+              a comma separated list, one per channel from the first,
+              e.g. "8,8,0,12".  Channels not listed get 0, full 16-bit
+              lines.
+
+ Parameters:  text     - text to parse; empty for no coding
+              bits     - receives maxChans widths
+              maxChans - size of bits
+
+ Return:      0 - success
+              1 - the text is malformed or lists more than maxChans
+              2 - a width is neither 0 nor BFP_MIN_BITS to BFP_MAX_BITS
+**************************************************************************/
+int BFP_ParseBits (const char *text, int *bits, unsigned int maxChans)
+{
+    const char    *p = text;
+    char          *end;
+    unsigned long  width;
+    unsigned int   count = 0;
+
+    memset (bits, 0, maxChans * sizeof(int));
+
+    while (*p != '\0')
+    {
+        while ((*p == ' ') || (*p == '\t') || (*p == ','))
+            p++;
+        if (*p == '\0')
+            break;
+
+        if ((*p < '0') || (*p > '9') || (count >= maxChans))
+            return (1);
+        width = strtoul(p, &end, 10);
+        p     = end;
+        if ((*p != '\0') && (*p != ',') && (*p != ' ') && (*p != '\t'))
+            return (1);
+        if ((width != 0) &&
+            ((width < BFP_MIN_BITS) || (width > BFP_MAX_BITS)))
+            return (2);
+
+        bits[count++] = (int)width;
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    BFP_LineBytes()
+
+ Description: Returns the length of a coded line.
+
+ Parameters:  samples - complex samples per line
+              block   - complex samples per exponent
+              bits    - mantissa bits
+
+ Return:      bytes
+**************************************************************************/
+unsigned int BFP_LineBytes (unsigned int samples, unsigned int block,
+                            unsigned int bits)
+{
+    unsigned int numBlocks = (samples + block - 1) / block;
+    unsigned int expBytes  = (numBlocks + BFP_ALIGN - 1) & ~(BFP_ALIGN - 1);
+
+    return ((expBytes + (numBlocks * ((block * 2 * bits) / 8)) +
+             BFP_ALIGN - 1) & ~(BFP_ALIGN - 1));
+}
+
+
+/**************************************************************************
+ Function:    BFP_Init()
+
+ Description: Sets up a coder for one channel and clears its statistics.
+
+ Parameters:  coder   - pointer to the BFP_CODER to initialize
+              samples - complex samples per line
+              block   - complex samples per exponent: BFP_MIN_BLOCK to
+                        BFP_MAX_BLOCK, a multiple of BFP_BLOCK_ALIGN
+              bits    - mantissa bits, BFP_MIN_BITS to BFP_MAX_BITS
+
+ Return:      0 - success
+              1 - parameters out of range
+              2 - allocation failed
+**************************************************************************/
+int BFP_Init (BFP_CODER *coder, unsigned int samples, unsigned int block,
+              unsigned int bits)
+{
+    memset (coder, 0, sizeof(BFP_CODER));
+
+    if ((samples == 0) ||
+        (block < BFP_MIN_BLOCK) || (block > BFP_MAX_BLOCK) ||
+        ((block % BFP_BLOCK_ALIGN) != 0) ||
+        (bits < BFP_MIN_BITS) || (bits > BFP_MAX_BITS))
+        return (1);
+
+    coder->samples   = samples;
+    coder->block     = block;
+    coder->bits      = bits;
+    coder->numBlocks = (samples + block - 1) / block;
+    coder->lineBytes = BFP_LineBytes(samples, block, bits);
+
+    coder->scratch = (int16_t *)malloc((size_t)samples * 2 * sizeof(int16_t));
+    if (coder->scratch == NULL)
+        return (2);
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    BFP_Free()
+
+ Description: Frees a coder's buffers.  Its statistics are kept.
+
+ Parameters:  coder - pointer to the BFP_CODER
+
+ Return:      none
+**************************************************************************/
+void BFP_Free (BFP_CODER *coder)
+{
+    free(coder->scratch);
+    coder->scratch = NULL;
+}
+
+
+/**************************************************************************
+ Function:    BFP_Encode()
+
+ Description: Codes one line.
+
+ Parameters:  coder - pointer to an initialized BFP_CODER
+              iq    - line: interleaved I, Q, coder->samples long
+              out   - receives coder->lineBytes bytes
+
+ Return:      none
+**************************************************************************/
+void BFP_Encode (const BFP_CODER *coder, const int16_t *iq,
+                 unsigned char *out)
+{
+    int16_t         tail[2 * BFP_MAX_BLOCK];
+    const int16_t  *x;
+    unsigned char  *mant;
+    unsigned int    blockBytes = (coder->block * 2 * coder->bits) / 8;
+    unsigned int    mag;
+    unsigned int    len;
+    unsigned int    e;
+    unsigned int    n;
+    unsigned int    b;
+
+    memset (out, 0, coder->lineBytes);
+    mant = out + ((coder->numBlocks + BFP_ALIGN - 1) & ~(BFP_ALIGN - 1));
+
+    for (b = 0; b < coder->numBlocks; b++)
+    {
+        x = iq + (2 * b * coder->block);
+        n = coder->samples - (b * coder->block);
+        if (n < coder->block)
+        {
+            memset (tail, 0, coder->block * 2 * sizeof(int16_t));
+            memcpy (tail, x, n * 2 * sizeof(int16_t));
+            x = tail;
+        }
+
+        /* shift the largest magnitude down to bits - 1 bits */
+        mag = BFP_Magnitude(x, 2 * coder->block);
+        e   = 0;
+        for (len = 0; mag != 0; len++)
+            mag >>= 1;
+        if (len > coder->bits - 1)
+            e = len - (coder->bits - 1);
+
+        out[b] = (unsigned char)e;
+        BFP_Quantize(x, 2 * coder->block, e, coder->bits, mant);
+        mant += blockBytes;
+    }
+}
+
+
+/**************************************************************************
+ Function:    BFP_Decode()
+
+ Description: Decodes one line.
+
+ Parameters:  coder - pointer to an initialized BFP_CODER
+              in    - coded line, coder->lineBytes long
+              iq    - receives coder->samples I/Q pairs
+
+ Return:      none
+**************************************************************************/
+void BFP_Decode (const BFP_CODER *coder, const unsigned char *in,
+                 int16_t *iq)
+{
+    int16_t              tail[2 * BFP_MAX_BLOCK];
+    const unsigned char *mant;
+    unsigned int         blockBytes = (coder->block * 2 * coder->bits) / 8;
+    unsigned int         e;
+    unsigned int         n;
+    unsigned int         b;
+
+    mant = in + ((coder->numBlocks + BFP_ALIGN - 1) & ~(BFP_ALIGN - 1));
+
+    for (b = 0; b < coder->numBlocks; b++)
+    {
+        /* a corrupt exponent must not shift values out of an int16 */
+        e = in[b];
+        if (e > 16 - coder->bits)
+            e = 16 - coder->bits;
+
+        n = coder->samples - (b * coder->block);
+        if (n >= coder->block)
+            BFP_Dequantize(mant, 2 * coder->block, e, coder->bits,
+                           iq + (2 * b * coder->block));
+        else
+        {
+            BFP_Dequantize(mant, 2 * coder->block, e, coder->bits, tail);
+            memcpy (iq + (2 * b * coder->block), tail,
+                    n * 2 * sizeof(int16_t));
+        }
+        mant += blockBytes;
+    }
+}
+
+
+/**************************************************************************
+ Function:    BFP_Measure()
+
+ Description: Adds one line to a coder's error statistics, by decoding it
+              and comparing it with the original.
+
+ Parameters:  coder - pointer to an initialized BFP_CODER
+              iq    - the line before coding
+              coded - the line as coded by BFP_Encode()
+
+ Return:      none
+**************************************************************************/
+void BFP_Measure (BFP_CODER *coder, const int16_t *iq,
+                  const unsigned char *coded)
+{
+    double        sig;
+    double        err;
+    double        quietSig = -1.0;
+    double        quietErr = 0.0;
+    unsigned int  first;
+    unsigned int  end;
+    unsigned int  i;
+    int           d;
+
+    BFP_Decode(coder, coded, coder->scratch);
+
+    for (first = 0; first < coder->samples * 2; first += coder->block * 2)
+    {
+        end = first + (coder->block * 2);
+        if (end > coder->samples * 2)
+            end = coder->samples * 2;
+
+        sig = 0.0;
+        err = 0.0;
+        for (i = first; i < end; i++)
+        {
+            d    = iq[i] - coder->scratch[i];
+            sig += (double)iq[i] * iq[i];
+            err += (double)d * d;
+            if (abs(d) > coder->maxError)
+                coder->maxError = abs(d);
+        }
+
+        coder->sigPower += sig;
+        coder->errPower += err;
+        if ((quietSig < 0.0) || (sig < quietSig))
+        {
+            quietSig = sig;
+            quietErr = err;
+        }
+    }
+
+    coder->quietSig += quietSig;
+    coder->quietErr += quietErr;
+    coder->measured++;
+}
+
+
+/**************************************************************************
+ Function:    BFP_Report()
+
+ Description: Prints the size reduction, the coding rate and the error
+              statistics.  The quietest block of each line is taken to be
+              receiver noise only; coding noise adds to it, so the SNR of
+              a target is reduced by 10 log10(1 + coding / receiver noise)
+              when it competes with the noise floor rather than with
+              clutter.
+
+ Parameters:  coder   - pointer to a BFP_CODER
+              chanNum - ADC channel number
+
+ Return:      none
+**************************************************************************/
+void BFP_Report (const BFP_CODER *coder, int chanNum)
+{
+    unsigned int rawBytes = coder->samples * 2 * sizeof(int16_t);
+
+    printf("[dmaThread %d] bfp: %u-bit mantissas, %u-sample blocks, "
+           "%u -> %u bytes per line, ratio %.2f\n", chanNum+1, coder->bits,
+           coder->block, rawBytes, coder->lineBytes,
+           (double)rawBytes / coder->lineBytes);
+
+    if (coder->encodeNs != 0)
+        printf("[dmaThread %d] bfp: %llu lines coded at %.1f MB/s\n",
+               chanNum+1, coder->lines,
+               ((double)coder->lines * rawBytes) /
+               ((double)coder->encodeNs / 1e9) / 1e6);
+
+    if (coder->measured == 0)
+        return;
+
+    if (coder->errPower == 0.0)
+    {
+        printf("[dmaThread %d] bfp: %llu lines measured, no coding error\n",
+               chanNum+1, coder->measured);
+        return;
+    }
+
+    printf("[dmaThread %d] bfp: %llu lines measured, SQNR %.1f dB, "
+           "max error %d\n", chanNum+1, coder->measured,
+           10.0 * log10(coder->sigPower / coder->errPower),
+           coder->maxError);
+
+    if (coder->quietErr == 0.0)
+        printf("[dmaThread %d] bfp: quietest block of each line: no coding "
+               "error, no SNR loss\n", chanNum+1);
+    else
+        printf("[dmaThread %d] bfp: quietest block of each line: SQNR %.1f "
+               "dB, SNR loss %.3f dB\n", chanNum+1,
+               10.0 * log10(coder->quietSig / coder->quietErr),
+               10.0 * log10(1.0 + (coder->quietErr / coder->quietSig)));
+}
+
+
+/**************************************************************************
+ Function:    BFP_Magnitude()
+
+ Description: Returns the largest magnitude in a block, counting a
+              negative value x as -x - 1 so that its bit length is the
+              number of bits it needs besides the sign.
+
+ Parameters:  x - values
+              n - number of values, a multiple of 16
+
+ Return:      magnitude
+**************************************************************************/
+static unsigned int BFP_Magnitude (const int16_t *x, unsigned int n)
+{
+#if defined(BFP_SSE2)
+    __m128i      vmax = _mm_setzero_si128();
+    __m128i      vmin = _mm_setzero_si128();
+    __m128i      v;
+    unsigned int i;
+
+    for (i = 0; i < n; i += 8)
+    {
+        v    = _mm_loadu_si128((const __m128i *)(x + i));
+        vmax = _mm_max_epi16(vmax, v);
+        vmin = _mm_min_epi16(vmin, v);
+    }
+
+    /* fold ~min into max, then reduce the 8 lanes */
+    vmax = _mm_max_epi16(vmax, _mm_xor_si128(vmin, _mm_set1_epi16(-1)));
+    vmax = _mm_max_epi16(vmax, _mm_srli_si128(vmax, 8));
+    vmax = _mm_max_epi16(vmax, _mm_srli_si128(vmax, 4));
+    vmax = _mm_max_epi16(vmax, _mm_srli_si128(vmax, 2));
+
+    return ((unsigned int)(_mm_cvtsi128_si32(vmax) & 0x7FFF));
+#else
+    int          mag = 0;
+    int          v;
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+    {
+        v = (x[i] < 0) ? -x[i] - 1 : x[i];
+        if (v > mag)
+            mag = v;
+    }
+
+    return ((unsigned int)mag);
+#endif
+}
+
+
+/**************************************************************************
+ Function:    BFP_Quantize()
+
+ Description: Rounds a block to mantissas of exponent e and packs them.
+
+ Parameters:  x    - values
+              n    - number of values, a multiple of 16
+              e    - exponent
+              bits - mantissa bits
+              out  - receives n * bits / 8 bytes
+
+ Return:      none
+**************************************************************************/
+static void BFP_Quantize (const int16_t *x, unsigned int n, unsigned int e,
+                          unsigned int bits, unsigned char *out)
+{
+    int16_t       mant[2 * BFP_MAX_BLOCK];
+    int           round = (e != 0) ? (1 << (e - 1)) : 0;
+    int           hi    = (1 << (bits - 1)) - 1;
+    int           lo    = -(1 << (bits - 1));
+    uint64_t      acc   = 0;
+    unsigned int  fill  = 0;
+    unsigned int  i;
+    int           v;
+#if defined(BFP_SSE2)
+    __m128i       vround = _mm_set1_epi16((short)round);
+    __m128i       vhi    = _mm_set1_epi16((short)hi);
+    __m128i       vlo    = _mm_set1_epi16((short)lo);
+    __m128i       shift  = _mm_cvtsi32_si128((int)e);
+    __m128i       a, b;
+
+    /* 8-bit mantissas: the pack saturates to the mantissa range */
+    if (bits == 8)
+    {
+        for (i = 0; i < n; i += 16)
+        {
+            a = _mm_loadu_si128((const __m128i *)(x + i));
+            b = _mm_loadu_si128((const __m128i *)(x + i + 8));
+            a = _mm_sra_epi16(_mm_adds_epi16(a, vround), shift);
+            b = _mm_sra_epi16(_mm_adds_epi16(b, vround), shift);
+            _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi16(a, b));
+        }
+        return;
+    }
+
+    for (i = 0; i < n; i += 8)
+    {
+        a = _mm_loadu_si128((const __m128i *)(x + i));
+        a = _mm_sra_epi16(_mm_adds_epi16(a, vround), shift);
+        a = _mm_min_epi16(_mm_max_epi16(a, vlo), vhi);
+        _mm_storeu_si128((__m128i *)(mant + i), a);
+    }
+#else
+    for (i = 0; i < n; i++)
+    {
+        v = (x[i] + round) >> e;
+        mant[i] = (int16_t)((v > hi) ? hi : ((v < lo) ? lo : v));
+    }
+#endif
+
+    for (i = 0; i < n; i++)
+    {
+        v     = mant[i];
+        acc  |= (uint64_t)((unsigned int)v & ((1U << bits) - 1)) << fill;
+        fill += bits;
+        while (fill >= 8)
+        {
+            *out++ = (unsigned char)acc;
+            acc  >>= 8;
+            fill  -= 8;
+        }
+    }
+}
+
+
+/**************************************************************************
+ Function:    BFP_Dequantize()
+
+ Description: Unpacks a block's mantissas and scales them by 2^e.
+
+ Parameters:  in   - n * bits / 8 bytes of packed mantissas
+              n    - number of values, a multiple of 16
+              e    - exponent, no more than 16 - bits
+              bits - mantissa bits
+              x    - receives the values
+
+ Return:      none
+**************************************************************************/
+static void BFP_Dequantize (const unsigned char *in, unsigned int n,
+                            unsigned int e, unsigned int bits, int16_t *x)
+{
+    uint64_t      acc   = 0;
+    unsigned int  fill  = 0;
+    unsigned int  sign  = 1U << (bits - 1);
+    unsigned int  i;
+    unsigned int  v;
+#if defined(BFP_SSE2)
+    __m128i       zero  = _mm_setzero_si128();
+    __m128i       shift = _mm_cvtsi32_si128((int)e);
+    __m128i       m;
+
+    /* 8-bit mantissas: move each into the top byte of its lane, then an
+     * arithmetic shift sign extends it and applies the exponent at once
+     */
+    if (bits == 8)
+    {
+        shift = _mm_cvtsi32_si128((int)(8 - e));
+        for (i = 0; i < n; i += 16)
+        {
+            m = _mm_loadu_si128((const __m128i *)(in + i));
+            _mm_storeu_si128((__m128i *)(x + i),
+                             _mm_sra_epi16(_mm_unpacklo_epi8(zero, m), shift));
+            _mm_storeu_si128((__m128i *)(x + i + 8),
+                             _mm_sra_epi16(_mm_unpackhi_epi8(zero, m), shift));
+        }
+        return;
+    }
+#endif
+
+    for (i = 0; i < n; i++)
+    {
+        while (fill < bits)
+        {
+            acc  |= (uint64_t)(*in++) << fill;
+            fill += 8;
+        }
+        v     = (unsigned int)acc & ((1U << bits) - 1);
+        acc >>= bits;
+        fill -= bits;
+
+        x[i]  = (int16_t)((int)(v ^ sign) - (int)sign);
+    }
+
+    /* the shift stays inside an int16 */
+#if defined(BFP_SSE2)
+    for (i = 0; i < n; i += 8)
+    {
+        m = _mm_loadu_si128((const __m128i *)(x + i));
+        _mm_storeu_si128((__m128i *)(x + i), _mm_sll_epi16(m, shift));
+    }
+#else
+    for (i = 0; i < n; i++)
+        x[i] = (int16_t)(x[i] * (1 << e));
+#endif
+}
@@ -0,0 +1,134 @@
+/***********************************************************************
+*
+*   File: bfp.h
+*
+*   Description: header file for bfp.c, block floating point coding of
+*                int16 I/Q range lines: a lossy, fixed-length format for
+*                channels whose lines do not need the full 16 bits.
+*
+*                Set from NeXtRAD.ini:
+*                    BFP_BITS  - mantissa bits for each channel, e.g.
+*                                "8,8,0,0"; 0 = write the channel's lines
+*                                as they are
+*                    BFP_BLOCK - complex samples sharing one exponent
+*
+*                Each block of BFP_BLOCK complex samples is stored as a
+*                shared exponent e and a bits-wide signed mantissa for
+*                every I and Q value; the value read back is mantissa << e.
+*                e is the smallest shift that fits the block's largest
+*                value into the mantissa, so the quantisation error in
+*                each block scales with the signal in it.  Blocks of noise
+*                then keep roughly the same SNR as blocks holding targets.
+*
+*                A coded line is:
+*
+*                    one exponent byte per block, zero padded to 8 bytes
+*                    per block: 2 * block mantissas, bits wide, packed LSB
+*                    first
+*                    zero padding to 8 bytes
+*
+*                so every line of a channel codes to the same length
+*                (BFP_LineBytes()).  A short last block is coded as if
+*                zero filled.  With 8-bit mantissas and 32-sample blocks
+*                a line takes 51% of its int16 size.
+*
+*                The 8-bit kernels use SSE2, which every x86_64 CPU has;
+*                other widths and other CPUs use the same arithmetic in
+*                plain C.
+*
+************************************************************************/
+
+#ifndef __BFP_H__
+#define __BFP_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* BFP_MIN_BITS / BFP_MAX_BITS - mantissa widths supported;
+ * BFP_MIN_BLOCK / BFP_MAX_BLOCK - block sizes supported, in complex
+ *                                 samples; must also be a multiple of
+ *                                 BFP_BLOCK_ALIGN
+ */
+#define BFP_MIN_BITS         2
+#define BFP_MAX_BITS         12
+#define BFP_MIN_BLOCK        8
+#define BFP_MAX_BLOCK        1024
+#define BFP_BLOCK_ALIGN      8
+
+/* BFP_MEASURE_EVERY - the writer measures the coding error on one line
+ * in this many
+ */
+#define BFP_MEASURE_EVERY    16
+
+
+/* BFP_CODER - coding parameters and error statistics for one channel
+ *     samples   = complex samples per line
+ *     block     = complex samples per exponent
+ *     bits      = mantissa bits
+ *     numBlocks = blocks per line
+ *     lineBytes = bytes of each coded line
+ *     scratch   = a decoded line, for BFP_Measure()
+ *
+ *   statistics, over the lines measured:
+ *     lines     = lines coded
+ *     encodeNs  = time spent coding them, in ns (kept by the caller)
+ *     measured  = lines measured
+ *     sigPower  = sum of the squared samples
+ *     errPower  = sum of the squared coding errors
+ *     maxError  = largest coding error of any sample
+ *     quietSig  = sum over lines of the power of the line's quietest block
+ *     quietErr  = sum over lines of the coding error power in that block
+ */
+typedef struct BFP_CODER
+        {
+            unsigned int        samples;
+            unsigned int        block;
+            unsigned int        bits;
+            unsigned int        numBlocks;
+            unsigned int        lineBytes;
+            int16_t            *scratch;
+
+            unsigned long long  lines;
+            unsigned long long  encodeNs;
+            unsigned long long  measured;
+            double              sigPower;
+            double              errPower;
+            int                 maxError;
+            double              quietSig;
+            double              quietErr;
+        } BFP_CODER;
+
+
+/* function prototypes */
+int          BFP_ParseBits (const char          *text,
+                            int                 *bits,
+                            unsigned int         maxChans);
+unsigned int BFP_LineBytes (unsigned int         samples,
+                            unsigned int         block,
+                            unsigned int         bits);
+int          BFP_Init      (BFP_CODER           *coder,
+                            unsigned int         samples,
+                            unsigned int         block,
+                            unsigned int         bits);
+void         BFP_Free      (BFP_CODER           *coder);
+void         BFP_Encode    (const BFP_CODER     *coder,
+                            const int16_t       *iq,
+                            unsigned char       *out);
+void         BFP_Decode    (const BFP_CODER     *coder,
+                            const unsigned char *in,
+                            int16_t             *iq);
+void         BFP_Measure   (BFP_CODER           *coder,
+                            const int16_t       *iq,
+                            const unsigned char *coded);
+void         BFP_Report    (const BFP_CODER     *coder,
+                            int                  chanNum);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BFP_H__ */
@@ -0,0 +1,843 @@
+/**************************************************************************
+*
+*   File: cfar.c
+*
+*   Description: CFAR detection on range-Doppler maps.  See cfar.h.
+*
+*                Cell averaging goes down the map a row (range bin) at a
+*                time, doing every Doppler column of the row together.  It
+*                keeps prefix sums down each column:
+*                row r of prefix is the sum of map rows 0 to r - 1, so
+*                a window's sum is the difference of two prefix rows.
+*                The sums are of the cells less the map's mean, which
+*                keeps them small and so keeps their rounding well
+*                under IQK_DB_ERROR even on long maps.  A prefix row is
+*                made just before the first row that needs it.  The
+*                AVX2 kernels give the same results as the plain C ones:
+*                the same operations in the same order, no FMA.
+*
+*                Ordered statistic instead goes down the map a block of
+*                CFAR_OS_BLOCK columns at a time, keeping a histogram per
+*                column of its training cells' codes, (dB - base) /
+*                CFAR_OS_STEP_DB, and a count per group of CFAR_OS_GROUP
+*                codes.  Moving the window down a row adds two rows and
+*                removes two.
+*                The rank'th code is found from the group the column's
+*                last search ended in, which the noise seldom moves far
+*                from, so a search is a step or two through the groups
+*                and at most CFAR_OS_GROUP through the codes.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CFAR_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#include "cfar.h"
+#include "dmaring.h"
+
+
+/* CFAR_MEAN_STRIDE - every CFAR_MEAN_STRIDE'th row goes into the map's
+ * mean; it only centres the sums and histograms, so need not be exact
+ */
+#define CFAR_MEAN_STRIDE     16
+
+#define CFAR_OS_GROUPS       (CFAR_OS_CODES / CFAR_OS_GROUP)
+
+
+static float        CFAR_Mean       (const CFAR *cf, const float *map);
+static void         CFAR_Keep       (CFAR *cf, const float *row,
+                                     unsigned int r, unsigned int count,
+                                     unsigned long long cpi);
+static void         CFAR_DetectCa   (CFAR *cf, const float *map,
+                                     unsigned long long cpi);
+static void         CFAR_OsRow      (CFAR *cf, const float *row,
+                                     unsigned int n, float base,
+                                     uint16_t delta);
+static int          CFAR_DetOrder   (const void *a, const void *b);
+static void         CFAR_DetectOs   (CFAR *cf, const float *map,
+                                     unsigned long long cpi);
+static void         CFAR_ScalarSum  (const float *sum, const float *cell,
+                                     float offset, unsigned int cols,
+                                     float *next);
+static unsigned int CFAR_ScalarRow  (const float *cell, const float *lead0,
+                                     const float *lead1, const float *lag0,
+                                     const float *lag1, float scale,
+                                     float offset, float thresholdDb,
+                                     unsigned int cols, float *noise,
+                                     uint16_t *hits);
+static void         CFAR_Free       (CFAR *cf);
+
+#ifdef CFAR_HAVE_AVX2
+static void         CFAR_Avx2Sum    (const float *sum, const float *cell,
+                                     float offset, unsigned int cols,
+                                     float *next);
+static unsigned int CFAR_Avx2Row    (const float *cell, const float *lead0,
+                                     const float *lead1, const float *lag0,
+                                     const float *lag1, float scale,
+                                     float offset, float thresholdDb,
+                                     unsigned int cols, float *noise,
+                                     uint16_t *hits);
+#endif
+
+
+/**************************************************************************
+ Function:    CFAR_Start()
+
+ Description: Sets up a detection stage for maps of a given size and
+              opens detN.dat.
+
+ Parameters:  cf          - pointer to the CFAR to set up
+              method      - CFAR_CA or CFAR_OS
+              rows        - range bins of a map, up to 65536
+              cols        - Doppler bins of a map, up to 65536
+              guard       - guard cells each side
+              train       - training cells each side, 1 to
+                            CFAR_MAX_TRAIN
+              rank        - CFAR_OS's rank, 1 to 2 x train; 0 = 3/4 of
+                            2 x train
+              thresholdDb - detection threshold over the noise estimate
+              outfileName - detN.dat to write, or NULL
+
+ Return:      0 - success
+              1 - invalid method, size, window or rank
+              2 - allocation or file open failed
+**************************************************************************/
+int CFAR_Start (CFAR          *cf,
+                int            method,
+                unsigned int   rows,
+                unsigned int   cols,
+                unsigned int   guard,
+                unsigned int   train,
+                unsigned int   rank,
+                float          thresholdDb,
+                const char    *outfileName)
+{
+    size_t prefixFloats = ((size_t)rows + 1) * cols;
+
+    memset (cf, 0, sizeof(CFAR));
+
+    if (rank == 0)
+        rank = (3 * 2 * train + 3) / 4;
+    if (((method != CFAR_CA) && (method != CFAR_OS)) ||
+        (rows == 0) || (rows > 65536) || (cols == 0) || (cols > 65536) ||
+        (train == 0) || (train > CFAR_MAX_TRAIN) || (guard > rows) ||
+        (rank > 2 * train))
+        return (1);
+
+    cf->method      = method;
+    cf->rows        = rows;
+    cf->cols        = cols;
+    cf->guard       = guard;
+    cf->train       = train;
+    cf->rank        = rank;
+    cf->thresholdDb = thresholdDb;
+    cf->caSum       = CFAR_ScalarSum;
+    cf->caRow       = CFAR_ScalarRow;
+    cf->kernelName  = "scalar";
+
+#ifdef CFAR_HAVE_AVX2
+    __builtin_cpu_init();
+    if ((method == CFAR_CA) && __builtin_cpu_supports("avx2"))
+    {
+        cf->caSum      = CFAR_Avx2Sum;
+        cf->caRow      = CFAR_Avx2Row;
+        cf->kernelName = "avx2";
+    }
+#endif
+
+    /* calloc and fill now, so the buffers are not faulted in (and
+     * locked) during the run; prefix row 0 stays zero
+     */
+    if (method == CFAR_CA)
+    {
+        cf->prefix = (float *)calloc(prefixFloats, sizeof(float));
+        if (cf->prefix == NULL)
+        {
+            CFAR_Free(cf);
+            return (2);
+        }
+        memset (cf->prefix, 0, prefixFloats * sizeof(float));
+    }
+    else
+    {
+        cf->hist   = (uint16_t *)calloc(CFAR_OS_BLOCK * CFAR_OS_CODES, sizeof(uint16_t));
+        cf->groups = (uint16_t *)calloc(CFAR_OS_BLOCK * CFAR_OS_GROUPS, sizeof(uint16_t));
+        cf->pivot  = (uint16_t *)calloc(CFAR_OS_BLOCK, sizeof(uint16_t));
+        cf->below  = (uint16_t *)calloc(CFAR_OS_BLOCK, sizeof(uint16_t));
+        if ((cf->hist == NULL) || (cf->groups == NULL) ||
+            (cf->pivot == NULL) || (cf->below == NULL))
+        {
+            CFAR_Free(cf);
+            return (2);
+        }
+    }
+
+    cf->noise = (float *)calloc(cols, sizeof(float));
+    cf->hits  = (uint16_t *)calloc(cols, sizeof(uint16_t));
+    cf->det   = (CFAR_DET *)calloc(CFAR_MAX_DETECTIONS, sizeof(CFAR_DET));
+    if ((cf->noise == NULL) || (cf->hits == NULL) || (cf->det == NULL))
+    {
+        CFAR_Free(cf);
+        return (2);
+    }
+    memset (cf->det, 0, CFAR_MAX_DETECTIONS * sizeof(CFAR_DET));
+
+    if (outfileName != NULL)
+    {
+        cf->outfile = fopen(outfileName, "wb");
+        if (cf->outfile == NULL)
+        {
+            CFAR_Free(cf);
+            return (2);
+        }
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    CFAR_UseScalar()
+
+ Description: Puts a cell averaging stage on the plain C kernels, for
+              comparison with the AVX2 ones (cfartest).
+
+ Parameters:  cf - pointer to a started stage
+
+ Return:      none
+**************************************************************************/
+void CFAR_UseScalar (CFAR *cf)
+{
+    cf->caSum      = CFAR_ScalarSum;
+    cf->caRow      = CFAR_ScalarRow;
+    cf->kernelName = "scalar";
+}
+
+
+/**************************************************************************
+ Function:    CFAR_Detect()
+
+ Description: Searches a map, leaves its detections in cf->det and
+              writes them to detN.dat.
+
+ Parameters:  cf  - pointer to the stage
+              map - rows x cols dB, as rdop.c makes it
+              cpi - CPI the map was made from
+
+ Return:      detections kept in cf->det
+**************************************************************************/
+unsigned int CFAR_Detect (CFAR *cf, const float *map, unsigned long long cpi)
+{
+    unsigned long long ns = DMARING_TimeNs();
+
+    cf->numDets = 0;
+    if (cf->method == CFAR_CA)
+        CFAR_DetectCa(cf, map, cpi);
+    else
+        CFAR_DetectOs(cf, map, cpi);
+
+    if ((cf->outfile != NULL) && (cf->numDets != 0) &&
+        (fwrite(cf->det, sizeof(CFAR_DET), cf->numDets, cf->outfile) != cf->numDets))
+        cf->writeError = 1;
+
+    ns = DMARING_TimeNs() - ns;
+    cf->totalNs += ns;
+    if (ns > cf->maxNs)
+        cf->maxNs = ns;
+    cf->maps++;
+
+    return (cf->numDets);
+}
+
+
+/**************************************************************************
+ Function:    CFAR_Stop()
+
+ Description: Closes detN.dat and frees the buffers.  Call once no more
+              maps will be searched.
+
+ Parameters:  cf - pointer to the stage
+
+ Return:      0 - success
+              1 - a write to detN.dat failed
+**************************************************************************/
+int CFAR_Stop (CFAR *cf)
+{
+    if ((cf->outfile != NULL) && (fclose(cf->outfile) != 0))
+        cf->writeError = 1;
+    cf->outfile = NULL;
+
+    CFAR_Free(cf);
+
+    return (cf->writeError);
+}
+
+
+/**************************************************************************
+ Function:    CFAR_Report()
+
+ Description: Prints the detector's settings, the maps searched and
+              detections found, and the time a map took.
+
+ Parameters:  cf      - pointer to a stopped stage
+              chanNum - ADC channel number
+
+ Return:      none
+**************************************************************************/
+void CFAR_Report (CFAR *cf, int chanNum)
+{
+    printf("[dmaThread %d] cfar: %s (%s), guard %u, train %u",
+           chanNum+1, CFAR_Name(cf->method), cf->kernelName, cf->guard,
+           cf->train);
+    if (cf->method == CFAR_OS)
+        printf(", rank %u", cf->rank);
+    printf(", threshold %.1f dB, %llu map(s), %llu detection(s)",
+           cf->thresholdDb, cf->maps, cf->detections);
+    if (cf->overLimit != 0)
+        printf(", %llu over the limit of %d a map", cf->overLimit,
+               CFAR_MAX_DETECTIONS);
+    printf("\n");
+
+    if (cf->maps != 0)
+        printf("[dmaThread %d] cfar: %.2f ms per map (max %.2f ms), "
+               "%.2f ns per cell\n", chanNum+1,
+               ((double)cf->totalNs / cf->maps) / 1e6, (double)cf->maxNs / 1e6,
+               (double)cf->totalNs / ((double)cf->maps * cf->rows * cf->cols));
+}
+
+
+/**************************************************************************
+ Function:    CFAR_Name()
+
+ Description: Gives the name of a CFAR method, for reports.
+
+ Parameters:  method - CFAR_OFF, CFAR_CA or CFAR_OS
+
+ Return:      name of the method
+**************************************************************************/
+const char *CFAR_Name (int method)
+{
+    switch (method)
+    {
+        case CFAR_OFF: return ("off");
+        case CFAR_CA:  return ("cell averaging");
+        case CFAR_OS:  return ("ordered statistic");
+        default:       return ("unknown");
+    }
+}
+
+
+/**************************************************************************
+ Function:    CFAR_Mean()
+
+ Description: Mean of every CFAR_MEAN_STRIDE'th row of a map.
+
+ Parameters:  cf  - pointer to the stage
+              map - the map
+
+ Return:      the mean, in dB
+**************************************************************************/
+static float CFAR_Mean (const CFAR *cf, const float *map)
+{
+    const float  *row;
+    double        sum = 0.0;
+    unsigned int  n   = 0;
+    unsigned int  r;
+    unsigned int  k;
+
+    for (r = 0; r < cf->rows; r += CFAR_MEAN_STRIDE)
+    {
+        row = map + ((size_t)r * cf->cols);
+        for (k = 0; k < cf->cols; k++)
+            sum += row[k];
+        n++;
+    }
+
+    return ((float)(sum / ((double)n * cf->cols)));
+}
+
+
+/**************************************************************************
+ Function:    CFAR_Keep()
+
+ Description: Adds a row's hits to the map's detections.
+
+ Parameters:  cf    - pointer to the stage; hits and noise hold the row's
+                      results
+              row   - the row's cells
+              r     - the row's range bin
+              count - entries of hits
+              cpi   - CPI of the map
+
+ Return:      none
+**************************************************************************/
+static void CFAR_Keep (CFAR *cf, const float *row, unsigned int r,
+                       unsigned int count, unsigned long long cpi)
+{
+    CFAR_DET     *d;
+    unsigned int  i;
+    unsigned int  k;
+
+    cf->detections += count;
+    for (i = 0; i < count; i++)
+    {
+        if (cf->numDets == CFAR_MAX_DETECTIONS)
+        {
+            cf->overLimit += count - i;
+            return;
+        }
+        k = cf->hits[i];
+        d = &(cf->det[cf->numDets++]);
+        d->cpi        = (uint32_t)cpi;
+        d->rangeBin   = (uint16_t)r;
+        d->dopplerBin = (uint16_t)k;
+        d->powerDb    = row[k];
+        d->noiseDb    = cf->noise[k];
+    }
+}
+
+
+/**************************************************************************
+ Function:    CFAR_DetectCa()
+
+ Description: Cell averaging search of a map.  Row r's window is prefix
+              rows r - guard - train to r - guard before it and
+              r + guard + 1 to r + guard + train + 1 after it, each
+              clipped to the map.
+
+ Parameters:  cf  - pointer to the stage
+              map - the map
+              cpi - CPI of the map
+
+ Return:      none
+**************************************************************************/
+static void CFAR_DetectCa (CFAR *cf, const float *map, unsigned long long cpi)
+{
+    unsigned int  cols   = cf->cols;
+    unsigned int  reach  = cf->guard + cf->train;
+    unsigned int  built  = 0;
+    float         offset = CFAR_Mean(cf, map);
+    const float  *row;
+    unsigned int  r;
+    unsigned int  leadLo, leadHi;
+    unsigned int  lagLo, lagHi;
+    unsigned int  count;
+
+    for (r = 0; r < cf->rows; r++)
+    {
+        leadHi = (r > cf->guard) ? (r - cf->guard) : 0;
+        leadLo = (r > reach) ? (r - reach) : 0;
+        lagLo  = r + cf->guard + 1;
+        lagHi  = r + reach + 1;
+        if (lagLo > cf->rows)
+            lagLo = cf->rows;
+        if (lagHi > cf->rows)
+            lagHi = cf->rows;
+
+        while (built < lagHi)
+        {
+            cf->caSum(cf->prefix + ((size_t)built * cols),
+                      map + ((size_t)built * cols), offset, cols,
+                      cf->prefix + ((size_t)(built + 1) * cols));
+            built++;
+        }
+
+        if ((leadHi - leadLo) + (lagHi - lagLo) == 0)
+            continue;
+
+        row   = map + ((size_t)r * cols);
+        count = cf->caRow(row,
+                          cf->prefix + ((size_t)leadLo * cols),
+                          cf->prefix + ((size_t)leadHi * cols),
+                          cf->prefix + ((size_t)lagLo * cols),
+                          cf->prefix + ((size_t)lagHi * cols),
+                          1.0f / (float)((leadHi - leadLo) + (lagHi - lagLo)),
+                          offset, cf->thresholdDb, cols, cf->noise, cf->hits);
+        if (count != 0)
+            CFAR_Keep(cf, row, r, count, cpi);
+    }
+}
+
+
+/**************************************************************************
+ Function:    CFAR_OsRow()
+
+ Description: Adds a block's part of a map row to, or takes it from, the
+              block's histograms.
+
+ Parameters:  cf    - pointer to the stage
+              row   - the block's first cell of the row
+              n     - columns in the block
+              base  - dB of code 0
+              delta - 1 to add, -1 (as uint16) to take away
+
+ Return:      none
+**************************************************************************/
+static void CFAR_OsRow (CFAR *cf, const float *row, unsigned int n, float base,
+                        uint16_t delta)
+{
+    uint16_t     *hist   = cf->hist;
+    uint16_t     *groups = cf->groups;
+    unsigned int  j;
+    unsigned int  c;
+    float         x;
+
+    /* clamped as a float and truncated, and below updated without a
+     * branch: which side of the pivot a cell falls is a coin toss the
+     * branch predictor loses
+     */
+    for (j = 0; j < n; j++)
+    {
+        x = (row[j] - base) * (1.0f / CFAR_OS_STEP_DB);
+        x = (x > 0.0f) ? x : 0.0f;
+        x = (x < (float)(CFAR_OS_CODES - 1)) ? x : (float)(CFAR_OS_CODES - 1);
+        c = (unsigned int)x;
+
+        hist[c] += delta;
+        groups[c / CFAR_OS_GROUP] += delta;
+        cf->below[j] += delta * (uint16_t)((c / CFAR_OS_GROUP) < cf->pivot[j]);
+
+        hist   += CFAR_OS_CODES;
+        groups += CFAR_OS_GROUPS;
+    }
+}
+
+
+/**************************************************************************
+ Function:    CFAR_DetOrder()
+
+ Description: qsort() comparison putting detections in range bin, then
+              Doppler bin, order.
+
+ Parameters:  a, b - the CFAR_DETs to compare
+
+ Return:      <0, 0 or >0 as a is before, with or after b
+**************************************************************************/
+static int CFAR_DetOrder (const void *a, const void *b)
+{
+    const CFAR_DET *da = (const CFAR_DET *)a;
+    const CFAR_DET *db = (const CFAR_DET *)b;
+
+    if (da->rangeBin != db->rangeBin)
+        return ((int)da->rangeBin - (int)db->rangeBin);
+    return ((int)da->dopplerBin - (int)db->dopplerBin);
+}
+
+
+/**************************************************************************
+ Function:    CFAR_DetectOs()
+
+ Description: Ordered statistic search of a map, CFAR_OS_BLOCK columns at
+              a time from top to bottom.  The window is the one
+              CFAR_DetectCa() uses; the rank is scaled down where the
+              map's ends clip it.  The detections are sorted at the end,
+              so if there are more than CFAR_MAX_DETECTIONS those kept
+              are the first columns'.
+
+ Parameters:  cf  - pointer to the stage
+              map - the map
+              cpi - CPI of the map
+
+ Return:      none
+**************************************************************************/
+static void CFAR_DetectOs (CFAR *cf, const float *map, unsigned long long cpi)
+{
+    unsigned int     cols  = cf->cols;
+    unsigned int     rows  = cf->rows;
+    unsigned int     guard = cf->guard;
+    unsigned int     reach = cf->guard + cf->train;
+    float            base  = CFAR_Mean(cf, map) -
+                             (CFAR_OS_CODES / 2) * CFAR_OS_STEP_DB;
+    const float     *cell;
+    const uint16_t  *hist;
+    const uint16_t  *groups;
+    CFAR_DET        *d;
+    unsigned int     first;
+    unsigned int     width;
+    unsigned int     r;
+    unsigned int     i;
+    unsigned int     j;
+    unsigned int     n;
+    unsigned int     want;
+    unsigned int     g;
+    unsigned int     c;
+    unsigned int     cum;
+    float            noise;
+
+    for (first = 0; first < cols; first += CFAR_OS_BLOCK)
+    {
+        width = cols - first;
+        if (width > CFAR_OS_BLOCK)
+            width = CFAR_OS_BLOCK;
+        cell = map + first;
+
+        memset (cf->hist, 0, CFAR_OS_BLOCK * CFAR_OS_CODES * sizeof(uint16_t));
+        memset (cf->groups, 0, CFAR_OS_BLOCK * CFAR_OS_GROUPS * sizeof(uint16_t));
+        memset (cf->below, 0, CFAR_OS_BLOCK * sizeof(uint16_t));
+        for (j = 0; j < CFAR_OS_BLOCK; j++)
+            cf->pivot[j] = CFAR_OS_GROUPS / 2;
+
+        /* row 0's window: the rows after it */
+        for (r = guard + 1; (r <= reach) && (r < rows); r++)
+            CFAR_OsRow(cf, cell + ((size_t)r * cols), width, base, 1);
+
+        for (r = 0; r < rows; r++)
+        {
+            /* move the window down from row r - 1 */
+            if (r > 0)
+            {
+                if (r > guard)
+                    CFAR_OsRow(cf, cell + ((size_t)(r - guard - 1) * cols),
+                               width, base, 1);
+                if (r > reach)
+                    CFAR_OsRow(cf, cell + ((size_t)(r - reach - 1) * cols),
+                               width, base, (uint16_t)-1);
+                if (r + guard < rows)
+                    CFAR_OsRow(cf, cell + ((size_t)(r + guard) * cols),
+                               width, base, (uint16_t)-1);
+                if (r + reach < rows)
+                    CFAR_OsRow(cf, cell + ((size_t)(r + reach) * cols),
+                               width, base, 1);
+            }
+
+            n  = ((r > guard) ? (r - guard) : 0) - ((r > reach) ? (r - reach) : 0);
+            n += ((r + reach < rows) ? (r + reach + 1) : rows) -
+                 ((r + guard < rows) ? (r + guard + 1) : rows);
+            if (n == 0)
+                continue;
+            want = (cf->rank * n + cf->train) / (2 * cf->train);
+            if (want == 0)
+                want = 1;
+            if (want > n)
+                want = n;
+
+            for (j = 0; j < width; j++)
+            {
+                hist   = cf->hist + (j * CFAR_OS_CODES);
+                groups = cf->groups + (j * CFAR_OS_GROUPS);
+
+                /* the group holding the want'th code, from the last one */
+                g   = cf->pivot[j];
+                cum = cf->below[j];
+                while (cum >= want)
+                    cum -= groups[--g];
+                while (cum + groups[g] < want)
+                    cum += groups[g++];
+                cf->pivot[j] = (uint16_t)g;
+                cf->below[j] = (uint16_t)cum;
+
+                /* the code within the group, counted without branches:
+                 * where the scan would stop is as unpredictable as the
+                 * noise
+                 */
+                hist += g * CFAR_OS_GROUP;
+                c     = g * CFAR_OS_GROUP;
+                for (i = 0; i < CFAR_OS_GROUP - 1; i++)
+                {
+                    cum += hist[i];
+                    c   += (cum < want);
+                }
+
+                noise = base + ((float)c + 0.5f) * CFAR_OS_STEP_DB;
+                if (cell[(size_t)r * cols + j] <= noise + cf->thresholdDb)
+                    continue;
+
+                cf->detections++;
+                if (cf->numDets == CFAR_MAX_DETECTIONS)
+                {
+                    cf->overLimit++;
+                    continue;
+                }
+                d = &(cf->det[cf->numDets++]);
+                d->cpi        = (uint32_t)cpi;
+                d->rangeBin   = (uint16_t)r;
+                d->dopplerBin = (uint16_t)(first + j);
+                d->powerDb    = cell[(size_t)r * cols + j];
+                d->noiseDb    = noise;
+            }
+        }
+    }
+
+    qsort(cf->det, cf->numDets, sizeof(CFAR_DET), CFAR_DetOrder);
+}
+
+
+/**************************************************************************
+ Function:    CFAR_ScalarSum()
+
+ Description: Makes the next prefix row: next = sum + (cell - offset).
+
+ Parameters:  sum    - prefix row r
+              cell   - map row r
+              offset - the map's mean
+              cols   - columns
+              next   - prefix row r + 1
+
+ Return:      none
+**************************************************************************/
+static void CFAR_ScalarSum (const float *sum, const float *cell, float offset,
+                            unsigned int cols, float *next)
+{
+    unsigned int k;
+
+    for (k = 0; k < cols; k++)
+        next[k] = sum[k] + (cell[k] - offset);
+}
+
+
+/**************************************************************************
+ Function:    CFAR_ScalarRow()
+
+ Description: Tests a row of cells.  Each column's noise is
+              ((lead1 - lead0) + (lag1 - lag0)) x scale + offset, and a
+              cell more than thresholdDb over it is a hit.
+
+ Parameters:  cell        - the row's cells
+              lead0       - prefix rows bounding the window before the
+              lead1         row
+              lag0        - prefix rows bounding the window after it
+              lag1
+              scale       - 1 / training cells
+              offset      - the map's mean
+              thresholdDb - detection threshold
+              cols        - columns
+              noise       - set to each column's noise
+              hits        - set to the columns hit, in order
+
+ Return:      entries of hits set
+**************************************************************************/
+static unsigned int CFAR_ScalarRow (const float *cell, const float *lead0,
+                                    const float *lead1, const float *lag0,
+                                    const float *lag1, float scale,
+                                    float offset, float thresholdDb,
+                                    unsigned int cols, float *noise,
+                                    uint16_t *hits)
+{
+    unsigned int count = 0;
+    unsigned int k;
+
+    for (k = 0; k < cols; k++)
+    {
+        noise[k] = ((lead1[k] - lead0[k]) + (lag1[k] - lag0[k])) * scale + offset;
+        if (cell[k] > noise[k] + thresholdDb)
+            hits[count++] = (uint16_t)k;
+    }
+
+    return (count);
+}
+
+
+/**************************************************************************
+ Function:    CFAR_Free()
+
+ Description: Frees the stage's buffers and closes detN.dat if it is
+              still open.
+
+ Parameters:  cf - pointer to the stage
+
+ Return:      none
+**************************************************************************/
+static void CFAR_Free (CFAR *cf)
+{
+    free(cf->prefix);
+    free(cf->hist);
+    free(cf->groups);
+    free(cf->pivot);
+    free(cf->below);
+    free(cf->noise);
+    free(cf->hits);
+    free(cf->det);
+    cf->prefix = NULL;
+    cf->hist   = NULL;
+    cf->groups = NULL;
+    cf->pivot  = NULL;
+    cf->below  = NULL;
+    cf->noise  = NULL;
+    cf->hits   = NULL;
+    cf->det    = NULL;
+
+    if (cf->outfile != NULL)
+        fclose(cf->outfile);
+    cf->outfile = NULL;
+}
+
+
+#ifdef CFAR_HAVE_AVX2
+
+/**************************************************************************
+ AVX2 kernels, 8 columns a vector.  Built for AVX2 function by function,
+ as in iqk.c, and only picked by CFAR_Start() once it has seen the CPU has
+ it.  The columns left over go to the plain C kernels.
+**************************************************************************/
+
+#define CFAR_AVX2_FN __attribute__((target("avx2")))
+
+CFAR_AVX2_FN
+static void CFAR_Avx2Sum (const float *sum, const float *cell, float offset,
+                          unsigned int cols, float *next)
+{
+    __m256       off = _mm256_set1_ps(offset);
+    unsigned int k;
+
+    for (k = 0; k + 8 <= cols; k += 8)
+        _mm256_storeu_ps(next + k,
+                         _mm256_add_ps(_mm256_loadu_ps(sum + k),
+                                       _mm256_sub_ps(_mm256_loadu_ps(cell + k), off)));
+    CFAR_ScalarSum(sum + k, cell + k, offset, cols - k, next + k);
+}
+
+
+CFAR_AVX2_FN
+static unsigned int CFAR_Avx2Row (const float *cell, const float *lead0,
+                                  const float *lead1, const float *lag0,
+                                  const float *lag1, float scale,
+                                  float offset, float thresholdDb,
+                                  unsigned int cols, float *noise,
+                                  uint16_t *hits)
+{
+    __m256        sc    = _mm256_set1_ps(scale);
+    __m256        off   = _mm256_set1_ps(offset);
+    __m256        thr   = _mm256_set1_ps(thresholdDb);
+    __m256        n;
+    unsigned int  count = 0;
+    unsigned int  tail;
+    unsigned int  mask;
+    unsigned int  k;
+    unsigned int  i;
+
+    for (k = 0; k + 8 <= cols; k += 8)
+    {
+        n = _mm256_add_ps(_mm256_sub_ps(_mm256_loadu_ps(lead1 + k),
+                                        _mm256_loadu_ps(lead0 + k)),
+                          _mm256_sub_ps(_mm256_loadu_ps(lag1 + k),
+                                        _mm256_loadu_ps(lag0 + k)));
+        n = _mm256_add_ps(_mm256_mul_ps(n, sc), off);
+        _mm256_storeu_ps(noise + k, n);
+
+        mask = (unsigned int)_mm256_movemask_ps(
+                   _mm256_cmp_ps(_mm256_loadu_ps(cell + k),
+                                 _mm256_add_ps(n, thr), _CMP_GT_OQ));
+        while (mask != 0)
+        {
+            hits[count++] = (uint16_t)(k + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    tail = CFAR_ScalarRow(cell + k, lead0 + k, lead1 + k, lag0 + k, lag1 + k,
+                          scale, offset, thresholdDb, cols - k, noise + k,
+                          hits + count);
+    for (i = 0; i < tail; i++)
+        hits[count + i] += (uint16_t)k;
+
+    return (count + tail);
+}
+
+#endif /* CFAR_HAVE_AVX2 */
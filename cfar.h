@@ -0,0 +1,216 @@
+/***********************************************************************
+*
+*   File: cfar.h
+*
+*   Description: header file for cfar.c, constant false alarm rate
+*                detection on the range-Doppler maps of a channel.
+*
+*                Set from NeXtRAD.ini [Processing]:
+*                    CFAR_METHOD       - 0 = off, 1 = cell averaging,
+*                                        2 = ordered statistic.  Needs
+*                                        the range-Doppler maps on
+*                    CFAR_GUARD        - range bins each side of the cell
+*                                        left out of the noise estimate
+*                    CFAR_TRAIN        - range bins each side of the
+*                                        guard cells the noise is
+*                                        estimated from
+*                    CFAR_THRESHOLD_DB - how far above the noise estimate
+*                                        a cell must be to be a detection
+*                    CFAR_OS_RANK      - ordered statistic: the rank, 1 to
+*                                        2 x CFAR_TRAIN, of the training
+*                                        cell taken as the noise; 0 = 3/4
+*                                        of the way up
+*
+*                The stage works on the maps as rdop.c makes them, in
+*                dB, down each Doppler column: a cell's training cells
+*                are the CFAR_TRAIN range bins before and after it, past
+*                CFAR_GUARD guard bins.  Near the ends of the map only the
+*                side(s) there are used.
+*
+*                Cell averaging takes the mean of the training cells in
+*                dB (log-CA CFAR), which a strong target in the window
+*                pulls up far less than a mean of powers would.  In
+*                noise, with CFAR_TRAIN = 16, a threshold of 15.5 dB gives
+*                a false alarm rate of about 1e-6 per cell and 14 dB about
+*                2e-5; CFAR_TRAIN = 8 needs 17 dB for 1e-6.  The window
+*                sums come from running sums down each column, so the
+*                cost per cell is the same for any window; whole rows are
+*                done at once, with AVX2 where the CPU has it;
+*                CFAR_UseScalar() puts a stage on plain C, to compare the
+*                two.
+*
+*                Ordered statistic takes the CFAR_OS_RANK'th smallest
+*                training cell, which holds up in clutter edges and
+*                between close targets.  Each column keeps a histogram of
+*                its training cells in CFAR_OS_STEP_DB steps, updated as
+*                the window moves down, so it too costs the same for any
+*                window; the estimate is good to half a step.  The 3/4
+*                rank sits above the mean of dB values, so it needs a
+*                lower threshold for the same false alarm rate: 11.5 dB
+*                gives about 1e-6 with CFAR_TRAIN = 16.  It is some twenty
+*                times slower than cell averaging.
+*
+*                Detections go to detN.dat as CFAR_DET records, in map
+*                order and, within a map, range bin then Doppler bin.  No
+*                map header is written: a map without detections adds
+*                nothing.  Every cell over the threshold is a detection;
+*                clustering them into targets is left to the reader.
+*
+************************************************************************/
+
+#ifndef __CFAR_H__
+#define __CFAR_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* CFAR_METHOD values */
+#define CFAR_OFF             0
+#define CFAR_CA              1
+#define CFAR_OS              2
+
+/* CFAR_MAX_TRAIN - largest CFAR_TRAIN;
+ * CFAR_MAX_DETECTIONS - detections kept from one map; more are counted
+ * and dropped
+ */
+#define CFAR_MAX_TRAIN       1024
+#define CFAR_MAX_DETECTIONS  65536
+
+/* ordered statistic histograms: CFAR_OS_CODES steps of CFAR_OS_STEP_DB,
+ * centred on the map's mean, in groups of CFAR_OS_GROUP steps;
+ * CFAR_OS_BLOCK columns are searched together, so that their histograms
+ * stay in the L1 cache
+ */
+#define CFAR_OS_STEP_DB      0.25f
+#define CFAR_OS_CODES        512
+#define CFAR_OS_GROUP        16
+#define CFAR_OS_BLOCK        16
+
+
+/* CFAR_DET - one detection, 16 bytes, as written to detN.dat
+ *     cpi        = CPI the map was made from, counting every CPI formed
+ *                  (dropped ones included) from 0; its first PRI is
+ *                  cpi x DOPPLER_CPI
+ *     rangeBin   = range bin (map row)
+ *     dopplerBin = Doppler bin (map column); zero Doppler is Doppler FFT
+ *                  size / 2
+ *     powerDb    = the cell
+ *     noiseDb    = noise estimate the cell was tested against
+ */
+typedef struct CFAR_DET
+        {
+            uint32_t            cpi;
+            uint16_t            rangeBin;
+            uint16_t            dopplerBin;
+            float               powerDb;
+            float               noiseDb;
+        } CFAR_DET;
+
+
+/* CFAR_CA_SUM - adds a row of cells to the running sums;
+ * CFAR_CA_ROW - tests one row of cells against the training sums;
+ * see cfar.c
+ */
+typedef void (*CFAR_CA_SUM) (const float *sum, const float *cell,
+                             float offset, unsigned int cols, float *next);
+
+typedef unsigned int (*CFAR_CA_ROW) (const float *cell, const float *lead0,
+                                     const float *lead1, const float *lag0,
+                                     const float *lag1, float scale,
+                                     float offset, float thresholdDb,
+                                     unsigned int cols, float *noise,
+                                     uint16_t *hits);
+
+
+/* CFAR - detection stage for one channel
+ *     method      = CFAR_CA or CFAR_OS
+ *     rows        = range bins of a map
+ *     cols        = Doppler bins of a map
+ *     guard       = guard cells each side
+ *     train       = training cells each side
+ *     rank        = ordered statistic rank out of 2 x train
+ *     thresholdDb = detection threshold over the noise estimate
+ *     caSum       = cell averaging kernels, and
+ *     caRow
+ *     kernelName    their name
+ *     prefix      = (rows + 1) x cols running sums down the columns
+ *     hist        = CFAR_OS_BLOCK x CFAR_OS_CODES training cell counts
+ *     groups      = CFAR_OS_BLOCK x (CFAR_OS_CODES / CFAR_OS_GROUP) counts
+ *     pivot       = CFAR_OS_BLOCK groups the last search of each column
+ *     below         ended in, and the training cells in the groups under
+ *                   it
+ *     noise       = cols noise estimates of the row being tested
+ *     hits        = cols columns over the threshold
+ *     det         = CFAR_MAX_DETECTIONS detections of the last map
+ *     numDets     = entries of det used
+ *     outfile     = detN.dat, or NULL
+ *
+ *   owned by the thread calling CFAR_Detect():
+ *     maps        = maps searched
+ *     detections  = detections found
+ *     overLimit   = detections dropped for want of room in det
+ *     totalNs     = time spent searching, summed over maps
+ *     maxNs       = longest time spent on a map
+ *     writeError  = set if a write to outfile failed
+ */
+typedef struct CFAR
+        {
+            int                 method;
+            unsigned int        rows;
+            unsigned int        cols;
+            unsigned int        guard;
+            unsigned int        train;
+            unsigned int        rank;
+            float               thresholdDb;
+            CFAR_CA_SUM         caSum;
+            CFAR_CA_ROW         caRow;
+            const char         *kernelName;
+            float              *prefix;
+            uint16_t           *hist;
+            uint16_t           *groups;
+            uint16_t           *pivot;
+            uint16_t           *below;
+            float              *noise;
+            uint16_t           *hits;
+            CFAR_DET           *det;
+            unsigned int        numDets;
+            FILE               *outfile;
+
+            unsigned long long  maps;
+            unsigned long long  detections;
+            unsigned long long  overLimit;
+            unsigned long long  totalNs;
+            unsigned long long  maxNs;
+            int                 writeError;
+        } CFAR;
+
+
+/* function prototypes */
+int          CFAR_Start     (CFAR               *cf,
+                             int                 method,
+                             unsigned int        rows,
+                             unsigned int        cols,
+                             unsigned int        guard,
+                             unsigned int        train,
+                             unsigned int        rank,
+                             float               thresholdDb,
+                             const char         *outfileName);
+void         CFAR_UseScalar (CFAR               *cf);
+unsigned int CFAR_Detect    (CFAR               *cf,
+                             const float        *map,
+                             unsigned long long  cpi);
+int          CFAR_Stop      (CFAR               *cf);
+void         CFAR_Report    (CFAR               *cf,
+                             int                 chanNum);
+const char  *CFAR_Name      (int                 method);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CFAR_H__ */
@@ -0,0 +1,449 @@
+/**************************************************************************
+*
+*   File: cfartest.c
+*
+*   Description: Check and micro-benchmark of the CFAR detectors (cfar.c),
+*                away from the radar.
+*
+*                Each map is -l range bins by -b Doppler bins (256 x 4096
+*                by default) in dB, as rdop.c makes them.  Two are made:
+*
+*                    target map - noise spread evenly over
+*                                 +-CFARTEST_NOISE_DB, so no noise cell
+*                                 can cross the threshold, with
+*                                 CFARTEST_TARGET_DB targets in the
+*                                 corners, one on the first training cell
+*                                 of another's window (just past its
+*                                 guard band), one on the last guard cell
+*                                 of another's, and one in the next
+*                                 Doppler column
+*                    noise map  - the dB of exponentially distributed
+*                                 power, as a square law detector gives
+*                                 from complex Gaussian noise
+*
+*                Cell averaging, on the kernels CFAR_Start() picks and on
+*                plain C (CFAR_UseScalar()), and ordered statistic must
+*                each detect the targets and nothing else.  The two cell
+*                averaging kernels must give the same detections, noise
+*                estimates included, bit for bit, on both maps.  The
+*                same is done on a map one range bin and three Doppler
+*                bins short of the size asked for, so that the AVX2
+*                kernels' leftover columns are covered.  The times are
+*                the mean of -r searches of the noise map.
+*
+*                Usage:
+*                    cfartest [options]
+*                    -l rows    range bins per map (256)
+*                    -b cols    Doppler bins per map (4096)
+*                    -g guard   guard cells each side (2)
+*                    -t train   training cells each side (16)
+*                    -r runs    maps searched per timing (20)
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cfar.h"
+#include "dmaring.h"
+
+
+/* CFARTEST_NOISE_DB - the target map's noise is within +- this of 0 dB;
+ * CFARTEST_TARGET_DB - its targets;
+ * CFARTEST_THRESHOLD_DB - detection threshold of every search: in the
+ * noise map it gives a hundred or so detections a 256 x 4096 map to
+ * compare the kernels on
+ */
+#define CFARTEST_NOISE_DB      1.0f
+#define CFARTEST_TARGET_DB     30.0f
+#define CFARTEST_THRESHOLD_DB  12.0f
+
+/* CFARTEST_MAX_TARGETS - targets put in the target map */
+#define CFARTEST_MAX_TARGETS   16
+
+
+/* CFARTEST_CELL - a target's place in the map
+ *     r = range bin (row)
+ *     c = Doppler bin (column)
+ */
+typedef struct CFARTEST_CELL
+        {
+            unsigned int        r;
+            unsigned int        c;
+        } CFARTEST_CELL;
+
+
+static int          CFARTEST_Size    (unsigned int rows, unsigned int cols,
+                                      unsigned int guard, unsigned int train,
+                                      unsigned int runs);
+static unsigned int CFARTEST_Targets (unsigned int rows, unsigned int cols,
+                                      unsigned int guard,
+                                      CFARTEST_CELL *cells);
+static int          CFARTEST_Order   (const void *a, const void *b);
+static void         CFARTEST_Noise   (float *map, size_t n, int even);
+static int          CFARTEST_Match   (const CFAR *cf, const float *map,
+                                      const CFARTEST_CELL *cells,
+                                      unsigned int numCells);
+static int          CFARTEST_Same    (const CFAR *a, const CFAR *b);
+static double       CFARTEST_Time    (CFAR *cf, const float *map,
+                                      unsigned int runs);
+static void         CFARTEST_Usage   (void);
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Checks the detectors at the size asked for and one a little
+              short of it, times them at the first, and prints PASS or
+              FAIL.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - every search found exactly the targets, and the cell
+                  averaging kernels agreed
+              1 - bad command line, allocation or set-up failed, or a
+                  search was wrong
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    unsigned int    rows  = 256;
+    unsigned int    cols  = 4096;
+    unsigned int    guard = 2;
+    unsigned int    train = 16;
+    unsigned int    runs  = 20;
+    int             failed;
+    int             a;
+
+    for (a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "-l") == 0) && (a + 1 < argc))
+            rows = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-b") == 0) && (a + 1 < argc))
+            cols = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-g") == 0) && (a + 1 < argc))
+            guard = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-t") == 0) && (a + 1 < argc))
+            train = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-r") == 0) && (a + 1 < argc))
+            runs = (unsigned int)atoi(argv[++a]);
+        else
+        {
+            CFARTEST_Usage();
+            return (1);
+        }
+    }
+    /* room for the targets: the pairs must not reach each other or the
+     * corners' windows
+     */
+    if ((guard == 0) || (train == 0) || (train > CFAR_MAX_TRAIN) ||
+        (rows > 65536) || (cols > 65536) || (cols <= 16) ||
+        (rows <= 8 * (guard + train + 1)) || (runs == 0))
+    {
+        CFARTEST_Usage();
+        return (1);
+    }
+
+    printf("guard %u, train %u, threshold %.1f dB, targets %.1f dB over "
+           "+-%.1f dB noise\n\n", guard, train, CFARTEST_THRESHOLD_DB,
+           CFARTEST_TARGET_DB, CFARTEST_NOISE_DB);
+    printf("%-11s %-18s %-7s %8s %8s %10s %9s %9s\n", "map", "method",
+           "kernel", "targets", "kernels", "ms/map", "ns/cell", "Mcell/s");
+
+    failed  = CFARTEST_Size(rows, cols, guard, train, runs);
+    failed |= CFARTEST_Size(rows - 1, cols - 3, guard, train, 0);
+
+    printf("%s\n", failed ? "FAIL" : "PASS");
+
+    return (failed ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    CFARTEST_Size()
+
+ Description: Checks the three searches at one map size, times them if
+              asked to, and prints a row for each.
+
+ Parameters:  rows, cols  - map size
+              guard       - guard cells each side
+              train       - training cells each side
+              runs        - maps searched per timing; 0 not to time
+
+ Return:      0 - every search found exactly the targets, and the cell
+                  averaging kernels agreed
+              1 - a search was wrong, or set-up failed
+**************************************************************************/
+static int CFARTEST_Size (unsigned int rows, unsigned int cols,
+                          unsigned int guard, unsigned int train,
+                          unsigned int runs)
+{
+    CFAR            ca;
+    CFAR            scalar;
+    CFAR            os;
+    CFAR           *cf[3] = {&ca, &scalar, &os};
+    CFARTEST_CELL   cells[CFARTEST_MAX_TARGETS];
+    unsigned int    numCells;
+    size_t          n = (size_t)rows * cols;
+    float          *targetMap;
+    float          *noiseMap;
+    char            size[24];
+    double          ns;
+    int             found[3];
+    int             same = 0;
+    int             failed = 0;
+    int             s;
+    unsigned int    i;
+
+    targetMap = (float *)malloc(n * sizeof(float));
+    noiseMap  = (float *)malloc(n * sizeof(float));
+    if ((targetMap == NULL) || (noiseMap == NULL) ||
+        (CFAR_Start(&ca, CFAR_CA, rows, cols, guard, train, 0,
+                    CFARTEST_THRESHOLD_DB, NULL) != 0) ||
+        (CFAR_Start(&scalar, CFAR_CA, rows, cols, guard, train, 0,
+                    CFARTEST_THRESHOLD_DB, NULL) != 0) ||
+        (CFAR_Start(&os, CFAR_OS, rows, cols, guard, train, 0,
+                    CFARTEST_THRESHOLD_DB, NULL) != 0))
+    {
+        printf("ERROR: %u x %u maps not set up.\n", rows, cols);
+        return (1);
+    }
+    CFAR_UseScalar(&scalar);
+
+    CFARTEST_Noise(targetMap, n, 1);
+    CFARTEST_Noise(noiseMap, n, 0);
+    numCells = CFARTEST_Targets(rows, cols, guard, cells);
+    for (i = 0; i < numCells; i++)
+        targetMap[(size_t)cells[i].r * cols + cells[i].c] = CFARTEST_TARGET_DB;
+
+    /* the targets, then the kernels against each other on both maps */
+    for (s = 0; s < 3; s++)
+    {
+        CFAR_Detect(cf[s], targetMap, 0);
+        found[s] = CFARTEST_Match(cf[s], targetMap, cells, numCells);
+        failed  |= found[s];
+    }
+    same |= CFARTEST_Same(&ca, &scalar);
+    CFAR_Detect(&ca, noiseMap, 1);
+    CFAR_Detect(&scalar, noiseMap, 1);
+    same |= CFARTEST_Same(&ca, &scalar);
+    failed |= same;
+
+    snprintf(size, sizeof(size), "%ux%u", rows, cols);
+    for (s = 0; s < 3; s++)
+    {
+        ns = (runs != 0) ? CFARTEST_Time(cf[s], noiseMap, runs) : 0.0;
+        printf("%-11s %-18s %-7s %8s %8s", size, CFAR_Name(cf[s]->method),
+               cf[s]->kernelName, found[s] ? "FAIL" : "ok",
+               (s == 2) ? "" : same ? "FAIL" : "same");
+        if (runs != 0)
+            printf(" %10.2f %9.2f %9.1f", ns / 1e6, ns / n, n * 1e3 / ns);
+        printf("\n");
+    }
+    if (strcmp(ca.kernelName, scalar.kernelName) == 0)
+        printf("%-11s no AVX2: cell averaging checked on plain C only\n",
+               size);
+
+    for (s = 0; s < 3; s++)
+        CFAR_Stop(cf[s]);
+    free(targetMap);
+    free(noiseMap);
+
+    return (failed);
+}
+
+
+/**************************************************************************
+ Function:    CFARTEST_Targets()
+
+ Description: Places the targets, in range bin then Doppler bin order,
+              the order CFAR_Detect() leaves its detections in:
+
+                  - the four corners, and a target on the first training
+                    cell of the bottom left one's window, where the map
+                    clips the window on one side
+                  - a pair in one column, the second on the first
+                    training cell after the first, just past its guard
+                    band, and a third target in the next column
+                  - a pair in one column, the second on the last guard
+                    cell after the first
+
+ Parameters:  rows, cols - map size; rows over 8 x (guard + train + 1)
+              guard      - guard cells each side
+              cells      - CFARTEST_MAX_TARGETS cells, set
+
+ Return:      targets placed
+**************************************************************************/
+static unsigned int CFARTEST_Targets (unsigned int rows, unsigned int cols,
+                                      unsigned int guard,
+                                      CFARTEST_CELL *cells)
+{
+    unsigned int n = 0;
+
+    cells[n].r = 0;                     cells[n++].c = 0;
+    cells[n].r = 0;                     cells[n++].c = cols - 1;
+    cells[n].r = rows - 1;              cells[n++].c = 0;
+    cells[n].r = rows - 1;              cells[n++].c = cols - 1;
+    cells[n].r = rows - guard - 2;      cells[n++].c = 0;
+
+    cells[n].r = rows / 2;              cells[n++].c = cols / 3;
+    cells[n].r = rows / 2 + guard + 1;  cells[n++].c = cols / 3;
+    cells[n].r = rows / 2;              cells[n++].c = cols / 3 + 1;
+
+    cells[n].r = rows / 4;              cells[n++].c = 2 * cols / 3;
+    cells[n].r = rows / 4 + guard;      cells[n++].c = 2 * cols / 3;
+
+    qsort(cells, n, sizeof(CFARTEST_CELL), CFARTEST_Order);
+
+    return (n);
+}
+
+
+/**************************************************************************
+ Function:    CFARTEST_Order()
+
+ Description: qsort() comparison putting cells in range bin, then Doppler
+              bin, order.
+
+ Parameters:  a, b - the CFARTEST_CELLs to compare
+
+ Return:      <0, 0 or >0 as a is before, with or after b
+**************************************************************************/
+static int CFARTEST_Order (const void *a, const void *b)
+{
+    const CFARTEST_CELL *ca = (const CFARTEST_CELL *)a;
+    const CFARTEST_CELL *cb = (const CFARTEST_CELL *)b;
+
+    if (ca->r != cb->r)
+        return ((ca->r < cb->r) ? -1 : 1);
+    if (ca->c != cb->c)
+        return ((ca->c < cb->c) ? -1 : 1);
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    CFARTEST_Noise()
+
+ Description: Fills a map with pseudo-random noise, in dB.
+
+ Parameters:  map  - n cells
+              n    - cells
+              even - nonzero for noise spread evenly over
+                     +-CFARTEST_NOISE_DB; zero for exponentially
+                     distributed power of mean 1 (0 dB)
+
+ Return:      none
+**************************************************************************/
+static void CFARTEST_Noise (float *map, size_t n, int even)
+{
+    unsigned int seed = even ? 27182 : 14142;
+    double       u;
+    size_t       i;
+
+    for (i = 0; i < n; i++)
+    {
+        seed = (seed * 1103515245U) + 12345U;
+        u    = ((seed >> 8) + 0.5) / 16777216.0;
+        if (even)
+            map[i] = (float)((2.0 * u - 1.0) * CFARTEST_NOISE_DB);
+        else
+            map[i] = (float)(10.0 * log10(-log(u)));
+    }
+}
+
+
+/**************************************************************************
+ Function:    CFARTEST_Match()
+
+ Description: Checks a search found exactly the targets, each with its
+              own power.
+
+ Parameters:  cf       - stage the target map was searched with
+              map      - the target map
+              cells    - the targets, in range bin then Doppler bin order
+              numCells - targets
+
+ Return:      0 - the detections were the targets
+              1 - a target was missed, or something else was detected
+**************************************************************************/
+static int CFARTEST_Match (const CFAR *cf, const float *map,
+                           const CFARTEST_CELL *cells, unsigned int numCells)
+{
+    const CFAR_DET *d;
+    unsigned int    i;
+
+    if ((cf->numDets != numCells) || (cf->overLimit != 0))
+        return (1);
+
+    for (i = 0; i < numCells; i++)
+    {
+        d = &(cf->det[i]);
+        if ((d->rangeBin != cells[i].r) || (d->dopplerBin != cells[i].c) ||
+            (d->powerDb != map[(size_t)cells[i].r * cf->cols + cells[i].c]))
+            return (1);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    CFARTEST_Same()
+
+ Description: Compares two stages' detections of the last map, bit for
+              bit.
+
+ Parameters:  a, b - the stages
+
+ Return:      0 - the same
+              1 - different
+**************************************************************************/
+static int CFARTEST_Same (const CFAR *a, const CFAR *b)
+{
+    if (a->numDets != b->numDets)
+        return (1);
+
+    return (memcmp(a->det, b->det, a->numDets * sizeof(CFAR_DET)) != 0);
+}
+
+
+/**************************************************************************
+ Function:    CFARTEST_Time()
+
+ Description: Times searches of a map.
+
+ Parameters:  cf   - the stage
+              map  - the map
+              runs - searches to time
+
+ Return:      ns per search
+**************************************************************************/
+static double CFARTEST_Time (CFAR *cf, const float *map, unsigned int runs)
+{
+    unsigned long long  start;
+    unsigned int        r;
+
+    start = DMARING_TimeNs();
+    for (r = 0; r < runs; r++)
+        CFAR_Detect(cf, map, r);
+
+    return ((double)(DMARING_TimeNs() - start) / runs);
+}
+
+
+/**************************************************************************
+ Function:    CFARTEST_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void CFARTEST_Usage (void)
+{
+    printf("usage: cfartest [-l rows] [-b cols] [-g guard] [-t train] "
+           "[-r runs]\n");
+}
@@ -0,0 +1,340 @@
+/**************************************************************************
+*
+*   File: ctbench.c
+*
+*   Description: Check and micro-benchmark of the corner turn (cturn.c)
+*                against naive transposes, away from the radar.
+*
+*                Each turn is made of a CPI of -l range lines of -b
+*                complex samples (256 x 4096 by default, as the
+*                range-Doppler stage uses):
+*
+*                    naive, line outer - double loop, writes strided
+*                    naive, bin outer  - double loop, reads strided
+*                    tiled             - CTURN_Transpose(), for 1 to -t
+*                                        threads
+*                    streamed          - CTURN_Begin() and CTURN_AddLine()
+*                                        per line, 1 to -t threads,
+*                                        including the copy of each line
+*
+*                Every tiled and streamed output must match the naive one
+*                bit for bit; so must a CPI one line and three bins short
+*                of the size asked for, so that partial tiles and bands
+*                are covered.  Times are the mean of -r turns.
+*
+*                Usage:
+*                    ctbench [options]
+*                    -l lines   range lines per CPI (256)
+*                    -b bins    complex samples per range line (4096)
+*                    -t threads most threads to share a turn (4)
+*                    -r runs    turns timed per row (20)
+*
+*                On a machine with fewer cores than -t the rows with
+*                more threads measure the scheduler, not the turn.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cturn.h"
+#include "dmaring.h"
+
+
+static void   CTBENCH_Naive    (const float *in, float *out,
+                                unsigned int lines, unsigned int bins,
+                                int binOuter);
+static void   CTBENCH_Stream   (CORNER_TURN *ct, const float *in,
+                                float *out);
+static int    CTBENCH_Check    (unsigned int lines, unsigned int bins,
+                                unsigned int maxThreads, const float *in,
+                                float *ref, float *out);
+static void   CTBENCH_Print    (const char *name, unsigned int threads,
+                                double ns, unsigned int lines,
+                                unsigned int bins, int failed);
+static void   CTBENCH_Usage    (void);
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Times the naive, tiled and streamed turns, checks the last
+              two against the first, and prints PASS or FAIL.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - every turn matched
+              1 - bad command line, allocation or set-up failed, or a
+                  turn differed
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    CORNER_TURN         ct;
+    unsigned int        lines      = 256;
+    unsigned int        bins       = 4096;
+    unsigned int        maxThreads = 4;
+    unsigned int        runs       = 20;
+    unsigned int        threads;
+    unsigned int        r;
+    size_t              n;
+    size_t              i;
+    float              *in;
+    float              *ref;
+    float              *out;
+    unsigned long long  start;
+    double              ns;
+    int                 failed;
+    int                 anyFailed  = 0;
+    int                 a;
+
+    for (a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "-l") == 0) && (a + 1 < argc))
+            lines = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-b") == 0) && (a + 1 < argc))
+            bins = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-t") == 0) && (a + 1 < argc))
+            maxThreads = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-r") == 0) && (a + 1 < argc))
+            runs = (unsigned int)atoi(argv[++a]);
+        else
+        {
+            CTBENCH_Usage();
+            return (1);
+        }
+    }
+    if ((lines < 2) || (bins < 4) || (maxThreads == 0) ||
+        (maxThreads > CTURN_MAX_THREADS) || (runs == 0))
+    {
+        CTBENCH_Usage();
+        return (1);
+    }
+
+    n   = (size_t)lines * bins * 2;
+    in  = (float *)malloc(n * sizeof(float));
+    ref = (float *)malloc(n * sizeof(float));
+    out = (float *)malloc(n * sizeof(float));
+    if ((in == NULL) || (ref == NULL) || (out == NULL))
+    {
+        printf("ERROR: no memory for a %u x %u CPI.\n", lines, bins);
+        return (1);
+    }
+    for (i = 0; i < n; i++)
+        in[i] = (float)i;
+
+    printf("%u x %u complex float (%.1f MB), mean of %u turns\n\n",
+           lines, bins, n * sizeof(float) / 1e6, runs);
+    printf("%-20s %7s %10s %9s %8s\n", "turn", "threads", "ms", "GB/s",
+           "compare");
+
+    /* the bin-outer loop is the reference: its output is the turn by
+     * definition
+     */
+    start = DMARING_TimeNs();
+    for (r = 0; r < runs; r++)
+        CTBENCH_Naive(in, ref, lines, bins, 1);
+    CTBENCH_Print("naive, bin outer", 1,
+                  (double)(DMARING_TimeNs() - start) / runs, lines, bins, -1);
+
+    memset (out, 0, n * sizeof(float));
+    start = DMARING_TimeNs();
+    for (r = 0; r < runs; r++)
+        CTBENCH_Naive(in, out, lines, bins, 0);
+    ns     = (double)(DMARING_TimeNs() - start) / runs;
+    failed = (memcmp(ref, out, n * sizeof(float)) != 0);
+    anyFailed |= failed;
+    CTBENCH_Print("naive, line outer", 1, ns, lines, bins, failed);
+
+    for (threads = 1; threads <= maxThreads; threads++)
+    {
+        if (CTURN_Init(&ct, lines, bins, threads) != 0)
+        {
+            printf("ERROR: corner turn of %u threads not set up.\n", threads);
+            return (1);
+        }
+
+        memset (out, 0, n * sizeof(float));
+        start = DMARING_TimeNs();
+        for (r = 0; r < runs; r++)
+            CTURN_Transpose(&ct, in, out);
+        ns     = (double)(DMARING_TimeNs() - start) / runs;
+        failed = (memcmp(ref, out, n * sizeof(float)) != 0);
+        anyFailed |= failed;
+        CTBENCH_Print("tiled", threads, ns, lines, bins, failed);
+
+        memset (out, 0, n * sizeof(float));
+        start = DMARING_TimeNs();
+        for (r = 0; r < runs; r++)
+            CTBENCH_Stream(&ct, in, out);
+        ns     = (double)(DMARING_TimeNs() - start) / runs;
+        failed = (memcmp(ref, out, n * sizeof(float)) != 0);
+        anyFailed |= failed;
+        CTBENCH_Print("streamed", threads, ns, lines, bins, failed);
+
+        CTURN_Free(&ct);
+    }
+
+    /* partial tiles and bands */
+    failed = CTBENCH_Check(lines - 1, bins - 3, maxThreads, in, ref, out);
+    printf("\n%u x %u, 1 to %u threads: %s\n", lines - 1, bins - 3,
+           maxThreads, failed ? "FAIL" : "ok");
+    anyFailed |= failed;
+
+    printf("%s\n", anyFailed ? "FAIL" : "PASS");
+
+    free(in);
+    free(ref);
+    free(out);
+
+    return (anyFailed ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    CTBENCH_Naive()
+
+ Description: Turns a CPI with a plain double loop.
+
+ Parameters:  in       - lines x bins complex samples, range line major
+              out      - bins x lines complex samples out
+              lines    - range lines
+              bins     - complex samples per line
+              binOuter - nonzero to loop over range bins outside, so
+                         writes are in order and reads stride; zero for
+                         the other way round
+
+ Return:      none
+**************************************************************************/
+static void CTBENCH_Naive (const float *in, float *out, unsigned int lines,
+                           unsigned int bins, int binOuter)
+{
+    unsigned int l;
+    unsigned int b;
+
+    if (binOuter)
+    {
+        for (b = 0; b < bins; b++)
+            for (l = 0; l < lines; l++)
+            {
+                out[2 * ((size_t)b * lines + l)]     = in[2 * ((size_t)l * bins + b)];
+                out[2 * ((size_t)b * lines + l) + 1] = in[2 * ((size_t)l * bins + b) + 1];
+            }
+    }
+    else
+    {
+        for (l = 0; l < lines; l++)
+            for (b = 0; b < bins; b++)
+            {
+                out[2 * ((size_t)b * lines + l)]     = in[2 * ((size_t)l * bins + b)];
+                out[2 * ((size_t)b * lines + l) + 1] = in[2 * ((size_t)l * bins + b) + 1];
+            }
+    }
+}
+
+
+/**************************************************************************
+ Function:    CTBENCH_Stream()
+
+ Description: Turns a CPI a line at a time, as the range-Doppler stage
+              does.
+
+ Parameters:  ct  - corner turn set up for the CPI
+              in  - the CPI, range line major
+              out - the CPI out, range bin major
+
+ Return:      none
+**************************************************************************/
+static void CTBENCH_Stream (CORNER_TURN *ct, const float *in, float *out)
+{
+    unsigned int l;
+
+    CTURN_Begin(ct, out);
+    for (l = 0; l < ct->lines; l++)
+        CTURN_AddLine(ct, in + 2 * (size_t)l * ct->bins);
+}
+
+
+/**************************************************************************
+ Function:    CTBENCH_Check()
+
+ Description: Turns a CPI of another size tiled and streamed, for 1 to
+              maxThreads threads, and compares each with the naive turn.
+
+ Parameters:  lines, bins - CPI size; no larger than the buffers
+              maxThreads  - most threads
+              in          - input, at least lines x bins
+              ref, out    - scratch outputs, at least lines x bins
+
+ Return:      0 - every turn matched
+              1 - a turn differed or could not be set up
+**************************************************************************/
+static int CTBENCH_Check (unsigned int lines, unsigned int bins,
+                          unsigned int maxThreads, const float *in,
+                          float *ref, float *out)
+{
+    CORNER_TURN  ct;
+    size_t       bytes = (size_t)lines * bins * 2 * sizeof(float);
+    unsigned int threads;
+    int          failed = 0;
+
+    CTBENCH_Naive(in, ref, lines, bins, 1);
+    for (threads = 1; threads <= maxThreads; threads++)
+    {
+        if (CTURN_Init(&ct, lines, bins, threads) != 0)
+            return (1);
+
+        memset (out, 0, bytes);
+        CTURN_Transpose(&ct, in, out);
+        failed |= (memcmp(ref, out, bytes) != 0);
+
+        memset (out, 0, bytes);
+        CTBENCH_Stream(&ct, in, out);
+        failed |= (memcmp(ref, out, bytes) != 0);
+
+        CTURN_Free(&ct);
+    }
+
+    return (failed);
+}
+
+
+/**************************************************************************
+ Function:    CTBENCH_Print()
+
+ Description: Prints one row of the table.
+
+ Parameters:  name    - turn
+              threads - threads sharing it
+              ns      - mean time per turn, in ns
+              lines   - range lines
+              bins    - complex samples per line
+              failed  - compare result, or -1 for the reference
+
+ Return:      none
+**************************************************************************/
+static void CTBENCH_Print (const char *name, unsigned int threads,
+                           double ns, unsigned int lines, unsigned int bins,
+                           int failed)
+{
+    /* each sample is read once and written once */
+    double bytes = 2.0 * lines * bins * 2 * sizeof(float);
+
+    printf("%-20s %7u %10.2f %9.2f %8s\n", name, threads, ns / 1e6,
+           bytes / ns, (failed < 0) ? "ref" : failed ? "FAIL" : "ok");
+}
+
+
+/**************************************************************************
+ Function:    CTBENCH_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void CTBENCH_Usage (void)
+{
+    printf("usage: ctbench [-l lines] [-b bins] [-t threads] [-r runs]\n");
+}
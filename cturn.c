@@ -0,0 +1,334 @@
+/**************************************************************************
+*
+*   File: cturn.c
+*
+*   Description: Cache-blocked corner turn.  See cturn.h.
+*
+*                Each turn is a job: the caller fills in the job fields,
+*                bumps ct->job, turns band 0 of the range bins itself and
+*                waits for each helper to report the job done.  Bands are
+*                whole multiples of CTURN_TILE_BINS, so no two threads
+*                ever write the same output row.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "cturn.h"
+
+
+static void  CTURN_Run          (CORNER_TURN *ct, const float *in,
+                                 unsigned int numLines, unsigned int first,
+                                 float *out);
+static void  CTURN_Band         (CORNER_TURN *ct, unsigned int band);
+static void *CTURN_HelperThread (void *pParams);
+
+
+/**************************************************************************
+ Function:    CTURN_Init()
+
+ Description: Sets up a corner turn for one CPI size and starts its
+              helper threads.
+
+ Parameters:  ct         - pointer to the CORNER_TURN to set up
+              lines      - range lines in a CPI
+              bins       - complex samples in a range line
+              numThreads - threads to share each turn, the caller's
+                           included, 1 to CTURN_MAX_THREADS
+
+ Return:      0 - success
+              1 - a size or numThreads is out of range
+              2 - allocation or thread creation failed
+**************************************************************************/
+int CTURN_Init (CORNER_TURN *ct, unsigned int lines, unsigned int bins,
+                unsigned int numThreads)
+{
+    unsigned int i;
+
+    memset (ct, 0, sizeof(*ct));
+
+    if ((lines == 0) || (bins == 0) || (numThreads < 1) ||
+        (numThreads > CTURN_MAX_THREADS))
+        return (1);
+
+    ct->lines      = lines;
+    ct->bins       = bins;
+    ct->numThreads = 1;
+
+    ct->block = (float *)malloc((size_t)CTURN_BLOCK_LINES * bins * 2 *
+                                sizeof(float));
+    if (ct->block == NULL)
+        return (2);
+
+    for (i = 1; i < numThreads; i++)
+    {
+        ct->helper[i].ct    = ct;
+        ct->helper[i].index = i;
+        if (pthread_create(&(ct->helper[i].thread), NULL,
+                           CTURN_HelperThread, &(ct->helper[i])) != 0)
+        {
+            CTURN_Free(ct);
+            return (2);
+        }
+        ct->numThreads = i + 1;
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    CTURN_Transpose()
+
+ Description: Turns a whole CPI.
+
+ Parameters:  ct  - pointer to the corner turn
+              in  - lines x bins complex samples, range line major
+              out - bins x lines complex samples out, range bin major;
+                    must not overlap in
+
+ Return:      none
+**************************************************************************/
+void CTURN_Transpose (CORNER_TURN *ct, const float *in, float *out)
+{
+    CTURN_Run(ct, in, ct->lines, 0, out);
+}
+
+
+/**************************************************************************
+ Function:    CTURN_Begin()
+
+ Description: Starts streaming a CPI into a buffer.  Any lines received
+              for a CPI that was not finished are dropped.
+
+ Parameters:  ct  - pointer to the corner turn
+              out - bins x lines complex samples, filled by
+                    CTURN_AddLine()
+
+ Return:      none
+**************************************************************************/
+void CTURN_Begin (CORNER_TURN *ct, float *out)
+{
+    ct->out        = out;
+    ct->blockLines = 0;
+    ct->received   = 0;
+}
+
+
+/**************************************************************************
+ Function:    CTURN_AddLine()
+
+ Description: Adds the next range line to the CPI being streamed.  The
+              line is copied, so its buffer can be reused at once.
+              Every CTURN_BLOCK_LINES lines, and at the last line of the
+              CPI, the lines gathered are turned into place.
+
+ Parameters:  ct   - pointer to the corner turn
+              line - bins complex samples
+
+ Return:      0 - line added
+              1 - line added and the CPI is complete; the buffer given
+                  to CTURN_Begin() holds it, and the next CPI needs
+                  another CTURN_Begin()
+             -1 - no CPI has been begun; the line is dropped
+**************************************************************************/
+int CTURN_AddLine (CORNER_TURN *ct, const float *line)
+{
+    size_t lineFloats = (size_t)ct->bins * 2;
+
+    if (ct->out == NULL)
+        return (-1);
+
+    memcpy (ct->block + (ct->blockLines * lineFloats), line,
+            lineFloats * sizeof(float));
+    ct->blockLines++;
+    ct->received++;
+
+    if ((ct->blockLines < CTURN_BLOCK_LINES) && (ct->received < ct->lines))
+        return (0);
+
+    CTURN_Run(ct, ct->block, ct->blockLines, ct->received - ct->blockLines,
+              ct->out);
+    ct->blockLines = 0;
+
+    if (ct->received < ct->lines)
+        return (0);
+
+    ct->out = NULL;
+    return (1);
+}
+
+
+/**************************************************************************
+ Function:    CTURN_Free()
+
+ Description: Stops the helper threads and frees the block buffer.  Safe
+              on a corner turn that failed to initialise.
+
+ Parameters:  ct - pointer to the corner turn
+
+ Return:      none
+**************************************************************************/
+void CTURN_Free (CORNER_TURN *ct)
+{
+    unsigned int i;
+
+    __atomic_store_n(&(ct->stop), 1, __ATOMIC_RELEASE);
+    for (i = 1; i < ct->numThreads; i++)
+        pthread_join(ct->helper[i].thread, NULL);
+    ct->numThreads = 0;
+
+    free(ct->block);
+    ct->block = NULL;
+    ct->out   = NULL;
+}
+
+
+/**************************************************************************
+ Function:    CTURN_Run()
+
+ Description: Turns consecutive lines of a CPI into place, sharing the
+              range bins among the caller and the helpers.
+
+ Parameters:  ct       - pointer to the corner turn
+              in       - numLines x bins complex samples
+              numLines - lines to turn
+              first    - CPI line number of the first of them
+              out      - the CPI, bins x lines
+
+ Return:      none
+**************************************************************************/
+static void CTURN_Run (CORNER_TURN *ct, const float *in,
+                       unsigned int numLines, unsigned int first, float *out)
+{
+    struct timespec    idle  = {0, CTURN_SLEEP_NS};
+    unsigned long long job;
+    unsigned int       spins = 0;
+    unsigned int       i;
+
+    ct->jobIn    = in;
+    ct->jobLines = numLines;
+    ct->jobFirst = first;
+    ct->jobOut   = out;
+
+    job = ct->job + 1;
+    __atomic_store_n(&(ct->job), job, __ATOMIC_RELEASE);
+
+    CTURN_Band(ct, 0);
+
+    for (i = 1; i < ct->numThreads; i++)
+    {
+        while (__atomic_load_n(&(ct->helper[i].doneJob), __ATOMIC_ACQUIRE) != job)
+        {
+            if (spins < CTURN_SPINS)
+                spins++;
+            else
+                nanosleep(&idle, NULL);
+        }
+    }
+}
+
+
+/**************************************************************************
+ Function:    CTURN_Band()
+
+ Description: Turns one thread's band of range bins for the posted job,
+              a tile at a time.  Within a tile the input is read down
+              the lines and the output written along them, so each
+              output row is written contiguously.
+
+ Parameters:  ct   - pointer to the corner turn
+              band - 0 for the caller, the helper's index otherwise
+
+ Return:      none
+**************************************************************************/
+static void CTURN_Band (CORNER_TURN *ct, unsigned int band)
+{
+    unsigned int  tiles = (ct->bins + CTURN_TILE_BINS - 1) / CTURN_TILE_BINS;
+    unsigned int  firstBin = ((tiles * band) / ct->numThreads) * CTURN_TILE_BINS;
+    unsigned int  endBin   = ((tiles * (band + 1)) / ct->numThreads) * CTURN_TILE_BINS;
+    const float  *in  = ct->jobIn;
+    float        *out = ct->jobOut;
+    size_t        inStride  = (size_t)ct->bins * 2;
+    size_t        outStride = (size_t)ct->lines * 2;
+    unsigned int  l0, l, lEnd;
+    unsigned int  b0, b, bEnd;
+    const float  *src;
+    float        *dst;
+
+    if (endBin > ct->bins)
+        endBin = ct->bins;
+
+    for (l0 = 0; l0 < ct->jobLines; l0 += CTURN_TILE_LINES)
+    {
+        lEnd = l0 + CTURN_TILE_LINES;
+        if (lEnd > ct->jobLines)
+            lEnd = ct->jobLines;
+
+        for (b0 = firstBin; b0 < endBin; b0 += CTURN_TILE_BINS)
+        {
+            bEnd = b0 + CTURN_TILE_BINS;
+            if (bEnd > endBin)
+                bEnd = endBin;
+
+            for (b = b0; b < bEnd; b++)
+            {
+                src = in + (l0 * inStride) + (2 * b);
+                dst = out + (b * outStride) + (2 * (ct->jobFirst + l0));
+                for (l = l0; l < lEnd; l++)
+                {
+                    dst[0] = src[0];
+                    dst[1] = src[1];
+                    src += inStride;
+                    dst += 2;
+                }
+            }
+        }
+    }
+}
+
+
+/**************************************************************************
+ Function:    CTURN_HelperThread()
+
+ Description: Helper.  Turns its band of each job posted, spinning
+              briefly between jobs and then sleeping in CTURN_SLEEP_NS
+              steps, until CTURN_Free() stops it.
+
+ Parameters:  pParams - pointer to the helper's CTURN_HELPER
+
+ Return:      NULL
+**************************************************************************/
+static void *CTURN_HelperThread (void *pParams)
+{
+    CTURN_HELPER       *h     = (CTURN_HELPER *)pParams;
+    CORNER_TURN        *ct    = h->ct;
+    struct timespec     idle  = {0, CTURN_SLEEP_NS};
+    unsigned long long  job;
+    unsigned int        spins = 0;
+
+    while (1)
+    {
+        job = __atomic_load_n(&(ct->job), __ATOMIC_ACQUIRE);
+        if (job == h->doneJob)
+        {
+            if (__atomic_load_n(&(ct->stop), __ATOMIC_ACQUIRE))
+                break;
+            if (spins < CTURN_SPINS)
+                spins++;
+            else
+                nanosleep(&idle, NULL);
+            continue;
+        }
+
+        spins = 0;
+        CTURN_Band(ct, h->index);
+        __atomic_store_n(&(h->doneJob), job, __ATOMIC_RELEASE);
+    }
+
+    return (NULL);
+}
@@ -0,0 +1,148 @@
+/***********************************************************************
+*
+*   File: cturn.h
+*
+*   Description: header file for cturn.c, the corner turn between the
+*                fast-time range lines a channel captures and the
+*                slow-time vectors Doppler processing works on.
+*
+*                A CPI (coherent processing interval) is "lines" range
+*                lines of "bins" complex samples.  The corner turn
+*                rewrites it range bin major: out[bin][line], so each
+*                range bin's slow-time vector is contiguous.  Data are
+*                complex float, re, im interleaved, as fft.c and iqk.c
+*                use them.
+*
+*                Done naively one side of the copy strides through
+*                memory a whole row at a time and every access misses
+*                the cache.  cturn.c copies CTURN_TILE_LINES x
+*                CTURN_TILE_BINS tiles, small enough that both the rows
+*                read and the rows written stay in L1, and splits the
+*                range bins among the calling thread and numThreads - 1
+*                helper threads.
+*
+*                Two ways in:
+*                    CTURN_Transpose() - turns a whole CPI held in memory
+*                    CTURN_Begin() and CTURN_AddLine() - turns lines as
+*                        they arrive.  Lines are gathered
+*                        CTURN_BLOCK_LINES at a time and each block turned
+*                        into place, so every range bin is written whole
+*                        cache lines at a time and the CPI is ready as
+*                        soon as its last line is in.
+*
+*                One thread drives a CORNER_TURN; the helpers only ever
+*                work inside a call from it.
+*
+************************************************************************/
+
+#ifndef __CTURN_H__
+#define __CTURN_H__
+
+#include <stddef.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* CTURN_TILE_LINES / CTURN_TILE_BINS - tile copied at a time: 32 x 32
+ * complex is 8 kB read and 8 kB written
+ */
+#define CTURN_TILE_LINES     32
+#define CTURN_TILE_BINS      32
+
+/* CTURN_BLOCK_LINES - lines CTURN_AddLine() gathers before turning them:
+ * four 64 byte cache lines per range bin, and at 4096 bins a 1 MB block
+ * that stays in L2 while it is turned
+ */
+#define CTURN_BLOCK_LINES    32
+
+/* CTURN_MAX_THREADS - threads a corner turn can use, the caller's
+ * included
+ */
+#define CTURN_MAX_THREADS    16
+
+/* CTURN_SPINS - empty polls before a waiting thread starts sleeping;
+ * CTURN_SLEEP_NS - length of each sleep once idle
+ */
+#define CTURN_SPINS          1024
+#define CTURN_SLEEP_NS       20000
+
+
+/* CTURN_HELPER - one helper thread
+ *     ct       = the helper's corner turn
+ *     index    = band of range bins it turns, 1 ... numThreads - 1; the
+ *                caller turns band 0
+ *     doneJob  = last job finished
+ *     thread   = helper thread
+ */
+typedef struct CTURN_HELPER
+        {
+            struct CORNER_TURN *ct;
+            unsigned int        index;
+            unsigned long long  doneJob;
+            pthread_t           thread;
+        } CTURN_HELPER;
+
+
+/* CORNER_TURN - corner turn for one CPI size
+ *     lines      = range lines in a CPI
+ *     bins       = complex samples in a range line
+ *     numThreads = threads sharing each turn, the caller's included
+ *     helper     = helper threads
+ *     job        = number of the job posted to the helpers
+ *     stop       = set by CTURN_Free() to end the helpers
+ *
+ *   the job posted:
+ *     jobIn      = first line to turn
+ *     jobLines   = lines to turn
+ *     jobFirst   = CPI line number of jobIn
+ *     jobOut     = CPI the lines go into
+ *
+ *   streaming, CTURN_Begin() / CTURN_AddLine():
+ *     out        = CPI being filled, NULL when none is
+ *     block      = CTURN_BLOCK_LINES lines gathered for turning
+ *     blockLines = lines in block
+ *     received   = lines of the CPI received so far
+ */
+typedef struct CORNER_TURN
+        {
+            unsigned int        lines;
+            unsigned int        bins;
+            unsigned int        numThreads;
+            CTURN_HELPER        helper[CTURN_MAX_THREADS];
+            unsigned long long  job;
+            int                 stop;
+
+            const float        *jobIn;
+            unsigned int        jobLines;
+            unsigned int        jobFirst;
+            float              *jobOut;
+
+            float              *out;
+            float              *block;
+            unsigned int        blockLines;
+            unsigned int        received;
+        } CORNER_TURN;
+
+
+/* function prototypes */
+int  CTURN_Init      (CORNER_TURN   *ct,
+                      unsigned int   lines,
+                      unsigned int   bins,
+                      unsigned int   numThreads);
+void CTURN_Transpose (CORNER_TURN   *ct,
+                      const float   *in,
+                      float         *out);
+void CTURN_Begin     (CORNER_TURN   *ct,
+                      float         *out);
+int  CTURN_AddLine   (CORNER_TURN   *ct,
+                      const float   *line);
+void CTURN_Free      (CORNER_TURN   *ct);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CTURN_H__ */
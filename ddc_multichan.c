@@ -204,6 +204,49 @@ unsigned int intrCount = 0;
 
 int Adc_delay;
 volatile int SAMPLES_PER_PRI_GLOBAL;
+volatile int NUM_DMA_BUFS_GLOBAL = NUM_DMA_BUFS;
+volatile int IRQ_COALESCE_GLOBAL = 1;       // range lines per link-end interrupt
+volatile int OUTPUT_BACKEND_GLOBAL = REC_FILE_STDIO;
+volatile int WRITE_BATCH_GLOBAL = 1;
+volatile int RECORD_FORMAT_GLOBAL = 0;      // 0 = raw range lines, 1 = nxrec
+volatile int COMPRESS_THREADS_GLOBAL = 0;   // compression workers per channel, 0 = off
+int BFP_BITS_GLOBAL[MAX_CHANNELS] = {0, 0, 0, 0};        // 0 = full 16-bit lines
+volatile int BFP_BLOCK_GLOBAL = 32;         // complex samples per exponent
+volatile int SEGMENT_PRIS_GLOBAL = 0;       // PRIs per segment, 0 = one file per channel
+volatile int SEGMENT_MB_GLOBAL = 0;         // largest segment in MB, 0 = no limit
+RANGE_GATE RANGE_GATE_GLOBAL[MAX_CHANNELS];  // range windows kept, none = whole line
+volatile int PULSE_COMPRESS_THREADS_GLOBAL = 0; // matched filter workers per channel, 0 = off
+volatile int PULSE_COMPRESS_FFT_GLOBAL = 0;     // 0 = long enough not to wrap
+volatile int PULSE_COMPRESS_OUTPUT_GLOBAL = 0;  // 1 = write pcN.dat
+volatile int RANGE_WINDOW_GLOBAL = WIN_UNIFORM;  // pulse compression taper
+volatile int RANGE_DOPPLER_THREADS_GLOBAL = 0;  // Doppler workers per channel, 0 = off
+volatile int DOPPLER_CPI_GLOBAL = 256;          // range lines per map
+volatile int DOPPLER_PADDING_FACTOR_GLOBAL = 1; // Doppler FFT size / DOPPLER_CPI
+volatile int DOPPLER_WINDOW_GLOBAL = WIN_HANNING; // slow-time taper
+volatile int RANGE_DOPPLER_OUTPUT_GLOBAL = 0;   // 1 = write rdN.dat
+volatile int CFAR_METHOD_GLOBAL = CFAR_OFF;     // detector on the maps, writes detN.dat
+volatile int CFAR_GUARD_GLOBAL = 2;             // guard range bins each side
+volatile int CFAR_TRAIN_GLOBAL = 16;            // training range bins each side
+volatile float CFAR_THRESHOLD_DB_GLOBAL = 15.5f; // over the noise estimate
+volatile int CFAR_OS_RANK_GLOBAL = 0;           // 0 = 3/4 of the training cells
+static float *pcRef = NULL;                 // matched filter reference
+static unsigned int pcRefSamples = 0;
+static TABLE_CACHE tableCache;              // FFT plans, windows, reference spectra
+int WAVEFORM_GLOBAL;
+int DAC_DELAY_GLOBAL;
+volatile int ASYNC_DEPTH_GLOBAL = 4;
+volatile int PRI_NS_GLOBAL = 0;             // 0 = estimate from the interrupts
+volatile int RT_PRIORITY_GLOBAL = 0;        // SCHED_FIFO priority, 0 = default scheduling
+volatile int ACQ_POLL_GLOBAL = 0;           // 1 = poll the link-end flag, 0 = interrupt
+volatile int POLL_SPIN_US_GLOBAL = 0;       // spin before backing off, 0 = never back off
+int ACQ_CPU_GLOBAL[MAX_CHANNELS] = {-1, -1, -1, -1};     // -1 = not pinned
+int WRITER_CPU_GLOBAL[MAX_CHANNELS] = {-1, -1, -1, -1};
+char STAGING_DIR_GLOBAL[MOVER_PATH_LEN];    // empty = record straight to the share
+static MOVER mover;
+static PRI_IRQ_LOG irqLog[MAX_CHANNELS];    // link-end interrupt times
+static LAT_HIST latHist[MAX_CHANNELS][LAT_NUM_STAGES];  // pipeline latencies
+static const char *latStageName[LAT_NUM_STAGES] =
+    {"irq->wake", "wake->sync", "publish->writer", "writer->written", "irq->written"};
 
 
 /**************************************************************************
@@ -225,6 +268,53 @@ typedef struct
     int DAC_DELAY;
     int ADC_DELAY;
     int SAMPLES_PER_PRI;
+    int GEOMETRY_WINDOW; // 1 = ADC_DELAY and SAMPLES_PER_PRI from the geometry
+    int NODE_ID;         // this node in [GeometrySettings]; node 0 transmits
+    double GEOMETRY_MARGIN; // bistatic range recorded either side of the target, m
+    double NODE_LAT[GEOM_MAX_NODES]; // NodenLocationLat/Lon/Ht
+    double NODE_LON[GEOM_MAX_NODES];
+    double NODE_HT[GEOM_MAX_NODES];
+    double TGT_LAT;      // TgtLocationLat/Lon/Ht
+    double TGT_LON;
+    double TGT_HT;
+    int NUM_RING_BUFS;   // DMA buffers per channel ring (NUM_DMA_BUFS)
+    int IRQ_COALESCE;    // range lines per link-end interrupt
+    int OUTPUT_BACKEND;  // 0 = stdio fwrite per line, 1 = batched pwritev, 2 = async O_DIRECT, 3 = mmap
+    int WRITE_BATCH;     // range lines per batched write
+    int RECORD_FORMAT;   // 0 = raw int16 I/Q, 1 = nxrec header and line prefixes
+    int COMPRESS_THREADS; // lossless compression workers per channel, 0 = off
+    char BFP_BITS[64];   // block floating point mantissa bits, one per channel
+    int BFP_BLOCK;       // complex samples per block floating point exponent
+    int SEGMENT_PRIS;    // PRIs per recording segment, 0 = not segmented
+    int SEGMENT_MB;      // largest recording segment in MB, 0 = no limit
+    int SEGMENT_SECONDS; // longest recording segment in seconds, 0 = no limit
+    char RANGE_GATES[MAX_CHANNELS][INI_MAX_LINE]; // range windows per channel, RANGE_GATESn
+    int PULSE_COMPRESS_THREADS; // matched filter workers per channel, 0 = off
+    int PULSE_COMPRESS_FFT; // FFT size, 0 = line + reference without wrapping
+    int PULSE_COMPRESS_OUTPUT; // 1 = write the compressed lines to pcN.dat
+    int RANGE_WINDOW;    // window code tapering the pulse compression
+    int RANGE_DOPPLER_THREADS; // Doppler workers per channel, 0 = off
+    int DOPPLER_CPI;     // range lines per range-Doppler map
+    int DOPPLER_PADDING_FACTOR; // Doppler FFT size as a multiple of DOPPLER_CPI
+    int DOPPLER_WINDOW;  // window code tapering the slow-time vectors
+    int RANGE_DOPPLER_OUTPUT; // 1 = write the maps to rdN.dat
+    int CFAR_METHOD;     // detector on the maps: 0 = off, 1 = CA, 2 = OS
+    int CFAR_GUARD;      // guard range bins each side of the cell under test
+    int CFAR_TRAIN;      // training range bins each side of the guard bins
+    double CFAR_THRESHOLD_DB; // detection threshold over the noise estimate
+    int CFAR_OS_RANK;    // ordered statistic rank, 0 = 3/4 of 2 x CFAR_TRAIN
+    char TABLE_CACHE_DIR[TCACHE_PATH_LEN]; // processing tables kept between runs
+    int ASYNC_DEPTH;     // staging buffers per channel for the async backend
+    char STAGING_DIR[MOVER_PATH_LEN]; // local directory to record into
+    int MOVER_RATE;      // MB/s limit when moving to the share, 0 = none
+    int PRI_NS;          // nominal PRI for missed pulse detection, 0 = estimate
+    int RT_PRIORITY;     // SCHED_FIFO priority of dmaThread(), 0 = default
+    char ACQ_CPUS[64];   // CPU list, one per channel's dmaThread()
+    char WRITER_CPUS[64]; // CPU list shared by the writer threads
+    int LOCK_MEMORY;     // 1 = mlockall() and prefault buffers
+    int JITTER_TEST;     // wake-ups in the startup jitter probe, 0 = off
+    int ACQ_POLL;        // 1 = busy-poll the ADC flags instead of the interrupt
+    int POLL_SPIN_US;    // poll spin time before backing off, 0 = never
     int NEXT_VARIABLE;
 
 } configuration;
@@ -251,6 +341,105 @@ static int handler(void* user, const char* section, const char* name,
 		pconfig->ADC_DELAY = atoi(value);
     } else if (MATCH("SAMPLES_PER_PRI")) {
 		pconfig->SAMPLES_PER_PRI = atoi(value);
+    } else if (MATCH("GEOMETRY_WINDOW")) {
+		pconfig->GEOMETRY_WINDOW = atoi(value);
+    } else if (MATCH("NODE_ID")) {
+		pconfig->NODE_ID = atoi(value);
+    } else if (MATCH("GEOMETRY_MARGIN")) {
+		pconfig->GEOMETRY_MARGIN = atof(value);
+    } else if ((strncmp(name, "Node", 4) == 0) && (name[4] >= '0') &&
+               (name[4] < '0' + GEOM_MAX_NODES) && (strncmp(name + 5, "Location", 8) == 0)) {
+		if (strcmp(name + 13, "Lat") == 0)
+		    pconfig->NODE_LAT[name[4] - '0'] = atof(value);
+		else if (strcmp(name + 13, "Lon") == 0)
+		    pconfig->NODE_LON[name[4] - '0'] = atof(value);
+		else if (strcmp(name + 13, "Ht") == 0)
+		    pconfig->NODE_HT[name[4] - '0'] = atof(value);
+		else
+		    return 0;
+    } else if (MATCH("TgtLocationLat")) {
+		pconfig->TGT_LAT = atof(value);
+    } else if (MATCH("TgtLocationLon")) {
+		pconfig->TGT_LON = atof(value);
+    } else if (MATCH("TgtLocationHt")) {
+		pconfig->TGT_HT = atof(value);
+    } else if (MATCH("NUM_DMA_BUFS")) {
+		pconfig->NUM_RING_BUFS = atoi(value);
+    } else if (MATCH("IRQ_COALESCE")) {
+		pconfig->IRQ_COALESCE = atoi(value);
+    } else if (MATCH("OUTPUT_BACKEND")) {
+		pconfig->OUTPUT_BACKEND = atoi(value);
+    } else if (MATCH("WRITE_BATCH")) {
+		pconfig->WRITE_BATCH = atoi(value);
+    } else if (MATCH("RECORD_FORMAT")) {
+		pconfig->RECORD_FORMAT = atoi(value);
+    } else if (MATCH("COMPRESS_THREADS")) {
+		pconfig->COMPRESS_THREADS = atoi(value);
+    } else if (MATCH("BFP_BITS")) {
+		strncpy(pconfig->BFP_BITS, value, sizeof(pconfig->BFP_BITS) - 1);
+    } else if (MATCH("BFP_BLOCK")) {
+		pconfig->BFP_BLOCK = atoi(value);
+    } else if (MATCH("SEGMENT_PRIS")) {
+		pconfig->SEGMENT_PRIS = atoi(value);
+    } else if (MATCH("SEGMENT_MB")) {
+		pconfig->SEGMENT_MB = atoi(value);
+    } else if (MATCH("SEGMENT_SECONDS")) {
+		pconfig->SEGMENT_SECONDS = atoi(value);
+    } else if ((strncmp(name, "RANGE_GATES", 11) == 0) && (name[11] >= '0') &&
+               (name[11] < '0' + MAX_CHANNELS) && (name[12] == '\0')) {
+		strncpy(pconfig->RANGE_GATES[name[11] - '0'], value, INI_MAX_LINE - 1);
+    } else if (MATCH("PULSE_COMPRESS_THREADS")) {
+		pconfig->PULSE_COMPRESS_THREADS = atoi(value);
+    } else if (MATCH("PULSE_COMPRESS_FFT")) {
+		pconfig->PULSE_COMPRESS_FFT = atoi(value);
+    } else if (MATCH("PULSE_COMPRESS_OUTPUT")) {
+		pconfig->PULSE_COMPRESS_OUTPUT = atoi(value);
+    } else if (MATCH("RANGE_WINDOW")) {
+		pconfig->RANGE_WINDOW = atoi(value);
+    } else if (MATCH("RANGE_DOPPLER_THREADS")) {
+		pconfig->RANGE_DOPPLER_THREADS = atoi(value);
+    } else if (MATCH("DOPPLER_CPI")) {
+		pconfig->DOPPLER_CPI = atoi(value);
+    } else if (MATCH("DOPPLER_PADDING_FACTOR")) {
+		pconfig->DOPPLER_PADDING_FACTOR = atoi(value);
+    } else if (MATCH("DOPPLER_WINDOW")) {
+		pconfig->DOPPLER_WINDOW = atoi(value);
+    } else if (MATCH("RANGE_DOPPLER_OUTPUT")) {
+		pconfig->RANGE_DOPPLER_OUTPUT = atoi(value);
+    } else if (MATCH("CFAR_METHOD")) {
+		pconfig->CFAR_METHOD = atoi(value);
+    } else if (MATCH("CFAR_GUARD")) {
+		pconfig->CFAR_GUARD = atoi(value);
+    } else if (MATCH("CFAR_TRAIN")) {
+		pconfig->CFAR_TRAIN = atoi(value);
+    } else if (MATCH("CFAR_THRESHOLD_DB")) {
+		pconfig->CFAR_THRESHOLD_DB = atof(value);
+    } else if (MATCH("CFAR_OS_RANK")) {
+		pconfig->CFAR_OS_RANK = atoi(value);
+    } else if (MATCH("TABLE_CACHE_DIR")) {
+		strncpy(pconfig->TABLE_CACHE_DIR, value, sizeof(pconfig->TABLE_CACHE_DIR) - 1);
+    } else if (MATCH("ASYNC_DEPTH")) {
+		pconfig->ASYNC_DEPTH = atoi(value);
+    } else if (MATCH("STAGING_DIR")) {
+		strncpy(pconfig->STAGING_DIR, value, sizeof(pconfig->STAGING_DIR) - 1);
+    } else if (MATCH("MOVER_RATE")) {
+		pconfig->MOVER_RATE = atoi(value);
+    } else if (MATCH("PRI_NS")) {
+		pconfig->PRI_NS = atoi(value);
+    } else if (MATCH("RT_PRIORITY")) {
+		pconfig->RT_PRIORITY = atoi(value);
+    } else if (MATCH("ACQ_CPUS")) {
+		strncpy(pconfig->ACQ_CPUS, value, sizeof(pconfig->ACQ_CPUS) - 1);
+    } else if (MATCH("WRITER_CPUS")) {
+		strncpy(pconfig->WRITER_CPUS, value, sizeof(pconfig->WRITER_CPUS) - 1);
+    } else if (MATCH("LOCK_MEMORY")) {
+		pconfig->LOCK_MEMORY = atoi(value);
+    } else if (MATCH("JITTER_TEST")) {
+		pconfig->JITTER_TEST = atoi(value);
+    } else if (MATCH("ACQ_POLL")) {
+		pconfig->ACQ_POLL = atoi(value);
+    } else if (MATCH("POLL_SPIN_US")) {
+		pconfig->POLL_SPIN_US = atoi(value);
     } else if (MATCH("NEXT_VARIABLE")) {
         pconfig->NEXT_VARIABLE = atoi(value);
     }  else {
@@ -293,6 +482,7 @@ static void dmaIntHandler(PVOID               hDev,
 #if DEBUG
     intrCount++;
 #endif
+    PRISTATS_IrqStamp(&irqLog[dmaChannel], DMARING_TimeNs());
     PTKIFC_SemaphorePost (ifcArgs, (4 + dmaChannel));
 }
 
@@ -426,6 +616,19 @@ int main (int argc, char *argv[])
 
     printf ("\n[%s] Entry\n", PROGRAM_ID);
 
+    /* latency histograms, dumped at the end of each channel's run and on
+     * SIGUSR1; the signal is blocked before any thread (including the
+     * driver's) is created so only the dump thread receives it
+     */
+    for (chan = 0; chan < MAX_CHANNELS; chan++)
+        for (i = 0; i < LAT_NUM_STAGES; i++)
+            LATHIST_Init(&latHist[chan][i], latStageName[i]);
+    if ((LATHIST_BlockSignal(SIGUSR1) != 0) ||
+        (LATHIST_StartDump(SIGUSR1, latHistDump) != 0))
+        printf("[%s] Warning: on-demand latency dump not available\n", PROGRAM_ID);
+    printf("[%s] latency stamp overhead %.1f ns (%d stamps per PRI)\n",
+           PROGRAM_ID, LATHIST_Overhead(), LAT_NUM_STAGES + 2);
+
     /* initialize OS-dependent resources */
     PTKIFC_Init(&ifcArgs);
 
@@ -593,7 +796,7 @@ int main (int argc, char *argv[])
 	//ptrFile = fopen("C:\\Waveforms\\5p625MHzSine.dat", "r");
 	//ptrFile = fopen("./Waveforms/WaveformDataTable.dat", "r");
 	//ptrFile = fopen("///smbtest/WaveformsRandy17Nov2017/WaveGenFiles/0p25usPulse.dat", "r");
-        ptrFile = fopen("///smbtest/Waveforms/WaveformTable.dat", "r");
+        ptrFile = fopen(WAVEFORM_TABLE, "r");
 
 	//ptrFile = fopen("./Waveforms/B50LFMChirp.dat", "r");
     ptrTemp = (unsigned int *)dmaBuf.usrBuf;
@@ -748,7 +951,7 @@ int main (int argc, char *argv[])
     {
         *(exitHdlResrc.dmaHandlePtr[chan]) = NULL;
 
-        for (i = 0; i < NUM_DMA_BUFS; i++)
+        for (i = 0; i < MAX_DMA_BUFS; i++)
         {
             (exitHdlResrc.dmaBufPtr[chan][i]) = &(dmaThreadParams[chan].dmaBuf[i]);
             (dmaThreadParams[chan].dmaBuf[i]).usrBuf = NULL;
@@ -1150,14 +1353,21 @@ double T_param_vec[]
     // Parser
 	// closes program if file can't be found
     configuration config;
+    memset(&config, 0, sizeof(config));
+    config.RANGE_WINDOW = WIN_UNIFORM; // window code 0 is HANNING, so unset must not read as 0
+    config.CFAR_GUARD = 2;             // 0 guard bins and 0 dB are both valid, so
+    config.CFAR_THRESHOLD_DB = 15.5;   // these need their defaults set here, and
+    config.CFAR_TRAIN = 16;            // a CFAR_TRAIN of 0 must be seen to be refused
 
 	//if (ini_parse("/smbtest/NeXtRAD_Header.txt", handler, &config) < 0) {
-    if (ini_parse("///smbtest/NeXtRAD.ini", handler, &config) < 0) {
+    if (ini_parse(NEXTRAD_INI, handler, &config) < 0) {
 		printf("PARSER: Can't load file.'\n");
 		return 1;
     }
 	int PulseNum = config.WAVEFORM;
 	int Dac_delay = config.DAC_DELAY;
+	WAVEFORM_GLOBAL = PulseNum;
+	DAC_DELAY_GLOBAL = Dac_delay;
 	if(Dac_delay < 1) {
         printf("ERROR: DAC_DELAY must be greater than or equal to 1.");
         return 1;
@@ -1165,7 +1375,392 @@ double T_param_vec[]
 
 	Adc_delay = config.ADC_DELAY;
 	SAMPLES_PER_PRI_GLOBAL = config.SAMPLES_PER_PRI;
-	printf("SAMPLES_PER_PRI_GLOBAL = %d\n", SAMPLES_PER_PRI_GLOBAL);
+
+	// or work both out from where this node, node 0 (the transmitter) and
+	// the target are, at the decimated sample rate
+	if (config.GEOMETRY_WINDOW) {
+	    GEOM_POS    tx, rx, tgt;
+	    GEOM_WINDOW win;
+	    double      sampleRate = moduleResrc->progParams.clockFreq / decimation;
+
+	    if ((config.NODE_ID < 0) || (config.NODE_ID >= GEOM_MAX_NODES)) {
+	        printf("ERROR: NODE_ID must be 0 to %d.\n", GEOM_MAX_NODES - 1);
+	        return 1;
+	    }
+	    tx.latDeg  = config.NODE_LAT[0];
+	    tx.lonDeg  = config.NODE_LON[0];
+	    tx.htM     = config.NODE_HT[0];
+	    rx.latDeg  = config.NODE_LAT[config.NODE_ID];
+	    rx.lonDeg  = config.NODE_LON[config.NODE_ID];
+	    rx.htM     = config.NODE_HT[config.NODE_ID];
+	    tgt.latDeg = config.TGT_LAT;
+	    tgt.lonDeg = config.TGT_LON;
+	    tgt.htM    = config.TGT_HT;
+
+	    status = GEOM_RecordWindow(&tx, &rx, &tgt, config.GEOMETRY_MARGIN,
+	                               GEOM_PulseWidthUs(config.WAVEFORM), sampleRate,
+	                               Dac_delay, XFER_WORD_SIZE, &win);
+	    if (status == 2) {
+	        printf("ERROR: GEOMETRY_WINDOW: the pulse does not fit in %d samples at %.2f MSPS.\n",
+	               (int)XFER_WORD_SIZE, sampleRate / 1e6);
+	        return 1;
+	    }
+	    if (status == 1)
+	        printf("WARNING: GEOMETRY_WINDOW: %.0f m either side of the target needs more than %d samples; window narrowed.\n",
+	               config.GEOMETRY_MARGIN, (int)XFER_WORD_SIZE);
+	    printf("GEOMETRY_WINDOW: node %d, bistatic range %.1f m (direct path %.1f m), recording %.1f to %.1f m\n",
+	           config.NODE_ID, win.rangeM, win.baselineM, win.startM, win.endM);
+	    if ((config.ADC_DELAY != 0) || (config.SAMPLES_PER_PRI != 0))
+	        printf("GEOMETRY_WINDOW: ADC_DELAY %d and SAMPLES_PER_PRI %d from NeXtRAD.ini not used.\n",
+	               config.ADC_DELAY, config.SAMPLES_PER_PRI);
+	    Adc_delay = win.adcDelay;
+	    SAMPLES_PER_PRI_GLOBAL = win.samples;
+	}
+	printf("Adc_delay = %d, SAMPLES_PER_PRI_GLOBAL = %d\n", Adc_delay, SAMPLES_PER_PRI_GLOBAL);
+
+	if (config.NUM_RING_BUFS > 0)
+	    NUM_DMA_BUFS_GLOBAL = config.NUM_RING_BUFS;
+	if (NUM_DMA_BUFS_GLOBAL > MAX_DMA_BUFS) {
+	    printf("ERROR: NUM_DMA_BUFS must not exceed %d.\n", MAX_DMA_BUFS);
+	    return 1;
+	}
+	printf("NUM_DMA_BUFS_GLOBAL = %d\n", NUM_DMA_BUFS_GLOBAL);
+
+	// descriptor groups must tile the ring, with one group being serviced
+	// while the DMA engine fills the next
+	if (config.IRQ_COALESCE > 0)
+	    IRQ_COALESCE_GLOBAL = config.IRQ_COALESCE;
+	if (((NUM_DMA_BUFS_GLOBAL % IRQ_COALESCE_GLOBAL) != 0) ||
+	    ((IRQ_COALESCE_GLOBAL > 1) && (NUM_DMA_BUFS_GLOBAL < 2 * IRQ_COALESCE_GLOBAL))) {
+	    printf("ERROR: NUM_DMA_BUFS must be a multiple of IRQ_COALESCE and at least twice it.\n");
+	    return 1;
+	}
+	// the link-end interrupt only comes at the end of a full group, so a
+	// run cut short inside one would wait for it until dmaThread timed out
+	if ((config.NUM_TRANSFERS > 0) && ((config.NUM_TRANSFERS % IRQ_COALESCE_GLOBAL) != 0)) {
+	    printf("ERROR: NUM_PRIS must be a multiple of IRQ_COALESCE, or 0 to run until stopped.\n");
+	    return 1;
+	}
+	printf("IRQ_COALESCE_GLOBAL = %d\n", IRQ_COALESCE_GLOBAL);
+
+	OUTPUT_BACKEND_GLOBAL = config.OUTPUT_BACKEND;
+	if (config.WRITE_BATCH > 0)
+	    WRITE_BATCH_GLOBAL = config.WRITE_BATCH;
+	if (OUTPUT_BACKEND_GLOBAL == REC_FILE_STDIO)
+	    WRITE_BATCH_GLOBAL = 1;
+	// a pwritev batch is written straight from the DMA buffers, so it has
+	// to be on disk before the ring comes round to its first buffer again
+	// (which, with coalescing, is up to a group before it is published)
+	if ((OUTPUT_BACKEND_GLOBAL == REC_FILE_PWRITEV) && (NUM_DMA_BUFS_GLOBAL > 1) &&
+	    ((WRITE_BATCH_GLOBAL + IRQ_COALESCE_GLOBAL) > NUM_DMA_BUFS_GLOBAL)) {
+	    WRITE_BATCH_GLOBAL = (NUM_DMA_BUFS_GLOBAL - IRQ_COALESCE_GLOBAL + 1) / 2;
+	    printf("WARNING: WRITE_BATCH + IRQ_COALESCE must not exceed NUM_DMA_BUFS, using %d.\n", WRITE_BATCH_GLOBAL);
+	}
+	// the mapped file is sized from the run length, or the segment length
+	if ((OUTPUT_BACKEND_GLOBAL == REC_FILE_MMAP) && (config.NUM_TRANSFERS <= 0) &&
+	    (config.SEGMENT_PRIS <= 0) && (config.SEGMENT_MB <= 0) && (config.SEGMENT_SECONDS <= 0)) {
+	    printf("ERROR: OUTPUT_BACKEND = 3 needs NUM_PRIS or a SEGMENT_ setting.\n");
+	    return 1;
+	}
+	if (config.ASYNC_DEPTH > 0)
+	    ASYNC_DEPTH_GLOBAL = config.ASYNC_DEPTH;
+	if ((ASYNC_DEPTH_GLOBAL < 2) || (ASYNC_DEPTH_GLOBAL > REC_FILE_MAX_ASYNC)) {
+	    printf("ERROR: ASYNC_DEPTH must be between 2 and %d.\n", REC_FILE_MAX_ASYNC);
+	    return 1;
+	}
+	printf("OUTPUT_BACKEND_GLOBAL = %d, WRITE_BATCH_GLOBAL = %d, ASYNC_DEPTH_GLOBAL = %d\n", OUTPUT_BACKEND_GLOBAL, WRITE_BATCH_GLOBAL, ASYNC_DEPTH_GLOBAL);
+
+	RECORD_FORMAT_GLOBAL = config.RECORD_FORMAT;
+	printf("RECORD_FORMAT_GLOBAL = %d (%s)\n", RECORD_FORMAT_GLOBAL, RECORD_FORMAT_GLOBAL ? "nxrec" : "raw");
+
+	// packed lines vary in length, so they need the nxrec index and a
+	// backend that appends rather than one that writes by PRI offset
+	COMPRESS_THREADS_GLOBAL = config.COMPRESS_THREADS;
+	if ((COMPRESS_THREADS_GLOBAL < 0) || (COMPRESS_THREADS_GLOBAL > IQPACK_MAX_WORKERS)) {
+	    printf("ERROR: COMPRESS_THREADS must be between 0 and %d.\n", IQPACK_MAX_WORKERS);
+	    return 1;
+	}
+	if ((COMPRESS_THREADS_GLOBAL > 0) &&
+	    ((RECORD_FORMAT_GLOBAL != 1) || (OUTPUT_BACKEND_GLOBAL == REC_FILE_MMAP))) {
+	    printf("ERROR: COMPRESS_THREADS needs RECORD_FORMAT = 1 and OUTPUT_BACKEND 0, 1 or 2.\n");
+	    return 1;
+	}
+	printf("COMPRESS_THREADS_GLOBAL = %d\n", COMPRESS_THREADS_GLOBAL);
+
+	// lossy block floating point, chosen per channel; BFP_BITS is a list
+	// of mantissa widths, and channels not listed keep their full 16 bits
+	{
+	    int anyBfp = 0;
+
+	    status = BFP_ParseBits(config.BFP_BITS, BFP_BITS_GLOBAL, MAX_CHANNELS);
+	    if (status == 1) {
+	        printf("ERROR: BFP_BITS must be a list of up to %d mantissa widths.\n", MAX_CHANNELS);
+	        return 1;
+	    }
+	    if (status == 2) {
+	        printf("ERROR: BFP_BITS must be 0 or %d to %d.\n", BFP_MIN_BITS, BFP_MAX_BITS);
+	        return 1;
+	    }
+	    for (i = 0; i < MAX_CHANNELS; i++)
+	        if (BFP_BITS_GLOBAL[i] != 0)
+	            anyBfp = 1;
+	    if (config.BFP_BLOCK > 0)
+	        BFP_BLOCK_GLOBAL = config.BFP_BLOCK;
+	    if (anyBfp) {
+	        if ((BFP_BLOCK_GLOBAL < BFP_MIN_BLOCK) || (BFP_BLOCK_GLOBAL > BFP_MAX_BLOCK) ||
+	            ((BFP_BLOCK_GLOBAL % BFP_BLOCK_ALIGN) != 0)) {
+	            printf("ERROR: BFP_BLOCK must be a multiple of %d from %d to %d.\n",
+	                   BFP_BLOCK_ALIGN, BFP_MIN_BLOCK, BFP_MAX_BLOCK);
+	            return 1;
+	        }
+	        if ((RECORD_FORMAT_GLOBAL != 1) || (COMPRESS_THREADS_GLOBAL > 0)) {
+	            printf("ERROR: BFP_BITS needs RECORD_FORMAT = 1 and COMPRESS_THREADS = 0.\n");
+	            return 1;
+	        }
+	    }
+	}
+	printf("BFP_BITS = %d,%d,%d,%d, BFP_BLOCK_GLOBAL = %d\n",
+	       BFP_BITS_GLOBAL[0], BFP_BITS_GLOBAL[1], BFP_BITS_GLOBAL[2], BFP_BITS_GLOBAL[3],
+	       BFP_BLOCK_GLOBAL);
+
+	// range gating; RANGE_GATESn lists the windows kept from adcN's lines,
+	// and the windows go in the nxrec header, so raw files cannot be gated
+	for (i = 0; i < MAX_CHANNELS; i++) {
+	    status = RGATE_Parse(&RANGE_GATE_GLOBAL[i], config.RANGE_GATES[i], SAMPLES_PER_PRI_GLOBAL);
+	    if (status == 1) {
+	        printf("ERROR: RANGE_GATES%u must be up to %d windows like 1000-1999, 3000-3499.\n",
+	               i, RGATE_MAX_WINDOWS);
+	        return 1;
+	    }
+	    if (status == 2) {
+	        printf("ERROR: RANGE_GATES%u windows must be in order, not overlap and end before bin %d.\n",
+	               i, SAMPLES_PER_PRI_GLOBAL);
+	        return 1;
+	    }
+	    if (RANGE_GATE_GLOBAL[i].numWindows == 0)
+	        continue;
+	    if (RECORD_FORMAT_GLOBAL != 1) {
+	        printf("ERROR: RANGE_GATES%u needs RECORD_FORMAT = 1.\n", i);
+	        return 1;
+	    }
+	    printf("RANGE_GATES%u = %s (%u of %d samples)\n", i, config.RANGE_GATES[i],
+	           RANGE_GATE_GLOBAL[i].samples, SAMPLES_PER_PRI_GLOBAL);
+	}
+
+	// I/Q kernels for the processing stages, picked for this CPU before
+	// any thread uses them
+	IQK_Init(1);
+	printf("IQ kernels: %s\n", IQK_Name());
+
+	// pulse compression; the reference is this run's waveform from the
+	// table the DAC was loaded from, at the decimated sample rate
+	PULSE_COMPRESS_THREADS_GLOBAL = config.PULSE_COMPRESS_THREADS;
+	PULSE_COMPRESS_FFT_GLOBAL = config.PULSE_COMPRESS_FFT;
+	PULSE_COMPRESS_OUTPUT_GLOBAL = config.PULSE_COMPRESS_OUTPUT;
+	RANGE_WINDOW_GLOBAL = config.RANGE_WINDOW;
+	if ((PULSE_COMPRESS_THREADS_GLOBAL < 0) || (PULSE_COMPRESS_THREADS_GLOBAL > PCOMP_MAX_WORKERS)) {
+	    printf("ERROR: PULSE_COMPRESS_THREADS must be between 0 and %d.\n", PCOMP_MAX_WORKERS);
+	    return 1;
+	}
+	if ((RANGE_WINDOW_GLOBAL < WIN_HANNING) || (RANGE_WINDOW_GLOBAL > WIN_BLACKMAN)) {
+	    printf("ERROR: RANGE_WINDOW must be between %d and %d.\n", WIN_HANNING, WIN_BLACKMAN);
+	    return 1;
+	}
+	if (PULSE_COMPRESS_THREADS_GLOBAL > 0) {
+	    double sampleRate = moduleResrc->progParams.clockFreq / decimation;
+
+	    if ((PULSE_COMPRESS_FFT_GLOBAL != 0) &&
+	        ((PULSE_COMPRESS_FFT_GLOBAL < SAMPLES_PER_PRI_GLOBAL) ||
+	         (FFT_NextSize(PULSE_COMPRESS_FFT_GLOBAL) != (unsigned int)PULSE_COMPRESS_FFT_GLOBAL))) {
+	        printf("ERROR: PULSE_COMPRESS_FFT must be 0 or a power of 2 from SAMPLES_PER_PRI to %d.\n", FFT_MAX_SIZE);
+	        return 1;
+	    }
+	    if ((PulseNum < 1) || (PulseNum > ram_length_size) || (PulseNum > ram_offset_size)) {
+	        printf("ERROR: PULSE_COMPRESS_THREADS: WAVEFORM_INDEX %d is not in RAMdataTable.\n", PulseNum);
+	        return 1;
+	    }
+	    pcRef = (float *)malloc(XFER_WORD_SIZE * 2 * sizeof(float));
+	    if (pcRef == NULL) {
+	        printf("ERROR: PULSE_COMPRESS_THREADS: reference allocation failed.\n");
+	        return 1;
+	    }
+	    status = PCOMP_LoadReference(WAVEFORM_TABLE, RAM_OFFSET_VEC[PulseNum-1],
+	                                 RAM_LENGTH_VEC[PulseNum-1], sampleRate, pcRef,
+	                                 XFER_WORD_SIZE, &pcRefSamples);
+	    if (status != 0) {
+	        printf("ERROR: PULSE_COMPRESS_THREADS: waveform %d could not be read from %s (%d).\n",
+	               PulseNum, WAVEFORM_TABLE, status);
+	        return 1;
+	    }
+	    printf("PULSE_COMPRESS_THREADS_GLOBAL = %d, FFT %d, reference %u samples at %.2f MSPS, %s window%s\n",
+	           PULSE_COMPRESS_THREADS_GLOBAL, PULSE_COMPRESS_FFT_GLOBAL, pcRefSamples,
+	           sampleRate / 1e6, WIN_Name(RANGE_WINDOW_GLOBAL),
+	           PULSE_COMPRESS_OUTPUT_GLOBAL ? ", writing pcN.dat" : "");
+	}
+
+	// range-Doppler maps of the compressed lines
+	RANGE_DOPPLER_THREADS_GLOBAL = config.RANGE_DOPPLER_THREADS;
+	if (config.DOPPLER_CPI > 0)
+	    DOPPLER_CPI_GLOBAL = config.DOPPLER_CPI;
+	if (config.DOPPLER_PADDING_FACTOR > 0)
+	    DOPPLER_PADDING_FACTOR_GLOBAL = config.DOPPLER_PADDING_FACTOR;
+	DOPPLER_WINDOW_GLOBAL = config.DOPPLER_WINDOW;
+	RANGE_DOPPLER_OUTPUT_GLOBAL = config.RANGE_DOPPLER_OUTPUT;
+	if ((RANGE_DOPPLER_THREADS_GLOBAL < 0) || (RANGE_DOPPLER_THREADS_GLOBAL > RDOP_MAX_WORKERS)) {
+	    printf("ERROR: RANGE_DOPPLER_THREADS must be between 0 and %d.\n", RDOP_MAX_WORKERS);
+	    return 1;
+	}
+	if (RANGE_DOPPLER_THREADS_GLOBAL > 0) {
+	    if (PULSE_COMPRESS_THREADS_GLOBAL == 0) {
+	        printf("ERROR: RANGE_DOPPLER_THREADS needs PULSE_COMPRESS_THREADS set.\n");
+	        return 1;
+	    }
+	    if ((DOPPLER_CPI_GLOBAL < 2) ||
+	        (FFT_NextSize(DOPPLER_CPI_GLOBAL * DOPPLER_PADDING_FACTOR_GLOBAL) == 0)) {
+	        printf("ERROR: DOPPLER_CPI x DOPPLER_PADDING_FACTOR must be from 2 to %d.\n", FFT_MAX_SIZE);
+	        return 1;
+	    }
+	    if ((DOPPLER_WINDOW_GLOBAL < WIN_HANNING) || (DOPPLER_WINDOW_GLOBAL > WIN_BLACKMAN)) {
+	        printf("ERROR: DOPPLER_WINDOW must be between %d and %d.\n", WIN_HANNING, WIN_BLACKMAN);
+	        return 1;
+	    }
+	    printf("RANGE_DOPPLER_THREADS_GLOBAL = %d, CPI %d, Doppler FFT %u, %s window%s\n",
+	           RANGE_DOPPLER_THREADS_GLOBAL, DOPPLER_CPI_GLOBAL,
+	           FFT_NextSize(DOPPLER_CPI_GLOBAL * DOPPLER_PADDING_FACTOR_GLOBAL),
+	           WIN_Name(DOPPLER_WINDOW_GLOBAL),
+	           RANGE_DOPPLER_OUTPUT_GLOBAL ? ", writing rdN.dat" : "");
+	}
+
+	// CFAR detection on the maps
+	CFAR_METHOD_GLOBAL = config.CFAR_METHOD;
+	CFAR_GUARD_GLOBAL = config.CFAR_GUARD;
+	CFAR_TRAIN_GLOBAL = config.CFAR_TRAIN;
+	CFAR_THRESHOLD_DB_GLOBAL = (float)config.CFAR_THRESHOLD_DB;
+	CFAR_OS_RANK_GLOBAL = config.CFAR_OS_RANK;
+	if ((CFAR_METHOD_GLOBAL < CFAR_OFF) || (CFAR_METHOD_GLOBAL > CFAR_OS)) {
+	    printf("ERROR: CFAR_METHOD must be between %d and %d.\n", CFAR_OFF, CFAR_OS);
+	    return 1;
+	}
+	if (CFAR_METHOD_GLOBAL != CFAR_OFF) {
+	    if (RANGE_DOPPLER_THREADS_GLOBAL == 0) {
+	        printf("ERROR: CFAR_METHOD needs RANGE_DOPPLER_THREADS set.\n");
+	        return 1;
+	    }
+	    if ((CFAR_GUARD_GLOBAL < 0) ||
+	        (CFAR_TRAIN_GLOBAL < 1) || (CFAR_TRAIN_GLOBAL > CFAR_MAX_TRAIN) ||
+	        (CFAR_OS_RANK_GLOBAL < 0) || (CFAR_OS_RANK_GLOBAL > 2 * CFAR_TRAIN_GLOBAL)) {
+	        printf("ERROR: CFAR_TRAIN must be from 1 to %d, CFAR_GUARD at least 0 and CFAR_OS_RANK from 0 to 2 x CFAR_TRAIN.\n",
+	               CFAR_MAX_TRAIN);
+	        return 1;
+	    }
+	    printf("CFAR_METHOD_GLOBAL = %d (%s), guard %d, train %d, threshold %.1f dB, writing detN.dat\n",
+	           CFAR_METHOD_GLOBAL, CFAR_Name(CFAR_METHOD_GLOBAL), CFAR_GUARD_GLOBAL,
+	           CFAR_TRAIN_GLOBAL, CFAR_THRESHOLD_DB_GLOBAL);
+	}
+
+	// tables the processing stages are set up from, mapped from
+	// TABLE_CACHE_DIR when an earlier run made them
+	if (PULSE_COMPRESS_THREADS_GLOBAL > 0) {
+	    if (TCACHE_Open(&tableCache, config.TABLE_CACHE_DIR) != 0) {
+	        printf("ERROR: TABLE_CACHE_DIR %s could not be made.\n", config.TABLE_CACHE_DIR);
+	        return 1;
+	    }
+	    printf("TABLE_CACHE_DIR = %s\n",
+	           (config.TABLE_CACHE_DIR[0] != '\0') ? config.TABLE_CACHE_DIR : "(none)");
+	}
+
+	PRI_NS_GLOBAL = config.PRI_NS;
+	printf("PRI_NS_GLOBAL = %d\n", PRI_NS_GLOBAL);
+
+	// segmented recording; a segment duration becomes a PRI count here,
+	// and each channel's dmaThread() turns SEGMENT_MB into one from its
+	// own record size
+	if ((config.SEGMENT_PRIS < 0) || (config.SEGMENT_MB < 0) || (config.SEGMENT_SECONDS < 0)) {
+	    printf("ERROR: SEGMENT_PRIS, SEGMENT_MB and SEGMENT_SECONDS must not be negative.\n");
+	    return 1;
+	}
+	SEGMENT_PRIS_GLOBAL = config.SEGMENT_PRIS;
+	SEGMENT_MB_GLOBAL = config.SEGMENT_MB;
+	if (config.SEGMENT_SECONDS > 0) {
+	    unsigned long long pris;
+
+	    if (PRI_NS_GLOBAL <= 0) {
+	        printf("ERROR: SEGMENT_SECONDS needs PRI_NS to be set.\n");
+	        return 1;
+	    }
+	    pris = ((unsigned long long)config.SEGMENT_SECONDS * 1000000000ULL) / PRI_NS_GLOBAL;
+	    if (pris > 0x7FFFFFFF)
+	        pris = 0x7FFFFFFF;
+	    if ((pris > 0) && ((SEGMENT_PRIS_GLOBAL == 0) || (pris < (unsigned long long)SEGMENT_PRIS_GLOBAL)))
+	        SEGMENT_PRIS_GLOBAL = (int)pris;
+	}
+	if ((SEGMENT_PRIS_GLOBAL > 0) || (SEGMENT_MB_GLOBAL > 0))
+	    printf("SEGMENT_PRIS_GLOBAL = %d, SEGMENT_MB_GLOBAL = %d\n", SEGMENT_PRIS_GLOBAL, SEGMENT_MB_GLOBAL);
+
+	// real-time settings; channel c's dmaThread() runs on ACQ_CPUS[c] and
+	// its writer on WRITER_CPUS[c % number of writer CPUs]
+	RT_PRIORITY_GLOBAL = config.RT_PRIORITY;
+	{
+	    int cpus[MAX_CHANNELS];
+	    int numCpus;
+
+	    numCpus = RTSCHED_ParseCpuList(config.ACQ_CPUS, cpus, MAX_CHANNELS);
+	    if (numCpus < 0) {
+	        printf("ERROR: ACQ_CPUS must be a list of up to %d CPU numbers.\n", MAX_CHANNELS);
+	        return 1;
+	    }
+	    for (i = 0; i < (unsigned int)numCpus; i++)
+	        ACQ_CPU_GLOBAL[i] = cpus[i];
+
+	    numCpus = RTSCHED_ParseCpuList(config.WRITER_CPUS, cpus, MAX_CHANNELS);
+	    if (numCpus < 0) {
+	        printf("ERROR: WRITER_CPUS must be a list of up to %d CPU numbers.\n", MAX_CHANNELS);
+	        return 1;
+	    }
+	    for (i = 0; (numCpus > 0) && (i < MAX_CHANNELS); i++)
+	        WRITER_CPU_GLOBAL[i] = cpus[i % numCpus];
+	}
+	printf("RT_PRIORITY_GLOBAL = %d, ACQ_CPUS = %d,%d,%d,%d, WRITER_CPUS = %d,%d,%d,%d\n",
+	       RT_PRIORITY_GLOBAL,
+	       ACQ_CPU_GLOBAL[0], ACQ_CPU_GLOBAL[1], ACQ_CPU_GLOBAL[2], ACQ_CPU_GLOBAL[3],
+	       WRITER_CPU_GLOBAL[0], WRITER_CPU_GLOBAL[1], WRITER_CPU_GLOBAL[2], WRITER_CPU_GLOBAL[3]);
+
+	// busy-poll acquisition; each polling thread keeps a CPU busy
+	ACQ_POLL_GLOBAL = config.ACQ_POLL;
+	POLL_SPIN_US_GLOBAL = config.POLL_SPIN_US;
+	if (ACQ_POLL_GLOBAL) {
+	    printf("ACQ_POLL_GLOBAL = %d, POLL_SPIN_US_GLOBAL = %d\n", ACQ_POLL_GLOBAL, POLL_SPIN_US_GLOBAL);
+	    if (ADC_DMA_LINK_MASK == 0) {
+	        printf("ERROR: ACQ_POLL needs the ADC DMA status link field, which this ReadyFlow does not define.\n");
+	        return 1;
+	    }
+	    if (NUM_DMA_BUFS_GLOBAL < 2 * IRQ_COALESCE_GLOBAL) {
+	        printf("ERROR: ACQ_POLL needs NUM_DMA_BUFS to be at least twice IRQ_COALESCE.\n");
+	        return 1;
+	    }
+	    if (config.ACQ_CPUS[0] == '\0')
+	        printf("WARNING: ACQ_POLL is set without ACQ_CPUS; the polling threads are not pinned.\n");
+	}
+
+	if (config.JITTER_TEST > 0)
+	    jitterTest(config.JITTER_TEST);
+
+	if (config.LOCK_MEMORY) {
+	    if (RTSCHED_LockMemory() != 0)
+	        printf("WARNING: mlockall() failed, memory is not locked.\n");
+	    else
+	        printf("LOCK_MEMORY: process memory locked\n");
+	}
+
+	// record to local storage and let the mover copy to the share
+	strcpy(STAGING_DIR_GLOBAL, config.STAGING_DIR);
+	if (STAGING_DIR_GLOBAL[0] != '\0') {
+	    if (MOVER_Start(&mover, STAGING_DIR_GLOBAL, "///smbtest", config.MOVER_RATE) != 0) {
+	        printf("ERROR: Can't start the staging mover.\n");
+	        return 1;
+	    }
+	    printf("STAGING_DIR_GLOBAL = %s, MOVER_RATE = %d MB/s\n", STAGING_DIR_GLOBAL, config.MOVER_RATE);
+	}
 	printf("PARSER:\nWAVEFORM INDEX = \t%i,\nDURATION = \t%0.1E s\n", PulseNum, T_param_vec[PulseNum-1]);
 
 #endif
@@ -1682,7 +2277,7 @@ double T_param_vec[]
 	printf("Bytes to record per range line:\t %d\n", SAMPLES_PER_PRI_GLOBAL<<2);
 
 	if (SAMPLES_PER_PRI_GLOBAL > XFER_WORD_SIZE) {
-	    printf("ERROR: SAMPLES_PER_PRI in header file exceeds ADC buffer size.\n");
+	    printf("ERROR: SAMPLES_PER_PRI in header file exceeds ADC buffer size (XFER_WORD_SIZE %d).\n", (int)XFER_WORD_SIZE);
 	    return 1;
 	}
 
@@ -1782,6 +2377,20 @@ printf("File write complete.\n");
     for (chan = P716x_ADC1; chan < numChans; chan++)
         PTKIFC_ThreadWaitFinish(&ifcArgs, chan);
 
+    /* finish moving the staged recordings to the share */
+    if (STAGING_DIR_GLOBAL[0] != '\0')
+    {
+        MOVER_Stop(&mover);
+        MOVER_Report(&mover);
+    }
+
+    /* the stages are done with their tables */
+    if (PULSE_COMPRESS_THREADS_GLOBAL > 0)
+    {
+        TCACHE_Report(&tableCache);
+        TCACHE_Close(&tableCache);
+    }
+
 	/* clean up and exit */
     exitHdlResrc.exitCode[0] = 0;
     return (exitHandler (&exitHdlResrc));
@@ -1990,17 +2599,42 @@ static void dmaThread (PVOID pParams)
     DWORD                  bufSize      = dmaParams->bufSize;
     IFC_ARGS              *ifcArgs      = dmaParams->ifcArgs;
     unsigned int           loopCount    = dmaParams->moduleResrc->progParams.loop;
+    unsigned int           numDmaBufs   = NUM_DMA_BUFS_GLOBAL;
+    unsigned int           bufIndex     = 0;   /* ring buffer being filled */
+    unsigned int           irqCoalesce  = IRQ_COALESCE_GLOBAL;
+    unsigned long          irqIndex     = 0;   /* link-end interrupts serviced */
+    unsigned int           groupLines;      /* lines kept from this wake-up */
+    unsigned int           doneGroups;      /* poll mode: groups left to stamp */
+    unsigned int           line;
+    DWORD                  linkIntr;
     //unsigned int           loopCount    = 5;
 
     P716x_ADC_TRIG_CTRL_LLIST_DEFINITION  trigLlistDef;
-    P716x_ADC_DMA_LLIST_DESCRIPTOR        dmaDescriptor[NUM_DMA_BUFS];
+    P716x_ADC_DMA_LLIST_DESCRIPTOR        dmaDescriptor[MAX_DMA_BUFS];
+    DMA_STAGES             stages;
+    void                  *ringBufs[MAX_DMA_BUFS];
+    PRI_STATS              priStats;
+    ADC_POLL               adcPoll;
+    unsigned long long     intrTime;
+    unsigned long long     serviceTime;
+    unsigned long          backlog;
+    unsigned int           adcFlags;
     DWORD                  dwStatus;
 
     DWORD                  operand;
     int                    status;
     unsigned int           i;
-	FILE                  *outfile;
-	char                   outfileName[40];
+	unsigned long long     segPris      = SEGMENT_PRIS_GLOBAL;
+	unsigned long long     mbPris;
+	char                   baseName[16];
+	char                   outfileName[2*MOVER_PATH_LEN];
+	char                   pcFileName[2*MOVER_PATH_LEN];
+	char                   rdFileName[2*MOVER_PATH_LEN];
+	char                   detFileName[2*MOVER_PATH_LEN];
+	NXREC_HEADER           nxrecFields;
+	void                  *nxrecHeader  = NULL;
+	unsigned int           headerBytes  = 0;
+	unsigned int           recordBytes  = SAMPLES_PER_PRI_GLOBAL*4;
 
 
 
@@ -2013,9 +2647,12 @@ static void dmaThread (PVOID pParams)
 //	sprintf (outfileName, "%d_%d_%d_%d_%d_%d_adc%ddata.dat",timeinfo->tm_mday,timeinfo->tm_mon+1,timeinfo->tm_year+1900,timeinfo->tm_hour,timeinfo->tm_min,timeinfo->tm_sec,chanNum);
 	//sprintf (outfileName, "./data/%d_%d_%d_%d_%d_%d_adc%ddata.dat",timeinfo->tm_year+1900,timeinfo->tm_mon+1,timeinfo->tm_mday,timeinfo->tm_hour,timeinfo->tm_min,timeinfo->tm_sec,chanNum);
 	//sprintf (outfileName, "/smbtest/%d_%d_%d_%d_%d_%d_adc%ddata.dat",timeinfo->tm_year+1900,timeinfo->tm_mon+1,timeinfo->tm_mday,timeinfo->tm_hour,timeinfo->tm_min,timeinfo->tm_sec,chanNum);
-	sprintf (outfileName, "///smbtest/adc%d.dat",chanNum);
+	outputName(outfileName, "adc", chanNum);
+	outputName(pcFileName, "pc", chanNum);
+	outputName(rdFileName, "rd", chanNum);
+	outputName(detFileName, "det", chanNum);
 //	sprintf (outfileName, "%d_%d_%d_%d_%d_%d_adc%ddata.dat",timeinfo->tm_year+1900,timeinfo->tm_mon+1,timeinfo->tm_mday,timeinfo->tm_hour,timeinfo->tm_min,timeinfo->tm_sec,chanNum);
-	outfile = fopen(outfileName, "wb"); //DP Change directory
+	//outfile = fopen(outfileName, "wb"); //DP Change directory
 	//system(sprintf("cp Nextradheader.txt ThisExperiment%s ", outfilename);
 
 
@@ -2064,7 +2701,8 @@ static void dmaThread (PVOID pParams)
 	else {
 		trigLlistDef.delay    = Adc_delay;
 	}
-        trigLlistDef.length   = ((NUM_DMA_BUFS*bufSize)>>2) - 1; //NUM_DMA_BUFS*bufSize - 1; FMP
+        /* one range line per trigger; each fills the next ring buffer */
+        trigLlistDef.length   = (bufSize>>2) - 1; //NUM_DMA_BUFS*bufSize - 1; FMP
     }
 
 
@@ -2108,7 +2746,7 @@ static void dmaThread (PVOID pParams)
         return;
     }
 
-    for (i = 0; i < NUM_DMA_BUFS; i++)
+    for (i = 0; i < numDmaBufs; i++)
     {
         /* allocate a DMA buffer */
         dwStatus = PTK716X_DMAAllocMem(dmaParams->dmaHandle, bufSize, &(dmaParams->dmaBuf[i]), TRUE);
@@ -2120,9 +2758,10 @@ static void dmaThread (PVOID pParams)
             return;
         }
         memset (dmaParams->dmaBuf[i].usrBuf, 0x5a, bufSize);
+        ringBufs[i] = dmaParams->dmaBuf[i].usrBuf;
     }
 
-    dmaParams->dataBuf = (int *)malloc(NUM_DMA_BUFS*bufSize);
+    dmaParams->dataBuf = (int *)malloc(numDmaBufs*bufSize);
     if (dmaParams->dataBuf == NULL)
     {
         printf("[dmaThread %d] memory allocation error\n", chanNum+1);
@@ -2136,17 +2775,22 @@ static void dmaThread (PVOID pParams)
     P716xAdcDmaReset(p716xRegs, chanNum);
 
 
-    for (i = 0; i < NUM_DMA_BUFS; i++)
+    for (i = 0; i < numDmaBufs; i++)
     {
+        /* with coalescing only the last link of each group interrupts */
+        linkIntr = (((i + 1) % irqCoalesce) == 0) ?
+                   P716x_ADC_DMA_CWORD_LINK_END_INTR_ENABLE :
+                   P716x_ADC_DMA_CWORD_LINK_END_INTR_DISABLE;
+
         if( i == 0 )   /* The first descriptor */
         {
-            if( NUM_DMA_BUFS == 1)
+            if( numDmaBufs == 1)
             {
                 /* the thread uses a single descriptor */
                 dmaDescriptor[i].linkCtrlWord =
                       ((0 << P716x_ADC_DMA_CWORD_NEXT_LINK_ADDR_OFFSET) |
                        P716x_ADC_DMA_CWORD_START_MODE_AUTO              |
-                       P716x_ADC_DMA_CWORD_LINK_END_INTR_ENABLE         |
+                       linkIntr                                         |
                        P716x_ADC_DMA_CWORD_END_OF_CHAIN_DISABLE);
             }
             else
@@ -2155,17 +2799,17 @@ static void dmaThread (PVOID pParams)
                 dmaDescriptor[i].linkCtrlWord =
                       (((i+1) << P716x_ADC_DMA_CWORD_NEXT_LINK_ADDR_OFFSET) |
                        P716x_ADC_DMA_CWORD_START_MODE_AUTO                  |
-                       P716x_ADC_DMA_CWORD_LINK_END_INTR_ENABLE);
+                       linkIntr);
             }
 
         }
-        else if( i != (NUM_DMA_BUFS-1) )
+        else if( i != (numDmaBufs-1) )
         {
             /* the thread uses a single descriptor */
             dmaDescriptor[i].linkCtrlWord =
                   (((i+1) << P716x_ADC_DMA_CWORD_NEXT_LINK_ADDR_OFFSET) |
                    P716x_ADC_DMA_CWORD_START_MODE_AUTO                  |
-                   P716x_ADC_DMA_CWORD_LINK_END_INTR_ENABLE);
+                   linkIntr);
         }
         else  /* Last descriptor */
         {
@@ -2173,7 +2817,7 @@ static void dmaThread (PVOID pParams)
             dmaDescriptor[i].linkCtrlWord =
                   ((0 << P716x_ADC_DMA_CWORD_NEXT_LINK_ADDR_OFFSET) |
                    P716x_ADC_DMA_CWORD_START_MODE_AUTO              |
-                   P716x_ADC_DMA_CWORD_LINK_END_INTR_ENABLE         |
+                   linkIntr                                         |
                    P716x_ADC_DMA_CWORD_END_OF_CHAIN_DISABLE);
         }
 
@@ -2195,15 +2839,20 @@ static void dmaThread (PVOID pParams)
          P716x_ADC_DMA_CTRL_DMA_INPUT_FIFO_RESET);
 
 
-    /* enable the DMA interrupt */
-    PTKIFC_MutexLock(ifcArgs, 0, (unsigned long)IFC_WAIT_STATE_FOREVER);
-    dwStatus = PTK716X_intEnable(
-                   hDev,
-                   (PTK716X_PCIE_INTR_ADC_ACQ_MOD1 << chanNum),
-                   P716x_ADC_INTR_LINK_END,
-                   (PVOID)(ifcArgs),
-                   dmaIntHandler);
-    PTKIFC_MutexUnlock(ifcArgs, 0);
+    /* enable the DMA interrupt; in poll mode the link-end flag is still
+       latched in the interrupt flag register, but no interrupt is raised */
+    dwStatus = PTK716X_STATUS_OK;
+    if (!ACQ_POLL_GLOBAL)
+    {
+        PTKIFC_MutexLock(ifcArgs, 0, (unsigned long)IFC_WAIT_STATE_FOREVER);
+        dwStatus = PTK716X_intEnable(
+                       hDev,
+                       (PTK716X_PCIE_INTR_ADC_ACQ_MOD1 << chanNum),
+                       P716x_ADC_INTR_LINK_END,
+                       (PVOID)(ifcArgs),
+                       dmaIntHandler);
+        PTKIFC_MutexUnlock(ifcArgs, 0);
+    }
     if (dwStatus != PTK716X_STATUS_OK)
     {
         printf("[dmaThread %d] Interrupt Enabling error\n", chanNum+1);
@@ -2234,7 +2883,8 @@ static void dmaThread (PVOID pParams)
     }
 
     /* Flush the CPU caches (see documentation of WDC_DMASyncCpu()) */
-    PTK716X_DMASyncCpu(dmaParams->dmaBuf);
+    for (i = 0; i < numDmaBufs; i++)
+        PTK716X_DMASyncCpu(&dmaParams->dmaBuf[i]);
 
     /* Flush the ADC Input FIFOs */
     P716xAdcFifoFlush(p716xRegs, chanNum);
@@ -2250,7 +2900,212 @@ static void dmaThread (PVOID pParams)
 
 
     /* Flush the CPU caches */
-    PTK716X_DMASyncCpu(dmaParams->dmaBuf);
+    for (i = 0; i < numDmaBufs; i++)
+        PTK716X_DMASyncCpu(&dmaParams->dmaBuf[i]);
+
+	// the output is opened last, once nothing but the writer can fail,
+	// so that the error returns above leave no file or finisher behind.
+	// An nxrec file describes itself: the run parameters and NeXtRAD.ini
+	// go in its header and each line gets a prefix
+	if (RECORD_FORMAT_GLOBAL)
+	{
+	    memset (&nxrecFields, 0, sizeof(nxrecFields));
+	    nxrecFields.chanNum       = chanNum;
+	    nxrecFields.samplesPerPri = RANGE_GATE_GLOBAL[chanNum].samples;
+	    nxrecFields.rangeBins     = SAMPLES_PER_PRI_GLOBAL;
+	    nxrecFields.numGates      = RANGE_GATE_GLOBAL[chanNum].numWindows;
+	    memcpy (nxrecFields.gate, RANGE_GATE_GLOBAL[chanNum].window,
+	            sizeof(nxrecFields.gate));
+	    nxrecFields.numPris       = loopCount;
+	    nxrecFields.waveformIndex = WAVEFORM_GLOBAL;
+	    nxrecFields.adcDelay      = Adc_delay;
+	    nxrecFields.dacDelay      = DAC_DELAY_GLOBAL;
+	    nxrecFields.decimation    = dmaParams->moduleResrc->progParams.decimation;
+	    nxrecFields.irqCoalesce   = IRQ_COALESCE_GLOBAL;
+	    nxrecFields.tuneFreqHz    = dmaParams->moduleResrc->progParams.tuneFreq;
+	    nxrecFields.clockFreqHz   = dmaParams->moduleResrc->progParams.clockFreq;
+	    nxrecFields.sampleFormat  = (COMPRESS_THREADS_GLOBAL > 0) ?
+	                                    NXREC_FMT_CI16_PACK : NXREC_FMT_CI16;
+	    if (BFP_BITS_GLOBAL[chanNum] > 0)
+	    {
+	        nxrecFields.sampleFormat = NXREC_FMT_CI16_BFP;
+	        nxrecFields.bfpBlock     = BFP_BLOCK_GLOBAL;
+	        nxrecFields.bfpBits      = BFP_BITS_GLOBAL[chanNum];
+	    }
+
+	    nxrecHeader = malloc(NXREC_MAX_HEADER);
+	    if (nxrecHeader == NULL)
+	    {
+	        printf("[dmaThread %d] Output file header allocation error\n", chanNum+1);
+	        *(dmaParams->exitCodePtr) = 14;
+	        return;
+	    }
+	    headerBytes  = NXREC_BuildHeader(nxrecHeader, &nxrecFields, NEXTRAD_INI);
+	    recordBytes  = ((NXREC_HEADER *)nxrecHeader)->recordBytes;
+	}
+
+	// segmented: adcN_00000.dat, adcN_00001.dat, ... each closed and
+	// handed to the mover as soon as the writer moves past it; the
+	// finisher thread builds each segment's own header
+	if (SEGMENT_MB_GLOBAL > 0)
+	{
+	    mbPris = ((unsigned long long)SEGMENT_MB_GLOBAL * 1000000ULL) / recordBytes;
+	    if (mbPris == 0)
+	        mbPris = 1;
+	    if ((segPris == 0) || (mbPris < segPris))
+	        segPris = mbPris;
+	}
+	stages.started   = 0;
+	stages.segmented = (segPris != 0);
+	if (segPris != 0)
+	{
+	    free(nxrecHeader);
+	    sprintf (baseName, "adc%d", chanNum);
+	    status = RECSEG_Open(&stages.outSeg, chanNum, outputDir(),
+	                         baseName, OUTPUT_BACKEND_GLOBAL,
+	                         WRITE_BATCH_GLOBAL, ASYNC_DEPTH_GLOBAL, segPris, loopCount,
+	                         recordBytes, RECORD_FORMAT_GLOBAL ? &nxrecFields : NULL,
+	                         NEXTRAD_INI, segmentDone);
+	    if (status != 0)
+	    {
+	        printf("[dmaThread %d] Output segment open error\n", chanNum+1);
+	        *(dmaParams->exitCodePtr) = 14;
+	        return;
+	    }
+	}
+	// the run length is known unless running until a key is hit
+	else if (RECFILE_Open(&stages.outfile, outfileName, OUTPUT_BACKEND_GLOBAL,
+	                 WRITE_BATCH_GLOBAL, ASYNC_DEPTH_GLOBAL,
+	                 (loopCount != 0) ?
+	                     headerBytes + ((unsigned long long)loopCount * recordBytes) : 0) != 0)
+	{
+	    printf("[dmaThread %d] Output file open error\n", chanNum+1);
+	    *(dmaParams->exitCodePtr) = 14;
+	    free(nxrecHeader);
+	    return;
+	}
+	stages.started |= STAGE_OUTPUT;
+	if ((segPris == 0) && (nxrecHeader != NULL))
+	{
+	    status = RECFILE_WriteHeader(&stages.outfile, nxrecHeader, headerBytes);
+	    free(nxrecHeader);
+	    if (status != 0)
+	    {
+	        printf("[dmaThread %d] Output file header write error\n", chanNum+1);
+	        *(dmaParams->exitCodePtr) = 14;
+	        stagesStop(chanNum, &stages);
+	        return;
+	    }
+	}
+
+    /* start the writer thread that drains the ring to disk */
+    status = DMARING_Init(&stages.dmaRing, chanNum, numDmaBufs, irqCoalesce,
+                          ringBufs, SAMPLES_PER_PRI_GLOBAL*4,
+                          (segPris != 0) ? RECSEG_File(&stages.outSeg) : &stages.outfile);
+    stages.started |= STAGE_RING;
+    if (status == 0)
+    {
+        DMARING_SetHistograms(&stages.dmaRing, latHist[chanNum]);
+        /* overruns are judged from the interrupts as they arrive, which
+           run ahead of the lines published when this thread is behind */
+        DMARING_SetIrqCount(&stages.dmaRing, &irqLog[chanNum].count);
+        DMARING_SetLinePrefix(&stages.dmaRing, RECORD_FORMAT_GLOBAL);
+        status = DMARING_SetIndex(&stages.dmaRing, RECORD_FORMAT_GLOBAL,
+                                  (segPris != 0) ? segPris : loopCount);
+    }
+    if ((status == 0) && (segPris != 0))
+        status = DMARING_SetSegments(&stages.dmaRing, &stages.outSeg);
+    /* range gating; the pool or coder below then works on the windows */
+    if (status == 0)
+        status = DMARING_SetGate(&stages.dmaRing, &RANGE_GATE_GLOBAL[chanNum]);
+    /* compression workers; their slots cover the ring and a write batch */
+    if ((status == 0) && (COMPRESS_THREADS_GLOBAL > 0))
+    {
+        status = IQPACK_PoolStart(&stages.packPool, COMPRESS_THREADS_GLOBAL,
+                                  numDmaBufs + WRITE_BATCH_GLOBAL,
+                                  RANGE_GATE_GLOBAL[chanNum].samples);
+        if (status == 0)
+        {
+            stages.started |= STAGE_PACK;
+            status = DMARING_SetPack(&stages.dmaRing, &stages.packPool);
+        }
+    }
+    /* or block floating point, coded by the writer itself */
+    if ((status == 0) && (BFP_BITS_GLOBAL[chanNum] > 0))
+    {
+        status = BFP_Init(&stages.bfpCoder, RANGE_GATE_GLOBAL[chanNum].samples, BFP_BLOCK_GLOBAL,
+                          BFP_BITS_GLOBAL[chanNum]);
+        if (status == 0)
+        {
+            stages.started |= STAGE_BFP;
+            status = DMARING_SetBfp(&stages.dmaRing, &stages.bfpCoder);
+        }
+    }
+    /* detection on the range-Doppler maps, run by the worker finishing
+     * each one
+     */
+    if ((status == 0) && (CFAR_METHOD_GLOBAL != CFAR_OFF))
+    {
+        status = CFAR_Start(&stages.cfar, CFAR_METHOD_GLOBAL, SAMPLES_PER_PRI_GLOBAL,
+                            FFT_NextSize(DOPPLER_CPI_GLOBAL * DOPPLER_PADDING_FACTOR_GLOBAL),
+                            CFAR_GUARD_GLOBAL, CFAR_TRAIN_GLOBAL, CFAR_OS_RANK_GLOBAL,
+                            CFAR_THRESHOLD_DB_GLOBAL, detFileName);
+        if (status == 0)
+            stages.started |= STAGE_CFAR;
+    }
+    /* range-Doppler maps, fed by the pulse compression's feeder */
+    if ((status == 0) && (RANGE_DOPPLER_THREADS_GLOBAL > 0))
+    {
+        status = RDOP_Start(&stages.rangeDoppler, RANGE_DOPPLER_THREADS_GLOBAL,
+                            SAMPLES_PER_PRI_GLOBAL, DOPPLER_CPI_GLOBAL,
+                            DOPPLER_PADDING_FACTOR_GLOBAL, DOPPLER_WINDOW_GLOBAL,
+                            &tableCache, (CFAR_METHOD_GLOBAL != CFAR_OFF) ? &stages.cfar : NULL,
+                            RANGE_DOPPLER_OUTPUT_GLOBAL ? rdFileName : NULL);
+        if (status == 0)
+            stages.started |= STAGE_RDOP;
+    }
+    /* pulse compression, a further consumer of the ring; it filters
+     * whole lines whatever is recorded
+     */
+    if ((status == 0) && (PULSE_COMPRESS_THREADS_GLOBAL > 0))
+    {
+        status = PCOMP_Start(&stages.pulseComp, &stages.dmaRing, PULSE_COMPRESS_THREADS_GLOBAL,
+                             SAMPLES_PER_PRI_GLOBAL, PULSE_COMPRESS_FFT_GLOBAL,
+                             pcRef, pcRefSamples, RANGE_WINDOW_GLOBAL, &tableCache,
+                             (RANGE_DOPPLER_THREADS_GLOBAL > 0) ? &stages.rangeDoppler : NULL,
+                             PULSE_COMPRESS_OUTPUT_GLOBAL ? pcFileName : NULL);
+        if (status == 0)
+            stages.started |= STAGE_PCOMP;
+    }
+    if (status == 0)
+    {
+        status = DMARING_Start(&stages.dmaRing);
+        if (status == 0)
+            stages.started |= STAGE_WRITER;
+    }
+    if (status != 0)
+    {
+        printf("[dmaThread %d] Writer thread start error\n", chanNum+1);
+        *(dmaParams->exitCodePtr) = 9;
+        stagesStop(chanNum, &stages);
+        return;
+    }
+    if (RTSCHED_SetThread(stages.dmaRing.writer, 0, WRITER_CPU_GLOBAL[chanNum]) != 0)
+        printf("[dmaThread %d] Warning: writer not pinned to CPU %d\n",
+               chanNum+1, WRITER_CPU_GLOBAL[chanNum]);
+
+    /* real-time scheduling for the acquisition loop; the writer started
+     * above keeps the default policy
+     */
+    status = RTSCHED_SetThread(pthread_self(), RT_PRIORITY_GLOBAL,
+                               ACQ_CPU_GLOBAL[chanNum]);
+    if (status == 1)
+        printf("[dmaThread %d] Warning: SCHED_FIFO %d not set\n",
+               chanNum+1, RT_PRIORITY_GLOBAL);
+    else if (status == 2)
+        printf("[dmaThread %d] Warning: not pinned to CPU %d\n",
+               chanNum+1, ACQ_CPU_GLOBAL[chanNum]);
+    RTSCHED_PrefaultStack();
 
     printf("[dmaThread %d] will run ", chanNum+1);
     if (loopCount != 0)
@@ -2267,6 +3122,19 @@ static void dmaThread (PVOID pParams)
     }
 
 
+    /* the poller waits on the flag register, whose flags are in its
+       low 32 bits */
+    ADCPOLL_Init(&adcPoll,
+                 (volatile unsigned int *)p716xRegs->adcRegs[chanNum].interruptFlag,
+                 P716x_ADC_INTR_LINK_END,
+                 (unsigned long long)POLL_SPIN_US_GLOBAL * 1000ULL);
+    /* ... and counts the groups done from where the DMA engine is, as
+       the flag is a latch (checked in main()) */
+    ADCPOLL_SetPosition(&adcPoll,
+                        (volatile unsigned int *)p716xRegs->adcRegs[chanNum].dmaStatus,
+                        ADC_DMA_LINK_MASK, ADC_DMA_LINK_SHIFT,
+                        numDmaBufs, irqCoalesce);
+
     /* start DMA */
     P716xAdcDmaStart(p716xRegs, chanNum);
 
@@ -2281,6 +3149,9 @@ static void dmaThread (PVOID pParams)
                  dmaParams->moduleResrc->progParams.decimation);
     }
 
+    PRISTATS_Init(&priStats, PRI_NS_GLOBAL, ADC_FLAGS_BAD_TRIG,
+                  ADC_FLAGS_OVERFLOW, irqCoalesce);
+
     /* release semaphore to indicate "ready" to main() */
     PTKIFC_SemaphorePost(ifcArgs, chanNum);
 
@@ -2301,11 +3172,37 @@ static void dmaThread (PVOID pParams)
 	//if(chanNum == 0 && loopCount%100 == 0) printf("%*i",10, loopCount);
 	//if(chanNum == 1) printf("\r%*i  %*.1f %%",10 , totalPulses-loopCount,10, (float)(totalPulses-loopCount)/(float)(totalPulses)*100.0);
 
-	for (i = 0; i < NUM_DMA_BUFS; i++)
+	for (i = 0; (i < numDmaBufs) && (loopCount); i += irqCoalesce)
         {
-            /* Wait for DMA to Complete (interrupt signal) */
-            status = PTKIFC_SemaphoreWait (ifcArgs, (4 + chanNum),
-                                           IFC_WAIT_STATE_MILSEC(1000000)); //DP
+            /* Wait for DMA to Complete (interrupt signal, or the
+               link-end flag in poll mode) */
+            if (ACQ_POLL_GLOBAL)
+            {
+                /* a flag may stand for several groups, each stamped as
+                   an interrupt; those already stamped need no wait.
+                   Only the last group's time is known */
+                status = PTK716X_STATUS_OK;
+                while ((status == PTK716X_STATUS_OK) &&
+                       (PRISTATS_IrqCount(&irqLog[chanNum]) <= irqIndex))
+                {
+                    if (ADCPOLL_Wait(&adcPoll, 1000000ULL * 1000000ULL,
+                                     &intrTime) != 0)
+                    {
+                        status = -1;
+                        break;
+                    }
+                    P716xClearAdcInterruptFlag(
+                        p716xRegs->adcRegs[chanNum].interruptFlag,
+                        P716x_ADC_INTR_LINK_END);
+                    for (doneGroups = ADCPOLL_Completed(&adcPoll);
+                         doneGroups > 0; doneGroups--)
+                        PRISTATS_IrqStamp(&irqLog[chanNum],
+                                          (doneGroups == 1) ? intrTime : 0);
+                }
+            }
+            else
+                status = PTKIFC_SemaphoreWait (ifcArgs, (4 + chanNum),
+                                               IFC_WAIT_STATE_MILSEC(1000000)); //DP
 
 	    //if(chanNum == 1 && i == 0) printf("\r%*i  %*.1f %%",10 , totalPulses-loopCount,10, (float)(totalPulses-loopCount)/(float)(totalPulses)*100.0);
 	    if (status != PTK716X_STATUS_OK)
@@ -2314,11 +3211,37 @@ static void dmaThread (PVOID pParams)
                 printf("[dmaThread %d] Semaphore timeout \n", chanNum+1);
                 *(dmaParams->exitCodePtr) = 17;
     //            stopFlag = 1<<chanNum;
+                stagesStop(chanNum, &stages);
                 return;
             }
 
+            /* time the interrupt and sample the error flags; with
+               coalescing they cover the whole descriptor group */
+            serviceTime = DMARING_TimeNs();
+            intrTime    = PRISTATS_IrqTime(&irqLog[chanNum], irqIndex++,
+                                           &backlog);
+            adcFlags    = P716xReadAdcInterruptFlag(
+                              p716xRegs->adcRegs[chanNum].interruptFlag,
+                              ADC_FLAGS_BAD_TRIG | ADC_FLAGS_OVERFLOW);
+            if (adcFlags != 0)
+                P716xClearAdcInterruptFlag(
+                    p716xRegs->adcRegs[chanNum].interruptFlag, adcFlags);
+            /* the last group of a run may hold more lines than are
+               still wanted */
+            groupLines = irqCoalesce;
+            if ((operand != 0) && (loopCount < groupLines))
+                groupLines = loopCount;
+            PRISTATS_Line(&priStats, intrTime, serviceTime, backlog,
+                          adcFlags, groupLines);
+            if (intrTime != 0)
+                LATHIST_Record(&latHist[chanNum][LAT_IRQ_TO_WAKE],
+                               serviceTime - intrTime);
+
             /* Flush the I/O caches */
-            PTK716X_DMASyncIo(&dmaParams->dmaBuf[i]);
+            for (line = 0; line < groupLines; line++)
+                PTK716X_DMASyncIo(&dmaParams->dmaBuf[bufIndex + line]);
+            LATHIST_Record(&latHist[chanNum][LAT_WAKE_TO_SYNC],
+                           DMARING_TimeNs() - serviceTime);
 
             /* copy captured data to ADC data buffer */
  //           memcpy (dmaParams->dataBuf+((i*bufSize)>>2), dmaParams->dmaBuf[i].usrBuf, bufSize);
@@ -2329,7 +3252,15 @@ static void dmaThread (PVOID pParams)
 			// OR
 			//fwrite(dmaParams->dmaBuf[i].usrBuf, 1, bufSize, outfile);
 			// OR
-			fwrite(dmaParams->dmaBuf[i].usrBuf, 1, SAMPLES_PER_PRI_GLOBAL*4, outfile);
+			//fwrite(dmaParams->dmaBuf[i].usrBuf, 1, SAMPLES_PER_PRI_GLOBAL*4, outfile);
+			// hand the buffers to the writer thread; the disk write
+			// happens off the interrupt path
+			DMARING_PublishGroup(&stages.dmaRing, bufIndex, groupLines,
+			                     intrTime, adcFlags);
+
+            /* the DMA engine has moved on to the next descriptor group */
+            bufIndex = (bufIndex + irqCoalesce) % numDmaBufs;
+            loopCount = loopCount - (operand * groupLines);
 
 #if (TRIGGER)
             /* release semaphore to indicate "ready" to main() */
@@ -2354,8 +3285,6 @@ static void dmaThread (PVOID pParams)
                 }
             }
         }  /* end for() */
-
-        loopCount = loopCount - operand;
 	// Display loopCount
 	//if(chanNum == 0 && loopCount%10 == 0) printf("\r");
 	//if(chanNum == 0 && loopCount%100 == 0) printf("\r");
@@ -2365,7 +3294,38 @@ static void dmaThread (PVOID pParams)
     // Display loopCount
     // printf("\n");
 
-    fclose(outfile);
+    /* let the writer thread drain the ring before closing the file */
+    if (stagesStop(chanNum, &stages) != 0)
+        *(dmaParams->exitCodePtr) = 14;
+    DMARING_Report(&stages.dmaRing);
+    if (segPris != 0)
+        RECSEG_Report(&stages.outSeg);
+    if (COMPRESS_THREADS_GLOBAL > 0)
+        IQPACK_Report(&stages.packPool, chanNum);
+    if (BFP_BITS_GLOBAL[chanNum] > 0)
+        BFP_Report(&stages.bfpCoder, chanNum);
+    RGATE_Report(&RANGE_GATE_GLOBAL[chanNum], chanNum);
+    if (PULSE_COMPRESS_THREADS_GLOBAL > 0)
+        PCOMP_Report(&stages.pulseComp, chanNum, PRI_NS_GLOBAL);
+    if (RANGE_DOPPLER_THREADS_GLOBAL > 0)
+        RDOP_Report(&stages.rangeDoppler, chanNum, PRI_NS_GLOBAL);
+    if (CFAR_METHOD_GLOBAL != CFAR_OFF)
+        CFAR_Report(&stages.cfar, chanNum);
+    PRISTATS_Report(&priStats, chanNum);
+    if (ACQ_POLL_GLOBAL)
+        ADCPOLL_Report(&adcPoll, chanNum);
+    latHistPrint(chanNum);
+
+    /* hand the finished recording to the mover; segments have been
+       handed over one by one as they were closed */
+    if (segPris == 0)
+        outputQueue(chanNum, outfileName);
+    if (PULSE_COMPRESS_OUTPUT_GLOBAL && (PULSE_COMPRESS_THREADS_GLOBAL > 0))
+        outputQueue(chanNum, pcFileName);
+    if (RANGE_DOPPLER_OUTPUT_GLOBAL && (RANGE_DOPPLER_THREADS_GLOBAL > 0))
+        outputQueue(chanNum, rdFileName);
+    if (CFAR_METHOD_GLOBAL != CFAR_OFF)
+        outputQueue(chanNum, detFileName);
 
     /* Clear Trigger */
     P716xSetAdcGateTrigCtrlTriggerClearState(
@@ -2375,11 +3335,14 @@ static void dmaThread (PVOID pParams)
     P716xAdcDmaAbort(p716xRegs, chanNum);
 
     /* Disable DMA Interrupt */
-    PTKIFC_MutexLock(ifcArgs, 0, (unsigned long)IFC_WAIT_STATE_FOREVER);
-    PTK716X_intDisable(hDev,
-                       (PTK716X_PCIE_INTR_ADC_ACQ_MOD1 << chanNum),
-                       P716x_ADC_INTR_LINK_END);
-    PTKIFC_MutexUnlock(ifcArgs, 0);
+    if (!ACQ_POLL_GLOBAL)
+    {
+        PTKIFC_MutexLock(ifcArgs, 0, (unsigned long)IFC_WAIT_STATE_FOREVER);
+        PTK716X_intDisable(hDev,
+                           (PTK716X_PCIE_INTR_ADC_ACQ_MOD1 << chanNum),
+                           P716x_ADC_INTR_LINK_END);
+        PTKIFC_MutexUnlock(ifcArgs, 0);
+    }
 
 
     /* close viewer socket connections if in use */
@@ -2428,6 +3391,239 @@ static void dmaThread (PVOID pParams)
     return;
 }
 
+/**************************************************************************
+ Function:    jitterTest()
+
+ Description: Runs the wake-up jitter probe with default scheduling and
+              then with channel 1's acquisition settings (RT_PRIORITY,
+              ACQ_CPUS), and prints both distributions.  The period is
+              the configured PRI, or 1 ms if PRI_NS is not set.
+
+ Parameters:  loops - wake-ups per run
+
+ Return:      none
+**************************************************************************/
+static void jitterTest (int loops)
+{
+    LAT_HIST     hist;
+    unsigned int periodUs = (PRI_NS_GLOBAL >= 1000) ? (PRI_NS_GLOBAL / 1000) : 1000;
+
+    printf("JITTER_TEST: %d wake-ups every %u us\n", loops, periodUs);
+
+    LATHIST_Init(&hist, "default");
+    RTSCHED_JitterProbe(0, -1, loops, periodUs, &hist);
+    LATHIST_Print(&hist, "JITTER_TEST wake-up late");
+
+    LATHIST_Init(&hist, "RT settings");
+    if (RTSCHED_JitterProbe(RT_PRIORITY_GLOBAL, ACQ_CPU_GLOBAL[0], loops,
+                            periodUs, &hist) != 0)
+        printf("JITTER_TEST: RT settings could not all be applied\n");
+    LATHIST_Print(&hist, "JITTER_TEST wake-up late");
+}
+
+
+/**************************************************************************
+ Function:    segmentDone()
+
+ Description: Called by a channel's segment finisher for each segment it
+              closes.  When recording to the staging directory, queues
+              the segment for the mover, so it is copied to the share
+              while the run goes on.  A segment that failed is left where
+              it is.
+
+ Parameters:  chanNum  - ADC channel number
+              fileName - segment file name, relative to the directory
+              failed   - nonzero if the segment failed to write or close
+
+ Return:      none
+**************************************************************************/
+static void segmentDone (int chanNum, const char *fileName, int failed)
+{
+    if (failed)
+    {
+        printf("[dmaThread %d] Failure writing %s\n", chanNum+1, fileName);
+        return;
+    }
+
+    outputQueue(chanNum, fileName);
+}
+
+
+/**************************************************************************
+ Function:    stagesStop()
+
+ Description: Tears down the stages a channel has started, as marked in
+              stages->started, from the writer down to the output file:
+              drains and stops the threads, writes the PRI index and
+              closes the output.  Used on every way out of dmaThread()
+              once the output is open.  The stages stay readable for
+              their reports.
+
+ Parameters:  chanNum - ADC channel number
+              stages  - the channel's stages
+
+ Return:      0 - success
+              1 - an output failed to write or close; each is reported
+**************************************************************************/
+static int stagesStop (int chanNum, DMA_STAGES *stages)
+{
+    unsigned int started = stages->started;
+    int          failed  = 0;
+
+    if ((started & STAGE_WRITER) && (DMARING_Stop(&stages->dmaRing) != 0))
+    {
+        printf("[dmaThread %d] Failure writing to file\n", chanNum+1);
+        failed = 1;
+    }
+    if (started & STAGE_PACK)
+        IQPACK_PoolStop(&stages->packPool);
+    if ((started & STAGE_PCOMP) && (PCOMP_Stop(&stages->pulseComp) != 0))
+    {
+        printf("[dmaThread %d] Failure writing pc%d.dat\n", chanNum+1, chanNum);
+        failed = 1;
+    }
+    if ((started & STAGE_RDOP) && (RDOP_Stop(&stages->rangeDoppler) != 0))
+    {
+        printf("[dmaThread %d] Failure writing rd%d.dat\n", chanNum+1, chanNum);
+        failed = 1;
+    }
+    if ((started & STAGE_CFAR) && (CFAR_Stop(&stages->cfar) != 0))
+    {
+        printf("[dmaThread %d] Failure writing det%d.dat\n", chanNum+1, chanNum);
+        failed = 1;
+    }
+    if (started & STAGE_BFP)
+        BFP_Free(&stages->bfpCoder);
+
+    /* the index is only written for a run; a ring whose writer never
+       started only has its buffers freed */
+    if ((started & STAGE_WRITER) && (DMARING_WriteIndex(&stages->dmaRing) != 0))
+    {
+        printf("[dmaThread %d] Failure writing PRI index\n", chanNum+1);
+        failed = 1;
+    }
+    else if (!(started & STAGE_WRITER) && (started & STAGE_RING))
+        DMARING_Free(&stages->dmaRing);
+
+    if ((started & STAGE_OUTPUT) &&
+        ((stages->segmented ? RECSEG_Close(&stages->outSeg)
+                            : RECFILE_Close(&stages->outfile)) != 0))
+    {
+        printf("[dmaThread %d] Failure writing to file\n", chanNum+1);
+        failed = 1;
+    }
+
+    stages->started = 0;
+
+    return (failed);
+}
+
+
+/**************************************************************************
+ Function:    outputDir()
+
+ Description: Names the directory a channel records into: the staging
+              directory if there is one, else the share.
+
+ Parameters:  none
+
+ Return:      directory name
+**************************************************************************/
+static const char *outputDir (void)
+{
+    return ((STAGING_DIR_GLOBAL[0] != '\0') ? STAGING_DIR_GLOBAL : "///smbtest");
+}
+
+
+/**************************************************************************
+ Function:    outputName()
+
+ Description: Builds the path of one of a channel's output files,
+              <dir>/<stem><chanNum>.dat, in the directory outputDir()
+              names.
+
+ Parameters:  fileName - receives the path; 2*MOVER_PATH_LEN long
+              stem     - "adc", "pc", "rd" or "det"
+              chanNum  - ADC channel number
+
+ Return:      none
+**************************************************************************/
+static void outputName (char *fileName, const char *stem, int chanNum)
+{
+    sprintf (fileName, "%s/%s%d.dat", outputDir(), stem, chanNum);
+}
+
+
+/**************************************************************************
+ Function:    outputQueue()
+
+ Description: Hands a closed output file to the mover when recording to
+              the staging directory; does nothing when recording straight
+              to the share.  A file the mover cannot take is reported and
+              left in staging.
+
+ Parameters:  chanNum  - ADC channel number
+              fileName - file name, either bare or with the directory
+                         outputName() put on it
+
+ Return:      none
+**************************************************************************/
+static void outputQueue (int chanNum, const char *fileName)
+{
+    const char *name = strrchr(fileName, '/');
+
+    if (STAGING_DIR_GLOBAL[0] == '\0')
+        return;
+
+    name = (name != NULL) ? name + 1 : fileName;
+    if (MOVER_Enqueue(&mover, name) != 0)
+        printf("[dmaThread %d] %s left in %s\n", chanNum+1,
+               name, STAGING_DIR_GLOBAL);
+}
+
+
+/**************************************************************************
+ Function:    latHistPrint()
+
+ Description: Prints a channel's latency histograms.
+
+ Parameters:  chanNum - ADC channel number
+
+ Return:      none
+**************************************************************************/
+static void latHistPrint (int chanNum)
+{
+    char prefix[32];
+    int  stage;
+
+    sprintf(prefix, "[dmaThread %d] latency", chanNum+1);
+    for (stage = 0; stage < LAT_NUM_STAGES; stage++)
+        LATHIST_Print(&latHist[chanNum][stage], prefix);
+}
+
+
+/**************************************************************************
+ Function:    latHistDump()
+
+ Description: Prints the latency histograms of every channel that has
+              recorded anything.  Called by the dump thread on SIGUSR1,
+              while acquisition carries on.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void latHistDump (void)
+{
+    int chan;
+
+    for (chan = 0; chan < MAX_CHANNELS; chan++)
+    {
+        if (latHist[chan][LAT_IRQ_TO_WAKE].total != 0)
+            latHistPrint(chan);
+    }
+}
+
 /**************************************************************************
  Function: exitHandler
 
@@ -2477,7 +3673,7 @@ static int exitHandler (EXIT_HANDLE_RESRC *ehResrc)
 
     for (cntr = 0; cntr < (*ehResrc->numChans); cntr++)
     {
-        for (index = 0; index < NUM_DMA_BUFS; index++)
+        for (index = 0; index < MAX_DMA_BUFS; index++)
         {
             if( ((*(ehResrc->dmaBufPtr[cntr][index])).usrBuf) != NULL )
 
@@ -2561,7 +3757,7 @@ static int regDump (MODULE_RESRC *moduleResrc,
 
     P716xAdcRegDump(&moduleResrc->p716xRegs, channel, regdumpfile);
     P716xAdcDmaLListDescriptorDump(&(moduleResrc->p716xRegs), channel, 0,
-                                   NUM_DMA_BUFS-1, regdumpfile);
+                                   NUM_DMA_BUFS_GLOBAL-1, regdumpfile);
     P716xAdcTrigCtrlLListDump(&(moduleResrc->p716xRegs), channel,
                               0, 0, regdumpfile);
 
@@ -2684,9 +3880,10 @@ static void PTKHLL_SetProgramOptions (P716x_CMDLINE_ARGS   *argParams,
     // Parser
 	// closes program if file can't be found
     configuration config;
+    memset(&config, 0, sizeof(config));
 
 	//if (ini_parse("///smbtest/NeXtRAD_Header.txt", handler, &config) < 0) {
-	if (ini_parse("///smbtest/NeXtRAD.ini", handler, &config) < 0) {
+	if (ini_parse(NEXTRAD_INI, handler, &config) < 0) {
 		printf("Can't load in file.'\n");
 		return 1;
     }
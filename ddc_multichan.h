@@ -61,6 +61,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>  
+#include <signal.h>
 
 #include "716x.h"              /* 716x-family general header */
 #include "ptk716x.h"           /* 716x driver header */
@@ -70,6 +71,24 @@
 #include "716xview.h"          /* For signal Analyzer */
 #include "716xddcregdump.h"    /* debug DDC IP core registers */
 
+#include "dmaring.h"           /* DMA buffer ring and writer thread */
+#include "mover.h"             /* staging directory to share migration */
+#include "pristats.h"          /* per-PRI missed pulse accounting */
+#include "rtsched.h"           /* RT scheduling, pinning, memory locking */
+#include "adcpoll.h"           /* busy-poll acquisition */
+#include "nxrec.h"             /* self-describing recording format */
+#include "iqpack.h"            /* lossless range line compression */
+#include "bfp.h"               /* block floating point range lines */
+#include "recseg.h"            /* segmented recording */
+#include "rgate.h"             /* range-gated recording */
+#include "geom.h"              /* recording window from the geometry */
+#include "pcomp.h"             /* real-time pulse compression */
+#include "rdop.h"              /* real-time range-Doppler maps */
+#include "win.h"               /* window functions */
+#include "iqk.h"               /* vectorised I/Q kernels */
+#include "tcache.h"            /* FFT plan and window table cache */
+#include "cfar.h"              /* CFAR detection on the range-Doppler maps */
+
 
 /* program defines and constants ------------------------------------------
  *
@@ -84,8 +103,12 @@
  * program must then be recompiled. 
  */
 
-/* NUM_DMA_BUFS - number of circular DMA buffers used in this example */
-#define NUM_DMA_BUFS     1
+/* NUM_DMA_BUFS - default number of circular DMA buffers per channel.  The
+ * ring depth is normally set at run time by NUM_DMA_BUFS in NeXtRAD.ini,
+ * up to MAX_DMA_BUFS (dmaring.h).  A deeper ring lets the writer thread
+ * ride out longer disk stalls before range lines are overwritten.
+ */
+#define NUM_DMA_BUFS     16
 
 
 /* MAX_CHANNELS - Maximum number DMA channels used to adquire data for the
@@ -111,6 +134,44 @@
 /* DEBUG - set to 1 for debugging statements */
 #define DEBUG            0
 
+/* ADC_FLAGS_BAD_TRIG / ADC_FLAGS_OVERFLOW - ADC interrupt flag bits that
+ * dmaThread() samples and clears for every range line.  A bad trigger
+ * means a trigger arrived while the previous acquisition was still
+ * running (a missed pulse); an overflow means the ADC input FIFO filled
+ * and data was lost.
+ */
+#define ADC_FLAGS_BAD_TRIG   P716x_ADC_INTR_BAD_TRIG_ACTIVE
+#ifdef P716x_ADC_INTR_FIFO_FULL
+#define ADC_FLAGS_OVERFLOW   P716x_ADC_INTR_FIFO_FULL
+#else
+#define ADC_FLAGS_OVERFLOW   0
+#endif
+
+/* ADC_DMA_LINK_MASK / ADC_DMA_LINK_SHIFT - field of the ADC DMA status
+ * register holding the linked-list descriptor the DMA engine is filling.
+ * In poll mode (ACQ_POLL) it is read each time the link-end flag is seen,
+ * to count the descriptor groups completed since; the flag itself is a
+ * latch and cannot count.  Poll mode is refused if the ReadyFlow headers
+ * do not give the field.
+ */
+#ifdef P716x_ADC_DMA_STAT_LINK_NUM_MASK
+#define ADC_DMA_LINK_MASK    P716x_ADC_DMA_STAT_LINK_NUM_MASK
+#define ADC_DMA_LINK_SHIFT   P716x_ADC_DMA_STAT_LINK_NUM_SHIFT
+#else
+#define ADC_DMA_LINK_MASK    0
+#define ADC_DMA_LINK_SHIFT   0
+#endif
+
+/* NEXTRAD_INI - experiment configuration read at startup; its text is
+ * also recorded in the header of each nxrec file
+ */
+#define NEXTRAD_INI      "///smbtest/NeXtRAD.ini"
+
+/* WAVEFORM_TABLE - DAC waveform table (Cobalt_Waveform_IO), loaded into
+ * the DAC at startup and the source of the pulse compression reference
+ */
+#define WAVEFORM_TABLE   "///smbtest/Waveforms/WaveformTable.dat"
+
 
 /* ACTIVE_CHANNEL - selects the DDC channel used for input.  Use defines:
  *     P716x_DDC1 (program default)
@@ -309,7 +370,7 @@ typedef struct DMA_THREAD_PARAMS
             IFC_ARGS              *ifcArgs;
             DWORD                  bufSize;
             PTK716X_DMA_HANDLE    *dmaHandle;
-            PTK716X_DMA_BUFFER     dmaBuf[NUM_DMA_BUFS];
+            PTK716X_DMA_BUFFER     dmaBuf[MAX_DMA_BUFS];
             int                   *dataBuf;
             DWORD                  useViewer;
             int                   *sockFd;
@@ -319,6 +380,46 @@ typedef struct DMA_THREAD_PARAMS
         } DMA_THREAD_PARAMS;
 
 
+/* STAGE_* - bits of DMA_STAGES.started, one per stage dmaThread() has
+ * started; stagesStop() tears down just those
+ */
+#define STAGE_OUTPUT     0x01    /* output file or segments open */
+#define STAGE_RING       0x02    /* ring set up */
+#define STAGE_WRITER     0x04    /* writer thread running */
+#define STAGE_PACK       0x08    /* compression workers running */
+#define STAGE_BFP        0x10    /* block floating point coder set up */
+#define STAGE_CFAR       0x20    /* detection running */
+#define STAGE_RDOP       0x40    /* range-Doppler maps running */
+#define STAGE_PCOMP      0x80    /* pulse compression running */
+
+
+/* DMA_STAGES - a channel's recording and processing stages, where:
+ *     started      = STAGE_* bits of the stages started
+ *     segmented    = nonzero if recording to outSeg rather than outfile
+ *     outfile      = output file, when not segmented
+ *     outSeg       = output segments, when segmented
+ *     dmaRing      = DMA buffer ring and its writer thread
+ *     packPool     = compression workers
+ *     bfpCoder     = block floating point coder
+ *     pulseComp    = pulse compression
+ *     rangeDoppler = range-Doppler maps
+ *     cfar         = detection
+ */
+typedef struct DMA_STAGES
+        {
+            unsigned int           started;
+            int                    segmented;
+            REC_FILE               outfile;
+            REC_SEG                outSeg;
+            DMA_RING               dmaRing;
+            IQPACK_POOL            packPool;
+            BFP_CODER              bfpCoder;
+            PULSE_COMP             pulseComp;
+            RANGE_DOPPLER          rangeDoppler;
+            CFAR                   cfar;
+        } DMA_STAGES;
+
+
 /* EXIT_HANDLE_RESRC - exit handler resources structure where:
  *     exitCode[5]   = exit codes for main and threads
  *     modResrcBase  - module resource table base address
@@ -337,7 +438,7 @@ typedef struct EXIT_HANDLE_RESRC
             DWORD          *libStatPtr;
             DWORD          *intrStatPtr;
             PTK716X_DMA_HANDLE   **dmaHandlePtr[MAX_CHANNELS];
-            PTK716X_DMA_BUFFER   *dmaBufPtr[MAX_CHANNELS][NUM_DMA_BUFS];
+            PTK716X_DMA_BUFFER   *dmaBufPtr[MAX_CHANNELS][MAX_DMA_BUFS];
             int           **dataBufPtr[MAX_CHANNELS];
             DWORD          *numChans;
             IFC_ARGS       *ifcArgs;
@@ -398,6 +499,14 @@ static void selectDdcInput(DWORD  dataSrc,
 //static void dmaThread(PVOID pParams, int Adc_delay);
 static void dmaThread(PVOID pParams);
 static int  exitHandler (EXIT_HANDLE_RESRC *ehResrc);
+static void latHistPrint (int chanNum);
+static void latHistDump (void);
+static void jitterTest (int loops);
+static void segmentDone (int chanNum, const char *fileName, int failed);
+static int  stagesStop (int chanNum, DMA_STAGES *stages);
+static const char *outputDir (void);
+static void outputName (char *fileName, const char *stem, int chanNum);
+static void outputQueue (int chanNum, const char *fileName);
 static int  regDump (MODULE_RESRC *moduleResrc, 
                      char         *progId,
                      DWORD         numChans,
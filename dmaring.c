@@ -0,0 +1,1372 @@
+/**************************************************************************
+*
+*   File: dmaring.c
+*
+*   Description: Per-channel ring of DMA range-line buffers drained by a
+*                dedicated writer thread.  See dmaring.h.
+*
+*                The DMA engine runs round the descriptor chain without
+*                waiting for software, so the ring cannot apply back
+*                pressure.  If the writer falls a full ring behind, the
+*                buffer it is about to save has already been refilled;
+*                such lines are still written (so the file stays aligned
+*                to the PRI count) but are counted as overruns.  A line
+*                the writer's queue has no room for is not dropped
+*                either: the writer is then more than a ring behind, and
+*                takes the line from the ring itself when it sees the PRI
+*                index jump, writing it with the usual overrun check but
+*                without its times and flags.  With
+*                interrupt coalescing the engine can be up to a group
+*                less one lines past the last published line, and the
+*                overrun check allows for that.
+*
+*                Hand-off to the writer and any other consumer is through
+*                lock-free SPSC queues; the acquisition side never blocks
+*                or makes a system call.  An idle writer spins briefly and
+*                then sleeps in short steps while waiting for work.
+*
+*                Packed lines are written once the pool hands them back.
+*                The DMA buffer is finished with as soon as its line is
+*                packed, so the overrun check is made then for every
+*                backend.  With the pwritev backend a packed block stays
+*                in its pool slot until the batch holding it is written.
+*
+*                Block floating point lines are coded as they are dequeued,
+*                into a buffer for each place in the batch, so the coded
+*                line outlives the DMA buffer for the pwritev backend just
+*                as the batch's prefixes do.
+*
+*                Range-gated lines with a single window are written,
+*                packed or coded straight from the DMA buffer at the
+*                window's offset.  Lines with several windows are gathered
+*                first, into a buffer for each place in the batch (or each
+*                pool slot), after which the DMA buffer is finished with
+*                and the overrun check is made.
+*
+*                The PRI index lives in memory until the run ends.  It is
+*                allocated for the whole run up front when the PRI count is
+*                known, so the writer only has to grow it for runs of
+*                unknown length.  With segmented output it is sized for one
+*                segment, written when the writer leaves the segment and
+*                allocated afresh for the next.
+*
+*                The segment boundary is checked before a line is coded
+*                or its packed block counted into the batch, since moving
+*                to the next segment flushes the batch.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "dmaring.h"
+
+
+/* WRITER_SPINS - empty polls before the writer starts sleeping;
+ * WRITER_SLEEP_NS - length of each sleep once idle;
+ * INDEX_MIN_ENTRIES - initial index size when the run length is not known
+ */
+#define WRITER_SPINS      256
+#define WRITER_SLEEP_NS   20000
+#define INDEX_MIN_ENTRIES 65536
+
+
+static void *DMARING_WriterThread (void *pParams);
+static void  DMARING_FlushBatch   (DMA_RING *ring);
+static void  DMARING_WriteLine    (DMA_RING *ring, RANGE_LINE_DESC *desc,
+                                   unsigned long long deqTime);
+static void  DMARING_CatchUp      (DMA_RING *ring, unsigned long long pri);
+static int   DMARING_CheckOverrun (DMA_RING *ring, unsigned long long pri);
+static void  DMARING_AddEntry     (DMA_RING *ring, RANGE_LINE_DESC *desc,
+                                   int writeFailed);
+static void  DMARING_AppendLine   (DMA_RING *ring, RANGE_LINE_DESC *desc,
+                                   void *data, unsigned int len,
+                                   unsigned long long deqTime, int overrun);
+static void  DMARING_PackLine     (DMA_RING *ring, RANGE_LINE_DESC *desc,
+                                   unsigned long long deqTime);
+static void  DMARING_WritePacked  (DMA_RING *ring, int wait);
+static void  DMARING_BfpLine      (DMA_RING *ring, RANGE_LINE_DESC *desc,
+                                   unsigned long long deqTime);
+static void  DMARING_CheckSegment (DMA_RING *ring, unsigned long long pri);
+static const int16_t *DMARING_GateLine (DMA_RING *ring, RANGE_LINE_DESC *desc,
+                                   unsigned int place, int *overrun);
+
+
+/**************************************************************************
+ Function:    DMARING_TimeNs()
+
+ Description: Returns CLOCK_MONOTONIC time in ns.  Served from the vDSO on
+              Linux, so it does not enter the kernel.
+
+ Parameters:  none
+
+ Return:      time in ns
+**************************************************************************/
+unsigned long long DMARING_TimeNs (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (((unsigned long long)ts.tv_sec * 1000000000ULL) +
+            (unsigned long long)ts.tv_nsec);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_Init()
+
+ Description: Initializes a channel ring with the writer as its only
+              consumer.  The DMA buffers are owned by the caller and must
+              stay allocated until DMARING_Stop() has returned.
+
+ Parameters:  ring      - pointer to the ring to initialize
+              chanNum   - ADC channel number
+              numBufs     - number of DMA buffers (1 to MAX_DMA_BUFS)
+              linesPerIrq - range lines per link-end interrupt; must
+                            divide numBufs and, if more than 1, leave at
+                            least two groups in the ring
+              bufs        - user-space address of each DMA buffer
+              lineBytes   - bytes written to disk per range line
+              outfile     - open output file; with the pwritev backend its
+                            batch size plus linesPerIrq must not exceed
+                            numBufs so a batch is written before the DMA
+                            engine refills its buffers
+
+ Return:      0 - success
+              1 - invalid number of buffers, group size or batch size
+**************************************************************************/
+int DMARING_Init (DMA_RING     *ring,
+                  int           chanNum,
+                  unsigned int  numBufs,
+                  unsigned int  linesPerIrq,
+                  void        **bufs,
+                  unsigned int  lineBytes,
+                  REC_FILE     *outfile)
+{
+    unsigned int i;
+
+    memset (ring, 0, sizeof(DMA_RING));
+
+    if ((numBufs == 0) || (numBufs > MAX_DMA_BUFS))
+        return (1);
+
+    if ((linesPerIrq == 0) || ((numBufs % linesPerIrq) != 0) ||
+        ((linesPerIrq > 1) && (numBufs < 2 * linesPerIrq)))
+        return (1);
+
+    if ((outfile->backend == REC_FILE_PWRITEV) && (numBufs > 1) &&
+        ((outfile->batchLines + linesPerIrq - 1) >= numBufs))
+        return (1);
+
+    ring->chanNum      = chanNum;
+    ring->numBufs      = numBufs;
+    ring->linesPerIrq  = linesPerIrq;
+    ring->lineBytes    = lineBytes;
+    ring->outfile      = outfile;
+    ring->numConsumers = 1;
+    ring->latMin       = ~0ULL;
+
+    for (i = 0; i < numBufs; i++)
+        ring->bufs[i] = bufs[i];
+
+    for (i = 0; i < DMARING_MAX_CONSUMERS; i++)
+        SPSCQ_Init(&(ring->queue[i]));
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_AddConsumer()
+
+ Description: Attaches another consumer to the ring.  Every published
+              descriptor is also pushed to the returned queue, which the
+              consumer drains with SPSCQ_Pop() from a single thread.  The
+              consumer must be finished with a buffer before the DMA
+              engine comes round to it again.  Call before DMARING_Start().
+
+ Parameters:  ring - pointer to an initialized ring
+
+ Return:      pointer to the consumer's queue, or NULL if none are left
+**************************************************************************/
+SPSC_QUEUE *DMARING_AddConsumer (DMA_RING *ring)
+{
+    if (ring->numConsumers >= DMARING_MAX_CONSUMERS)
+        return (NULL);
+
+    return (&(ring->queue[ring->numConsumers++]));
+}
+
+
+/**************************************************************************
+ Function:    DMARING_Refilled()
+
+ Description: Tells a consumer whether the DMA engine may already have
+              refilled a line's buffer, i.e. whether what it has read of
+              the line can be trusted.  Check after reading the line.
+              Counts nothing, so any consumer thread may call it.  The
+              engine's position is taken from the interrupts counted as
+              they complete (DMARING_SetIrqCount()) when they are ahead
+              of the lines published, as they are when the acquisition
+              thread has fallen behind.
+
+ Parameters:  ring - pointer to the ring
+              pri  - PRI index of the line
+
+ Return:      1 - the buffer may have been refilled
+              0 - the line was intact
+**************************************************************************/
+int DMARING_Refilled (DMA_RING *ring, unsigned long long pri)
+{
+    unsigned long published;
+    unsigned long completed;
+
+    published = __atomic_load_n(&(ring->published), __ATOMIC_ACQUIRE);
+    if (ring->irqCount != NULL)
+    {
+        completed = __atomic_load_n(ring->irqCount, __ATOMIC_ACQUIRE) *
+                    ring->linesPerIrq;
+        if (completed > published)
+            published = completed;
+    }
+
+    return ((published + ring->linesPerIrq - 1 - pri) >= ring->numBufs);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_SetIrqCount()
+
+ Description: Gives DMARING_Refilled() the count of link-end interrupts
+              kept as they complete, so that lines the DMA engine has
+              overwritten while the acquisition thread was behind are
+              seen as such.  Call before DMARING_Start().
+
+ Parameters:  ring     - pointer to an initialized ring
+              irqCount - the interrupt count, or NULL to judge from the
+                         lines published alone
+
+ Return:      none
+**************************************************************************/
+void DMARING_SetIrqCount (DMA_RING *ring, const unsigned long *irqCount)
+{
+    ring->irqCount = irqCount;
+}
+
+
+/**************************************************************************
+ Function:    DMARING_SetHistograms()
+
+ Description: Has the writer thread record its latency stages
+              (LAT_PUB_TO_WRITER, LAT_WRITER_TO_OUT and LAT_IRQ_TO_OUT)
+              into a channel's histograms.  Call before DMARING_Start().
+
+ Parameters:  ring - pointer to an initialized ring
+              hist - array of LAT_NUM_STAGES histograms
+
+ Return:      none
+**************************************************************************/
+void DMARING_SetHistograms (DMA_RING *ring, LAT_HIST *hist)
+{
+    ring->hist = hist;
+}
+
+
+/**************************************************************************
+ Function:    DMARING_SetLinePrefix()
+
+ Description: Has the writer thread put an NXREC_LINE prefix in front of
+              each line it writes (nxrec format).  Call before
+              DMARING_Start().
+
+ Parameters:  ring   - pointer to an initialized ring
+              enable - 1 to write prefixes, 0 for raw lines
+
+ Return:      none
+**************************************************************************/
+void DMARING_SetLinePrefix (DMA_RING *ring, int enable)
+{
+    ring->linePrefix = enable;
+}
+
+
+/**************************************************************************
+ Function:    DMARING_SetIndex()
+
+ Description: Has the writer thread build the nxrec PRI index as it
+              writes.  Call before DMARING_Start().
+
+ Parameters:  ring          - pointer to an initialized ring
+              enable        - 1 to build the index, 0 not to
+              expectedLines - lines the run will write, or 0 if not known
+
+ Return:      0 - success
+              1 - the index could not be allocated
+**************************************************************************/
+int DMARING_SetIndex (DMA_RING           *ring,
+                      int                 enable,
+                      unsigned long long  expectedLines)
+{
+    ring->buildIndex = enable;
+    if (!enable)
+        return (0);
+
+    /* one spare entry holds the trailer when the index is written */
+    ring->indexSize = (expectedLines != 0) ? expectedLines + 1 :
+                                             INDEX_MIN_ENTRIES;
+    ring->index     = (NXREC_INDEX_ENTRY *)malloc(ring->indexSize *
+                                                  sizeof(NXREC_INDEX_ENTRY));
+    if (ring->index == NULL)
+    {
+        ring->buildIndex = 0;
+        ring->indexSize  = 0;
+        return (1);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_SetPack()
+
+ Description: Has the writer thread compress each line through a started
+              iqpack.c pool before writing it.  The pool's slots must
+              cover the ring depth plus, for the pwritev backend, the
+              batch size.  Call before DMARING_Start(), and stop the pool
+              only after DMARING_Stop().  With range gating, call
+              DMARING_SetGate() first.
+
+ Parameters:  ring - pointer to an initialized ring
+              pool - pointer to a started pool for ring->lineBytes / 4
+                     complex samples per line
+
+ Return:      0 - success
+              1 - the output backend needs fixed-length lines (mmap), the
+                  ring codes its lines in block floating point, or the
+                  pool is too small
+**************************************************************************/
+int DMARING_SetPack (DMA_RING *ring, IQPACK_POOL *pool)
+{
+    if ((ring->outfile->backend == REC_FILE_MMAP) || (ring->bfp != NULL) ||
+        (pool->samples * 2 * sizeof(int16_t) != ring->lineBytes) ||
+        (pool->numSlots < ring->numBufs +
+                          ((ring->outfile->backend == REC_FILE_PWRITEV) ?
+                               ring->outfile->batchLines : 0)))
+        return (1);
+
+    ring->pack = pool;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_SetBfp()
+
+ Description: Has the writer thread code each line in block floating point
+              (bfp.c) before writing it.  Call before DMARING_Start().
+              Not for use with DMARING_SetPack().  With range gating,
+              call DMARING_SetGate() first.
+
+ Parameters:  ring  - pointer to an initialized ring
+              coder - pointer to a coder set up for ring->lineBytes / 4
+                      complex samples per line; the writer adds to its
+                      statistics
+
+ Return:      0 - success
+              1 - the ring packs its lines, the line size does not match
+                  or the batch buffers could not be allocated
+**************************************************************************/
+int DMARING_SetBfp (DMA_RING *ring, BFP_CODER *coder)
+{
+    if ((ring->pack != NULL) ||
+        (coder->samples * 2 * sizeof(int16_t) != ring->lineBytes))
+        return (1);
+
+    ring->bfpBuf = (unsigned char *)malloc((size_t)ring->outfile->batchLines *
+                                           coder->lineBytes);
+    if (ring->bfpBuf == NULL)
+        return (1);
+
+    ring->bfp = coder;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_SetGate()
+
+ Description: Has the writer thread keep only a channel's range windows
+              of each line.  ring->lineBytes becomes the windows' size,
+              which is what DMARING_SetPack() and DMARING_SetBfp() then
+              expect their pool or coder to be set up for, so call this
+              before either of them.  Call before DMARING_Start().
+
+ Parameters:  ring - pointer to an initialized ring
+              gate - pointer to the channel's windows, for lines of
+                     ring->lineBytes / 4 complex samples; nothing is done
+                     if it has none
+
+ Return:      0 - success
+              1 - the ring already packs or codes its lines, or the line
+                  size does not match
+**************************************************************************/
+int DMARING_SetGate (DMA_RING *ring, RANGE_GATE *gate)
+{
+    if ((ring->pack != NULL) || (ring->bfp != NULL) ||
+        (gate->lineSamples * 2 * sizeof(int16_t) != ring->lineBytes))
+        return (1);
+
+    if (gate->numWindows == 0)
+        return (0);
+
+    ring->gate      = gate;
+    ring->lineBytes = gate->samples * 2 * sizeof(int16_t);
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_SetSegments()
+
+ Description: Has the writer thread split its output into recseg.c
+              segments.  When the first PRI of the next segment comes up,
+              the writer flushes the current segment, adds its index and
+              carries on in the next segment's file.  The ring must have
+              been initialized with RECSEG_File() as its output file.
+              Call after DMARING_SetIndex(), which should then be given
+              the segment length, and before DMARING_Start().
+
+ Parameters:  ring - pointer to an initialized ring
+              seg  - pointer to the open segmented output
+
+ Return:      0 - success
+              1 - the ring is not writing to the segment's file
+**************************************************************************/
+int DMARING_SetSegments (DMA_RING *ring, REC_SEG *seg)
+{
+    if (ring->outfile != RECSEG_File(seg))
+        return (1);
+
+    ring->seg         = seg;
+    ring->segFirstPri = 0;
+    ring->segEndPri   = seg->segPris;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_Start()
+
+ Description: Starts the writer thread for a ring, after allocating the
+              gather buffers if its lines have several range windows.
+
+ Parameters:  ring - pointer to an initialized ring
+
+ Return:      0 - success
+              1 - the gather buffers could not be allocated, or thread
+                  creation failed
+**************************************************************************/
+int DMARING_Start (DMA_RING *ring)
+{
+    size_t places;
+
+    /* a gathered line is held until its batch is written, or until it
+     * has been packed; the coder is done with it at once
+     */
+    if ((ring->gate != NULL) && (ring->gate->numWindows > 1))
+    {
+        places = (ring->pack != NULL) ? ring->pack->numSlots :
+                 (ring->bfp != NULL)  ? 1 : ring->outfile->batchLines;
+        ring->gateBuf = (int16_t *)malloc(places * ring->lineBytes);
+        if (ring->gateBuf == NULL)
+            return (1);
+    }
+
+    if (pthread_create(&(ring->writer), NULL, DMARING_WriterThread, ring) != 0)
+    {
+        free(ring->gateBuf);
+        ring->gateBuf = NULL;
+        return (1);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_Free()
+
+ Description: Frees what DMARING_SetIndex(), DMARING_SetBfp() and
+              DMARING_Start() allocated, for a ring whose writer was not
+              started.  The output file is left to the caller.
+
+ Parameters:  ring - pointer to an initialized ring
+
+ Return:      none
+**************************************************************************/
+void DMARING_Free (DMA_RING *ring)
+{
+    free(ring->index);
+    ring->index     = NULL;
+    ring->indexSize = 0;
+    free(ring->bfpBuf);
+    ring->bfpBuf = NULL;
+    free(ring->gateBuf);
+    ring->gateBuf = NULL;
+}
+
+
+/**************************************************************************
+ Function:    DMARING_Publish()
+
+ Description: Hands a filled DMA buffer to the writer thread and any other
+              consumers.  Called by the acquisition thread once per range
+              line, in the order the DMA engine filled the buffers.  Takes
+              no locks and makes no system calls; a consumer whose queue
+              is full misses the line and it is counted as dropped,
+              except the writer, which catches up from the ring (see
+              DMARING_CatchUp()).  The run's first line must be in
+              buffer 0, so that line p is in buffer p % numBufs.
+
+ Parameters:  ring     - pointer to the ring
+              bufIndex - index of the DMA buffer just filled
+              intrTime - time of the line's link-end interrupt, in ns
+              adcFlags - ADC interrupt flags sampled for the line
+
+ Return:      none
+**************************************************************************/
+void DMARING_Publish (DMA_RING           *ring,
+                      unsigned int        bufIndex,
+                      unsigned long long  intrTime,
+                      unsigned int        adcFlags)
+{
+    RANGE_LINE_DESC  desc;
+    unsigned long    depth;
+    unsigned int     i;
+
+    desc.buf       = ring->bufs[bufIndex];
+    desc.bufIndex  = bufIndex;
+    desc.chanNum   = ring->chanNum;
+    desc.priIndex  = ring->published;
+    desc.timestamp = DMARING_TimeNs();
+    desc.intrTime  = intrTime;
+    desc.adcFlags  = adcFlags;
+
+    for (i = 0; i < ring->numConsumers; i++)
+    {
+        if ((SPSCQ_Push(&(ring->queue[i]), &desc) != 0) && (i != 0))
+            ring->dropped[i]++;
+    }
+
+    __atomic_store_n(&(ring->published), ring->published + 1,
+                     __ATOMIC_RELEASE);
+
+    depth = SPSCQ_Depth(&(ring->queue[0]));
+    if (depth > ring->maxDepth)
+        ring->maxDepth = depth;
+}
+
+
+/**************************************************************************
+ Function:    DMARING_PublishGroup()
+
+ Description: Publishes the range lines of one coalesced descriptor group,
+              in fill order.  All lines of the group carry the group's
+              link-end interrupt time, which is when the last of them
+              completed.
+
+ Parameters:  ring     - pointer to the ring
+              firstBuf - index of the group's first DMA buffer
+              count    - lines to publish (the group size, or fewer for
+                         the last group of a run)
+              intrTime - time of the group's link-end interrupt, in ns
+              adcFlags - ADC interrupt flags sampled for the group
+
+ Return:      none
+**************************************************************************/
+void DMARING_PublishGroup (DMA_RING           *ring,
+                           unsigned int        firstBuf,
+                           unsigned int        count,
+                           unsigned long long  intrTime,
+                           unsigned int        adcFlags)
+{
+    unsigned int bufIndex = firstBuf;
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+    {
+        DMARING_Publish(ring, bufIndex, intrTime, adcFlags);
+        if (++bufIndex == ring->numBufs)
+            bufIndex = 0;
+    }
+}
+
+
+/**************************************************************************
+ Function:    DMARING_Stop()
+
+ Description: Lets the writer thread drain all published lines, including
+              a final partial batch, then waits for it to exit.  The
+              output file is not closed.  Called from the acquisition
+              thread.
+
+ Parameters:  ring - pointer to a started ring
+
+ Return:      0 - all lines written
+              1 - a write to the output file failed
+**************************************************************************/
+int DMARING_Stop (DMA_RING *ring)
+{
+    __atomic_store_n(&(ring->stop), 1, __ATOMIC_RELEASE);
+
+    pthread_join(ring->writer, NULL);
+
+    free(ring->bfpBuf);
+    ring->bfpBuf = NULL;
+    free(ring->gateBuf);
+    ring->gateBuf = NULL;
+
+    return (ring->writeError);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_WriteIndex()
+
+ Description: Adds the PRI index and trailer to the end of the output file
+              and frees the index.  Call after DMARING_Stop() and before
+              the file is closed; does nothing if no index was built.
+              With segmented output this finishes the last segment; the
+              writer has added the others' as it left them.
+
+ Parameters:  ring - pointer to a stopped ring
+
+ Return:      0 - success, or no index
+              1 - the index, or that of an earlier segment, was
+                  incomplete or could not be written
+**************************************************************************/
+int DMARING_WriteIndex (DMA_RING *ring)
+{
+    NXREC_TRAILER *trailer;
+    size_t         indexBytes;
+    int            status;
+
+    if (ring->index == NULL)
+        return ((ring->buildIndex || ring->indexFailed) ? 1 : 0);
+
+    indexBytes = ring->indexLen * sizeof(NXREC_INDEX_ENTRY);
+
+    /* the trailer (no larger than an entry) goes in the spare entry
+     * after the last one, so the file gets a single trailer write
+     */
+    trailer = (NXREC_TRAILER *)((char *)ring->index + indexBytes);
+    memset (trailer, 0, sizeof(NXREC_TRAILER));
+    memcpy (trailer->magic, NXREC_INDEX_MAGIC, sizeof(trailer->magic));
+    trailer->indexOffset = ring->outfile->appendEnd;
+    trailer->numEntries  = ring->indexLen;
+    trailer->entryBytes  = sizeof(NXREC_INDEX_ENTRY);
+
+    status = RECFILE_WriteTrailer(ring->outfile, ring->index,
+                                  indexBytes + sizeof(NXREC_TRAILER));
+
+    free(ring->index);
+    ring->index     = NULL;
+    ring->indexLen  = 0;
+    ring->indexSize = 0;
+
+    return ((status || ring->indexFailed) ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_Report()
+
+ Description: Prints the ring statistics for a channel: line counts,
+              hand-off latency through the writer's queue and the write
+              throughput seen by the writer thread.  For the async backend
+              this is the rate lines are staged and submitted, since the
+              writer does not wait for the disk.  With segmented output,
+              call once the segments are closed; the byte counts are
+              summed over them.
+
+ Parameters:  ring - pointer to a stopped ring
+
+ Return:      none
+**************************************************************************/
+void DMARING_Report (DMA_RING *ring)
+{
+    unsigned long long bytesWritten = ring->outfile->bytesWritten;
+    unsigned long      writeCalls   = ring->outfile->writeCalls;
+    unsigned int       i;
+
+    if (ring->seg != NULL)
+    {
+        bytesWritten = ring->seg->bytesWritten;
+        writeCalls   = ring->seg->writeCalls;
+    }
+
+    printf("[dmaThread %d] ring: %u buffers, %u line(s) per interrupt, "
+           "%lu lines published, %lu written\n", ring->chanNum+1,
+           ring->numBufs, ring->linesPerIrq, ring->published, ring->written);
+    printf("[dmaThread %d] ring: max depth %lu, %lu overrun(s)\n",
+           ring->chanNum+1, ring->maxDepth, ring->overruns);
+    if (ring->late != 0)
+        printf("[dmaThread %d] ring: %lu line(s) taken from the ring after "
+               "the writer's queue filled\n", ring->chanNum+1, ring->late);
+
+    for (i = 0; i < ring->numConsumers; i++)
+    {
+        if (ring->dropped[i] != 0)
+            printf("[dmaThread %d] ring: consumer %u dropped %lu line(s)\n",
+                   ring->chanNum+1, i, ring->dropped[i]);
+    }
+
+    if (ring->written > ring->late)
+    {
+        printf("[dmaThread %d] ring: hand-off latency min %.1f / mean %.1f"
+               " / max %.1f us\n", ring->chanNum+1,
+               ring->latMin / 1e3,
+               ((double)ring->latSum / (ring->written - ring->late)) / 1e3,
+               ring->latMax / 1e3);
+    }
+
+    if (ring->writeNs != 0)
+    {
+        printf("[dmaThread %d] ring: write throughput %.1f MB/s "
+               "(%.0f bytes per line%s)\n", ring->chanNum+1,
+               ((double)bytesWritten) / ((double)ring->writeNs / 1e9) / 1e6,
+               ((ring->pack != NULL) && (ring->pack->collected != 0)) ?
+                   (double)ring->pack->bytesOut / ring->pack->collected :
+               (ring->bfp != NULL) ? (double)ring->bfp->lineBytes :
+                   (double)ring->lineBytes,
+               (ring->pack != NULL) ? ", packed" :
+               (ring->bfp != NULL) ? ", block floating point" : "");
+    }
+
+    if (ring->outfile->backend == REC_FILE_ASYNC)
+    {
+        printf("[dmaThread %d] ring: async output, %u staging buffers, %s\n",
+               ring->chanNum+1, ring->outfile->numSlots,
+               ring->outfile->directIo ? "O_DIRECT" : "page cache");
+    }
+
+    if (writeCalls != 0)
+    {
+        printf("[dmaThread %d] ring: %lu write call(s), %.0f bytes per call\n",
+               ring->chanNum+1, writeCalls,
+               (double)bytesWritten / writeCalls);
+    }
+}
+
+
+/**************************************************************************
+ Function:    DMARING_WriterThread()
+
+ Description: Writer thread.  Drains queue 0 and adds each line to the
+              output file in order, flushing every outfile->batchLines
+              lines.  Spins briefly when the queue is empty, then sleeps
+              in WRITER_SLEEP_NS steps.  Lines the queue had no room for
+              are taken from the ring before the next line queued, or
+              before the end.  A partial batch is flushed once the ring
+              has been stopped and drained.
+
+ Parameters:  pParams - pointer to the DMA_RING
+
+ Return:      NULL
+**************************************************************************/
+static void *DMARING_WriterThread (void *pParams)
+{
+    DMA_RING           *ring  = (DMA_RING *)pParams;
+    SPSC_QUEUE         *queue = &(ring->queue[0]);
+    RANGE_LINE_DESC     desc;
+    struct timespec     idle  = {0, WRITER_SLEEP_NS};
+    unsigned long long  start;
+    unsigned long long  latency;
+    unsigned int        spins = 0;
+
+    while (1)
+    {
+        if (SPSCQ_Pop(queue, &desc) != 0)
+        {
+            /* stop is set after the last publish, so once it is seen an
+             * empty queue really is drained
+             */
+            if (__atomic_load_n(&(ring->stop), __ATOMIC_ACQUIRE))
+            {
+                if (SPSCQ_Pop(queue, &desc) != 0)
+                {
+                    DMARING_CatchUp(ring, __atomic_load_n(&(ring->published),
+                                                          __ATOMIC_ACQUIRE));
+                    if (ring->pack != NULL)
+                        DMARING_WritePacked(ring, 1);
+                    DMARING_FlushBatch(ring);
+                    break;
+                }
+            }
+            else
+            {
+                /* write out lines the pool has finished meanwhile */
+                if (ring->pack != NULL)
+                    DMARING_WritePacked(ring, 0);
+                if (spins < WRITER_SPINS)
+                {
+                    spins++;
+                    SPSCQ_CpuRelax();
+                }
+                else
+                    nanosleep(&idle, NULL);
+                continue;
+            }
+        }
+
+        spins = 0;
+        start = DMARING_TimeNs();
+
+        latency = start - desc.timestamp;
+        if (latency < ring->latMin)
+            ring->latMin = latency;
+        if (latency > ring->latMax)
+            ring->latMax = latency;
+        ring->latSum += latency;
+        if (ring->hist != NULL)
+            LATHIST_Record(&(ring->hist[LAT_PUB_TO_WRITER]), latency);
+
+        DMARING_CatchUp(ring, desc.priIndex);
+        DMARING_WriteLine(ring, &desc, start);
+    }
+
+    return (NULL);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_WriteLine()
+
+ Description: Packs, codes or appends one line, as the ring is set up.
+              Writer thread only.
+
+ Parameters:  ring    - pointer to the ring
+              desc    - descriptor of the line
+              deqTime - time the line was dequeued, in ns
+
+ Return:      none
+**************************************************************************/
+static void DMARING_WriteLine (DMA_RING           *ring,
+                               RANGE_LINE_DESC    *desc,
+                               unsigned long long  deqTime)
+{
+    const int16_t *line;
+    int            overrun;
+
+    ring->nextPri = desc->priIndex + 1;
+
+    if (ring->pack != NULL)
+        DMARING_PackLine(ring, desc, deqTime);
+    else if (ring->bfp != NULL)
+        DMARING_BfpLine(ring, desc, deqTime);
+    else
+    {
+        DMARING_CheckSegment(ring, desc->priIndex);
+        line = DMARING_GateLine(ring, desc, ring->numPending, &overrun);
+        DMARING_AppendLine(ring, desc, (void *)line, ring->lineBytes,
+                           deqTime, overrun);
+    }
+}
+
+
+/**************************************************************************
+ Function:    DMARING_CatchUp()
+
+ Description: Writes the lines before a PRI index that never reached the
+              writer's queue because it was full, taking each from its
+              DMA buffer.  The queue holds more than a ring, so these
+              lines are usually refilled by now; each is checked for an
+              overrun as any other line is.  Their times and flags are
+              not known and are left 0.  Writer thread only.
+
+ Parameters:  ring - pointer to the ring
+              pri  - PRI index to catch up to
+
+ Return:      none
+**************************************************************************/
+static void DMARING_CatchUp (DMA_RING *ring, unsigned long long pri)
+{
+    RANGE_LINE_DESC desc;
+
+    while (ring->nextPri < pri)
+    {
+        desc.bufIndex  = (unsigned int)(ring->nextPri % ring->numBufs);
+        desc.buf       = ring->bufs[desc.bufIndex];
+        desc.chanNum   = ring->chanNum;
+        desc.priIndex  = ring->nextPri;
+        desc.timestamp = 0;
+        desc.intrTime  = 0;
+        desc.adcFlags  = 0;
+        ring->late++;
+        DMARING_WriteLine(ring, &desc, DMARING_TimeNs());
+    }
+}
+
+
+/**************************************************************************
+ Function:    DMARING_AppendLine()
+
+ Description: Adds one line to the output file and the index, and flushes
+              the batch once it is full.  Writer thread only.
+
+ Parameters:  ring    - pointer to the ring
+              desc    - descriptor of the line
+              data    - the line as written: the DMA buffer, its packed
+                        block, its coded form or its gathered windows
+              len     - bytes at data
+              deqTime - time the line was dequeued, in ns
+              overrun - result of the overrun check if already made
+                        (packed, coded and gathered lines), or -1 to
+                        check here
+
+ Return:      none
+**************************************************************************/
+static void DMARING_AppendLine (DMA_RING           *ring,
+                                RANGE_LINE_DESC    *desc,
+                                void               *data,
+                                unsigned int        len,
+                                unsigned long long  deqTime,
+                                int                 overrun)
+{
+    NXREC_LINE         *prefix;
+    unsigned long long  start = DMARING_TimeNs();
+    int                 failed;
+
+    /* the prefix stays in the batch until it is flushed, which the
+     * pwritev backend needs
+     */
+    prefix = &(ring->pendingPrefix[ring->numPending]);
+    if (ring->linePrefix)
+    {
+        prefix->sync     = NXREC_LINE_SYNC;
+        prefix->adcFlags = desc->adcFlags;
+        prefix->priIndex = desc->priIndex;
+        prefix->intrTime = desc->intrTime;
+        prefix->pubTime  = desc->timestamp;
+    }
+
+    failed = RECFILE_Append(ring->outfile, prefix,
+                            ring->linePrefix ? sizeof(NXREC_LINE) : 0,
+                            data, len, desc->priIndex - ring->segFirstPri);
+    if (failed)
+        ring->writeError = 1;
+    if (ring->buildIndex)
+        DMARING_AddEntry(ring, desc, failed);
+
+    /* only the pwritev backend still needs the DMA buffer after the
+     * append; the others have copied the line out of it
+     */
+    if (overrun < 0)
+    {
+        if (ring->outfile->backend == REC_FILE_PWRITEV)
+            ring->pendingPri[ring->numPending] = desc->priIndex;
+        else
+            overrun = DMARING_CheckOverrun(ring, desc->priIndex);
+    }
+    if ((overrun > 0) && (ring->index != NULL))
+        ring->index[ring->indexLen - 1].status |= NXREC_IDX_OVERRUN;
+
+    ring->pendingDeq[ring->numPending]  = deqTime;
+    ring->pendingIntr[ring->numPending] = desc->intrTime;
+    ring->numPending++;
+
+    ring->writeNs += DMARING_TimeNs() - start;
+
+    if (ring->numPending >= ring->outfile->batchLines)
+        DMARING_FlushBatch(ring);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_PackLine()
+
+ Description: Hands a line to the compression pool, then writes out any
+              lines the pool has finished.  If every pool slot is in use,
+              waits for the oldest line first.  Writer thread only.
+
+ Parameters:  ring    - pointer to the ring
+              desc    - descriptor of the line
+              deqTime - time the line was dequeued, in ns
+
+ Return:      none
+**************************************************************************/
+static void DMARING_PackLine (DMA_RING           *ring,
+                              RANGE_LINE_DESC    *desc,
+                              unsigned long long  deqTime)
+{
+    IQPACK_POOL  *pack = ring->pack;
+    unsigned int  slot;
+
+    while (!IQPACK_CanSubmit(pack))
+    {
+        /* every slot is either being packed or held by the batch */
+        if (pack->collected < pack->submitted)
+            DMARING_WritePacked(ring, 1);
+        else
+            DMARING_FlushBatch(ring);
+    }
+
+    slot = (unsigned int)(pack->submitted % pack->numSlots);
+    ring->packDesc[slot] = *desc;
+    ring->packDeq[slot]  = deqTime;
+    IQPACK_Submit(pack, DMARING_GateLine(ring, desc, slot,
+                                         &(ring->packOverrun[slot])));
+
+    DMARING_WritePacked(ring, 0);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_WritePacked()
+
+ Description: Writes packed lines as the pool hands them back, in PRI
+              order.  A slot is released at once unless the pwritev
+              backend still needs its block for the batch.  Writer thread
+              only.
+
+ Parameters:  ring - pointer to the ring
+              wait - 0 to write only the lines already packed; 1 to wait
+                     for one line, or for all of them when the ring is
+                     stopping
+
+ Return:      none
+**************************************************************************/
+static void DMARING_WritePacked (DMA_RING *ring, int wait)
+{
+    IQPACK_POOL     *pack = ring->pack;
+    IQPACK_SLOT     *slot;
+    RANGE_LINE_DESC *desc;
+    unsigned int     index;
+    int              overrun;
+    int              drain;
+
+    drain = wait && __atomic_load_n(&(ring->stop), __ATOMIC_ACQUIRE);
+
+    while ((slot = IQPACK_Collect(pack, wait)) != NULL)
+    {
+        index   = (unsigned int)((pack->collected - 1) % pack->numSlots);
+        desc    = &(ring->packDesc[index]);
+        overrun = ring->packOverrun[index];
+        if (overrun < 0)
+            overrun = DMARING_CheckOverrun(ring, desc->priIndex);
+        DMARING_CheckSegment(ring, desc->priIndex);
+
+        /* counted before the append, which may flush the batch */
+        if (ring->outfile->backend == REC_FILE_PWRITEV)
+            ring->packHeld++;
+
+        DMARING_AppendLine(ring, desc, slot->out, slot->packedBytes,
+                           ring->packDeq[index], overrun);
+
+        if (ring->outfile->backend != REC_FILE_PWRITEV)
+            IQPACK_Release(pack, 1);
+
+        if (!drain)
+            wait = 0;
+    }
+}
+
+
+/**************************************************************************
+ Function:    DMARING_BfpLine()
+
+ Description: Codes a line in block floating point and adds it to the
+              output file.  Every BFP_MEASURE_EVERY-th line also has its
+              coding error measured.  Writer thread only.
+
+ Parameters:  ring    - pointer to the ring
+              desc    - descriptor of the line
+              deqTime - time the line was dequeued, in ns
+
+ Return:      none
+**************************************************************************/
+static void DMARING_BfpLine (DMA_RING           *ring,
+                             RANGE_LINE_DESC    *desc,
+                             unsigned long long  deqTime)
+{
+    BFP_CODER          *bfp   = ring->bfp;
+    const int16_t      *iq;
+    unsigned char      *out;
+    unsigned long long  start;
+    int                 overrun;
+
+    DMARING_CheckSegment(ring, desc->priIndex);
+    iq    = DMARING_GateLine(ring, desc, 0, &overrun);
+    start = DMARING_TimeNs();
+
+    /* the coded line is kept until its batch is flushed */
+    out = ring->bfpBuf + ((size_t)ring->numPending * bfp->lineBytes);
+    BFP_Encode(bfp, iq, out);
+    bfp->encodeNs += DMARING_TimeNs() - start;
+
+    /* measured before the overrun check, which then covers both reads
+     * of the DMA buffer; a gathered line was checked when it was copied
+     */
+    if ((bfp->lines++ % BFP_MEASURE_EVERY) == 0)
+        BFP_Measure(bfp, iq, out);
+
+    if (overrun < 0)
+        overrun = DMARING_CheckOverrun(ring, desc->priIndex);
+
+    DMARING_AppendLine(ring, desc, out, bfp->lineBytes, deqTime, overrun);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_CheckSegment()
+
+ Description: Moves the output on to the next segment if a line belongs to
+              it: flushes the batch, adds the index to the segment being
+              left and switches to the file the segment finisher has
+              opened ahead.  If that file could not be opened, the rest of
+              the run goes on in the current segment.  Writer thread only.
+
+ Parameters:  ring - pointer to the ring
+              pri  - PRI index of the line about to be added
+
+ Return:      none
+**************************************************************************/
+static void DMARING_CheckSegment (DMA_RING *ring, unsigned long long pri)
+{
+    unsigned long long start;
+
+    if ((ring->seg == NULL) || (pri < ring->segEndPri))
+        return;
+
+    DMARING_FlushBatch(ring);
+
+    if (RECSEG_Next(ring->seg, ring->segEndPri) == NULL)
+    {
+        ring->segEndPri = ~0ULL;
+        return;
+    }
+
+    start = DMARING_TimeNs();
+    if (DMARING_WriteIndex(ring) != 0)
+        ring->indexFailed = 1;
+    ring->writeNs += DMARING_TimeNs() - start;
+
+    ring->outfile      = RECSEG_Switch(ring->seg);
+    ring->segFirstPri  = ring->segEndPri;
+    ring->segEndPri   += ring->seg->segPris;
+
+    /* a new index for the new segment; if it cannot be had, the segment
+     * is written without one and the failure reported at the end
+     */
+    if (ring->buildIndex)
+    {
+        ring->indexSize = ring->seg->segPris + 1;
+        ring->index     = (NXREC_INDEX_ENTRY *)malloc(ring->indexSize *
+                                                      sizeof(NXREC_INDEX_ENTRY));
+        if (ring->index == NULL)
+            ring->indexSize = 0;
+    }
+}
+
+
+/**************************************************************************
+ Function:    DMARING_GateLine()
+
+ Description: Returns a line as it is to be recorded.  Without range
+              gating that is the DMA buffer, and with a single window the
+              window in it.  Several windows are gathered into a place in
+              gateBuf, and the overrun check is made once they have been
+              copied.  Writer thread only.
+
+ Parameters:  ring    - pointer to the ring
+              desc    - descriptor of the line
+              place   - place in gateBuf: the line's place in the batch,
+                        or its pool slot
+              overrun - receives the result of the overrun check if it
+                        was made, or -1 if the line is still in the DMA
+                        buffer
+
+ Return:      pointer to the line's ring->lineBytes of I/Q samples
+**************************************************************************/
+static const int16_t *DMARING_GateLine (DMA_RING        *ring,
+                                        RANGE_LINE_DESC *desc,
+                                        unsigned int     place,
+                                        int             *overrun)
+{
+    const int16_t      *line = (const int16_t *)desc->buf;
+    int16_t            *out;
+    unsigned long long  start;
+
+    *overrun = -1;
+    if (ring->gate == NULL)
+        return (line);
+    if (ring->gateBuf == NULL)
+        return (line + (2 * (size_t)ring->gate->window[0].firstBin));
+
+    start = DMARING_TimeNs();
+    out   = ring->gateBuf + ((size_t)place * (ring->lineBytes / sizeof(int16_t)));
+    RGATE_Gather(ring->gate, line, out);
+    ring->gate->gatherNs += DMARING_TimeNs() - start;
+    ring->gate->lines++;
+
+    *overrun = DMARING_CheckOverrun(ring, desc->priIndex);
+
+    return (out);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_FlushBatch()
+
+ Description: Writes the writer's current batch and accounts for its
+              lines.  Writer thread only.
+
+ Parameters:  ring - pointer to the ring
+
+ Return:      none
+**************************************************************************/
+static void DMARING_FlushBatch (DMA_RING *ring)
+{
+    unsigned long long start = DMARING_TimeNs();
+    unsigned long long end;
+    unsigned long long first;
+    unsigned int       i;
+    int                failed;
+
+    if (ring->numPending == 0)
+        return;
+
+    failed = RECFILE_Flush(ring->outfile);
+    if (failed)
+        ring->writeError = 1;
+
+    end = DMARING_TimeNs();
+    ring->writeNs += end - start;
+
+    if (ring->hist != NULL)
+    {
+        for (i = 0; i < ring->numPending; i++)
+        {
+            LATHIST_Record(&(ring->hist[LAT_WRITER_TO_OUT]),
+                           end - ring->pendingDeq[i]);
+            if (ring->pendingIntr[i] != 0)
+                LATHIST_Record(&(ring->hist[LAT_IRQ_TO_OUT]),
+                               end - ring->pendingIntr[i]);
+        }
+    }
+
+    if (ring->packHeld != 0)
+    {
+        IQPACK_Release(ring->pack, ring->packHeld);
+        ring->packHeld = 0;
+    }
+
+    /* once line + numBufs - 1 has been published, the DMA engine is
+     * refilling that line's buffer; if that happened before the write
+     * finished, the saved data may be torn.  Packed, coded and gathered
+     * lines were checked when they were copied out of the buffer.
+     */
+    if (ring->outfile->backend == REC_FILE_PWRITEV)
+    {
+        /* the batch's lines are the last entries in the index */
+        first = ring->indexLen - ring->numPending;
+        for (i = 0; i < ring->numPending; i++)
+        {
+            if ((ring->pack == NULL) && (ring->bfp == NULL) &&
+                (ring->gateBuf == NULL) &&
+                DMARING_CheckOverrun(ring, ring->pendingPri[i]) &&
+                (ring->index != NULL))
+                ring->index[first + i].status |= NXREC_IDX_OVERRUN;
+            if (failed && (ring->index != NULL))
+                ring->index[first + i].status |= NXREC_IDX_WRITE;
+        }
+    }
+
+    ring->written   += ring->numPending;
+    ring->numPending = 0;
+}
+
+
+/**************************************************************************
+ Function:    DMARING_CheckOverrun()
+
+ Description: Counts an overrun if a line's DMA buffer may have been
+              refilled before the writer finished with it.  The DMA engine
+              may be filling any line of the group after the last one
+              published.  Writer thread only.
+
+ Parameters:  ring - pointer to the ring
+              pri  - PRI index of the line
+
+ Return:      1 - the line overran
+              0 - it did not
+**************************************************************************/
+static int DMARING_CheckOverrun (DMA_RING *ring, unsigned long long pri)
+{
+    if (DMARING_Refilled(ring, pri))
+    {
+        ring->overruns++;
+        return (1);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    DMARING_AddEntry()
+
+ Description: Adds a line just appended to the output file to the PRI
+              index, growing the index if it is full.  If it cannot grow,
+              the index is dropped and DMARING_WriteIndex() reports the
+              failure; the recording itself carries on.  Writer thread
+              only.
+
+ Parameters:  ring        - pointer to the ring
+              desc        - descriptor of the line
+              writeFailed - nonzero if the append failed
+
+ Return:      none
+**************************************************************************/
+static void DMARING_AddEntry (DMA_RING        *ring,
+                              RANGE_LINE_DESC *desc,
+                              int              writeFailed)
+{
+    NXREC_INDEX_ENTRY  *entry;
+    unsigned long long  newSize;
+
+    if (ring->index == NULL)
+        return;
+
+    /* keep room for the trailer after the last entry */
+    if ((ring->indexLen + 2) > ring->indexSize)
+    {
+        newSize = 2 * ring->indexSize;
+        entry   = (NXREC_INDEX_ENTRY *)realloc(ring->index, newSize *
+                                               sizeof(NXREC_INDEX_ENTRY));
+        if (entry == NULL)
+        {
+            free(ring->index);
+            ring->index = NULL;
+            return;
+        }
+        ring->index     = entry;
+        ring->indexSize = newSize;
+    }
+
+    entry = &(ring->index[ring->indexLen++]);
+    entry->priIndex = desc->priIndex;
+    entry->offset   = ring->outfile->lineOffset;
+    entry->intrTime = desc->intrTime;
+    entry->adcFlags = desc->adcFlags;
+    entry->status   = writeFailed ? NXREC_IDX_WRITE : 0;
+}
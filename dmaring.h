@@ -0,0 +1,264 @@
+/***********************************************************************
+*
+*   File: dmaring.h
+*
+*   Description: header file for dmaring.c, the per-channel ring of DMA
+*                range-line buffers and the writer thread that drains it
+*                to disk.
+*
+*                The acquisition thread (dmaThread() in ddc_multichan.c)
+*                only publishes a descriptor of each filled DMA buffer
+*                into lock-free SPSC queues (spscq.h); all file I/O happens
+*                on the writer thread, so a slow disk is absorbed by the
+*                ring rather than by the trigger stream.  Further stages
+*                (viewer, processing) can attach their own queue with
+*                DMARING_AddConsumer().
+*
+*                Nothing in this module calls the PTK716X library.  The
+*                ring is driven purely through DMARING_Publish(), so it
+*                can be exercised by a software stand-in for the DMA
+*                interrupt/semaphore path.
+*
+*                With interrupt coalescing (IRQ_COALESCE in NeXtRAD.ini)
+*                only every linesPerIrq-th DMA descriptor raises a link-end
+*                interrupt.  dmaThread() then wakes once per group and
+*                hands the whole group over with DMARING_PublishGroup().
+*
+*                For the nxrec format the writer also builds the file's PRI
+*                index (DMARING_SetIndex()).  It is added to the file by
+*                DMARING_WriteIndex() once the ring has been stopped.
+*
+*                With compression (DMARING_SetPack()) the writer hands
+*                each line to an iqpack.c worker pool and writes the
+*                packed blocks as they come back, in PRI order.  With
+*                block floating point (DMARING_SetBfp()) it codes each
+*                line itself before writing it.
+*
+*                With range gating (DMARING_SetGate()) the writer keeps
+*                only the rgate.c windows of each line; they are then
+*                what is packed, coded and written.
+*
+*                With segmented output (DMARING_SetSegments()) the writer
+*                moves to the next recseg.c segment file when the first PRI
+*                of that segment comes up, after flushing the current one
+*                and adding its index.  Each segment gets its own index.
+*
+************************************************************************/
+
+#ifndef __DMARING_H__
+#define __DMARING_H__
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "spscq.h"
+#include "recfile.h"
+#include "lathist.h"
+#include "nxrec.h"
+#include "iqpack.h"
+#include "bfp.h"
+#include "recseg.h"
+#include "rgate.h"
+
+
+/* MAX_DMA_BUFS - upper bound on the number of DMA buffers in a channel
+ * ring.  The ring depth actually used is read from NUM_DMA_BUFS in
+ * NeXtRAD.ini and must not exceed this value.
+ */
+#define MAX_DMA_BUFS          64
+
+/* the writer's queue must hold more than a ring's worth of lines, so that
+ * a line it has no room for is one the DMA engine has already refilled
+ * (see DMARING_Publish())
+ */
+#if SPSCQ_SIZE <= MAX_DMA_BUFS
+#error "SPSCQ_SIZE must exceed MAX_DMA_BUFS"
+#endif
+
+/* DMARING_MAX_CONSUMERS - number of descriptor queues per ring.  Queue 0
+ * always feeds the ring's own writer thread.
+ */
+#define DMARING_MAX_CONSUMERS  4
+
+/* latency stages histogrammed per channel (see DMARING_SetHistograms()):
+ *     LAT_IRQ_TO_WAKE   - link-end interrupt to dmaThread() wake-up
+ *     LAT_WAKE_TO_SYNC  - wake-up to DMA buffer synced for the CPU
+ *     LAT_PUB_TO_WRITER - publish to the writer thread dequeuing the line
+ *     LAT_WRITER_TO_OUT - dequeue to the line's write returning
+ *     LAT_IRQ_TO_OUT    - interrupt to the line's write returning
+ * "Write returning" is when the data has been handed to the kernel (or,
+ * for the async backend, submitted), not when it is on the disk.
+ */
+#define LAT_IRQ_TO_WAKE        0
+#define LAT_WAKE_TO_SYNC       1
+#define LAT_PUB_TO_WRITER      2
+#define LAT_WRITER_TO_OUT      3
+#define LAT_IRQ_TO_OUT         4
+#define LAT_NUM_STAGES         5
+
+
+/* DMA_RING - ring of DMA buffers for one channel
+ *     queue        = descriptor queue for each consumer
+ *
+ *   set up before the writer starts:
+ *     chanNum      = ADC channel number (for messages only)
+ *     numBufs      = number of DMA buffers in the ring
+ *     linesPerIrq  = range lines per link-end interrupt (descriptor group)
+ *     bufs         = user-space address of each DMA buffer
+ *     lineBytes    = bytes written to disk per range line, before
+ *                    packing or coding; the windows' bytes if gated
+ *     outfile      = output file, opened and closed by the caller; the
+ *                    writer flushes it every outfile->batchLines lines
+ *     numConsumers = number of queues in use
+ *     linePrefix   = write an NXREC_LINE prefix in front of each line
+ *     buildIndex   = build an NXREC_INDEX_ENTRY for each line written
+ *     pack         = compression pool lines are packed by, or NULL
+ *     bfp          = block floating point coder for the lines, or NULL
+ *     seg          = segmented output the file belongs to, or NULL
+ *     gate         = range windows kept from each line, or NULL
+ *     irqCount     = link-end interrupts counted as they complete (the
+ *                    channel's PRI_IRQ_LOG count), or NULL
+ *
+ *   owned by the acquisition thread:
+ *     published    = range lines handed off
+ *     dropped      = lines a consumer missed because its queue was full;
+ *                    never counted for queue 0, the writer's
+ *     maxDepth     = highest number of lines waiting for the writer
+ *     stop         = set by DMARING_Stop() to drain and end the writer
+ *
+ *   owned by the writer thread:
+ *     written      = range lines written to disk
+ *     nextPri      = PRI index of the next line to write
+ *     late         = lines the writer's queue had no room for, taken
+ *                    from the ring by the writer itself
+ *     overruns     = range lines whose buffer was refilled by the DMA
+ *                    engine before the writer had saved it
+ *     writeError   = set if a write to the output file failed
+ *     latMin/Max/Sum = publish-to-dequeue hand-off latency, in ns
+ *     writeNs      = time spent writing, in ns
+ *     pendingPri   = PRI index of each line in the unflushed batch
+ *     pendingDeq   = time each line in the batch was dequeued, in ns
+ *     pendingIntr  = interrupt time of each line in the batch, in ns
+ *     pendingPrefix = record prefix of each line in the batch
+ *     numPending   = lines in the unflushed batch
+ *     index        = PRI index built so far, or NULL
+ *     indexLen     = entries in index
+ *     indexSize    = entries allocated; the array grows by doubling
+ *     packDesc     = descriptor of each line in the pool, by pool slot
+ *     packDeq      = time each line in the pool was dequeued, in ns
+ *     packHeld     = packed lines in the unflushed batch; their pool
+ *                    slots are released when the batch is written
+ *     bfpBuf       = coded line for each place in the batch
+ *     gateBuf      = gathered windows for each place in the batch, or
+ *                    each pool slot when packing; NULL unless there is
+ *                    more than one window
+ *     packOverrun  = overrun check made when each line in the pool was
+ *                    gathered, or -1 if it is packed from the DMA buffer
+ *     segFirstPri  = first PRI of the segment being written
+ *     segEndPri    = first PRI of the next segment
+ *     indexFailed  = the index of an earlier segment was incomplete or
+ *                    could not be written
+ *     hist         = LAT_NUM_STAGES latency histograms, or NULL
+ *     writer       = writer thread
+ */
+typedef struct DMA_RING
+        {
+            SPSC_QUEUE          queue[DMARING_MAX_CONSUMERS];
+
+            int                 chanNum;
+            unsigned int        numBufs;
+            unsigned int        linesPerIrq;
+            void               *bufs[MAX_DMA_BUFS];
+            unsigned int        lineBytes;
+            REC_FILE           *outfile;
+            unsigned int        numConsumers;
+            int                 linePrefix;
+            int                 buildIndex;
+            IQPACK_POOL        *pack;
+            BFP_CODER          *bfp;
+            REC_SEG            *seg;
+            RANGE_GATE         *gate;
+            const unsigned long *irqCount;
+
+            unsigned long       published __attribute__((aligned(SPSCQ_CACHE_LINE)));
+            unsigned long       dropped[DMARING_MAX_CONSUMERS];
+            unsigned long       maxDepth;
+            int                 stop;
+
+            unsigned long       written __attribute__((aligned(SPSCQ_CACHE_LINE)));
+            unsigned long long  nextPri;
+            unsigned long       late;
+            unsigned long       overruns;
+            int                 writeError;
+            unsigned long long  latMin;
+            unsigned long long  latMax;
+            unsigned long long  latSum;
+            unsigned long long  writeNs;
+            unsigned long long  pendingPri[REC_FILE_MAX_BATCH];
+            unsigned long long  pendingDeq[REC_FILE_MAX_BATCH];
+            unsigned long long  pendingIntr[REC_FILE_MAX_BATCH];
+            NXREC_LINE          pendingPrefix[REC_FILE_MAX_BATCH];
+            unsigned int        numPending;
+            NXREC_INDEX_ENTRY  *index;
+            unsigned long long  indexLen;
+            unsigned long long  indexSize;
+            RANGE_LINE_DESC     packDesc[IQPACK_MAX_SLOTS];
+            unsigned long long  packDeq[IQPACK_MAX_SLOTS];
+            unsigned int        packHeld;
+            unsigned char      *bfpBuf;
+            int16_t            *gateBuf;
+            int                 packOverrun[IQPACK_MAX_SLOTS];
+            unsigned long long  segFirstPri;
+            unsigned long long  segEndPri;
+            int                 indexFailed;
+            LAT_HIST           *hist;
+            pthread_t           writer;
+        } DMA_RING;
+
+
+/* function prototypes */
+int         DMARING_Init        (DMA_RING     *ring,
+                                 int           chanNum,
+                                 unsigned int  numBufs,
+                                 unsigned int  linesPerIrq,
+                                 void        **bufs,
+                                 unsigned int  lineBytes,
+                                 REC_FILE     *outfile);
+SPSC_QUEUE *DMARING_AddConsumer (DMA_RING     *ring);
+int         DMARING_Refilled    (DMA_RING     *ring,
+                                 unsigned long long pri);
+void        DMARING_SetHistograms (DMA_RING   *ring,
+                                 LAT_HIST     *hist);
+void        DMARING_SetIrqCount (DMA_RING     *ring,
+                                 const unsigned long *irqCount);
+void        DMARING_SetLinePrefix (DMA_RING   *ring,
+                                 int           enable);
+int         DMARING_SetIndex    (DMA_RING     *ring,
+                                 int           enable,
+                                 unsigned long long expectedLines);
+int         DMARING_SetPack     (DMA_RING     *ring,
+                                 IQPACK_POOL  *pool);
+int         DMARING_SetBfp      (DMA_RING     *ring,
+                                 BFP_CODER    *coder);
+int         DMARING_SetGate     (DMA_RING     *ring,
+                                 RANGE_GATE   *gate);
+int         DMARING_SetSegments (DMA_RING     *ring,
+                                 REC_SEG      *seg);
+int         DMARING_Start       (DMA_RING     *ring);
+void        DMARING_Free        (DMA_RING     *ring);
+void        DMARING_Publish     (DMA_RING     *ring,
+                                 unsigned int  bufIndex,
+                                 unsigned long long intrTime,
+                                 unsigned int  adcFlags);
+void        DMARING_PublishGroup (DMA_RING    *ring,
+                                 unsigned int  firstBuf,
+                                 unsigned int  count,
+                                 unsigned long long intrTime,
+                                 unsigned int  adcFlags);
+int         DMARING_Stop        (DMA_RING     *ring);
+int         DMARING_WriteIndex  (DMA_RING     *ring);
+void        DMARING_Report      (DMA_RING     *ring);
+
+unsigned long long DMARING_TimeNs (void);
+
+#endif /* __DMARING_H__ */
@@ -0,0 +1,494 @@
+/**************************************************************************
+*
+*   File: dmaringtest.c
+*
+*   Description: Check of the acquisition path (dmaring.c, pristats.c)
+*                against a software stand-in for the DMA descriptor
+*                engine and its link-end interrupt, away from the radar.
+*
+*                The stand-in is a thread that fills a ring of
+*                MAX_DMA_BUFS buffers one range line per PRI (-p), each
+*                line holding its own PRI number in every word, and
+*                stamps the interrupt log and posts a semaphore once per
+*                group of K lines, as dmaIntHandler() does.  The
+*                stamps are the nominal pulse times, so the counts below
+*                do not depend on how this machine schedules.  Three
+*                triggers are dropped, at a quarter, half and three
+*                quarters of the run; each leaves no line and raises a
+*                bad trigger flag.  The main thread stands in for
+*                dmaThread(): it waits on the semaphore, accounts each
+*                group with PRISTATS_Line() and hands it to the writer
+*                with DMARING_PublishGroup(), which writes an nxrec
+*                style file (line prefix and index) with the pwritev
+*                backend.
+*
+*                For K = 1, 2, 4 and 8 there must be one gap and one
+*                missed pulse per dropped trigger, no late lines and no
+*                overruns, and the file must hold every line, in order,
+*                intact.
+*
+*                A last run with K = 4 and no dropped triggers starts
+*                the writer only once -S lines have been published, as
+*                if it had stalled on the disk.  Its queue fills, so the
+*                writer must take the lines it missed from the ring
+*                (DMARING_CatchUp()): the file must still hold every
+*                line in order, there must be late lines and overruns,
+*                and any line whose data is not its own must be marked
+*                as overrun in the index.
+*
+*                Usage:
+*                    dmaringtest [options]
+*                    -n lines   range lines per run, a multiple of 8 (4096)
+*                    -p us      PRI in us (100)
+*                    -s samples samples per range line (1024)
+*                    -S lines   lines published before the stalled
+*                               writer starts (512)
+*                    -f file    output file (dmaringtest.dat), removed
+*                               after the runs
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "dmaring.h"
+#include "pristats.h"
+#include "recfile.h"
+#include "nxrec.h"
+
+
+/* DMARINGTEST_DROPS - triggers dropped per run */
+#define DMARINGTEST_DROPS    3
+
+/* DMARINGTEST_BATCH - lines per pwritev batch, as WRITE_BATCH */
+#define DMARINGTEST_BATCH    16
+
+/* DMARINGTEST_BAD_TRIG - ADC flag the stand-in raises for a dropped
+ * trigger
+ */
+#define DMARINGTEST_BAD_TRIG 0x1U
+
+
+/* DMA_STANDIN - the stand-in descriptor engine and interrupt
+ *     bufs        = the DMA ring, MAX_DMA_BUFS range lines
+ *     lineWords   = 32-bit words per range line
+ *     linesPerIrq = lines per descriptor group, K
+ *     lines       = lines to capture
+ *     priNs       = PRI, in ns
+ *     start       = time of pulse 0, in ns
+ *     drop        = pulse numbers whose trigger is dropped, in order
+ *     numDrops    = entries in drop
+ *     adcFlags    = ADC flags raised since the last group was serviced
+ *     log         = link-end interrupt times, as irqLog[]
+ *     irq         = posted once per interrupt, as the ifc semaphore
+ */
+typedef struct DMA_STANDIN
+        {
+            void               *bufs[MAX_DMA_BUFS];
+            unsigned int        lineWords;
+            unsigned int        linesPerIrq;
+            unsigned long       lines;
+            unsigned long long  priNs;
+            unsigned long long  start;
+            unsigned long long  drop[DMARINGTEST_DROPS];
+            unsigned int        numDrops;
+            unsigned int        adcFlags;
+            PRI_IRQ_LOG         log;
+            sem_t               irq;
+        } DMA_STANDIN;
+
+
+static int   DMARINGTEST_Run    (DMA_STANDIN *sim, unsigned int linesPerIrq,
+                                 int dropTriggers, unsigned long stallLines,
+                                 const char *fileName);
+static void *DMARINGTEST_Engine (void *pParams);
+static int   DMARINGTEST_Check  (DMA_RING *ring, DMA_STANDIN *sim,
+                                 const char *fileName,
+                                 unsigned long *torn);
+static void  DMARINGTEST_Usage  (void);
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Sets up the stand-in from the command line, makes the runs
+              and prints PASS or FAIL.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - every run came out as expected
+              1 - bad command line, set up failed, or a run did not
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    static DMA_STANDIN  sim;
+    static const unsigned int groupSizes[] = {1, 2, 4, 8};
+    const char         *fileName   = "dmaringtest.dat";
+    unsigned long       lines      = 4096;
+    unsigned long       stallLines = 512;
+    unsigned int        priUs      = 100;
+    unsigned int        samples    = 1024;
+    unsigned int        i;
+    int                 failed     = 0;
+    int                 a;
+
+    for (a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "-n") == 0) && (a + 1 < argc))
+            lines = strtoul(argv[++a], NULL, 10);
+        else if ((strcmp(argv[a], "-p") == 0) && (a + 1 < argc))
+            priUs = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-s") == 0) && (a + 1 < argc))
+            samples = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-S") == 0) && (a + 1 < argc))
+            stallLines = strtoul(argv[++a], NULL, 10);
+        else if ((strcmp(argv[a], "-f") == 0) && (a + 1 < argc))
+            fileName = argv[++a];
+        else
+        {
+            DMARINGTEST_Usage();
+            return (1);
+        }
+    }
+
+    /* each dropped trigger must fall in its own group, after the first;
+     * the stalled writer must be more than a queue and a ring behind
+     */
+    if ((lines < 32) || ((lines % 8) != 0) || (priUs == 0) ||
+        (samples == 0) || (stallLines < SPSCQ_SIZE + MAX_DMA_BUFS) ||
+        (stallLines >= lines))
+    {
+        DMARINGTEST_Usage();
+        return (1);
+    }
+
+    sim.lineWords = samples;
+    sim.lines     = lines;
+    sim.priNs     = (unsigned long long)priUs * 1000ULL;
+    for (i = 0; i < MAX_DMA_BUFS; i++)
+    {
+        sim.bufs[i] = malloc(samples * 4);
+        if (sim.bufs[i] == NULL)
+        {
+            printf("ERROR: no memory for the DMA ring.\n");
+            return (1);
+        }
+        memset (sim.bufs[i], 0xff, samples * 4);
+    }
+    if (sem_init(&sim.irq, 0, 0) != 0)
+    {
+        printf("ERROR: interrupt semaphore not set up.\n");
+        return (1);
+    }
+
+    printf("%d DMA buffers, %u-sample lines, PRI %u us, %lu lines per "
+           "run\n\n", MAX_DMA_BUFS, samples, priUs, lines);
+    printf("%-8s %2s %6s %6s %5s %7s %9s %6s %9s %6s %s\n", "run", "K",
+           "lines", "irqs", "gaps", "missed", "bad trig", "late",
+           "overruns", "torn", "file");
+
+    for (i = 0; i < sizeof(groupSizes) / sizeof(groupSizes[0]); i++)
+        failed |= DMARINGTEST_Run(&sim, groupSizes[i], 1, 0, fileName);
+    failed |= DMARINGTEST_Run(&sim, 4, 0, stallLines, fileName);
+
+    unlink(fileName);
+    sem_destroy(&sim.irq);
+    for (i = 0; i < MAX_DMA_BUFS; i++)
+        free(sim.bufs[i]);
+
+    printf("%s\n", failed ? "FAIL" : "PASS");
+
+    return (failed ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    DMARINGTEST_Run()
+
+ Description: Captures sim->lines lines through the stand-in and the ring
+              into a file, as dmaThread() does, then checks the counts and
+              the file and prints a row.
+
+ Parameters:  sim          - the stand-in
+              linesPerIrq  - lines per descriptor group, K
+              dropTriggers - 1 to drop DMARINGTEST_DROPS triggers
+              stallLines   - lines published before the writer is
+                             started, or 0 to start it first
+              fileName     - output file
+
+ Return:      0 - the run came out as expected
+              1 - it did not, or could not be set up
+**************************************************************************/
+static int DMARINGTEST_Run (DMA_STANDIN *sim, unsigned int linesPerIrq,
+                            int dropTriggers, unsigned long stallLines,
+                            const char *fileName)
+{
+    static DMA_RING     ring;
+    REC_FILE            outfile;
+    PRI_STATS           stats;
+    pthread_t           engine;
+    unsigned long long  serviceTime;
+    unsigned long long  intrTime;
+    unsigned long       backlog;
+    unsigned long       groups = sim->lines / linesPerIrq;
+    unsigned long       expect = dropTriggers ? DMARINGTEST_DROPS : 0;
+    unsigned long       torn   = 0;
+    unsigned long       g;
+    unsigned int        bufIndex = 0;
+    unsigned int        adcFlags;
+    unsigned int        i;
+    int                 started  = 0;
+    int                 fileBad;
+    int                 failed;
+
+    sim->linesPerIrq = linesPerIrq;
+    sim->numDrops    = 0;
+    sim->adcFlags    = 0;
+    memset (&sim->log, 0, sizeof(PRI_IRQ_LOG));
+    for (i = 0; i < expect; i++)
+        sim->drop[sim->numDrops++] = (sim->lines * (i + 1)) / 4;
+
+    if (RECFILE_Open(&outfile, fileName, REC_FILE_PWRITEV, DMARINGTEST_BATCH,
+                     0, 0) != 0)
+    {
+        printf("ERROR: %s could not be created.\n", fileName);
+        return (1);
+    }
+    if ((DMARING_Init(&ring, 0, MAX_DMA_BUFS, linesPerIrq, sim->bufs,
+                      sim->lineWords * 4, &outfile) != 0) ||
+        (DMARING_SetIndex(&ring, 1, sim->lines) != 0))
+    {
+        printf("ERROR: ring of %u line groups not set up.\n", linesPerIrq);
+        RECFILE_Close(&outfile);
+        return (1);
+    }
+    DMARING_SetIrqCount(&ring, &sim->log.count);
+    DMARING_SetLinePrefix(&ring, 1);
+    PRISTATS_Init(&stats, sim->priNs, DMARINGTEST_BAD_TRIG, 0, linesPerIrq);
+
+    if ((stallLines == 0) && (DMARING_Start(&ring) != 0))
+    {
+        printf("ERROR: writer thread could not be started.\n");
+        DMARING_Free(&ring);
+        RECFILE_Close(&outfile);
+        return (1);
+    }
+    started = (stallLines == 0);
+
+    sim->start = DMARING_TimeNs() + 1000000ULL;
+    if (pthread_create(&engine, NULL, DMARINGTEST_Engine, sim) != 0)
+    {
+        printf("ERROR: stand-in thread could not be started.\n");
+        if (started)
+            DMARING_Stop(&ring);
+        DMARING_Free(&ring);
+        RECFILE_Close(&outfile);
+        return (1);
+    }
+
+    for (g = 0; g < groups; g++)
+    {
+        while (sem_wait(&sim->irq) != 0)
+            ;
+
+        serviceTime = DMARING_TimeNs();
+        intrTime    = PRISTATS_IrqTime(&sim->log, g, &backlog);
+        adcFlags    = __atomic_exchange_n(&sim->adcFlags, 0, __ATOMIC_ACQ_REL);
+        PRISTATS_Line(&stats, intrTime, serviceTime, backlog, adcFlags,
+                      linesPerIrq);
+        DMARING_PublishGroup(&ring, bufIndex, linesPerIrq, intrTime, adcFlags);
+        bufIndex = (bufIndex + linesPerIrq) % MAX_DMA_BUFS;
+
+        if ((!started) && (ring.published >= stallLines))
+        {
+            if (DMARING_Start(&ring) != 0)
+            {
+                printf("ERROR: writer thread could not be started.\n");
+                break;
+            }
+            started = 1;
+        }
+    }
+    pthread_join(engine, NULL);
+
+    failed = !started || (DMARING_Stop(&ring) != 0);
+    fileBad = failed || DMARINGTEST_Check(&ring, sim, fileName, &torn);
+    DMARING_WriteIndex(&ring);
+    failed |= (RECFILE_Close(&outfile) != 0);
+
+    /* every line is written, in order; the counts are exact because the
+     * interrupt times are the nominal ones
+     */
+    failed |= fileBad || (ring.published != sim->lines) ||
+              (ring.written != sim->lines) || (stats.lines != sim->lines) ||
+              (stats.irqs != groups) || (stats.gaps != expect) ||
+              (stats.missed != expect) || (stats.badTrigs != expect);
+    if (stallLines == 0)
+        failed |= (ring.late != 0) || (ring.overruns != 0) || (torn != 0);
+    else
+        failed |= (ring.late == 0) || (ring.overruns == 0);
+
+    printf("%-8s %2u %6lu %6lu %5lu %7lu %9lu %6lu %9lu %6lu %s%s\n",
+           (stallLines == 0) ? "paced" : "stalled", linesPerIrq, ring.written,
+           stats.irqs, stats.gaps, stats.missed, stats.badTrigs, ring.late,
+           ring.overruns, torn, fileBad ? "bad" : "ok",
+           failed ? "  FAIL" : "");
+
+    return (failed);
+}
+
+
+/**************************************************************************
+ Function:    DMARINGTEST_Engine()
+
+ Description: Stand-in thread.  At each pulse whose trigger is not
+              dropped, fills the next DMA buffer with the line's PRI
+              number; at the end of each group, stamps the interrupt log
+              with the pulse time and posts the interrupt semaphore.
+
+ Parameters:  pParams - pointer to the DMA_STANDIN
+
+ Return:      NULL
+**************************************************************************/
+static void *DMARINGTEST_Engine (void *pParams)
+{
+    DMA_STANDIN        *sim   = (DMA_STANDIN *)pParams;
+    struct timespec     ts;
+    unsigned long long  pulse = 0;
+    unsigned long long  t;
+    unsigned long       n;
+    uint32_t           *line;
+    unsigned int        d     = 0;
+    unsigned int        w;
+
+    for (n = 0; n < sim->lines; n++)
+    {
+        while ((d < sim->numDrops) && (sim->drop[d] == pulse))
+        {
+            __atomic_or_fetch(&sim->adcFlags, DMARINGTEST_BAD_TRIG,
+                              __ATOMIC_RELEASE);
+            pulse++;
+            d++;
+        }
+
+        t = sim->start + pulse * sim->priNs;
+        ts.tv_sec  = (time_t)(t / 1000000000ULL);
+        ts.tv_nsec = (long)(t % 1000000000ULL);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+                               NULL) == EINTR)
+            ;
+
+        line = (uint32_t *)sim->bufs[n % MAX_DMA_BUFS];
+        for (w = 0; w < sim->lineWords; w++)
+            line[w] = (uint32_t)n;
+
+        if (((n + 1) % sim->linesPerIrq) == 0)
+        {
+            PRISTATS_IrqStamp(&sim->log, t);
+            sem_post(&sim->irq);
+        }
+        pulse++;
+    }
+
+    return (NULL);
+}
+
+
+/**************************************************************************
+ Function:    DMARINGTEST_Check()
+
+ Description: Reads back the records of a stopped ring's file and its
+              index.  Each record must carry the sync word and its own
+              PRI number, in order.  A line whose data is not its own
+              PRI number is torn; it must be marked as overrun in the
+              index.
+
+ Parameters:  ring     - pointer to the stopped ring, index not yet
+                         written
+              sim      - the stand-in
+              fileName - the ring's output file
+              torn     - receives the number of torn lines
+
+ Return:      0 - the file is as expected
+              1 - a record is missing, out of order, or torn without
+                  being marked, or the file could not be read
+**************************************************************************/
+static int DMARINGTEST_Check (DMA_RING *ring, DMA_STANDIN *sim,
+                              const char *fileName, unsigned long *torn)
+{
+    size_t          recBytes = sizeof(NXREC_LINE) + ring->lineBytes;
+    unsigned char  *rec;
+    NXREC_LINE     *prefix;
+    uint32_t       *line;
+    unsigned long   n;
+    unsigned int    w;
+    int             fd;
+    int             bad = 0;
+
+    *torn = 0;
+    if ((ring->index == NULL) || (ring->indexLen != sim->lines))
+        return (1);
+
+    fd  = open(fileName, O_RDONLY);
+    rec = (unsigned char *)malloc(recBytes);
+    if ((fd < 0) || (rec == NULL))
+    {
+        if (fd >= 0)
+            close(fd);
+        free(rec);
+        return (1);
+    }
+    prefix = (NXREC_LINE *)rec;
+    line   = (uint32_t *)(rec + sizeof(NXREC_LINE));
+
+    for (n = 0; (n < sim->lines) && !bad; n++)
+    {
+        if ((pread(fd, rec, recBytes, (off_t)(n * recBytes)) !=
+             (ssize_t)recBytes) ||
+            (prefix->sync != NXREC_LINE_SYNC) || (prefix->priIndex != n) ||
+            (ring->index[n].priIndex != n))
+        {
+            bad = 1;
+            break;
+        }
+
+        for (w = 0; w < sim->lineWords; w++)
+            if (line[w] != (uint32_t)n)
+                break;
+        if (w < sim->lineWords)
+        {
+            (*torn)++;
+            if (!(ring->index[n].status & NXREC_IDX_OVERRUN))
+                bad = 1;
+        }
+    }
+
+    close(fd);
+    free(rec);
+
+    return (bad);
+}
+
+
+/**************************************************************************
+ Function:    DMARINGTEST_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void DMARINGTEST_Usage (void)
+{
+    printf("usage: dmaringtest [-n lines] [-p us] [-s samples] [-S lines] "
+           "[-f file]\n");
+}
@@ -0,0 +1,639 @@
+/**************************************************************************
+*
+*   File: fft.c
+*
+*   Description: Complex single precision FFTs.  See fft.h.
+*
+*                Iterative decimation in time: the input is put in
+*                bit-reversed order and then passes of butterflies combine
+*                transforms of size 2, 4, ... n.  Each pass does two
+*                radix-2 stages at once (radix 2^2): four points are
+*                loaded, put through both stages and stored, so the data
+*                is swept log2(n)/2 times instead of log2(n), and the
+*                second stage's odd twiddle is the first's times -j,
+*                which costs no multiply.  When log2(n) is odd a plain
+*                radix-2 stage, with no twiddles, goes first.
+*
+*                The twiddle factors are made in double precision, in the
+*                order the passes read them: for the pass combining
+*                stages of half size h and 2h, the h factors
+*                e^(-j2pi k/2h) and then the h factors e^(-j2pi k/4h),
+*                k = 0 ... h - 1.  Every pass reads its factors
+*                straight through.
+*
+*                The AVX2 kernels do four butterflies at a time, in
+*                passes with h of 4 or more.  The size-specific kernels
+*                are the same code with n a constant, so the compiler
+*                can unroll and drop the loop arithmetic for that size;
+*                they are only C's nearest thing to a template.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define FFT_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#include "fft.h"
+
+
+static void FFT_Scalar (const FFT_PLAN *plan, float *x, int inverse);
+
+#ifdef FFT_HAVE_AVX2
+static void FFT_Avx2     (const FFT_PLAN *plan, float *x, int inverse);
+static void FFT_Avx2_256 (const FFT_PLAN *plan, float *x, int inverse);
+static void FFT_Avx2_4096 (const FFT_PLAN *plan, float *x, int inverse);
+static void FFT_Avx2_8192 (const FFT_PLAN *plan, float *x, int inverse);
+#endif
+
+
+/**************************************************************************
+ Function:    FFT_Init()
+
+ Description: Makes the tables for a transform size and picks its kernel.
+
+ Parameters:  plan - pointer to the FFT_PLAN to set up
+              n    - transform size, a power of two from FFT_MIN_SIZE to
+                     FFT_MAX_SIZE
+
+ Return:      0 - success
+              1 - n is not a supported size
+              2 - allocation failed
+**************************************************************************/
+int FFT_Init (FFT_PLAN *plan, unsigned int n)
+{
+    float        *twiddle;
+    unsigned int *bitrev;
+    int           status;
+
+    memset (plan, 0, sizeof(FFT_PLAN));
+
+    if ((n < FFT_MIN_SIZE) || (n > FFT_MAX_SIZE) || ((n & (n - 1)) != 0))
+        return (1);
+
+    twiddle = (float *)malloc(FFT_TWIDDLE_FLOATS(n) * sizeof(float));
+    bitrev  = (unsigned int *)malloc(n * sizeof(unsigned int));
+    if ((twiddle == NULL) || (bitrev == NULL))
+    {
+        free(twiddle);
+        free(bitrev);
+        return (2);
+    }
+
+    FFT_MakeTables(n, twiddle, bitrev);
+    status = FFT_InitShared(plan, n, twiddle, bitrev);
+    plan->shared = 0;
+
+    return (status);
+}
+
+
+/**************************************************************************
+ Function:    FFT_MakeTables()
+
+ Description: Makes the twiddle factors and bit-reversal permutation for a
+              transform size, into the caller's memory.
+
+ Parameters:  n       - transform size, a power of two from FFT_MIN_SIZE
+                        to FFT_MAX_SIZE
+              twiddle - FFT_TWIDDLE_FLOATS(n) floats
+              bitrev  - n indices
+
+ Return:      0 - success
+              1 - n is not a supported size
+**************************************************************************/
+int FFT_MakeTables (unsigned int n, float *twiddle, unsigned int *bitrev)
+{
+    unsigned int  log2n = 0;
+    unsigned int  i;
+    unsigned int  b;
+    unsigned int  r;
+    unsigned int  h;
+    unsigned int  k;
+    float        *tw;
+    double        a;
+
+    if ((n < FFT_MIN_SIZE) || (n > FFT_MAX_SIZE) || ((n & (n - 1)) != 0))
+        return (1);
+
+    while ((1U << log2n) < n)
+        log2n++;
+
+    /* the passes' factors total 2 (1 + 4 + 16 ...) or 2 (2 + 8 + 32 ...)
+     * complex, under n; the rest of the table is left zero
+     */
+    memset (twiddle, 0, FFT_TWIDDLE_FLOATS(n) * sizeof(float));
+    tw = twiddle;
+    for (h = ((log2n & 1) ? 2 : 1); h < n; h *= 4)
+    {
+        for (k = 0; k < h; k++)
+        {
+            a = (-2.0 * M_PI * k) / (2 * h);
+            tw[2*k]     = (float)cos(a);
+            tw[2*k + 1] = (float)sin(a);
+        }
+        tw += 2 * h;
+        for (k = 0; k < h; k++)
+        {
+            a = (-2.0 * M_PI * k) / (4 * h);
+            tw[2*k]     = (float)cos(a);
+            tw[2*k + 1] = (float)sin(a);
+        }
+        tw += 2 * h;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        r = 0;
+        for (b = 0; b < log2n; b++)
+            r |= ((i >> b) & 1) << (log2n - 1 - b);
+        bitrev[i] = r;
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    FFT_InitShared()
+
+ Description: Sets up a plan on tables from FFT_MakeTables() held
+              elsewhere, and picks its kernel.  The tables must outlive
+              the plan; FFT_Free() does not free them.
+
+ Parameters:  plan    - pointer to the FFT_PLAN to set up
+              n       - transform size the tables were made for
+              twiddle - FFT_TWIDDLE_FLOATS(n) floats
+              bitrev  - n indices
+
+ Return:      0 - success
+              1 - n is not a supported size
+**************************************************************************/
+int FFT_InitShared (FFT_PLAN           *plan,
+                    unsigned int        n,
+                    const float        *twiddle,
+                    const unsigned int *bitrev)
+{
+    memset (plan, 0, sizeof(FFT_PLAN));
+
+    if ((n < FFT_MIN_SIZE) || (n > FFT_MAX_SIZE) || ((n & (n - 1)) != 0))
+        return (1);
+
+    plan->n          = n;
+    plan->twiddle    = twiddle;
+    plan->bitrev     = bitrev;
+    plan->shared     = 1;
+    plan->kernel     = FFT_Scalar;
+    plan->kernelName = "scalar";
+    while ((1U << plan->log2n) < n)
+        plan->log2n++;
+
+#ifdef FFT_HAVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        switch (n)
+        {
+            case 256:
+                plan->kernel     = FFT_Avx2_256;
+                plan->kernelName = "avx2-256";
+                break;
+            case 4096:
+                plan->kernel     = FFT_Avx2_4096;
+                plan->kernelName = "avx2-4096";
+                break;
+            case 8192:
+                plan->kernel     = FFT_Avx2_8192;
+                plan->kernelName = "avx2-8192";
+                break;
+            default:
+                plan->kernel     = FFT_Avx2;
+                plan->kernelName = "avx2";
+                break;
+        }
+    }
+#endif
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    FFT_UseGeneral()
+
+ Description: Switches a plan from the kernel FFT_Init() picked to the
+              general one, for comparison with it (fftbench): the
+              general AVX2 kernel if simd is set and the CPU has AVX2,
+              else plain C.
+
+ Parameters:  plan - pointer to a plan
+              simd - 0 for plain C
+
+ Return:      none
+**************************************************************************/
+void FFT_UseGeneral (FFT_PLAN *plan, int simd)
+{
+    plan->kernel     = FFT_Scalar;
+    plan->kernelName = "scalar";
+
+#ifdef FFT_HAVE_AVX2
+    if (simd && __builtin_cpu_supports("avx2"))
+    {
+        plan->kernel     = FFT_Avx2;
+        plan->kernelName = "avx2";
+    }
+#else
+    (void)simd;
+#endif
+}
+
+
+/**************************************************************************
+ Function:    FFT_Forward()
+
+ Description: Forward transform, in place.
+
+ Parameters:  plan - plan for the size
+              x    - plan->n complex points, re, im interleaved
+
+ Return:      none
+**************************************************************************/
+void FFT_Forward (const FFT_PLAN *plan, float *x)
+{
+    plan->kernel(plan, x, 0);
+}
+
+
+/**************************************************************************
+ Function:    FFT_Inverse()
+
+ Description: Inverse transform, in place, without the 1/n scaling.
+
+ Parameters:  plan - plan for the size
+              x    - plan->n complex points, re, im interleaved
+
+ Return:      none
+**************************************************************************/
+void FFT_Inverse (const FFT_PLAN *plan, float *x)
+{
+    plan->kernel(plan, x, 1);
+}
+
+
+/**************************************************************************
+ Function:    FFT_Free()
+
+ Description: Frees a plan's tables, unless they are shared.  Safe on a
+              plan that failed to initialise.
+
+ Parameters:  plan - pointer to the plan
+
+ Return:      none
+**************************************************************************/
+void FFT_Free (FFT_PLAN *plan)
+{
+    if (!plan->shared)
+    {
+        free((void *)plan->twiddle);
+        free((void *)plan->bitrev);
+    }
+    plan->twiddle = NULL;
+    plan->bitrev  = NULL;
+    plan->n       = 0;
+}
+
+
+/**************************************************************************
+ Function:    FFT_NextSize()
+
+ Description: Returns the smallest power of two at least n, and at least
+              FFT_MIN_SIZE.
+
+ Parameters:  n - points to hold
+
+ Return:      transform size, or 0 if n is more than FFT_MAX_SIZE
+**************************************************************************/
+unsigned int FFT_NextSize (unsigned int n)
+{
+    unsigned int size = FFT_MIN_SIZE;
+
+    if (n > FFT_MAX_SIZE)
+        return (0);
+    while (size < n)
+        size <<= 1;
+
+    return (size);
+}
+
+
+/**************************************************************************
+ Function:    FFT_BitReverse()
+
+ Description: Puts the points in bit-reversed order.
+
+ Parameters:  plan - plan for the size
+              x    - the points
+              n    - transform size
+
+ Return:      none
+**************************************************************************/
+static inline void FFT_BitReverse (const FFT_PLAN *plan, float *x,
+                                   unsigned int n)
+{
+    unsigned int i;
+    unsigned int j;
+    float        t;
+
+    for (i = 0; i < n; i++)
+    {
+        j = plan->bitrev[i];
+        if (j > i)
+        {
+            t = x[2*i];     x[2*i]     = x[2*j];     x[2*j]     = t;
+            t = x[2*i + 1]; x[2*i + 1] = x[2*j + 1]; x[2*j + 1] = t;
+        }
+    }
+}
+
+
+/**************************************************************************
+ Function:    FFT_ScalarPass()
+
+ Description: One radix 2^2 pass in plain C, combining the stages of half
+              size h and 2h.  Each butterfly takes points a, b, c, d at
+              k, k + h, k + 2h, k + 3h of a 4h group:
+                  b *= w1, d *= w1;  a, b = a + b, a - b;  c, d = c + d, c - d
+                  c *= w2, d *= w2 (-j);  a, c = a + c, a - c;  b, d = b + d, b - d
+              with w1 = e^(-j2pi k/2h) and w2 = e^(-j2pi k/4h), all
+              conjugated for the inverse.
+
+ Parameters:  x       - the points
+              n       - transform size
+              h       - half size of the first stage
+              tw      - the pass's twiddle factors
+              inverse - 1 for the inverse transform
+
+ Return:      none
+**************************************************************************/
+static inline void FFT_ScalarPass (float *x, unsigned int n, unsigned int h,
+                                   const float *tw, int inverse)
+{
+    const float  *tw2  = tw + (2 * h);
+    float         sign = inverse ? -1.0f : 1.0f;
+    unsigned int  i;
+    unsigned int  k;
+    float        *a;
+    float        *b;
+    float        *c;
+    float        *d;
+    float         w1r, w1i, w2r, w2i;
+    float         br, bi, dr, di, cr, ci, tr, ti;
+    float         ar, ai;
+
+    for (i = 0; i < n; i += 4 * h)
+    {
+        for (k = 0; k < h; k++)
+        {
+            w1r = tw[2*k];
+            w1i = sign * tw[2*k + 1];
+            w2r = tw2[2*k];
+            w2i = sign * tw2[2*k + 1];
+            a = &x[2*(i + k)];
+            b = a + (2 * h);
+            c = a + (4 * h);
+            d = a + (6 * h);
+
+            /* stage of half size h */
+            br = (b[0] * w1r) - (b[1] * w1i);
+            bi = (b[0] * w1i) + (b[1] * w1r);
+            dr = (d[0] * w1r) - (d[1] * w1i);
+            di = (d[0] * w1i) + (d[1] * w1r);
+            ar = a[0] + br;  ai = a[1] + bi;
+            br = a[0] - br;  bi = a[1] - bi;
+            cr = c[0] + dr;  ci = c[1] + di;
+            dr = c[0] - dr;  di = c[1] - di;
+
+            /* stage of half size 2h; d's factor is w2 times -j (+j for
+             * the inverse)
+             */
+            tr = (cr * w2r) - (ci * w2i);
+            ti = (cr * w2i) + (ci * w2r);
+            cr = tr;
+            ci = ti;
+            tr = (dr * w2r) - (di * w2i);
+            ti = (dr * w2i) + (di * w2r);
+            dr = sign * ti;
+            di = -sign * tr;
+
+            a[0] = ar + cr;  a[1] = ai + ci;
+            c[0] = ar - cr;  c[1] = ai - ci;
+            b[0] = br + dr;  b[1] = bi + di;
+            d[0] = br - dr;  d[1] = bi - di;
+        }
+    }
+}
+
+
+/**************************************************************************
+ Function:    FFT_Radix2First()
+
+ Description: The plain radix-2 first stage used when log2(n) is odd;
+              its twiddle factors are all 1.
+
+ Parameters:  x - the points
+              n - transform size
+
+ Return:      none
+**************************************************************************/
+static inline void FFT_Radix2First (float *x, unsigned int n)
+{
+    unsigned int i;
+    float        tr;
+    float        ti;
+
+    for (i = 0; i < n; i += 2)
+    {
+        tr = x[2*i + 2];
+        ti = x[2*i + 3];
+        x[2*i + 2] = x[2*i]     - tr;
+        x[2*i + 3] = x[2*i + 1] - ti;
+        x[2*i]     = x[2*i]     + tr;
+        x[2*i + 1] = x[2*i + 1] + ti;
+    }
+}
+
+
+/**************************************************************************
+ Function:    FFT_Scalar()
+
+ Description: Plain C kernel, for any size.
+
+ Parameters:  plan    - plan for the size
+              x       - plan->n complex points, re, im interleaved
+              inverse - 1 for the inverse transform
+
+ Return:      none
+**************************************************************************/
+static void FFT_Scalar (const FFT_PLAN *plan, float *x, int inverse)
+{
+    unsigned int  n  = plan->n;
+    const float  *tw = plan->twiddle;
+    unsigned int  h  = 1;
+
+    FFT_BitReverse(plan, x, n);
+
+    if (plan->log2n & 1)
+    {
+        FFT_Radix2First(x, n);
+        h = 2;
+    }
+    for (; h < n; h *= 4)
+    {
+        FFT_ScalarPass(x, n, h, tw, inverse);
+        tw += 4 * h;
+    }
+}
+
+
+#ifdef FFT_HAVE_AVX2
+
+/**************************************************************************
+ AVX2 kernels.  A vector holds four complex points.  Built for AVX2
+ function by function, as in iqk.c, and only picked by FFT_Init() once it
+ has seen the CPU has it.
+**************************************************************************/
+
+#define FFT_AVX2_FN __attribute__((target("avx2")))
+
+/* complex multiply of four points by four factors, interleaved */
+FFT_AVX2_FN
+static inline __m256 FFT_Avx2Mul (__m256 x, __m256 w)
+{
+    __m256 wr = _mm256_moveldup_ps(w);
+    __m256 wi = _mm256_movehdup_ps(w);
+    __m256 xs = _mm256_permute_ps(x, _MM_SHUFFLE(2, 3, 0, 1));
+
+    return (_mm256_addsub_ps(_mm256_mul_ps(x, wr), _mm256_mul_ps(xs, wi)));
+}
+
+
+/**************************************************************************
+ Function:    FFT_Avx2Body()
+
+ Description: The AVX2 transform.  Passes with h of 4 or more are done
+              four butterflies at a time; the first pass (h of 1, or 2
+              after the radix-2 stage) is done in plain C.  Inlined into
+              each kernel, so the size-specific ones have n constant.
+
+ Parameters:  plan    - plan for the size
+              x       - n complex points, re, im interleaved
+              inverse - 1 for the inverse transform
+              n       - transform size
+              log2n   - log2(n)
+
+ Return:      none
+**************************************************************************/
+FFT_AVX2_FN
+static inline __attribute__((always_inline))
+void FFT_Avx2Body (const FFT_PLAN *plan, float *x, int inverse,
+                   unsigned int n, unsigned int log2n)
+{
+    const float  *tw   = plan->twiddle;
+    unsigned int  h    = 1;
+    unsigned int  i;
+    unsigned int  k;
+    __m256        conj;
+    __m256        negJ;
+    __m256        w1, w2;
+    __m256        a, b, c, d, t;
+    float        *p;
+
+    /* conj flips the factors' imaginary parts for the inverse; negJ
+     * turns a swapped (im, re) pair into the product with -j, or +j for
+     * the inverse
+     */
+    conj = inverse ? _mm256_setr_ps(0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f)
+                   : _mm256_setzero_ps();
+    negJ = inverse ? _mm256_setr_ps(-0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f)
+                   : _mm256_setr_ps(0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f);
+
+    FFT_BitReverse(plan, x, n);
+
+    if (log2n & 1)
+    {
+        FFT_Radix2First(x, n);
+        h = 2;
+    }
+    if (h < n)
+    {
+        FFT_ScalarPass(x, n, h, tw, inverse);
+        tw += 4 * h;
+        h  *= 4;
+    }
+
+    for (; h < n; h *= 4)
+    {
+        for (i = 0; i < n; i += 4 * h)
+        {
+            for (k = 0; k < h; k += 4)
+            {
+                w1 = _mm256_xor_ps(_mm256_loadu_ps(tw + (2 * k)), conj);
+                w2 = _mm256_xor_ps(_mm256_loadu_ps(tw + (2 * h) + (2 * k)), conj);
+                p  = &x[2*(i + k)];
+                a  = _mm256_loadu_ps(p);
+                b  = FFT_Avx2Mul(_mm256_loadu_ps(p + (2 * h)), w1);
+                c  = _mm256_loadu_ps(p + (4 * h));
+                d  = FFT_Avx2Mul(_mm256_loadu_ps(p + (6 * h)), w1);
+
+                t = a;
+                a = _mm256_add_ps(t, b);
+                b = _mm256_sub_ps(t, b);
+                t = c;
+                c = _mm256_add_ps(t, d);
+                d = _mm256_sub_ps(t, d);
+
+                c = FFT_Avx2Mul(c, w2);
+                d = FFT_Avx2Mul(d, w2);
+                d = _mm256_xor_ps(_mm256_permute_ps(d, _MM_SHUFFLE(2, 3, 0, 1)), negJ);
+
+                _mm256_storeu_ps(p,           _mm256_add_ps(a, c));
+                _mm256_storeu_ps(p + (4 * h), _mm256_sub_ps(a, c));
+                _mm256_storeu_ps(p + (2 * h), _mm256_add_ps(b, d));
+                _mm256_storeu_ps(p + (6 * h), _mm256_sub_ps(b, d));
+            }
+        }
+        tw += 4 * h;
+    }
+}
+
+
+FFT_AVX2_FN
+static void FFT_Avx2 (const FFT_PLAN *plan, float *x, int inverse)
+{
+    FFT_Avx2Body(plan, x, inverse, plan->n, plan->log2n);
+}
+
+FFT_AVX2_FN
+static void FFT_Avx2_256 (const FFT_PLAN *plan, float *x, int inverse)
+{
+    FFT_Avx2Body(plan, x, inverse, 256, 8);
+}
+
+FFT_AVX2_FN
+static void FFT_Avx2_4096 (const FFT_PLAN *plan, float *x, int inverse)
+{
+    FFT_Avx2Body(plan, x, inverse, 4096, 12);
+}
+
+FFT_AVX2_FN
+static void FFT_Avx2_8192 (const FFT_PLAN *plan, float *x, int inverse)
+{
+    FFT_Avx2Body(plan, x, inverse, 8192, 13);
+}
+
+#endif /* FFT_HAVE_AVX2 */
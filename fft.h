@@ -0,0 +1,102 @@
+/***********************************************************************
+*
+*   File: fft.h
+*
+*   Description: header file for fft.c, complex single precision FFTs for
+*                the in-process signal processing stages (pcomp.c).
+*
+*                Data are interleaved re, im float pairs, transformed in
+*                place.  Sizes are powers of two.  A plan holds the
+*                twiddle factors and the bit-reversal permutation for one
+*                size; it is read-only once made, so any number of
+*                threads can transform with the same plan at once.
+*
+*                The forward transform is X[k] = sum x[n] e^(-j2pi nk/N);
+*                the inverse uses e^(+j2pi nk/N) and is not scaled by 1/N,
+*                which callers fold into whatever they multiply by.
+*
+*                FFT_Init() picks the kernel for the size and the CPU.  On
+*                CPUs with AVX2 the sizes the experiments use get kernels
+*                built for that one size: 256 (experiment.ini
+*                doppler_cpi), 4096 (XFER_WORD_SIZE lines,
+*                n_cmplx_samples_padded) and 8192 (pulse compression of
+*                4096 sample lines without wrapping).  Other sizes get a
+*                general AVX2 kernel, and CPUs without AVX2 plain C.
+*                plan->kernelName says which, for reports, and
+*                FFT_UseGeneral() puts a plan on the general kernel, to
+*                compare the two.
+*
+*                FFT_MakeTables() and FFT_InitShared() split FFT_Init() in
+*                two, so the tables can be made once and kept elsewhere
+*                (tcache.c keeps them in files, mapped at start up); a
+*                plan made with FFT_InitShared() only points at them.
+*
+************************************************************************/
+
+#ifndef __FFT_H__
+#define __FFT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* FFT_MIN_SIZE / FFT_MAX_SIZE - transform sizes a plan can be made for */
+#define FFT_MIN_SIZE         2
+#define FFT_MAX_SIZE         65536
+
+
+/* FFT_TWIDDLE_FLOATS - floats of twiddle table for size n */
+#define FFT_TWIDDLE_FLOATS(n)  (2 * (n))
+
+
+/* FFT_PLAN - tables for one transform size
+ *     n          = transform size, complex points
+ *     log2n      = log2(n)
+ *     twiddle    = twiddle factors in the order the passes use them; see
+ *                  fft.c
+ *     bitrev     = bit-reversed index of each point
+ *     kernel     = the transform for this size; inverse = 1 for the
+ *                  inverse
+ *     kernelName = name of the kernel
+ *     shared     = 1 if the tables are not the plan's own, and
+ *                  FFT_Free() leaves them
+ */
+typedef struct FFT_PLAN
+        {
+            unsigned int        n;
+            unsigned int        log2n;
+            const float        *twiddle;
+            const unsigned int *bitrev;
+            void              (*kernel) (const struct FFT_PLAN *plan, float *x,
+                                         int inverse);
+            const char         *kernelName;
+            int                 shared;
+        } FFT_PLAN;
+
+
+/* function prototypes */
+int  FFT_Init       (FFT_PLAN           *plan,
+                     unsigned int        n);
+int  FFT_MakeTables (unsigned int        n,
+                     float              *twiddle,
+                     unsigned int       *bitrev);
+int  FFT_InitShared (FFT_PLAN           *plan,
+                     unsigned int        n,
+                     const float        *twiddle,
+                     const unsigned int *bitrev);
+void FFT_Forward    (const FFT_PLAN     *plan,
+                     float              *x);
+void FFT_Inverse    (const FFT_PLAN     *plan,
+                     float              *x);
+void FFT_UseGeneral (FFT_PLAN           *plan,
+                     int                 simd);
+void FFT_Free       (FFT_PLAN           *plan);
+
+unsigned int FFT_NextSize (unsigned int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FFT_H__ */
@@ -0,0 +1,414 @@
+/**************************************************************************
+*
+*   File: fftbench.c
+*
+*   Description: Check and micro-benchmark of the FFT kernels (fft.c),
+*                away from the radar.
+*
+*                For each size (256, 4096 and 8192 by default: the
+*                Doppler CPI and the pulse compression lines) three
+*                kernels are run on the same pseudo-random data:
+*
+*                    picked  - the one FFT_Init() picks, specialised for
+*                              the size on AVX2 CPUs
+*                    general - the general AVX2 kernel, FFT_UseGeneral()
+*                    scalar  - plain C
+*
+*                Each is checked forward and inverse against an O(n^2)
+*                DFT made in double precision: the largest error in any
+*                bin, relative to the largest bin, must be under
+*                FFTBENCH_TOL.  Each is then timed, and so is FFTW's
+*                single precision transform when fftbench is built with
+*                HAVE_FFTW3F (the Makefile adds it if pkg-config finds
+*                fftw3f).
+*
+*                Usage:
+*                    fftbench [options] [size ...]
+*                    -r runs    transforms timed per kernel (2000)
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef HAVE_FFTW3F
+#include <fftw3.h>
+#endif
+
+#include "fft.h"
+#include "dmaring.h"
+
+
+/* FFTBENCH_TOL - largest error allowed, relative to the largest bin; the
+ * float transforms come to a few 1e-7 at these sizes
+ */
+#define FFTBENCH_TOL         2e-6
+
+/* FFTBENCH_KERNELS - kernels run per size: picked, general, scalar */
+#define FFTBENCH_KERNELS     3
+
+/* FFTBENCH_MAX_SIZES - sizes on the command line */
+#define FFTBENCH_MAX_SIZES   16
+
+
+static int    FFTBENCH_Size   (unsigned int n, unsigned int runs);
+static void   FFTBENCH_Dft    (const float *x, double *X, unsigned int n,
+                               int inverse);
+static double FFTBENCH_Error  (const float *x, const double *X,
+                               unsigned int n);
+static double FFTBENCH_Time   (const FFT_PLAN *plan, float *x,
+                               unsigned int runs);
+#ifdef HAVE_FFTW3F
+static double FFTBENCH_Fftw   (unsigned int n, const float *in,
+                               unsigned int runs);
+#endif
+static void   FFTBENCH_Usage  (void);
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Checks and times the kernels at each size, and prints PASS
+              or FAIL.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - every kernel was within FFTBENCH_TOL
+              1 - bad command line, allocation failed, or a kernel was
+                  out
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    unsigned int    sizes[FFTBENCH_MAX_SIZES] = {256, 4096, 8192};
+    unsigned int    numSizes = 3;
+    unsigned int    given    = 0;
+    unsigned int    runs     = 2000;
+    unsigned int    i;
+    int             failed   = 0;
+    int             a;
+
+    for (a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "-r") == 0) && (a + 1 < argc))
+            runs = (unsigned int)atoi(argv[++a]);
+        else if ((argv[a][0] != '-') && (given < FFTBENCH_MAX_SIZES))
+            sizes[given++] = (unsigned int)atoi(argv[a]);
+        else
+        {
+            FFTBENCH_Usage();
+            return (1);
+        }
+    }
+    if (given != 0)
+        numSizes = given;
+    if (runs == 0)
+    {
+        FFTBENCH_Usage();
+        return (1);
+    }
+
+    printf("error is the largest bin error over the largest bin, "
+           "limit %.1e\n\n", FFTBENCH_TOL);
+    printf("%6s %-10s %12s %12s %10s\n", "n", "kernel", "fwd error",
+           "inv error", "us");
+
+    for (i = 0; i < numSizes; i++)
+        failed |= FFTBENCH_Size(sizes[i], runs);
+
+    printf("%s\n", failed ? "FAIL" : "PASS");
+
+    return (failed ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    FFTBENCH_Size()
+
+ Description: Checks and times the three kernels at one size and prints
+              a row for each.
+
+ Parameters:  n    - transform size
+              runs - transforms timed per kernel
+
+ Return:      0 - every kernel was within FFTBENCH_TOL
+              1 - a kernel was out, n is not a supported size, or
+                  allocation failed
+**************************************************************************/
+static int FFTBENCH_Size (unsigned int n, unsigned int runs)
+{
+    FFT_PLAN      plan;
+    float        *in;
+    float        *x;
+    double       *fwd;
+    double       *inv;
+    double        fwdErr;
+    double        invErr;
+    double        us;
+    unsigned int  seed = 31415;
+    unsigned int  i;
+    int           k;
+    int           out;
+    int           failed = 0;
+
+    if (FFT_Init(&plan, n) != 0)
+    {
+        printf("%6u not a supported size\n", n);
+        return (1);
+    }
+
+    in  = (float *)malloc(2 * n * sizeof(float));
+    x   = (float *)malloc(2 * n * sizeof(float));
+    fwd = (double *)malloc(2 * n * sizeof(double));
+    inv = (double *)malloc(2 * n * sizeof(double));
+    if ((in == NULL) || (x == NULL) || (fwd == NULL) || (inv == NULL))
+    {
+        free(in); free(x); free(fwd); free(inv);
+        FFT_Free(&plan);
+        return (1);
+    }
+
+    for (i = 0; i < 2 * n; i++)
+    {
+        seed = (seed * 1103515245U) + 12345U;
+        in[i] = (float)(seed >> 8) / 8388608.0f - 1.0f;
+    }
+    FFTBENCH_Dft(in, fwd, n, 0);
+    FFTBENCH_Dft(in, inv, n, 1);
+
+    for (k = 0; k < FFTBENCH_KERNELS; k++)
+    {
+        if (k > 0)
+            FFT_UseGeneral(&plan, k == 1);
+
+        memcpy (x, in, 2 * n * sizeof(float));
+        FFT_Forward(&plan, x);
+        fwdErr = FFTBENCH_Error(x, fwd, n);
+
+        memcpy (x, in, 2 * n * sizeof(float));
+        FFT_Inverse(&plan, x);
+        invErr = FFTBENCH_Error(x, inv, n);
+
+        us  = FFTBENCH_Time(&plan, x, runs) / 1e3;
+        out = !(fwdErr < FFTBENCH_TOL) || !(invErr < FFTBENCH_TOL);
+        failed |= out;
+        printf("%6u %-10s %12.2e %12.2e %10.2f%s\n", n, plan.kernelName,
+               fwdErr, invErr, us, out ? "  FAIL" : "");
+    }
+#ifdef HAVE_FFTW3F
+    printf("%6u %-10s %12s %12s %10.2f\n", n, "fftw", "", "",
+           FFTBENCH_Fftw(n, in, runs) / 1e3);
+#endif
+
+    free(in);
+    free(x);
+    free(fwd);
+    free(inv);
+    FFT_Free(&plan);
+
+    return (failed);
+}
+
+
+/**************************************************************************
+ Function:    FFTBENCH_Dft()
+
+ Description: Direct DFT in double precision, the reference.  The
+              exponentials come from a table of n roots of unity, indexed
+              by n k mod n, so none is made from a large angle.
+
+ Parameters:  x       - n complex points in
+              X       - n complex points out
+              n       - size
+              inverse - 1 for e^(+j2pi nk/N), unscaled, as FFT_Inverse()
+
+ Return:      none
+**************************************************************************/
+static void FFTBENCH_Dft (const float *x, double *X, unsigned int n,
+                          int inverse)
+{
+    double       *w = (double *)malloc(2 * n * sizeof(double));
+    double        sign = inverse ? 1.0 : -1.0;
+    double        re;
+    double        im;
+    unsigned int  j;
+    unsigned int  k;
+    unsigned int  m;
+
+    if (w == NULL)
+        return;
+
+    for (j = 0; j < n; j++)
+    {
+        w[2 * j]     = cos(2.0 * M_PI * j / n);
+        w[2 * j + 1] = sign * sin(2.0 * M_PI * j / n);
+    }
+
+    for (k = 0; k < n; k++)
+    {
+        re = 0.0;
+        im = 0.0;
+        m  = 0;
+        for (j = 0; j < n; j++)
+        {
+            re += x[2 * j] * w[2 * m]     - x[2 * j + 1] * w[2 * m + 1];
+            im += x[2 * j] * w[2 * m + 1] + x[2 * j + 1] * w[2 * m];
+            m = (m + k) & (n - 1);
+        }
+        X[2 * k]     = re;
+        X[2 * k + 1] = im;
+    }
+
+    free(w);
+}
+
+
+/**************************************************************************
+ Function:    FFTBENCH_Error()
+
+ Description: Largest difference of any bin from the reference, over the
+              largest reference bin.
+
+ Parameters:  x - n complex points from a kernel
+              X - n complex points of the reference
+              n - size
+
+ Return:      the relative error
+**************************************************************************/
+static double FFTBENCH_Error (const float *x, const double *X,
+                              unsigned int n)
+{
+    double       err  = 0.0;
+    double       peak = 0.0;
+    double       d;
+    unsigned int k;
+
+    for (k = 0; k < n; k++)
+    {
+        d = hypot(x[2 * k] - X[2 * k], x[2 * k + 1] - X[2 * k + 1]);
+        if (!(d <= err))
+            err = d;
+        d = hypot(X[2 * k], X[2 * k + 1]);
+        if (d > peak)
+            peak = d;
+    }
+
+    return (err / peak);
+}
+
+
+/**************************************************************************
+ Function:    FFTBENCH_Time()
+
+ Description: Times forward transforms with a plan's kernel.  The data
+              are transformed over and over in place; four forward
+              transforms multiply them by n^2, which is taken out again
+              every four (exactly, n being a power of two), untimed.
+
+ Parameters:  plan - the plan
+              x    - plan->n complex points, overwritten
+              runs - transforms to time
+
+ Return:      ns per transform
+**************************************************************************/
+static double FFTBENCH_Time (const FFT_PLAN *plan, float *x,
+                             unsigned int runs)
+{
+    unsigned long long  start;
+    unsigned long long  scaleNs = 0;
+    unsigned long long  t;
+    unsigned int        r;
+    unsigned int        i;
+
+    start = DMARING_TimeNs();
+    for (r = 0; r < runs; r++)
+    {
+        FFT_Forward(plan, x);
+        if ((r & 3) == 3)
+        {
+            t = DMARING_TimeNs();
+            for (i = 0; i < 2 * plan->n; i++)
+                x[i] *= 1.0f / ((float)plan->n * plan->n);
+            scaleNs += DMARING_TimeNs() - t;
+        }
+    }
+
+    return ((double)(DMARING_TimeNs() - start - scaleNs) / runs);
+}
+
+
+#ifdef HAVE_FFTW3F
+/**************************************************************************
+ Function:    FFTBENCH_Fftw()
+
+ Description: Times FFTW's single precision forward transform, in place,
+              with a plan FFTW has measured for the size, as
+              FFTBENCH_Time() times the others.
+
+ Parameters:  n    - size
+              in   - n complex points to start from
+              runs - transforms to time
+
+ Return:      ns per transform, or 0 if FFTW could not plan
+**************************************************************************/
+static double FFTBENCH_Fftw (unsigned int n, const float *in,
+                             unsigned int runs)
+{
+    fftwf_complex      *x;
+    fftwf_plan          p;
+    unsigned long long  start;
+    unsigned long long  scaleNs = 0;
+    unsigned long long  t;
+    unsigned int        r;
+    unsigned int        i;
+
+    x = (fftwf_complex *)fftwf_malloc(n * sizeof(fftwf_complex));
+    if (x == NULL)
+        return (0.0);
+    p = fftwf_plan_dft_1d((int)n, x, x, FFTW_FORWARD, FFTW_MEASURE);
+    if (p == NULL)
+    {
+        fftwf_free(x);
+        return (0.0);
+    }
+    memcpy (x, in, n * sizeof(fftwf_complex));
+
+    start = DMARING_TimeNs();
+    for (r = 0; r < runs; r++)
+    {
+        fftwf_execute(p);
+        if ((r & 3) == 3)
+        {
+            t = DMARING_TimeNs();
+            for (i = 0; i < n; i++)
+            {
+                x[i][0] *= 1.0f / ((float)n * n);
+                x[i][1] *= 1.0f / ((float)n * n);
+            }
+            scaleNs += DMARING_TimeNs() - t;
+        }
+    }
+    t = DMARING_TimeNs() - start - scaleNs;
+
+    fftwf_destroy_plan(p);
+    fftwf_free(x);
+
+    return ((double)t / runs);
+}
+#endif
+
+
+/**************************************************************************
+ Function:    FFTBENCH_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void FFTBENCH_Usage (void)
+{
+    printf("usage: fftbench [-r runs] [size ...]\n");
+}
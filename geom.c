@@ -0,0 +1,185 @@
+/**************************************************************************
+*
+*   File: geom.c
+*
+*   Description: Recording window from the node and target geometry.
+*                See geom.h.
+*
+*                Distances are straight lines between ECEF points, which
+*                is what a radar path is; at NeXtRAD's baselines of a few
+*                km to tens of km the refraction bend is far below a range
+*                bin.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <math.h>
+
+#include "geom.h"
+
+
+/* WGS84 ellipsoid: semi-major axis in m and first eccentricity squared */
+#define WGS84_A              6378137.0
+#define WGS84_E2             6.69437999014e-3
+
+#define DEG_TO_RAD           (3.14159265358979323846 / 180.0)
+
+
+/**************************************************************************
+ Function:    GEOM_ToEcef()
+
+ Description: Converts a WGS84 position to earth-centred earth-fixed
+              coordinates.
+
+ Parameters:  pos  - the position
+              ecef - receives x, y and z in m
+
+ Return:      none
+**************************************************************************/
+void GEOM_ToEcef (const GEOM_POS *pos, double ecef[3])
+{
+    double lat = pos->latDeg * DEG_TO_RAD;
+    double lon = pos->lonDeg * DEG_TO_RAD;
+    double s   = sin(lat);
+    double n   = WGS84_A / sqrt(1.0 - (WGS84_E2 * s * s));
+
+    ecef[0] = (n + pos->htM) * cos(lat) * cos(lon);
+    ecef[1] = (n + pos->htM) * cos(lat) * sin(lon);
+    ecef[2] = ((n * (1.0 - WGS84_E2)) + pos->htM) * s;
+}
+
+
+/**************************************************************************
+ Function:    GEOM_Distance()
+
+ Description: Returns the straight-line distance between two positions.
+
+ Parameters:  a, b - the positions
+
+ Return:      distance in m
+**************************************************************************/
+double GEOM_Distance (const GEOM_POS *a, const GEOM_POS *b)
+{
+    double pa[3];
+    double pb[3];
+
+    GEOM_ToEcef(a, pa);
+    GEOM_ToEcef(b, pb);
+
+    return (sqrt(((pa[0] - pb[0]) * (pa[0] - pb[0])) +
+                 ((pa[1] - pb[1]) * (pa[1] - pb[1])) +
+                 ((pa[2] - pb[2]) * (pa[2] - pb[2]))));
+}
+
+
+/**************************************************************************
+ Function:    GEOM_PulseWidthUs()
+
+ Description: Returns the pulse width of a WAVEFORM_INDEX, from the table
+              in NeXtRAD.ini: 1 - 7 are LFM and 8 - 14 NLFM pulses of
+              0.5, 1, 3, 5, 10, 15 and 20 us.
+
+ Parameters:  waveformIndex - WAVEFORM_INDEX
+
+ Return:      pulse width in us, or 0 if the index is not in the table
+**************************************************************************/
+double GEOM_PulseWidthUs (int waveformIndex)
+{
+    static const double width[7] = {0.5, 1.0, 3.0, 5.0, 10.0, 15.0, 20.0};
+
+    if ((waveformIndex < 1) || (waveformIndex > 14))
+        return (0.0);
+
+    return (width[(waveformIndex - 1) % 7]);
+}
+
+
+/**************************************************************************
+ Function:    GEOM_RecordWindow()
+
+ Description: Works out a receiving node's ADC_DELAY and SAMPLES_PER_PRI
+              for the target: marginM of bistatic range either side of
+              it, no earlier than the direct path, plus a pulse length.
+              ADC_DELAY is rounded down, so the window starts no later
+              than asked.  If the window needs more than maxSamples it is
+              narrowed around the target to fit.
+
+ Parameters:  tx           - position of the transmitting node (node 0)
+              rx           - position of the receiving node; the same as
+                             tx for node 0
+              tgt          - position of the target
+              marginM      - bistatic range kept either side of the target
+              pulseUs      - pulse width, in us
+              sampleRateHz - decimated complex sample rate
+              dacDelay     - DAC_DELAY
+              maxSamples   - most samples a line can hold (XFER_WORD_SIZE)
+              win          - receives the window
+
+ Return:      0 - success
+              1 - the window was narrowed to maxSamples
+              2 - not even the pulse fits in maxSamples, or a parameter is
+                  out of range; win is not valid
+**************************************************************************/
+int GEOM_RecordWindow (const GEOM_POS  *tx,
+                       const GEOM_POS  *rx,
+                       const GEOM_POS  *tgt,
+                       double           marginM,
+                       double           pulseUs,
+                       double           sampleRateHz,
+                       unsigned int     dacDelay,
+                       unsigned int     maxSamples,
+                       GEOM_WINDOW     *win)
+{
+    double pulseSec = pulseUs * 1e-6;
+    double spanSec;
+    double startM;
+    double endM;
+    double clocks;
+    double samples;
+    int    status = 0;
+
+    if ((marginM < 0.0) || (pulseUs < 0.0) || (sampleRateHz <= 0.0) ||
+        ((pulseSec * sampleRateHz) >= maxSamples))
+        return (2);
+
+    win->rangeM    = GEOM_Distance(tx, tgt) + GEOM_Distance(tgt, rx);
+    win->baselineM = GEOM_Distance(tx, rx);
+
+    startM = win->rangeM - marginM;
+    endM   = win->rangeM + marginM;
+
+    /* too long: keep what fits, centred on the target */
+    spanSec = ((endM - startM) / GEOM_SPEED_OF_LIGHT) + pulseSec;
+    if ((spanSec * sampleRateHz) > maxSamples)
+    {
+        marginM = ((((double)maxSamples / sampleRateHz) - pulseSec) *
+                   GEOM_SPEED_OF_LIGHT) / 2.0;
+        startM  = win->rangeM - marginM;
+        endM    = win->rangeM + marginM;
+        status  = 1;
+    }
+    if (startM < win->baselineM)
+        startM = win->baselineM;
+
+    /* the first sample falls on a whole ADC_DELAY clock at or before
+     * startM
+     */
+    clocks        = floor((startM / GEOM_SPEED_OF_LIGHT) * GEOM_DELAY_CLOCK_HZ);
+    win->startM   = (clocks / GEOM_DELAY_CLOCK_HZ) * GEOM_SPEED_OF_LIGHT;
+    win->adcDelay = dacDelay + GEOM_TX_LATENCY + (unsigned int)clocks;
+    if (win->adcDelay < GEOM_MIN_ADC_DELAY)
+        win->adcDelay = GEOM_MIN_ADC_DELAY;
+
+    samples = ceil((((endM - win->startM) / GEOM_SPEED_OF_LIGHT) + pulseSec) *
+                   sampleRateHz);
+    if (samples > maxSamples)
+    {
+        samples = maxSamples;
+        status  = 1;
+    }
+    win->samples = (unsigned int)samples;
+    win->endM    = win->startM + (((samples - 1.0) / sampleRateHz) *
+                                  GEOM_SPEED_OF_LIGHT);
+
+    return (status);
+}
@@ -0,0 +1,107 @@
+/***********************************************************************
+*
+*   File: geom.h
+*
+*   Description: header file for geom.c, the recording window worked out
+*                from the node and target positions in NeXtRAD.ini
+*                ([GeometrySettings] and [TargetSettings]) instead of a
+*                hand-typed ADC_DELAY and SAMPLES_PER_PRI.
+*
+*                Positions are WGS84 latitude and longitude in decimal
+*                degrees and height in metres, converted to earth-centred
+*                earth-fixed coordinates for straight-line distances.
+*                Node 0 transmits; the bistatic range seen by node n is
+*                the path node 0 -> target -> node n, which for node 0
+*                itself is twice the monostatic range.
+*
+*                The window keeps GEOMETRY_MARGIN metres of bistatic range
+*                either side of the target, and a pulse length more at the
+*                far end so that the whole echo from its far edge is in
+*                the line.  It never starts before the direct path from
+*                node 0, the shortest bistatic range there is.
+*
+*                Delays are counted in ADC_DELAY clocks (GEOM_DELAY_CLOCK_HZ)
+*                from the trigger.  The pulse leaves node 0
+*                DAC_DELAY + GEOM_TX_LATENCY clocks after the trigger (the
+*                measured figure in NeXtRAD.ini); every node triggers at
+*                the same moment, so an echo arrives the propagation time
+*                after that at any node.
+*
+************************************************************************/
+
+#ifndef __GEOM_H__
+#define __GEOM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* GEOM_SPEED_OF_LIGHT - in m/s;
+ * GEOM_DELAY_CLOCK_HZ - rate ADC_DELAY and DAC_DELAY are counted at;
+ * GEOM_TX_LATENCY - clocks from DAC_DELAY running out to the pulse
+ *                   leaving, measured (186 * 2 at 180 MSPS);
+ * GEOM_MIN_ADC_DELAY - smallest ADC_DELAY the trigger logic takes
+ */
+#define GEOM_SPEED_OF_LIGHT  299792458.0
+#define GEOM_DELAY_CLOCK_HZ  180e6
+#define GEOM_TX_LATENCY      372
+#define GEOM_MIN_ADC_DELAY   10
+
+/* GEOM_MAX_NODES - nodes in [GeometrySettings] */
+#define GEOM_MAX_NODES       3
+
+
+/* GEOM_POS - a WGS84 position
+ *     latDeg = latitude, degrees north
+ *     lonDeg = longitude, degrees east
+ *     htM    = height above the ellipsoid, m
+ */
+typedef struct GEOM_POS
+        {
+            double  latDeg;
+            double  lonDeg;
+            double  htM;
+        } GEOM_POS;
+
+
+/* GEOM_WINDOW - a node's recording window
+ *     rangeM    = bistatic range of the target
+ *     baselineM = bistatic range of the direct path (0 for node 0)
+ *     startM    = bistatic range of the first sample recorded
+ *     endM      = bistatic range of the last sample recorded
+ *     adcDelay  = ADC_DELAY for the window
+ *     samples   = SAMPLES_PER_PRI for the window
+ */
+typedef struct GEOM_WINDOW
+        {
+            double        rangeM;
+            double        baselineM;
+            double        startM;
+            double        endM;
+            unsigned int  adcDelay;
+            unsigned int  samples;
+        } GEOM_WINDOW;
+
+
+/* function prototypes */
+void   GEOM_ToEcef        (const GEOM_POS  *pos,
+                           double           ecef[3]);
+double GEOM_Distance      (const GEOM_POS  *a,
+                           const GEOM_POS  *b);
+double GEOM_PulseWidthUs  (int              waveformIndex);
+int    GEOM_RecordWindow  (const GEOM_POS  *tx,
+                           const GEOM_POS  *rx,
+                           const GEOM_POS  *tgt,
+                           double           marginM,
+                           double           pulseUs,
+                           double           sampleRateHz,
+                           unsigned int     dacDelay,
+                           unsigned int     maxSamples,
+                           GEOM_WINDOW     *win);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GEOM_H__ */
@@ -0,0 +1,262 @@
+/**************************************************************************
+*
+*   File: geomtest.c
+*
+*   Description: Test of the geometry recording window (geom.c) against
+*                figures worked out by hand, away from the radar.
+*
+*                    ecef     - GEOM_ToEcef() on the equator, at the pole
+*                               and the chord of one degree of longitude
+*                               along the equator
+*                    windows  - GEOM_RecordWindow() for a target straight
+*                               above a node on the equator: the plain
+*                               window, one narrowed to fit the line
+*                               (status 1), one clamped to the direct
+*                               path, and pulses that cannot fit (status
+*                               2)
+*                    ini      - the node and target positions shipped in
+*                               NeXtRAD.ini, for nodes 0 and 1, with
+*                               GEOMETRY_MARGIN 1500 m, WAVEFORM_INDEX 3,
+*                               DAC_DELAY 1 and 4096 samples at 45 MSPS
+*
+*                Straight up from the equator the ECEF distance is the
+*                height difference, so those windows follow from
+*                GEOM_SPEED_OF_LIGHT and the 180 MHz delay clock alone.
+*                The NeXtRAD.ini figures were worked out separately in
+*                double precision from the WGS84 formulae.
+*
+*                Usage:
+*                    geomtest [-v]
+*                    -v         print every check, not just failures
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "geom.h"
+
+
+/* GEOMTEST_TOL_M - largest difference from a hand figure, in m */
+#define GEOMTEST_TOL_M       1e-3
+
+
+/* GEOM_CASE - one GEOM_RecordWindow() call and the window expected
+ *     name      = what the case checks
+ *     tx/rx/tgt = positions
+ *     marginM, pulseUs, sampleRateHz, dacDelay, maxSamples = as passed
+ *     status    = return expected
+ *     win       = window expected, if status is not 2
+ */
+typedef struct GEOM_CASE
+        {
+            const char     *name;
+            GEOM_POS        tx;
+            GEOM_POS        rx;
+            GEOM_POS        tgt;
+            double          marginM;
+            double          pulseUs;
+            double          sampleRateHz;
+            unsigned int    dacDelay;
+            unsigned int    maxSamples;
+            int             status;
+            GEOM_WINDOW     win;
+        } GEOM_CASE;
+
+
+static const GEOM_CASE geomCases[] =
+{
+    /* 7500 m up: 15000 m monostatic; 13500 m is 8105.6 clocks, so
+     * 8105 + 372 + 1; (16500 - 13498.99) m is 100.1 samples plus 10 for
+     * the pulse
+     */
+    {"monostatic", {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 7500.0},
+     1500.0, 1.0, 10e6, 1, 8192,
+     0, {15000.0, 0.0, 13498.988178, 16796.705216, 8478, 111}},
+
+    /* 64 samples leave 5.4 us, +-809.4 m; 14190.56 m is 8520.2 clocks;
+     * the 65 samples that needs are cut to 64
+     */
+    {"narrowed", {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 7500.0},
+     1500.0, 1.0, 10e6, 1, 64,
+     1, {15000.0, 0.0, 14190.176345, 16078.868831, 8893, 64}},
+
+    /* target at the receiver 3000 m up: the window would start at
+     * 1500 m, before the direct path, so starts at 3000 m, 1801.2 clocks
+     */
+    {"direct path", {0.0, 0.0, 0.0}, {0.0, 0.0, 3000.0}, {0.0, 0.0, 3000.0},
+     1500.0, 1.0, 10e6, 1, 8192,
+     0, {3000.0, 3000.0, 2999.590094, 4798.344842, 2174, 61}},
+
+    /* a 10 us pulse is 100 samples at 10 MSPS */
+    {"pulse too long", {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 7500.0},
+     1500.0, 10.0, 10e6, 1, 64,
+     2, {0.0, 0.0, 0.0, 0.0, 0, 0}},
+
+    {"negative margin", {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 7500.0},
+     -1.0, 1.0, 10e6, 1, 8192,
+     2, {0.0, 0.0, 0.0, 0.0, 0, 0}},
+
+    /* NeXtRAD.ini: node 0 records its own echo */
+    {"NeXtRAD.ini node 0", {-34.1891, 18.3665, 52.76}, {-34.1891, 18.3665, 52.76},
+     {-34.1874, 18.4280, 0.0235},
+     1500.0, 3.0, 45e6, 1, 4096,
+     0, {11345.008057, 0.0, 9844.851218, 13742.153172, 6284, 586}},
+
+    /* NeXtRAD.ini: node 1, as shipped some 3390 km north */
+    {"NeXtRAD.ini node 1", {-34.1891, 18.3665, 52.76}, {-3.1891, 18.3665, 52.76},
+     {-34.1874, 18.4280, 0.0235},
+     1500.0, 3.0, 45e6, 1, 4096,
+     0, {3395796.836794, 3390314.426661, 3394295.178345, 3398192.480299, 2038360, 586}},
+};
+
+
+static int  GEOMTEST_Check  (const char *name, const char *what,
+                             double got, double want, double tol);
+static void GEOMTEST_Usage  (void);
+
+static int verbose = 0;
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Runs the checks and prints PASS or FAIL.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - every check passed
+              1 - bad command line, or a check failed
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    const GEOM_CASE    *c;
+    GEOM_WINDOW         win;
+    GEOM_POS            pos;
+    double              ecef[3];
+    double              chord;
+    int                 failed = 0;
+    int                 status;
+    unsigned int        i;
+    int                 a;
+
+    for (a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "-v") == 0)
+            verbose = 1;
+        else
+        {
+            GEOMTEST_Usage();
+            return (1);
+        }
+    }
+
+    /* on the equator at 0 E the point is a + h along x; at 90 E along y */
+    pos.latDeg = 0.0;
+    pos.lonDeg = 0.0;
+    pos.htM    = 0.0;
+    GEOM_ToEcef(&pos, ecef);
+    failed |= GEOMTEST_Check("equator 0 E", "x", ecef[0], 6378137.0, 1e-6);
+    failed |= GEOMTEST_Check("equator 0 E", "y", ecef[1], 0.0, 1e-6);
+    failed |= GEOMTEST_Check("equator 0 E", "z", ecef[2], 0.0, 1e-6);
+    pos.lonDeg = 90.0;
+    pos.htM    = 100.0;
+    GEOM_ToEcef(&pos, ecef);
+    failed |= GEOMTEST_Check("equator 90 E", "x", ecef[0], 0.0, 1e-6);
+    failed |= GEOMTEST_Check("equator 90 E", "y", ecef[1], 6378237.0, 1e-6);
+    failed |= GEOMTEST_Check("equator 90 E", "z", ecef[2], 0.0, 1e-6);
+
+    /* at the pole z is the semi-minor axis, a * sqrt(1 - e^2) */
+    pos.latDeg = 90.0;
+    pos.lonDeg = 0.0;
+    pos.htM    = 0.0;
+    GEOM_ToEcef(&pos, ecef);
+    failed |= GEOMTEST_Check("north pole", "x", ecef[0], 0.0, 1e-6);
+    failed |= GEOMTEST_Check("north pole", "z", ecef[2], 6356752.314245, 1e-6);
+    pos.latDeg = -90.0;
+    GEOM_ToEcef(&pos, ecef);
+    failed |= GEOMTEST_Check("south pole", "z", ecef[2], -6356752.314245, 1e-6);
+
+    /* one degree along the equator is a chord of 2 a sin(0.5 deg) */
+    {
+        GEOM_POS east = {0.0, 1.0, 0.0};
+
+        pos.latDeg = 0.0;
+        chord = GEOM_Distance(&pos, &east);
+        failed |= GEOMTEST_Check("1 deg chord", "distance", chord,
+                                 111318.077888, GEOMTEST_TOL_M);
+    }
+
+    for (i = 0; i < sizeof(geomCases) / sizeof(geomCases[0]); i++)
+    {
+        c = &geomCases[i];
+        memset (&win, 0, sizeof(win));
+        status = GEOM_RecordWindow(&c->tx, &c->rx, &c->tgt, c->marginM,
+                                   c->pulseUs, c->sampleRateHz, c->dacDelay,
+                                   c->maxSamples, &win);
+        failed |= GEOMTEST_Check(c->name, "status", status, c->status, 0.0);
+        if ((status != c->status) || (status == 2))
+            continue;
+
+        failed |= GEOMTEST_Check(c->name, "rangeM", win.rangeM,
+                                 c->win.rangeM, GEOMTEST_TOL_M);
+        failed |= GEOMTEST_Check(c->name, "baselineM", win.baselineM,
+                                 c->win.baselineM, GEOMTEST_TOL_M);
+        failed |= GEOMTEST_Check(c->name, "startM", win.startM,
+                                 c->win.startM, GEOMTEST_TOL_M);
+        failed |= GEOMTEST_Check(c->name, "endM", win.endM,
+                                 c->win.endM, GEOMTEST_TOL_M);
+        failed |= GEOMTEST_Check(c->name, "adcDelay", win.adcDelay,
+                                 c->win.adcDelay, 0.0);
+        failed |= GEOMTEST_Check(c->name, "samples", win.samples,
+                                 c->win.samples, 0.0);
+    }
+
+    printf("%s\n", failed ? "FAIL" : "PASS");
+
+    return (failed ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    GEOMTEST_Check()
+
+ Description: Compares a result with the figure expected and prints it if
+              it is out, or always with -v.
+
+ Parameters:  name - case
+              what - quantity
+              got  - result
+              want - figure expected
+              tol  - largest difference allowed
+
+ Return:      0 - within tol
+              1 - out
+**************************************************************************/
+static int GEOMTEST_Check (const char *name, const char *what,
+                           double got, double want, double tol)
+{
+    int out = (fabs(got - want) > tol);
+
+    if (out || verbose)
+        printf("%-4s %-20s %-10s %16.6f, expected %16.6f\n",
+               out ? "FAIL" : "ok", name, what, got, want);
+
+    return (out);
+}
+
+
+/**************************************************************************
+ Function:    GEOMTEST_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void GEOMTEST_Usage (void)
+{
+    printf("usage: geomtest [-v]\n");
+}
@@ -0,0 +1,827 @@
+/**************************************************************************
+*
+*   File: iqk.c
+*
+*   Description: Vectorised I/Q kernels.  See iqk.h.
+*
+*                The kernels in use are held in IQK_Kernels, which starts
+*                out as the plain C set.  IQK_Init() replaces entries with
+*                vector versions once they have passed the self-check; it
+*                is meant to be called once, from main(), before any
+*                thread uses the kernels.
+*
+*                The vector kernels handle whole vectors and pass what is
+*                left of the line to the plain C kernel, so any n works
+*                and no alignment is needed.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define IQK_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define IQK_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+#include "iqk.h"
+
+
+/* log2(1 + t), 0 <= t < 1, as t (C1 + t (C2 + t (C3 + t C4)));
+ * fitted for least maximum error, 1.2e-4 in log2
+ */
+#define IQK_LOG2_C1          1.43863803f
+#define IQK_LOG2_C2          (-0.677743267f)
+#define IQK_LOG2_C3          0.321879707f
+#define IQK_LOG2_C4          (-0.0828606982f)
+
+/* IQK_DB_PER_LOG2 - 10 log10(2) */
+#define IQK_DB_PER_LOG2      3.01029995664f
+
+/* IQK_CHECK_SAMPLES - samples in the self-check line; odd so that every
+ * kernel's tail is exercised too
+ */
+#define IQK_CHECK_SAMPLES    1031
+
+
+/* IQK_KERNELS - one set of kernels
+ *     name            = name of the set
+ *     toComplex       = IQK_ToComplex()
+ *     toComplexWindowed = IQK_ToComplexWindowed()
+ *     split           = IQK_Split()
+ *     power           = IQK_Power()
+ *     powerI16        = IQK_PowerI16()
+ *     db              = IQK_Db()
+ */
+typedef struct IQK_KERNELS
+        {
+            const char  *name;
+            void       (*toComplex)         (const int16_t *, float *,
+                                             unsigned int);
+            void       (*toComplexWindowed) (const int16_t *, const float *,
+                                             float *, unsigned int);
+            void       (*split)             (const int16_t *, float *,
+                                             float *, unsigned int);
+            void       (*power)             (const float *, float *,
+                                             unsigned int);
+            void       (*powerI16)          (const int16_t *, float *,
+                                             unsigned int);
+            void       (*db)                (const float *, float *,
+                                             unsigned int);
+        } IQK_KERNELS;
+
+
+static void IQK_ScalarToComplex         (const int16_t *iq, float *x,
+                                         unsigned int n);
+static void IQK_ScalarToComplexWindowed (const int16_t *iq, const float *win,
+                                         float *x, unsigned int n);
+static void IQK_ScalarSplit             (const int16_t *iq, float *re,
+                                         float *im, unsigned int n);
+static void IQK_ScalarPower             (const float *x, float *pow,
+                                         unsigned int n);
+static void IQK_ScalarPowerI16          (const int16_t *iq, float *pow,
+                                         unsigned int n);
+static void IQK_ScalarDb                (const float *pow, float *db,
+                                         unsigned int n);
+static int  IQK_Check                   (const IQK_KERNELS *vec);
+
+#ifdef IQK_HAVE_AVX2
+static const IQK_KERNELS IQK_Avx2;
+#endif
+#ifdef IQK_HAVE_NEON
+static const IQK_KERNELS IQK_Neon;
+#endif
+
+
+static const IQK_KERNELS IQK_Scalar =
+{
+    "scalar",
+    IQK_ScalarToComplex,
+    IQK_ScalarToComplexWindowed,
+    IQK_ScalarSplit,
+    IQK_ScalarPower,
+    IQK_ScalarPowerI16,
+    IQK_ScalarDb
+};
+
+static IQK_KERNELS IQK_Kernels =
+{
+    "scalar",
+    IQK_ScalarToComplex,
+    IQK_ScalarToComplexWindowed,
+    IQK_ScalarSplit,
+    IQK_ScalarPower,
+    IQK_ScalarPowerI16,
+    IQK_ScalarDb
+};
+
+
+/**************************************************************************
+ Function:    IQK_Init()
+
+ Description: Picks the kernels for this CPU.  Each vector kernel is run
+              on a check line alongside the plain C one and used only if
+              its output is identical; any that is not is reported and
+              left as plain C.
+
+ Parameters:  useSimd - 0 to use the plain C kernels throughout
+
+ Return:      IQK_SCALAR, IQK_AVX2 or IQK_NEON - the set chosen
+**************************************************************************/
+int IQK_Init (int useSimd)
+{
+    const IQK_KERNELS *vec = NULL;
+    int                set = IQK_SCALAR;
+
+    IQK_Kernels = IQK_Scalar;
+    if (useSimd == 0)
+        return (IQK_SCALAR);
+
+#ifdef IQK_HAVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        vec = &IQK_Avx2;
+        set = IQK_AVX2;
+    }
+#endif
+#ifdef IQK_HAVE_NEON
+    vec = &IQK_Neon;
+    set = IQK_NEON;
+#endif
+
+    if (vec == NULL)
+        return (IQK_SCALAR);
+
+    if (IQK_Check(vec) != 0)
+        return (IQK_SCALAR);
+
+    return (set);
+}
+
+
+/**************************************************************************
+ Function:    IQK_Name()
+
+ Description: Names the kernel set chosen by IQK_Init().
+
+ Parameters:  none
+
+ Return:      "avx2", "neon" or "scalar"
+**************************************************************************/
+const char *IQK_Name (void)
+{
+    return (IQK_Kernels.name);
+}
+
+
+/**************************************************************************
+ Function:    IQK_ToComplex()
+
+ Description: Converts interleaved int16 I, Q to complex float.
+
+ Parameters:  iq - n complex samples, I then Q
+              x  - n complex points out, re, im interleaved
+              n  - samples
+
+ Return:      none
+**************************************************************************/
+void IQK_ToComplex (const int16_t *iq, float *x, unsigned int n)
+{
+    IQK_Kernels.toComplex(iq, x, n);
+}
+
+
+/**************************************************************************
+ Function:    IQK_ToComplexWindowed()
+
+ Description: Converts interleaved int16 I, Q to complex float and
+              multiplies each sample by its window weight.
+
+ Parameters:  iq  - n complex samples, I then Q
+              win - n real window weights, one per sample
+              x   - n complex points out, re, im interleaved
+              n   - samples
+
+ Return:      none
+**************************************************************************/
+void IQK_ToComplexWindowed (const int16_t *iq, const float *win, float *x,
+                            unsigned int n)
+{
+    IQK_Kernels.toComplexWindowed(iq, win, x, n);
+}
+
+
+/**************************************************************************
+ Function:    IQK_Split()
+
+ Description: Converts interleaved int16 I, Q to separate float I and Q
+              arrays.
+
+ Parameters:  iq - n complex samples, I then Q
+              re - n I values out
+              im - n Q values out
+              n  - samples
+
+ Return:      none
+**************************************************************************/
+void IQK_Split (const int16_t *iq, float *re, float *im, unsigned int n)
+{
+    IQK_Kernels.split(iq, re, im, n);
+}
+
+
+/**************************************************************************
+ Function:    IQK_Power()
+
+ Description: |x|^2 of complex float points.
+
+ Parameters:  x   - n complex points, re, im interleaved
+              pow - n powers out
+              n   - points
+
+ Return:      none
+**************************************************************************/
+void IQK_Power (const float *x, float *pow, unsigned int n)
+{
+    IQK_Kernels.power(x, pow, n);
+}
+
+
+/**************************************************************************
+ Function:    IQK_PowerI16()
+
+ Description: I^2 + Q^2 of int16 samples, as float.  Exact for any
+              sample below 2^12 in magnitude, within float rounding
+              otherwise.
+
+ Parameters:  iq  - n complex samples, I then Q
+              pow - n powers out
+              n   - samples
+
+ Return:      none
+**************************************************************************/
+void IQK_PowerI16 (const int16_t *iq, float *pow, unsigned int n)
+{
+    IQK_Kernels.powerI16(iq, pow, n);
+}
+
+
+/**************************************************************************
+ Function:    IQK_Db()
+
+ Description: 10 log10 of powers, to within IQK_DB_ERROR dB.  Powers
+              below IQK_MIN_POWER give IQK_DB_FLOOR.
+
+ Parameters:  pow - n powers
+              db  - n values out, in dB; may be the same array as pow
+              n   - values
+
+ Return:      none
+**************************************************************************/
+void IQK_Db (const float *pow, float *db, unsigned int n)
+{
+    IQK_Kernels.db(pow, db, n);
+}
+
+
+/**************************************************************************
+ Function:    IQK_Check()
+
+ Description: Runs each kernel of a vector set and the plain C kernel on
+              the same check data and installs the vector kernel if the
+              outputs match bit for bit.  The data cover the full int16
+              range, both ends of it, and powers from 0 and denormals up
+              to float's largest.
+
+ Parameters:  vec - the vector set
+
+ Return:      0 - success
+              1 - allocation failed; the plain C kernels are kept
+**************************************************************************/
+static int IQK_Check (const IQK_KERNELS *vec)
+{
+    unsigned int  n = IQK_CHECK_SAMPLES;
+    unsigned int  i;
+    unsigned int  seed = 12345;
+    uint32_t      bits;
+    int16_t      *iq;
+    float        *win;
+    float        *pow;
+    float        *a;
+    float        *b;
+    float        *c;
+    float        *d;
+    int           failed = 0;
+
+    iq  = (int16_t *)malloc(2 * n * sizeof(int16_t));
+    win = (float *)malloc(n * sizeof(float));
+    pow = (float *)malloc(n * sizeof(float));
+    a   = (float *)malloc(2 * n * sizeof(float));
+    b   = (float *)malloc(2 * n * sizeof(float));
+    c   = (float *)malloc(2 * n * sizeof(float));
+    d   = (float *)malloc(2 * n * sizeof(float));
+    if ((iq == NULL) || (win == NULL) || (pow == NULL) || (a == NULL) ||
+        (b == NULL) || (c == NULL) || (d == NULL))
+    {
+        free(iq); free(win); free(pow); free(a); free(b); free(c); free(d);
+        return (1);
+    }
+
+    for (i = 0; i < 2 * n; i++)
+    {
+        seed = (seed * 1103515245U) + 12345U;
+        iq[i] = (int16_t)(seed >> 16);
+    }
+    iq[0] = -32768; iq[1] = -32768;
+    iq[2] = 32767;  iq[3] = -32768;
+    iq[4] = 0;      iq[5] = 32767;
+
+    for (i = 0; i < n; i++)
+    {
+        seed = (seed * 1103515245U) + 12345U;
+        win[i] = (float)(seed >> 8) / 16777216.0f;
+
+        /* any bit pattern with a sign and exponent that is not NaN or
+         * infinity, which covers 0, denormals and the largest floats
+         */
+        seed = (seed * 1103515245U) + 12345U;
+        bits = (seed >> 1) % 0x7f800000U;
+        memcpy (&pow[i], &bits, sizeof(float));
+    }
+    pow[0] = 0.0f;
+    pow[1] = IQK_MIN_POWER;
+    pow[2] = 1.0f;
+
+    IQK_Scalar.toComplex(iq, a, n);
+    vec->toComplex(iq, b, n);
+    if (memcmp(a, b, 2 * n * sizeof(float)) == 0)
+        IQK_Kernels.toComplex = vec->toComplex;
+    else
+        failed = 1;
+
+    IQK_Scalar.toComplexWindowed(iq, win, a, n);
+    vec->toComplexWindowed(iq, win, b, n);
+    if (memcmp(a, b, 2 * n * sizeof(float)) == 0)
+        IQK_Kernels.toComplexWindowed = vec->toComplexWindowed;
+    else
+        failed = 1;
+
+    IQK_Scalar.split(iq, a, c, n);
+    vec->split(iq, b, d, n);
+    if ((memcmp(a, b, n * sizeof(float)) == 0) &&
+        (memcmp(c, d, n * sizeof(float)) == 0))
+        IQK_Kernels.split = vec->split;
+    else
+        failed = 1;
+
+    IQK_Scalar.toComplex(iq, c, n);
+    IQK_Scalar.power(c, a, n);
+    vec->power(c, b, n);
+    if (memcmp(a, b, n * sizeof(float)) == 0)
+        IQK_Kernels.power = vec->power;
+    else
+        failed = 1;
+
+    IQK_Scalar.powerI16(iq, a, n);
+    vec->powerI16(iq, b, n);
+    if (memcmp(a, b, n * sizeof(float)) == 0)
+        IQK_Kernels.powerI16 = vec->powerI16;
+    else
+        failed = 1;
+
+    IQK_Scalar.db(pow, a, n);
+    vec->db(pow, b, n);
+    if (memcmp(a, b, n * sizeof(float)) == 0)
+        IQK_Kernels.db = vec->db;
+    else
+        failed = 1;
+
+    if (failed)
+        printf("IQK_Init: some %s kernels differ from plain C; those are "
+               "left as plain C\n", vec->name);
+    IQK_Kernels.name = vec->name;
+
+    free(iq); free(win); free(pow); free(a); free(b); free(c); free(d);
+    return (0);
+}
+
+
+/**************************************************************************
+ Plain C kernels
+**************************************************************************/
+
+static void IQK_ScalarToComplex (const int16_t *iq, float *x, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < 2 * n; i++)
+        x[i] = (float)iq[i];
+}
+
+
+static void IQK_ScalarToComplexWindowed (const int16_t *iq, const float *win,
+                                         float *x, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+    {
+        x[2*i]     = (float)iq[2*i]     * win[i];
+        x[2*i + 1] = (float)iq[2*i + 1] * win[i];
+    }
+}
+
+
+static void IQK_ScalarSplit (const int16_t *iq, float *re, float *im,
+                             unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+    {
+        re[i] = (float)iq[2*i];
+        im[i] = (float)iq[2*i + 1];
+    }
+}
+
+
+static void IQK_ScalarPower (const float *x, float *pow, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+        pow[i] = (x[2*i] * x[2*i]) + (x[2*i + 1] * x[2*i + 1]);
+}
+
+
+static void IQK_ScalarPowerI16 (const int16_t *iq, float *pow, unsigned int n)
+{
+    unsigned int i;
+    float        re;
+    float        im;
+
+    for (i = 0; i < n; i++)
+    {
+        re = (float)iq[2*i];
+        im = (float)iq[2*i + 1];
+        pow[i] = (re * re) + (im * im);
+    }
+}
+
+
+static void IQK_ScalarDb (const float *pow, float *db, unsigned int n)
+{
+    unsigned int i;
+    uint32_t     bits;
+    float        m;
+    float        t;
+    float        l;
+    float        e;
+
+    for (i = 0; i < n; i++)
+    {
+        if (!(pow[i] >= IQK_MIN_POWER))
+        {
+            db[i] = IQK_DB_FLOOR;
+            continue;
+        }
+
+        memcpy (&bits, &pow[i], sizeof(bits));
+        e    = (float)((int32_t)(bits >> 23) - 127);
+        bits = (bits & 0x007fffffU) | 0x3f800000U;
+        memcpy (&m, &bits, sizeof(m));
+        t    = m - 1.0f;
+
+        l = (IQK_LOG2_C4 * t) + IQK_LOG2_C3;
+        l = (l * t) + IQK_LOG2_C2;
+        l = (l * t) + IQK_LOG2_C1;
+        l = l * t;
+        db[i] = (e + l) * IQK_DB_PER_LOG2;
+    }
+}
+
+
+#ifdef IQK_HAVE_AVX2
+
+/**************************************************************************
+ AVX2 kernels, 8 floats a vector.  Built for AVX2 function by function so
+ the rest of the program does not need it; only called once IQK_Init()
+ has seen the CPU has it.
+**************************************************************************/
+
+#define IQK_AVX2_FN __attribute__((target("avx2")))
+
+IQK_AVX2_FN
+static void IQK_Avx2ToComplex (const int16_t *iq, float *x, unsigned int n)
+{
+    unsigned int i;
+    __m128i      v;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        v = _mm_loadu_si128((const __m128i *)(iq + 2*i));
+        _mm256_storeu_ps(x + 2*i, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)));
+    }
+    IQK_ScalarToComplex(iq + 2*i, x + 2*i, n - i);
+}
+
+
+IQK_AVX2_FN
+static void IQK_Avx2ToComplexWindowed (const int16_t *iq, const float *win,
+                                       float *x, unsigned int n)
+{
+    const __m256i dup = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    unsigned int  i;
+    __m128i       v;
+    __m256        w;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        v = _mm_loadu_si128((const __m128i *)(iq + 2*i));
+        w = _mm256_castps128_ps256(_mm_loadu_ps(win + i));
+        w = _mm256_permutevar8x32_ps(w, dup);
+        _mm256_storeu_ps(x + 2*i,
+                         _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)),
+                                       w));
+    }
+    IQK_ScalarToComplexWindowed(iq + 2*i, win + i, x + 2*i, n - i);
+}
+
+
+IQK_AVX2_FN
+static void IQK_Avx2Split (const int16_t *iq, float *re, float *im,
+                           unsigned int n)
+{
+    unsigned int i;
+    __m256i      v;
+
+    /* each 32-bit lane is one sample, I in the low half */
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        v = _mm256_loadu_si256((const __m256i *)(iq + 2*i));
+        _mm256_storeu_ps(re + i,
+                         _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16)));
+        _mm256_storeu_ps(im + i, _mm256_cvtepi32_ps(_mm256_srai_epi32(v, 16)));
+    }
+    IQK_ScalarSplit(iq + 2*i, re + i, im + i, n - i);
+}
+
+
+IQK_AVX2_FN
+static void IQK_Avx2Power (const float *x, float *pow, unsigned int n)
+{
+    unsigned int i;
+    __m256       a;
+    __m256       b;
+    __m256       s;
+
+    /* hadd pairs re^2 with im^2 within each 128-bit half, leaving the
+     * powers in the order 0 1 4 5 2 3 6 7, which the permute undoes
+     */
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        a = _mm256_loadu_ps(x + 2*i);
+        b = _mm256_loadu_ps(x + 2*i + 8);
+        s = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+        s = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(s),
+                                                   _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_ps(pow + i, s);
+    }
+    IQK_ScalarPower(x + 2*i, pow + i, n - i);
+}
+
+
+IQK_AVX2_FN
+static void IQK_Avx2PowerI16 (const int16_t *iq, float *pow, unsigned int n)
+{
+    unsigned int i;
+    __m256i      v;
+    __m256       re;
+    __m256       im;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        v  = _mm256_loadu_si256((const __m256i *)(iq + 2*i));
+        re = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16));
+        im = _mm256_cvtepi32_ps(_mm256_srai_epi32(v, 16));
+        _mm256_storeu_ps(pow + i, _mm256_add_ps(_mm256_mul_ps(re, re),
+                                                _mm256_mul_ps(im, im)));
+    }
+    IQK_ScalarPowerI16(iq + 2*i, pow + i, n - i);
+}
+
+
+IQK_AVX2_FN
+static void IQK_Avx2Db (const float *pow, float *db, unsigned int n)
+{
+    const __m256  minPow = _mm256_set1_ps(IQK_MIN_POWER);
+    const __m256  dbFloor = _mm256_set1_ps(IQK_DB_FLOOR);
+    const __m256  one    = _mm256_set1_ps(1.0f);
+    const __m256  c1     = _mm256_set1_ps(IQK_LOG2_C1);
+    const __m256  c2     = _mm256_set1_ps(IQK_LOG2_C2);
+    const __m256  c3     = _mm256_set1_ps(IQK_LOG2_C3);
+    const __m256  c4     = _mm256_set1_ps(IQK_LOG2_C4);
+    const __m256  scale  = _mm256_set1_ps(IQK_DB_PER_LOG2);
+    const __m256i bias   = _mm256_set1_epi32(127);
+    const __m256i mant   = _mm256_set1_epi32(0x007fffff);
+    const __m256i oneExp = _mm256_set1_epi32(0x3f800000);
+    unsigned int  i;
+    __m256        p;
+    __m256        low;
+    __m256i       bits;
+    __m256        e;
+    __m256        t;
+    __m256        l;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        p    = _mm256_loadu_ps(pow + i);
+        low  = _mm256_cmp_ps(p, minPow, _CMP_NGE_UQ);
+        bits = _mm256_castps_si256(p);
+        e    = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23),
+                                                   bias));
+        t    = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, mant),
+                                                                 oneExp)),
+                             one);
+
+        l = _mm256_add_ps(_mm256_mul_ps(c4, t), c3);
+        l = _mm256_add_ps(_mm256_mul_ps(l, t), c2);
+        l = _mm256_add_ps(_mm256_mul_ps(l, t), c1);
+        l = _mm256_mul_ps(l, t);
+        l = _mm256_mul_ps(_mm256_add_ps(e, l), scale);
+
+        _mm256_storeu_ps(db + i, _mm256_blendv_ps(l, dbFloor, low));
+    }
+    IQK_ScalarDb(pow + i, db + i, n - i);
+}
+
+
+static const IQK_KERNELS IQK_Avx2 =
+{
+    "avx2",
+    IQK_Avx2ToComplex,
+    IQK_Avx2ToComplexWindowed,
+    IQK_Avx2Split,
+    IQK_Avx2Power,
+    IQK_Avx2PowerI16,
+    IQK_Avx2Db
+};
+
+#endif /* IQK_HAVE_AVX2 */
+
+
+#ifdef IQK_HAVE_NEON
+
+/**************************************************************************
+ NEON kernels, 4 floats a vector.  NEON is part of every AArch64 CPU, so
+ these are always used there once they pass the check.
+**************************************************************************/
+
+static void IQK_NeonToComplex (const int16_t *iq, float *x, unsigned int n)
+{
+    unsigned int i;
+    int16x8_t    v;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        v = vld1q_s16(iq + 2*i);
+        vst1q_f32(x + 2*i,     vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))));
+        vst1q_f32(x + 2*i + 4, vcvtq_f32_s32(vmovl_high_s16(v)));
+    }
+    IQK_ScalarToComplex(iq + 2*i, x + 2*i, n - i);
+}
+
+
+static void IQK_NeonToComplexWindowed (const int16_t *iq, const float *win,
+                                       float *x, unsigned int n)
+{
+    unsigned int i;
+    int16x8_t    v;
+    float32x4_t  w;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        v = vld1q_s16(iq + 2*i);
+        w = vld1q_f32(win + i);
+        vst1q_f32(x + 2*i,     vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))),
+                                         vzip1q_f32(w, w)));
+        vst1q_f32(x + 2*i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_high_s16(v)),
+                                         vzip2q_f32(w, w)));
+    }
+    IQK_ScalarToComplexWindowed(iq + 2*i, win + i, x + 2*i, n - i);
+}
+
+
+static void IQK_NeonSplit (const int16_t *iq, float *re, float *im,
+                           unsigned int n)
+{
+    unsigned int i;
+    int16x8x2_t  v;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        v = vld2q_s16(iq + 2*i);
+        vst1q_f32(re + i,     vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[0]))));
+        vst1q_f32(re + i + 4, vcvtq_f32_s32(vmovl_high_s16(v.val[0])));
+        vst1q_f32(im + i,     vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[1]))));
+        vst1q_f32(im + i + 4, vcvtq_f32_s32(vmovl_high_s16(v.val[1])));
+    }
+    IQK_ScalarSplit(iq + 2*i, re + i, im + i, n - i);
+}
+
+
+static void IQK_NeonPower (const float *x, float *pow, unsigned int n)
+{
+    unsigned int  i;
+    float32x4x2_t v;
+
+    /* separate multiplies and add, not vmla/vfma, to round as plain C */
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        v = vld2q_f32(x + 2*i);
+        vst1q_f32(pow + i, vaddq_f32(vmulq_f32(v.val[0], v.val[0]),
+                                     vmulq_f32(v.val[1], v.val[1])));
+    }
+    IQK_ScalarPower(x + 2*i, pow + i, n - i);
+}
+
+
+static void IQK_NeonPowerI16 (const int16_t *iq, float *pow, unsigned int n)
+{
+    unsigned int i;
+    int16x4x2_t  v;
+    float32x4_t  re;
+    float32x4_t  im;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        v  = vld2_s16(iq + 2*i);
+        re = vcvtq_f32_s32(vmovl_s16(v.val[0]));
+        im = vcvtq_f32_s32(vmovl_s16(v.val[1]));
+        vst1q_f32(pow + i, vaddq_f32(vmulq_f32(re, re), vmulq_f32(im, im)));
+    }
+    IQK_ScalarPowerI16(iq + 2*i, pow + i, n - i);
+}
+
+
+static void IQK_NeonDb (const float *pow, float *db, unsigned int n)
+{
+    const float32x4_t minPow = vdupq_n_f32(IQK_MIN_POWER);
+    const float32x4_t dbFloor = vdupq_n_f32(IQK_DB_FLOOR);
+    const float32x4_t one    = vdupq_n_f32(1.0f);
+    const float32x4_t c1     = vdupq_n_f32(IQK_LOG2_C1);
+    const float32x4_t c2     = vdupq_n_f32(IQK_LOG2_C2);
+    const float32x4_t c3     = vdupq_n_f32(IQK_LOG2_C3);
+    const float32x4_t c4     = vdupq_n_f32(IQK_LOG2_C4);
+    const float32x4_t scale  = vdupq_n_f32(IQK_DB_PER_LOG2);
+    unsigned int      i;
+    float32x4_t       p;
+    uint32x4_t        ok;
+    uint32x4_t        bits;
+    float32x4_t       e;
+    float32x4_t       t;
+    float32x4_t       l;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        p    = vld1q_f32(pow + i);
+        ok   = vcgeq_f32(p, minPow);
+        bits = vreinterpretq_u32_f32(p);
+        e    = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)),
+                                       vdupq_n_s32(127)));
+        t    = vsubq_f32(vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007fffff)),
+                                                         vdupq_n_u32(0x3f800000))),
+                         one);
+
+        l = vaddq_f32(vmulq_f32(c4, t), c3);
+        l = vaddq_f32(vmulq_f32(l, t), c2);
+        l = vaddq_f32(vmulq_f32(l, t), c1);
+        l = vmulq_f32(l, t);
+        l = vmulq_f32(vaddq_f32(e, l), scale);
+
+        vst1q_f32(db + i, vbslq_f32(ok, l, dbFloor));
+    }
+    IQK_ScalarDb(pow + i, db + i, n - i);
+}
+
+
+static const IQK_KERNELS IQK_Neon =
+{
+    "neon",
+    IQK_NeonToComplex,
+    IQK_NeonToComplexWindowed,
+    IQK_NeonSplit,
+    IQK_NeonPower,
+    IQK_NeonPowerI16,
+    IQK_NeonDb
+};
+
+#endif /* IQK_HAVE_NEON */
@@ -0,0 +1,87 @@
+/***********************************************************************
+*
+*   File: iqk.h
+*
+*   Description: header file for iqk.c, vectorised kernels for turning
+*                interleaved int16 I/Q range lines into complex float,
+*                power and dB, for the stages that consume the DMA
+*                buffers (pcomp.c and those after it).
+*
+*                Each kernel has a plain C version and, where the CPU has
+*                them, AVX2 (x86-64) and NEON (AArch64) versions.
+*                IQK_Init() picks the widest set the CPU supports at run
+*                time, then checks every vector kernel against the plain
+*                C one and falls back to plain C for any that disagree
+*                in a single bit.  Until it is called the plain C kernels
+*                are used.
+*
+*                The versions agree bit for bit because they do the same
+*                float operations in the same order: int16 to float is
+*                exact, and fft.c and iqk.c are built with
+*                -ffp-contract=off so no multiply and add is fused in one
+*                version and not another.
+*
+*                Complex float data are re, im interleaved, as fft.c
+*                uses them.
+*
+*                IQK_Db() is 10 log10(x) from the float's exponent and a
+*                4th order polynomial for log2 of its mantissa; the
+*                error is under IQK_DB_ERROR dB.  Powers below
+*                IQK_MIN_POWER (including 0) come out as IQK_DB_FLOOR.
+*
+************************************************************************/
+
+#ifndef __IQK_H__
+#define __IQK_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* IQK_MIN_POWER - smallest power IQK_Db() converts;
+ * IQK_DB_FLOOR - IQK_Db() of IQK_MIN_POWER;
+ * IQK_DB_ERROR - largest error of IQK_Db(), in dB
+ */
+#define IQK_MIN_POWER        1e-20f
+#define IQK_DB_FLOOR         (-200.0f)
+#define IQK_DB_ERROR         0.0004
+
+/* kernel sets, as returned by IQK_Init() */
+#define IQK_SCALAR           0
+#define IQK_AVX2             1
+#define IQK_NEON             2
+
+
+/* function prototypes */
+int         IQK_Init              (int              useSimd);
+const char *IQK_Name              (void);
+
+void        IQK_ToComplex         (const int16_t   *iq,
+                                   float           *x,
+                                   unsigned int     n);
+void        IQK_ToComplexWindowed (const int16_t   *iq,
+                                   const float     *win,
+                                   float           *x,
+                                   unsigned int     n);
+void        IQK_Split             (const int16_t   *iq,
+                                   float           *re,
+                                   float           *im,
+                                   unsigned int     n);
+void        IQK_Power             (const float     *x,
+                                   float           *pow,
+                                   unsigned int     n);
+void        IQK_PowerI16          (const int16_t   *iq,
+                                   float           *pow,
+                                   unsigned int     n);
+void        IQK_Db                (const float     *pow,
+                                   float           *db,
+                                   unsigned int     n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IQK_H__ */
@@ -0,0 +1,450 @@
+/**************************************************************************
+*
+*   File: iqkbench.c
+*
+*   Description: Check and micro-benchmark of the I/Q kernels (iqk.c),
+*                away from the radar.
+*
+*                    compare    - every kernel is run as plain C (before
+*                                 IQK_Init()) and as the set IQK_Init()
+*                                 picks, on full-range int16 lines of the
+*                                 last eight lengths up to the line, so
+*                                 every vector tail is covered; outputs
+*                                 must match bit for bit, and IQK_Db() must
+*                                 be within IQK_DB_ERROR of 10 log10 on
+*                                 powers from 0 and denormals up to
+*                                 float's largest
+*                    throughput - each kernel is run over one line many
+*                                 times, plain C and then the set picked,
+*                                 and the time per line printed
+*
+*                The line stays in cache, so the throughput figures are
+*                the kernels' own, not the memory system's.
+*
+*                Usage:
+*                    iqkbench [options]
+*                    -s samples samples per range line (4096)
+*                    -n lines   lines per kernel timed (100000)
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "iqk.h"
+#include "dmaring.h"
+
+
+/* IQKBENCH_KERNELS - kernels compared and timed, in IQKBENCH_Call() order */
+#define IQKBENCH_KERNELS     6
+
+/* IQKBENCH_TAILS - line lengths compared, ending at the line */
+#define IQKBENCH_TAILS       8
+
+
+/* IQKBENCH_LINE - one line in and the outputs of every kernel
+ *     iq        = n int16 I/Q pairs
+ *     win       = n window weights
+ *     pow       = n powers for IQK_Db()
+ *     cplx      = IQK_ToComplex(), 2n
+ *     cplxWin   = IQK_ToComplexWindowed(), 2n
+ *     re, im    = IQK_Split(), n each
+ *     powF      = IQK_Power() of cplx, n
+ *     powI      = IQK_PowerI16(), n
+ *     db        = IQK_Db() of pow, n
+ */
+typedef struct IQKBENCH_LINE
+        {
+            int16_t    *iq;
+            float      *win;
+            float      *pow;
+            float      *cplx;
+            float      *cplxWin;
+            float      *re;
+            float      *im;
+            float      *powF;
+            float      *powI;
+            float      *db;
+        } IQKBENCH_LINE;
+
+
+static const char *iqkbenchNames[IQKBENCH_KERNELS] =
+{
+    "ToComplex", "ToComplexWindowed", "Split", "Power", "PowerI16", "Db"
+};
+
+
+static int    IQKBENCH_Alloc   (IQKBENCH_LINE *line, unsigned int n);
+static void   IQKBENCH_Free    (IQKBENCH_LINE *line);
+static void   IQKBENCH_Fill    (IQKBENCH_LINE *line, unsigned int n);
+static void   IQKBENCH_Call    (int kernel, IQKBENCH_LINE *line,
+                                unsigned int n);
+static int    IQKBENCH_Compare (int kernel, const IQKBENCH_LINE *ref,
+                                const IQKBENCH_LINE *vec, unsigned int n);
+static double IQKBENCH_Time    (int kernel, IQKBENCH_LINE *line,
+                                unsigned int n, unsigned long lines);
+static void   IQKBENCH_Usage   (void);
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Compares the kernel set IQK_Init() picks with plain C, then
+              times both, and prints PASS or FAIL.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - every kernel matched
+              1 - bad command line, allocation failed, or a kernel
+                  differed
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    IQKBENCH_LINE   ref;
+    IQKBENCH_LINE   vec;
+    unsigned int    samples = 4096;
+    unsigned long   lines   = 100000;
+    unsigned int    n;
+    double          scalarNs[IQKBENCH_KERNELS];
+    double          vecNs;
+    double          dbErr = 0.0;
+    double          want;
+    int             failed[IQKBENCH_KERNELS];
+    int             anyFailed = 0;
+    int             set;
+    int             k;
+    unsigned int    i;
+    int             a;
+
+    for (a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "-s") == 0) && (a + 1 < argc))
+            samples = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-n") == 0) && (a + 1 < argc))
+            lines = (unsigned long)atol(argv[++a]);
+        else
+        {
+            IQKBENCH_Usage();
+            return (1);
+        }
+    }
+    if ((samples < IQKBENCH_TAILS) || (lines == 0))
+    {
+        IQKBENCH_Usage();
+        return (1);
+    }
+
+    if ((IQKBENCH_Alloc(&ref, samples) != 0) ||
+        (IQKBENCH_Alloc(&vec, samples) != 0))
+    {
+        printf("ERROR: no memory for %u-sample lines.\n", samples);
+        return (1);
+    }
+    IQKBENCH_Fill(&ref, samples);
+    memcpy (vec.iq, ref.iq, 2 * samples * sizeof(int16_t));
+    memcpy (vec.win, ref.win, samples * sizeof(float));
+    memcpy (vec.pow, ref.pow, samples * sizeof(float));
+
+    /* plain C first: the kernels are the plain C set until IQK_Init() */
+    IQK_Init(0);
+    for (k = 0; k < IQKBENCH_KERNELS; k++)
+        scalarNs[k] = IQKBENCH_Time(k, &ref, samples, lines);
+
+    set = IQK_Init(1);
+    printf("%u samples per line, %lu lines per kernel, kernels %s\n",
+           samples, lines, IQK_Name());
+    if (set == IQK_SCALAR)
+        printf("no vector set on this CPU; plain C is compared with itself\n");
+
+    for (k = 0; k < IQKBENCH_KERNELS; k++)
+    {
+        failed[k] = 0;
+        for (n = samples - IQKBENCH_TAILS + 1; n <= samples; n++)
+        {
+            IQK_Init(0);
+            IQKBENCH_Call(k, &ref, n);
+            IQK_Init(1);
+            IQKBENCH_Call(k, &vec, n);
+            failed[k] |= IQKBENCH_Compare(k, &ref, &vec, n);
+        }
+        anyFailed |= failed[k];
+    }
+
+    /* IQK_Db() against 10 log10, in double */
+    for (i = 0; i < samples; i++)
+    {
+        if (vec.pow[i] >= IQK_MIN_POWER)
+            want = 10.0 * log10((double)vec.pow[i]);
+        else
+            want = IQK_DB_FLOOR;
+        if (fabs(vec.db[i] - want) > dbErr)
+            dbErr = fabs(vec.db[i] - want);
+    }
+    if (dbErr > IQK_DB_ERROR)
+    {
+        failed[IQKBENCH_KERNELS - 1] = 1;
+        anyFailed = 1;
+    }
+
+    printf("\n%-20s %8s %16s %16s\n", "kernel", "compare",
+           "scalar us (Msps)", "set us (Msps)");
+    for (k = 0; k < IQKBENCH_KERNELS; k++)
+    {
+        vecNs = IQKBENCH_Time(k, &vec, samples, lines);
+        printf("%-20s %8s %8.2f (%5.0f) %8.2f (%5.0f)\n", iqkbenchNames[k],
+               failed[k] ? "FAIL" : "ok",
+               scalarNs[k] / 1e3, samples * 1e3 / scalarNs[k],
+               vecNs / 1e3, samples * 1e3 / vecNs);
+    }
+    printf("\nIQK_Db() largest error %.6f dB, limit %.6f dB\n",
+           dbErr, IQK_DB_ERROR);
+    printf("%s\n", anyFailed ? "FAIL" : "PASS");
+
+    IQKBENCH_Free(&ref);
+    IQKBENCH_Free(&vec);
+
+    return (anyFailed ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    IQKBENCH_Alloc()
+
+ Description: Allocates a line and the outputs of every kernel.
+
+ Parameters:  line - line to allocate
+              n    - samples
+
+ Return:      0 - success
+              1 - allocation failed; nothing is left allocated
+**************************************************************************/
+static int IQKBENCH_Alloc (IQKBENCH_LINE *line, unsigned int n)
+{
+    line->iq      = (int16_t *)malloc(2 * n * sizeof(int16_t));
+    line->win     = (float *)malloc(n * sizeof(float));
+    line->pow     = (float *)malloc(n * sizeof(float));
+    line->cplx    = (float *)malloc(2 * n * sizeof(float));
+    line->cplxWin = (float *)malloc(2 * n * sizeof(float));
+    line->re      = (float *)malloc(n * sizeof(float));
+    line->im      = (float *)malloc(n * sizeof(float));
+    line->powF    = (float *)malloc(n * sizeof(float));
+    line->powI    = (float *)malloc(n * sizeof(float));
+    line->db      = (float *)malloc(n * sizeof(float));
+    if ((line->iq == NULL) || (line->win == NULL) || (line->pow == NULL) ||
+        (line->cplx == NULL) || (line->cplxWin == NULL) ||
+        (line->re == NULL) || (line->im == NULL) || (line->powF == NULL) ||
+        (line->powI == NULL) || (line->db == NULL))
+    {
+        IQKBENCH_Free(line);
+        return (1);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    IQKBENCH_Free()
+
+ Description: Frees what IQKBENCH_Alloc() allocated.
+
+ Parameters:  line - line to free
+
+ Return:      none
+**************************************************************************/
+static void IQKBENCH_Free (IQKBENCH_LINE *line)
+{
+    free(line->iq);
+    free(line->win);
+    free(line->pow);
+    free(line->cplx);
+    free(line->cplxWin);
+    free(line->re);
+    free(line->im);
+    free(line->powF);
+    free(line->powI);
+    free(line->db);
+    memset (line, 0, sizeof(*line));
+}
+
+
+/**************************************************************************
+ Function:    IQKBENCH_Fill()
+
+ Description: Fills a line with pseudo-random samples over the full int16
+              range and both its ends, window weights in [0, 1), and
+              powers that are alternately |x|^2 of the line and any finite
+              non-negative float, with 0, IQK_MIN_POWER, a denormal and
+              float's largest among them.
+
+ Parameters:  line - line to fill
+              n    - samples
+
+ Return:      none
+**************************************************************************/
+static void IQKBENCH_Fill (IQKBENCH_LINE *line, unsigned int n)
+{
+    unsigned int  seed = 2718281;
+    unsigned int  i;
+    uint32_t      bits;
+    float         re;
+    float         im;
+
+    for (i = 0; i < 2 * n; i++)
+    {
+        seed = (seed * 1103515245U) + 12345U;
+        line->iq[i] = (int16_t)(seed >> 16);
+    }
+    line->iq[0] = -32768; line->iq[1] = -32768;
+    line->iq[2] = 32767;  line->iq[3] = -32768;
+    line->iq[4] = 0;      line->iq[5] = 32767;
+
+    for (i = 0; i < n; i++)
+    {
+        seed = (seed * 1103515245U) + 12345U;
+        line->win[i] = (float)(seed >> 8) / 16777216.0f;
+
+        if (i & 1)
+        {
+            seed = (seed * 1103515245U) + 12345U;
+            bits = (seed >> 1) % 0x7f800000U;
+            memcpy (&line->pow[i], &bits, sizeof(float));
+        }
+        else
+        {
+            re = line->iq[2 * i];
+            im = line->iq[2 * i + 1];
+            line->pow[i] = re * re + im * im;
+        }
+    }
+    line->pow[0] = 0.0f;
+    line->pow[1] = IQK_MIN_POWER;
+    line->pow[2] = 1e-40f;
+    line->pow[3] = 3.40282347e38f;
+}
+
+
+/**************************************************************************
+ Function:    IQKBENCH_Call()
+
+ Description: Runs one kernel of the set in use on a line.
+
+ Parameters:  kernel - index into iqkbenchNames
+              line   - line in, and where the output goes
+              n      - samples
+
+ Return:      none
+**************************************************************************/
+static void IQKBENCH_Call (int kernel, IQKBENCH_LINE *line, unsigned int n)
+{
+    switch (kernel)
+    {
+        case 0:
+            IQK_ToComplex(line->iq, line->cplx, n);
+            break;
+        case 1:
+            IQK_ToComplexWindowed(line->iq, line->win, line->cplxWin, n);
+            break;
+        case 2:
+            IQK_Split(line->iq, line->re, line->im, n);
+            break;
+        case 3:
+            /* on the complex line of the same kernel set */
+            IQK_ToComplex(line->iq, line->cplx, n);
+            IQK_Power(line->cplx, line->powF, n);
+            break;
+        case 4:
+            IQK_PowerI16(line->iq, line->powI, n);
+            break;
+        default:
+            IQK_Db(line->pow, line->db, n);
+            break;
+    }
+}
+
+
+/**************************************************************************
+ Function:    IQKBENCH_Compare()
+
+ Description: Compares one kernel's output on two lines bit for bit.
+
+ Parameters:  kernel - index into iqkbenchNames
+              ref    - plain C output
+              vec    - output of the set picked
+              n      - samples
+
+ Return:      0 - identical
+              1 - different
+**************************************************************************/
+static int IQKBENCH_Compare (int kernel, const IQKBENCH_LINE *ref,
+                             const IQKBENCH_LINE *vec, unsigned int n)
+{
+    switch (kernel)
+    {
+        case 0:
+            return (memcmp(ref->cplx, vec->cplx, 2 * n * sizeof(float)) != 0);
+        case 1:
+            return (memcmp(ref->cplxWin, vec->cplxWin,
+                           2 * n * sizeof(float)) != 0);
+        case 2:
+            return ((memcmp(ref->re, vec->re, n * sizeof(float)) != 0) ||
+                    (memcmp(ref->im, vec->im, n * sizeof(float)) != 0));
+        case 3:
+            return (memcmp(ref->powF, vec->powF, n * sizeof(float)) != 0);
+        case 4:
+            return (memcmp(ref->powI, vec->powI, n * sizeof(float)) != 0);
+        default:
+            return (memcmp(ref->db, vec->db, n * sizeof(float)) != 0);
+    }
+}
+
+
+/**************************************************************************
+ Function:    IQKBENCH_Time()
+
+ Description: Times one kernel of the set in use over a line.  Power is
+              timed on its own, on the complex line already made.
+
+ Parameters:  kernel - index into iqkbenchNames
+              line   - line in, and where the output goes
+              n      - samples
+              lines  - times to run the kernel
+
+ Return:      ns per line
+**************************************************************************/
+static double IQKBENCH_Time (int kernel, IQKBENCH_LINE *line,
+                             unsigned int n, unsigned long lines)
+{
+    unsigned long long  start;
+    unsigned long       l;
+
+    IQK_ToComplex(line->iq, line->cplx, n);
+    start = DMARING_TimeNs();
+    for (l = 0; l < lines; l++)
+    {
+        if (kernel == 3)
+            IQK_Power(line->cplx, line->powF, n);
+        else
+            IQKBENCH_Call(kernel, line, n);
+    }
+
+    return ((double)(DMARING_TimeNs() - start) / lines);
+}
+
+
+/**************************************************************************
+ Function:    IQKBENCH_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void IQKBENCH_Usage (void)
+{
+    printf("usage: iqkbench [-s samples] [-n lines]\n");
+}
@@ -0,0 +1,767 @@
+/**************************************************************************
+*
+*   File: iqpack.c
+*
+*   Description: Lossless compression of int16 I/Q range lines and its
+*                worker pool.  See iqpack.h.
+*
+*                The bit stream is written and read through a 64-bit
+*                accumulator, 32 bits at a time on the encoder side, and
+*                refilled up to 56 bits ahead on the decoder side.  A Rice
+*                code (q zeros, a one, then the k low bits) is decoded
+*                with a single count-trailing-zeros.  The decoder never
+*                reads past the end of the block it is given, so it can
+*                decode straight out of a mapped file.
+*
+*                Only the submitting thread writes a slot's src and seq,
+*                and it only does so while the slot is IQPACK_FREE.  A
+*                worker only touches a slot between seeing it
+*                IQPACK_QUEUED with its own sequence number and marking it
+*                IQPACK_DONE.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "iqpack.h"
+#include "dmaring.h"
+
+
+/* IQPACK_WRITER - bit stream being written
+ *     acc = bits not yet stored, LSB first
+ *     n   = number of bits in acc
+ *     p   = where the next byte goes
+ */
+typedef struct IQPACK_WRITER
+        {
+            uint64_t        acc;
+            unsigned int    n;
+            unsigned char  *p;
+        } IQPACK_WRITER;
+
+
+/* IQPACK_READER - bit stream being read
+ *     acc = bits loaded but not consumed, LSB first
+ *     n   = number of bits in acc
+ *     p   = next byte to load
+ *     end = end of the stream; zeros are loaded past it
+ */
+typedef struct IQPACK_READER
+        {
+            uint64_t             acc;
+            unsigned int         n;
+            const unsigned char *p;
+            const unsigned char *end;
+        } IQPACK_READER;
+
+
+static void  IQPACK_EncodeRun  (IQPACK_WRITER *bw, const int16_t *x,
+                                unsigned int n, int order, unsigned int k,
+                                int *p1, int *p2);
+static int   IQPACK_DecodeRun  (IQPACK_READER *br, int16_t *x,
+                                unsigned int n, int order, unsigned int k,
+                                int *p1, int *p2);
+static void *IQPACK_WorkerThread (void *pParams);
+
+
+/**************************************************************************
+ Function:    IQPACK_Put()
+
+ Description: Appends up to 32 bits to a bit stream.
+
+ Parameters:  bw  - the stream
+              v   - the bits; none may be set above bit len - 1
+              len - number of bits
+
+ Return:      none
+**************************************************************************/
+static inline void IQPACK_Put (IQPACK_WRITER *bw, uint32_t v, unsigned int len)
+{
+    bw->acc |= (uint64_t)v << bw->n;
+    bw->n   += len;
+    if (bw->n >= 32)
+    {
+        bw->p[0] = (unsigned char)(bw->acc);
+        bw->p[1] = (unsigned char)(bw->acc >> 8);
+        bw->p[2] = (unsigned char)(bw->acc >> 16);
+        bw->p[3] = (unsigned char)(bw->acc >> 24);
+        bw->p   += 4;
+        bw->acc >>= 32;
+        bw->n   -= 32;
+    }
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_Refill()
+
+ Description: Loads whole bytes into a reader until it holds at least 56
+              bits.  Only called with fewer than 56 bits held.
+
+ Parameters:  br - the stream
+
+ Return:      none
+**************************************************************************/
+static inline void IQPACK_Refill (IQPACK_READER *br)
+{
+    uint64_t     v;
+    unsigned int i;
+
+    if (br->end - br->p >= 8)
+    {
+        v = 0;
+        for (i = 0; i < 8; i++)
+            v |= (uint64_t)br->p[i] << (8 * i);
+        br->acc |= v << br->n;
+        br->p   += (63 - br->n) >> 3;
+        br->n   |= 56;
+        return;
+    }
+
+    while (br->n <= 56)
+    {
+        if (br->p < br->end)
+            br->acc |= (uint64_t)(*br->p) << br->n;
+        br->p++;
+        br->n += 8;
+    }
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_Zigzag()
+
+ Description: Maps a signed residual onto an unsigned one: 0, -1, 1, -2,
+              2 ... become 0, 1, 2, 3, 4 ...
+
+ Parameters:  r - residual
+
+ Return:      zigzag code
+**************************************************************************/
+static inline uint32_t IQPACK_Zigzag (int32_t r)
+{
+    return (((uint32_t)r << 1) ^ (uint32_t)(r >> 31));
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_MaxBytes()
+
+ Description: Returns the largest block IQPACK_Encode() can produce for a
+              line, including slack for its 32-bit stores and padding.
+
+ Parameters:  samples - complex samples per line
+
+ Return:      bytes
+**************************************************************************/
+unsigned int IQPACK_MaxBytes (unsigned int samples)
+{
+    unsigned int subBlocks = (samples + IQPACK_SUB_SAMPLES - 1) /
+                             IQPACK_SUB_SAMPLES;
+
+    return ((unsigned int)sizeof(IQPACK_BLOCK) +
+            (((subBlocks * 14) +
+              (samples * 2 * (IQPACK_ESCAPE + 1 + IQPACK_RAW_BITS)) + 7) / 8) +
+            8 + IQPACK_ALIGN);
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_Encode()
+
+ Description: Packs one line.
+
+ Parameters:  iq      - line: interleaved I, Q
+              samples - complex samples in the line
+              out     - receives the block; IQPACK_MaxBytes(samples) long
+
+ Return:      block length in bytes
+**************************************************************************/
+unsigned int IQPACK_Encode (const int16_t *iq, unsigned int samples,
+                            unsigned char *out)
+{
+    IQPACK_WRITER       bw;
+    IQPACK_BLOCK        hdr;
+    int                 prev[2][2] = {{0, 0}, {0, 0}};
+    int                 order[2];
+    unsigned int        k[2];
+    unsigned long long  sum[3];
+    unsigned int        first;
+    unsigned int        n;
+    unsigned int        c;
+    unsigned int        i;
+    int                 x, p1, p2, o;
+
+    bw.acc = 0;
+    bw.n   = 0;
+    bw.p   = out + sizeof(IQPACK_BLOCK);
+
+    for (first = 0; first < samples; first += IQPACK_SUB_SAMPLES)
+    {
+        n = samples - first;
+        if (n > IQPACK_SUB_SAMPLES)
+            n = IQPACK_SUB_SAMPLES;
+
+        /* pick the predictor with the smallest total residual, and the
+         * Rice parameter near the log2 of its mean
+         */
+        for (c = 0; c < 2; c++)
+        {
+            sum[0] = sum[1] = sum[2] = 0;
+            p1 = prev[c][0];
+            p2 = prev[c][1];
+            for (i = 0; i < n; i++)
+            {
+                x = iq[2 * (first + i) + c];
+                sum[0] += IQPACK_Zigzag(x);
+                sum[1] += IQPACK_Zigzag(x - p1);
+                sum[2] += IQPACK_Zigzag(x - (2 * p1) + p2);
+                p2 = p1;
+                p1 = x;
+            }
+
+            o = 0;
+            if (sum[1] < sum[o])
+                o = 1;
+            if (sum[2] < sum[o])
+                o = 2;
+
+            order[c] = o;
+            k[c]     = 0;
+            while ((k[c] < IQPACK_MAX_K) &&
+                   (((unsigned long long)n << (k[c] + 1)) <= sum[o]))
+                k[c]++;
+
+            IQPACK_Put(&bw, (uint32_t)(o | (k[c] << 2)), 7);
+        }
+
+        for (c = 0; c < 2; c++)
+            IQPACK_EncodeRun(&bw, &iq[(2 * first) + c], n, order[c], k[c],
+                             &prev[c][0], &prev[c][1]);
+    }
+
+    /* store the bits left in the accumulator */
+    while (bw.n > 0)
+    {
+        *bw.p++ = (unsigned char)bw.acc;
+        bw.acc >>= 8;
+        bw.n     = (bw.n > 8) ? bw.n - 8 : 0;
+    }
+
+    /* pad, so that whatever follows the block in a file stays aligned */
+    while (((bw.p - out) % IQPACK_ALIGN) != 0)
+        *bw.p++ = 0;
+
+    hdr.bytes   = (uint32_t)(bw.p - out);
+    hdr.samples = samples;
+    memcpy (out, &hdr, sizeof(IQPACK_BLOCK));
+
+    return (hdr.bytes);
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_Decode()
+
+ Description: Unpacks one line.
+
+ Parameters:  in      - block, as written by IQPACK_Encode()
+              len     - bytes available at in; at least the block length
+              iq      - receives the line: interleaved I, Q
+              samples - complex samples expected
+
+ Return:      0 - success
+              1 - the block is corrupt, truncated, or for another line
+                  length
+**************************************************************************/
+int IQPACK_Decode (const unsigned char *in, unsigned int len,
+                   int16_t *iq, unsigned int samples)
+{
+    IQPACK_READER   br;
+    IQPACK_BLOCK    hdr;
+    int             prev[2][2] = {{0, 0}, {0, 0}};
+    int             order[2];
+    unsigned int    k[2];
+    unsigned int    first;
+    unsigned int    n;
+    unsigned int    c;
+    unsigned int    param;
+
+    if (len < sizeof(IQPACK_BLOCK))
+        return (1);
+    memcpy (&hdr, in, sizeof(IQPACK_BLOCK));
+    if ((hdr.samples != samples) || (hdr.bytes < sizeof(IQPACK_BLOCK)) ||
+        (hdr.bytes > len))
+        return (1);
+
+    br.acc = 0;
+    br.n   = 0;
+    br.p   = in + sizeof(IQPACK_BLOCK);
+    br.end = in + hdr.bytes;
+
+    for (first = 0; first < samples; first += IQPACK_SUB_SAMPLES)
+    {
+        n = samples - first;
+        if (n > IQPACK_SUB_SAMPLES)
+            n = IQPACK_SUB_SAMPLES;
+
+        if (br.n < 14)
+            IQPACK_Refill(&br);
+        for (c = 0; c < 2; c++)
+        {
+            param     = (unsigned int)(br.acc & 0x7F);
+            br.acc  >>= 7;
+            br.n     -= 7;
+            order[c]  = (int)(param & 3);
+            k[c]      = param >> 2;
+            if ((order[c] == 3) || (k[c] > IQPACK_MAX_K))
+                return (1);
+        }
+
+        for (c = 0; c < 2; c++)
+        {
+            if (IQPACK_DecodeRun(&br, &iq[(2 * first) + c], n, order[c],
+                                 k[c], &prev[c][0], &prev[c][1]) != 0)
+                return (1);
+        }
+    }
+
+    /* the bits consumed must all have come from the block */
+    if ((unsigned long long)(br.p - in) * 8 - br.n >
+        (unsigned long long)hdr.bytes * 8)
+        return (1);
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_EncodeRun()
+
+ Description: Writes the Rice codes of one stream (I or Q) of a
+              sub-block.
+
+ Parameters:  bw    - the stream
+              x     - first sample of the stream; samples are 2 apart
+              n     - samples
+              order - predictor order, 0 to 2
+              k     - Rice parameter
+              p1    - previous sample of the stream, updated
+              p2    - the one before, updated
+
+ Return:      none
+**************************************************************************/
+static void IQPACK_EncodeRun (IQPACK_WRITER *bw, const int16_t *x,
+                              unsigned int n, int order, unsigned int k,
+                              int *p1, int *p2)
+{
+    uint32_t        mask = (1U << k) - 1;
+    uint32_t        u;
+    uint32_t        q;
+    unsigned int    i;
+    int             a = *p1;
+    int             b = *p2;
+    int             r;
+
+    for (i = 0; i < n; i++)
+    {
+        r = x[2 * i];
+        if (order == 1)
+            r -= a;
+        else if (order == 2)
+            r -= (2 * a) - b;
+        b = a;
+        a = x[2 * i];
+
+        u = IQPACK_Zigzag(r);
+        q = u >> k;
+        if (q < IQPACK_ESCAPE)
+        {
+            if ((q + 1 + k) <= 32)
+                IQPACK_Put(bw, (1U << q) | ((u & mask) << (q + 1)),
+                           q + 1 + k);
+            else
+            {
+                IQPACK_Put(bw, 1U << q, q + 1);
+                IQPACK_Put(bw, u & mask, k);
+            }
+        }
+        else
+        {
+            IQPACK_Put(bw, 1U << IQPACK_ESCAPE, IQPACK_ESCAPE + 1);
+            IQPACK_Put(bw, u, IQPACK_RAW_BITS);
+        }
+    }
+
+    *p1 = a;
+    *p2 = b;
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_DecodeRun()
+
+ Description: Reads the Rice codes of one stream (I or Q) of a sub-block
+              and rebuilds its samples.
+
+ Parameters:  br    - the stream
+              x     - first sample of the stream; samples are 2 apart
+              n     - samples
+              order - predictor order, 0 to 2
+              k     - Rice parameter
+              p1    - previous sample of the stream, updated
+              p2    - the one before, updated
+
+ Return:      0 - success
+              1 - invalid code
+**************************************************************************/
+static int IQPACK_DecodeRun (IQPACK_READER *br, int16_t *x,
+                             unsigned int n, int order, unsigned int k,
+                             int *p1, int *p2)
+{
+    uint64_t        mask = (1ULL << k) - 1;
+    uint32_t        u;
+    unsigned int    q;
+    unsigned int    i;
+    int             a = *p1;
+    int             b = *p2;
+    int             r;
+
+    for (i = 0; i < n; i++)
+    {
+        /* a code is at most IQPACK_ESCAPE + 1 + IQPACK_RAW_BITS bits */
+        if (br->n < (IQPACK_ESCAPE + 1 + IQPACK_RAW_BITS))
+            IQPACK_Refill(br);
+
+        if ((br->acc & ((1ULL << (IQPACK_ESCAPE + 1)) - 1)) == 0)
+            return (1);
+        q = (unsigned int)__builtin_ctzll(br->acc);
+
+        if (q < IQPACK_ESCAPE)
+        {
+            br->acc >>= q + 1;
+            u = (uint32_t)(((uint64_t)q << k) | (br->acc & mask));
+            br->acc >>= k;
+            br->n    -= q + 1 + k;
+        }
+        else
+        {
+            br->acc >>= IQPACK_ESCAPE + 1;
+            u = (uint32_t)(br->acc & ((1U << IQPACK_RAW_BITS) - 1));
+            br->acc >>= IQPACK_RAW_BITS;
+            br->n    -= IQPACK_ESCAPE + 1 + IQPACK_RAW_BITS;
+        }
+
+        r = (int)(u >> 1) ^ -(int)(u & 1);
+        if (order == 1)
+            r += a;
+        else if (order == 2)
+            r += (2 * a) - b;
+
+        if ((r < -32768) || (r > 32767))
+            return (1);
+        x[2 * i] = (int16_t)r;
+        b = a;
+        a = r;
+    }
+
+    *p1 = a;
+    *p2 = b;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_PoolStart()
+
+ Description: Allocates a pool's slots and starts its workers.
+
+ Parameters:  pool       - pointer to the IQPACK_POOL to initialize
+              numWorkers - workers to start (1 to IQPACK_MAX_WORKERS)
+              numSlots   - lines that can be in the pool at once (at
+                           least numWorkers, at most IQPACK_MAX_SLOTS)
+              samples    - complex samples per line
+
+ Return:      0 - success
+              1 - invalid worker or slot count
+              2 - allocation or thread creation failed
+**************************************************************************/
+int IQPACK_PoolStart (IQPACK_POOL  *pool,
+                      unsigned int  numWorkers,
+                      unsigned int  numSlots,
+                      unsigned int  samples)
+{
+    unsigned int i;
+
+    memset (pool, 0, sizeof(IQPACK_POOL));
+
+    if ((numWorkers == 0) || (numWorkers > IQPACK_MAX_WORKERS) ||
+        (numSlots < numWorkers) || (numSlots > IQPACK_MAX_SLOTS))
+        return (1);
+
+    pool->numSlots = numSlots;
+    pool->samples  = samples;
+    pool->maxBytes = IQPACK_MaxBytes(samples);
+
+    /* touch the output buffers now so they are not faulted in (and
+     * locked) during the run
+     */
+    for (i = 0; i < numSlots; i++)
+    {
+        pool->slot[i].out = (unsigned char *)malloc(pool->maxBytes);
+        if (pool->slot[i].out == NULL)
+        {
+            IQPACK_PoolStop(pool);
+            return (2);
+        }
+        memset (pool->slot[i].out, 0, pool->maxBytes);
+    }
+
+    /* the workers step through the lines by numWorkers, so it is set
+     * before any of them starts
+     */
+    pool->numWorkers = numWorkers;
+    for (i = 0; i < numWorkers; i++)
+    {
+        pool->worker[i].pool  = pool;
+        pool->worker[i].index = i;
+        if (pthread_create(&(pool->worker[i].thread), NULL,
+                           IQPACK_WorkerThread, &(pool->worker[i])) != 0)
+        {
+            pool->numWorkers = i;
+            IQPACK_PoolStop(pool);
+            return (2);
+        }
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_CanSubmit()
+
+ Description: Tells the submitting thread whether a slot is free.  Slots
+              are freed only by IQPACK_Release(), so when this returns 0
+              the caller has to collect and release lines first.
+
+ Parameters:  pool - pointer to a started pool
+
+ Return:      1 - IQPACK_Submit() may be called
+              0 - every slot is in use
+**************************************************************************/
+int IQPACK_CanSubmit (IQPACK_POOL *pool)
+{
+    return ((pool->submitted - pool->released) < pool->numSlots);
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_Submit()
+
+ Description: Queues a line for packing.  The line must stay unchanged
+              until it has been collected.  Check IQPACK_CanSubmit()
+              first.
+
+ Parameters:  pool - pointer to a started pool
+              src  - line: interleaved I, Q, pool->samples long
+
+ Return:      submission number of the line
+**************************************************************************/
+unsigned long long IQPACK_Submit (IQPACK_POOL *pool, const int16_t *src)
+{
+    IQPACK_SLOT *slot = &(pool->slot[pool->submitted % pool->numSlots]);
+
+    slot->src = src;
+    __atomic_store_n(&(slot->seq), pool->submitted, __ATOMIC_RELAXED);
+    __atomic_store_n(&(slot->state), IQPACK_QUEUED, __ATOMIC_RELEASE);
+
+    return (pool->submitted++);
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_Collect()
+
+ Description: Returns the oldest line not yet collected, once it has been
+              packed.  Lines come back in submission order.  The slot
+              stays valid until it is released.
+
+ Parameters:  pool - pointer to a started pool
+              wait - 1 to wait for the line, 0 to return at once
+
+ Return:      the line's slot, or NULL if there is no line to collect
+              (or, without wait, it is not packed yet)
+**************************************************************************/
+IQPACK_SLOT *IQPACK_Collect (IQPACK_POOL *pool, int wait)
+{
+    IQPACK_SLOT     *slot;
+    struct timespec  idle  = {0, IQPACK_SLEEP_NS};
+    unsigned int     spins = 0;
+
+    if (pool->collected == pool->submitted)
+        return (NULL);
+
+    slot = &(pool->slot[pool->collected % pool->numSlots]);
+    while (__atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE) != IQPACK_DONE)
+    {
+        if (!wait)
+            return (NULL);
+        if (spins < IQPACK_SPINS)
+            spins++;
+        else
+            nanosleep(&idle, NULL);
+    }
+
+    pool->collected++;
+    pool->bytesIn  += (unsigned long long)pool->samples * 2 * sizeof(int16_t);
+    pool->bytesOut += slot->packedBytes;
+
+    return (slot);
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_Release()
+
+ Description: Frees the slots of the oldest collected lines once their
+              packed blocks are no longer needed.
+
+ Parameters:  pool  - pointer to a started pool
+              count - lines to release; no more than have been collected
+                      and not released
+
+ Return:      none
+**************************************************************************/
+void IQPACK_Release (IQPACK_POOL *pool, unsigned long long count)
+{
+    IQPACK_SLOT *slot;
+
+    if (count > pool->collected - pool->released)
+        count = pool->collected - pool->released;
+
+    while (count-- > 0)
+    {
+        slot = &(pool->slot[pool->released % pool->numSlots]);
+        __atomic_store_n(&(slot->state), IQPACK_FREE, __ATOMIC_RELEASE);
+        pool->released++;
+    }
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_PoolStop()
+
+ Description: Stops the workers and frees the slots.  Collect every line
+              submitted first; lines still queued are not packed.
+
+ Parameters:  pool - pointer to the pool
+
+ Return:      none
+**************************************************************************/
+void IQPACK_PoolStop (IQPACK_POOL *pool)
+{
+    unsigned int i;
+
+    __atomic_store_n(&(pool->stop), 1, __ATOMIC_RELEASE);
+
+    for (i = 0; i < pool->numWorkers; i++)
+        pthread_join(pool->worker[i].thread, NULL);
+
+    for (i = 0; i < IQPACK_MAX_SLOTS; i++)
+    {
+        free(pool->slot[i].out);
+        pool->slot[i].out = NULL;
+    }
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_Report()
+
+ Description: Prints the compression ratio and the packing rate of each
+              worker, i.e. what one core sustains.
+
+ Parameters:  pool    - pointer to a stopped pool
+              chanNum - ADC channel number
+
+ Return:      none
+**************************************************************************/
+void IQPACK_Report (IQPACK_POOL *pool, int chanNum)
+{
+    IQPACK_WORKER *w;
+    unsigned int   i;
+
+    printf("[dmaThread %d] pack: %u worker(s), %llu lines, %llu -> %llu "
+           "bytes, ratio %.2f\n", chanNum+1, pool->numWorkers,
+           pool->collected, pool->bytesIn, pool->bytesOut,
+           (pool->bytesOut != 0) ?
+               (double)pool->bytesIn / pool->bytesOut : 0.0);
+
+    for (i = 0; i < pool->numWorkers; i++)
+    {
+        w = &(pool->worker[i]);
+        if (w->busyNs == 0)
+            continue;
+        printf("[dmaThread %d] pack: worker %u, %lu lines, %.1f MB/s "
+               "while busy\n", chanNum+1, i, w->lines,
+               ((double)w->lines * pool->samples * 2 * sizeof(int16_t)) /
+               ((double)w->busyNs / 1e9) / 1e6);
+    }
+}
+
+
+/**************************************************************************
+ Function:    IQPACK_WorkerThread()
+
+ Description: Compression worker.  Packs lines index, index + W,
+              index + 2W ... in turn, waiting for each to be submitted.
+              Spins briefly when idle, then sleeps in IQPACK_SLEEP_NS
+              steps.
+
+ Parameters:  pParams - pointer to the worker's IQPACK_WORKER
+
+ Return:      NULL
+**************************************************************************/
+static void *IQPACK_WorkerThread (void *pParams)
+{
+    IQPACK_WORKER      *w    = (IQPACK_WORKER *)pParams;
+    IQPACK_POOL        *pool = w->pool;
+    IQPACK_SLOT        *slot;
+    struct timespec     idle  = {0, IQPACK_SLEEP_NS};
+    unsigned long long  seq   = w->index;
+    unsigned long long  start;
+    unsigned int        spins = 0;
+
+    while (1)
+    {
+        slot = &(pool->slot[seq % pool->numSlots]);
+        if ((__atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE) != IQPACK_QUEUED) ||
+            (__atomic_load_n(&(slot->seq), __ATOMIC_RELAXED) != seq))
+        {
+            if (__atomic_load_n(&(pool->stop), __ATOMIC_ACQUIRE))
+                break;
+            if (spins < IQPACK_SPINS)
+                spins++;
+            else
+                nanosleep(&idle, NULL);
+            continue;
+        }
+
+        spins = 0;
+        start = DMARING_TimeNs();
+        slot->packedBytes = IQPACK_Encode(slot->src, pool->samples, slot->out);
+        w->busyNs += DMARING_TimeNs() - start;
+        w->lines++;
+
+        __atomic_store_n(&(slot->state), IQPACK_DONE, __ATOMIC_RELEASE);
+        seq += pool->numWorkers;
+    }
+
+    return (NULL);
+}
@@ -0,0 +1,193 @@
+/***********************************************************************
+*
+*   File: iqpack.h
+*
+*   Description: header file for iqpack.c, lossless compression of int16
+*                I/Q range lines and the worker pool that compresses them
+*                for the channel writer thread.
+*
+*                Set from NeXtRAD.ini:
+*                    COMPRESS_THREADS - compression workers per channel;
+*                                       0 = write lines uncompressed
+*
+*                Each line is packed into one self-contained block, so
+*                any line can be decoded on its own:
+*
+*                    IQPACK_BLOCK header (block length, samples)
+*                    bit stream, LSB first, per sub-block of
+*                    IQPACK_SUB_SAMPLES complex samples:
+*                        I parameters (7 bits), Q parameters (7 bits)
+*                        Rice codes of the I residuals, then of the Q
+*                        residuals
+*
+*                The I and Q samples are coded as two separate streams.
+*                Each stream has its own predictor, since the two are
+*                independent but each is correlated along range by the
+*                DDC filters.  For every sub-block, the encoder picks the
+*                fixed predictor (none, first or second difference) that
+*                gives the smallest residuals, and a Rice parameter for
+*                their size.  A parameter byte holds order | (k << 2).
+*                A residual too large for its Rice code is escaped as
+*                IQPACK_ESCAPE zeros and a one, then 18 raw bits.
+*
+*                Workers take lines in a fixed rotation (worker w packs
+*                lines w, w + W, w + 2W, ...), and the writer collects
+*                them in submission order.  Output stays in PRI order
+*                without the workers sharing a queue or taking a lock.
+*
+************************************************************************/
+
+#ifndef __IQPACK_H__
+#define __IQPACK_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* IQPACK_SUB_SAMPLES - complex samples sharing one set of parameters;
+ * IQPACK_MAX_K - largest Rice parameter;
+ * IQPACK_ESCAPE - unary length that marks an escaped residual;
+ * IQPACK_RAW_BITS - bits of an escaped residual (zigzag coded)
+ */
+#define IQPACK_SUB_SAMPLES   64
+#define IQPACK_MAX_K         17
+#define IQPACK_ESCAPE        16
+#define IQPACK_RAW_BITS      18
+
+/* IQPACK_ALIGN - blocks are padded to a multiple of this many bytes */
+#define IQPACK_ALIGN         8
+
+/* IQPACK_MAX_WORKERS - compression workers per pool;
+ * IQPACK_MAX_SLOTS - lines a pool can hold between submit and release
+ */
+#define IQPACK_MAX_WORKERS   16
+#define IQPACK_MAX_SLOTS     128
+
+/* IQPACK_SPINS - empty polls before an idle worker starts sleeping;
+ * IQPACK_SLEEP_NS - length of each sleep once idle
+ */
+#define IQPACK_SPINS         256
+#define IQPACK_SLEEP_NS      20000
+
+/* slot states */
+#define IQPACK_FREE          0
+#define IQPACK_QUEUED        1
+#define IQPACK_DONE          2
+
+
+/* IQPACK_BLOCK - header of a packed line
+ *     bytes   = length of the block including this header and its
+ *               padding to IQPACK_ALIGN
+ *     samples = complex samples in the line
+ */
+typedef struct IQPACK_BLOCK
+        {
+            uint32_t    bytes;
+            uint32_t    samples;
+        } IQPACK_BLOCK;
+
+
+/* IQPACK_SLOT - one line passing through a pool
+ *     seq         = submission number of the line in the slot
+ *     state       = IQPACK_FREE, _QUEUED or _DONE
+ *     src         = line to pack; read by the worker
+ *     out         = packed block, IQPACK_MaxBytes() long
+ *     packedBytes = length of the packed block
+ */
+typedef struct IQPACK_SLOT
+        {
+            unsigned long long  seq;
+            int                 state;
+            const int16_t      *src;
+            unsigned char      *out;
+            unsigned int        packedBytes;
+        } IQPACK_SLOT;
+
+
+/* IQPACK_WORKER - one compression worker
+ *     pool   = the worker's pool
+ *     index  = worker number; it packs lines index, index + W, ...
+ *     lines  = lines packed
+ *     busyNs = time spent packing, in ns
+ *     thread = worker thread
+ */
+typedef struct IQPACK_WORKER
+        {
+            struct IQPACK_POOL *pool;
+            unsigned int        index;
+            unsigned long       lines;
+            unsigned long long  busyNs;
+            pthread_t           thread;
+        } IQPACK_WORKER;
+
+
+/* IQPACK_POOL - compression workers for one channel
+ *     numWorkers = workers started
+ *     numSlots   = slots in use
+ *     samples    = complex samples per line
+ *     maxBytes   = size of each slot's output buffer
+ *     slot       = line slots, used round robin by submission number
+ *     worker     = workers
+ *
+ *   owned by the submitting (writer) thread:
+ *     submitted  = lines submitted
+ *     collected  = lines collected
+ *     released   = lines whose slots have been freed
+ *     bytesIn    = bytes of lines collected, before packing
+ *     bytesOut   = bytes of lines collected, after packing
+ *     stop       = set by IQPACK_PoolStop() to end the workers
+ */
+typedef struct IQPACK_POOL
+        {
+            unsigned int        numWorkers;
+            unsigned int        numSlots;
+            unsigned int        samples;
+            unsigned int        maxBytes;
+            IQPACK_SLOT         slot[IQPACK_MAX_SLOTS];
+            IQPACK_WORKER       worker[IQPACK_MAX_WORKERS];
+
+            unsigned long long  submitted;
+            unsigned long long  collected;
+            unsigned long long  released;
+            unsigned long long  bytesIn;
+            unsigned long long  bytesOut;
+            int                 stop;
+        } IQPACK_POOL;
+
+
+/* function prototypes - codec */
+unsigned int IQPACK_MaxBytes  (unsigned int        samples);
+unsigned int IQPACK_Encode    (const int16_t      *iq,
+                               unsigned int        samples,
+                               unsigned char      *out);
+int          IQPACK_Decode    (const unsigned char *in,
+                               unsigned int        len,
+                               int16_t            *iq,
+                               unsigned int        samples);
+
+/* function prototypes - worker pool */
+int          IQPACK_PoolStart (IQPACK_POOL        *pool,
+                               unsigned int        numWorkers,
+                               unsigned int        numSlots,
+                               unsigned int        samples);
+int          IQPACK_CanSubmit (IQPACK_POOL        *pool);
+unsigned long long
+             IQPACK_Submit    (IQPACK_POOL        *pool,
+                               const int16_t      *src);
+IQPACK_SLOT *IQPACK_Collect   (IQPACK_POOL        *pool,
+                               int                 wait);
+void         IQPACK_Release   (IQPACK_POOL        *pool,
+                               unsigned long long  count);
+void         IQPACK_PoolStop  (IQPACK_POOL        *pool);
+void         IQPACK_Report    (IQPACK_POOL        *pool,
+                               int                 chanNum);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IQPACK_H__ */
@@ -0,0 +1,253 @@
+/**************************************************************************
+*
+*   File: lathist.c
+*
+*   Description: Log-linear latency histograms.  See lathist.h.
+*
+*                Histograms can be dumped on demand by sending the process
+*                a signal.  The signal is blocked in every thread, and a
+*                dump thread waits for it with sigwait().  The printing is
+*                done on that thread, away from both the signal context and
+*                the acquisition threads.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "lathist.h"
+
+
+/* LATHIST_CAL_LOOPS - stamps timed by LATHIST_Overhead() */
+#define LATHIST_CAL_LOOPS   1000000
+
+
+static void *LATHIST_DumpThread (void *pParams);
+
+static int     dumpSigNo;
+static void  (*dumpCallback)(void);
+
+
+/**************************************************************************
+ Function:    LATHIST_Init()
+
+ Description: Empties a histogram.
+
+ Parameters:  hist - pointer to the histogram
+              name - stage name used when printing
+
+ Return:      none
+**************************************************************************/
+void LATHIST_Init (LAT_HIST *hist, const char *name)
+{
+    memset (hist, 0, sizeof(LAT_HIST));
+    hist->name = name;
+}
+
+
+/**************************************************************************
+ Function:    LATHIST_Percentile()
+
+ Description: Returns the value below which a given percentage of the
+              recorded values fall, as the midpoint of its bucket (but no
+              more than the largest value recorded).
+
+ Parameters:  hist    - pointer to the histogram
+              percent - 0 to 100
+
+ Return:      value in ns, or 0 if the histogram is empty
+**************************************************************************/
+unsigned long long LATHIST_Percentile (LAT_HIST *hist, double percent)
+{
+    unsigned long       total = __atomic_load_n(&(hist->total), __ATOMIC_RELAXED);
+    unsigned long       seen  = 0;
+    unsigned long       target;
+    unsigned long long  lower;
+    unsigned long long  width;
+    unsigned int        group;
+    unsigned int        i;
+
+    if (total == 0)
+        return (0);
+
+    target = (unsigned long)((percent / 100.0) * total);
+    if (target >= total)
+        target = total - 1;
+
+    for (i = 0; i < LATHIST_BUCKETS; i++)
+    {
+        seen += __atomic_load_n(&(hist->count[i]), __ATOMIC_RELAXED);
+        if (seen > target)
+            break;
+    }
+    if (i == LATHIST_BUCKETS)
+        i = LATHIST_BUCKETS - 1;
+
+    if (i < LATHIST_SUB_COUNT)
+        return (i);
+
+    group = i >> LATHIST_SUB_BITS;
+    width = 1ULL << (group - 1);
+    lower = (unsigned long long)(LATHIST_SUB_COUNT + (i & (LATHIST_SUB_COUNT - 1)))
+            << (group - 1);
+
+    lower += width / 2;
+    width  = __atomic_load_n(&(hist->max), __ATOMIC_RELAXED);
+
+    return ((lower < width) ? lower : width);
+}
+
+
+/**************************************************************************
+ Function:    LATHIST_Print()
+
+ Description: Prints one line summarizing a histogram: count and the 50th,
+              90th, 99th and 99.9th percentiles and maximum in us.
+
+ Parameters:  hist   - pointer to the histogram
+              prefix - text printed at the start of the line
+
+ Return:      none
+**************************************************************************/
+void LATHIST_Print (LAT_HIST *hist, const char *prefix)
+{
+    unsigned long total = __atomic_load_n(&(hist->total), __ATOMIC_RELAXED);
+
+    if (total == 0)
+    {
+        printf("%s %-18s no samples\n", prefix, hist->name);
+        return;
+    }
+
+    printf("%s %-18s n %-9lu p50 %9.1f  p90 %9.1f  p99 %9.1f  "
+           "p99.9 %9.1f  max %9.1f us\n", prefix, hist->name, total,
+           LATHIST_Percentile(hist, 50.0) / 1e3,
+           LATHIST_Percentile(hist, 90.0) / 1e3,
+           LATHIST_Percentile(hist, 99.0) / 1e3,
+           LATHIST_Percentile(hist, 99.9) / 1e3,
+           __atomic_load_n(&(hist->max), __ATOMIC_RELAXED) / 1e3);
+}
+
+
+/**************************************************************************
+ Function:    LATHIST_Overhead()
+
+ Description: Measures the cost of one stamp: a CLOCK_MONOTONIC read plus
+              a histogram update.
+
+ Parameters:  none
+
+ Return:      ns per stamp
+**************************************************************************/
+double LATHIST_Overhead (void)
+{
+    static LAT_HIST  cal;
+    struct timespec  ts;
+    struct timespec  start;
+    struct timespec  end;
+    unsigned long long prev = 0;
+    unsigned long long now;
+    unsigned int     i;
+
+    LATHIST_Init(&cal, "calibration");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < LATHIST_CAL_LOOPS; i++)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now = ((unsigned long long)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+        LATHIST_Record(&cal, now - prev);
+        prev = now;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((((end.tv_sec - start.tv_sec) * 1e9) +
+             (end.tv_nsec - start.tv_nsec)) / LATHIST_CAL_LOOPS);
+}
+
+
+/**************************************************************************
+ Function:    LATHIST_BlockSignal()
+
+ Description: Blocks the dump signal in the calling thread.  Call from
+              main() before any other thread is created, so every thread
+              inherits the mask and only the dump thread receives it.
+
+ Parameters:  signo - signal used to request a dump (e.g. SIGUSR1)
+
+ Return:      0 - success
+              1 - failed
+**************************************************************************/
+int LATHIST_BlockSignal (int signo)
+{
+    sigset_t set;
+
+    sigemptyset(&set);
+    sigaddset(&set, signo);
+
+    return ((pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    LATHIST_StartDump()
+
+ Description: Starts a detached thread that calls dumpFn each time signo
+              is received.  The signal must already be blocked with
+              LATHIST_BlockSignal().
+
+ Parameters:  signo  - signal used to request a dump
+              dumpFn - function that prints the histograms
+
+ Return:      0 - success
+              1 - thread creation failed
+**************************************************************************/
+int LATHIST_StartDump (int signo, void (*dumpFn)(void))
+{
+    pthread_t thread;
+
+    dumpSigNo    = signo;
+    dumpCallback = dumpFn;
+
+    if (pthread_create(&thread, NULL, LATHIST_DumpThread, NULL) != 0)
+        return (1);
+    pthread_detach(thread);
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    LATHIST_DumpThread()
+
+ Description: Dump thread.  Waits for the dump signal and calls the dump
+              function, for the life of the process.
+
+ Parameters:  pParams - unused
+
+ Return:      NULL (never returns)
+**************************************************************************/
+static void *LATHIST_DumpThread (void *pParams)
+{
+    sigset_t set;
+    int      signo;
+
+    (void)pParams;
+
+    sigemptyset(&set);
+    sigaddset(&set, dumpSigNo);
+
+    while (1)
+    {
+        if (sigwait(&set, &signo) == 0)
+        {
+            dumpCallback();
+            fflush(stdout);
+        }
+    }
+
+    return (NULL);
+}
@@ -0,0 +1,115 @@
+/***********************************************************************
+*
+*   File: lathist.h
+*
+*   Description: header file for lathist.c, lock-free log-linear latency
+*                histograms for the acquisition pipeline.
+*
+*                Each histogram has one writer thread.  Recording a value
+*                finds its bucket with a count-leading-zeros and bumps two
+*                counters with plain (relaxed) stores: no locks, no atomic
+*                read-modify-write, no system calls.  Any thread may read a
+*                histogram while it is being written; the snapshot is
+*                consistent per bucket.
+*
+*                Buckets are HDR style: each power of two is split into
+*                2^LATHIST_SUB_BITS equal steps, so a reported value is
+*                within 1/2^LATHIST_SUB_BITS of the true one over the
+*                whole range from 1 ns to LATHIST_MAX_NS.
+*
+************************************************************************/
+
+#ifndef __LATHIST_H__
+#define __LATHIST_H__
+
+#include <stdio.h>
+
+
+/* LATHIST_SUB_BITS - linear steps per power of two (as a power of two);
+ * LATHIST_MAX_BITS - values of 2^LATHIST_MAX_BITS ns and over go into the
+ *                    last bucket (about 18 minutes at 40)
+ */
+#define LATHIST_SUB_BITS    4
+#define LATHIST_SUB_COUNT   (1 << LATHIST_SUB_BITS)
+#define LATHIST_MAX_BITS    40
+#define LATHIST_MAX_NS      (1ULL << LATHIST_MAX_BITS)
+#define LATHIST_BUCKETS     ((LATHIST_MAX_BITS - LATHIST_SUB_BITS + 1) * LATHIST_SUB_COUNT)
+
+
+/* LAT_HIST - one latency histogram
+ *     name   = stage name used when printing
+ *     total  = values recorded
+ *     max    = largest value recorded, in ns
+ *     count  = values recorded in each bucket
+ */
+typedef struct LAT_HIST
+        {
+            const char         *name;
+            unsigned long       total;
+            unsigned long long  max;
+            unsigned long       count[LATHIST_BUCKETS];
+        } LAT_HIST;
+
+
+/**************************************************************************
+ Function:    LATHIST_Bucket()
+
+ Description: Returns the bucket a value falls in.
+
+ Parameters:  ns - value in ns
+
+ Return:      bucket index
+**************************************************************************/
+static inline unsigned int LATHIST_Bucket (unsigned long long ns)
+{
+    unsigned int msb;
+
+    if (ns < LATHIST_SUB_COUNT)
+        return ((unsigned int)ns);
+    if (ns >= LATHIST_MAX_NS)
+        return (LATHIST_BUCKETS - 1);
+
+    msb = 63 - __builtin_clzll(ns);
+
+    return (((msb - LATHIST_SUB_BITS + 1) << LATHIST_SUB_BITS) +
+            (unsigned int)((ns >> (msb - LATHIST_SUB_BITS)) &
+                           (LATHIST_SUB_COUNT - 1)));
+}
+
+
+/**************************************************************************
+ Function:    LATHIST_Record()
+
+ Description: Adds a value to a histogram.  Only the histogram's own
+              writer thread may call this.
+
+ Parameters:  hist - pointer to the histogram
+              ns   - latency in ns
+
+ Return:      none
+**************************************************************************/
+static inline void LATHIST_Record (LAT_HIST *hist, unsigned long long ns)
+{
+    unsigned int bucket = LATHIST_Bucket(ns);
+
+    __atomic_store_n(&(hist->count[bucket]), hist->count[bucket] + 1,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&(hist->total), hist->total + 1, __ATOMIC_RELAXED);
+    if (ns > hist->max)
+        __atomic_store_n(&(hist->max), ns, __ATOMIC_RELAXED);
+}
+
+
+/* function prototypes */
+void               LATHIST_Init        (LAT_HIST     *hist,
+                                        const char   *name);
+unsigned long long LATHIST_Percentile  (LAT_HIST     *hist,
+                                        double        percent);
+void               LATHIST_Print       (LAT_HIST     *hist,
+                                        const char   *prefix);
+double             LATHIST_Overhead    (void);
+int                LATHIST_BlockSignal (int           signo);
+int                LATHIST_StartDump   (int           signo,
+                                        void        (*dumpFn)(void));
+
+#endif /* __LATHIST_H__ */
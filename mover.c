@@ -0,0 +1,524 @@
+/**************************************************************************
+*
+*   File: mover.c
+*
+*   Description: Background migration of staged recordings to the share.
+*                See mover.h.
+*
+*                A file is first copied to <name>.part in the destination
+*                directory and renamed once it has been read back and its
+*                CRC-32 matches.  A half-copied file therefore never shows
+*                up under its real name.  If anything fails the staged
+*                original is kept and the failure is counted.  If only
+*                deleting the original fails, the copy stands and the
+*                file is counted as moved and as not removed.
+*
+*                The thread runs at the lowest CPU priority and in the idle
+*                I/O class.  The staged file is dropped from the page cache
+*                as it is read, so the mover does not compete with the
+*                channel writers for memory.
+*
+**************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "mover.h"
+#include "dmaring.h"
+
+
+/* MOVER_NICE - nice value of the mover thread;
+ * IOPRIO_* - ioprio_set() arguments (no glibc wrapper exists)
+ */
+#define MOVER_NICE             19
+#define IOPRIO_WHO_PROCESS     1
+#define IOPRIO_CLASS_IDLE      3
+#define IOPRIO_CLASS_SHIFT     13
+
+
+static unsigned int        crcTable[256];
+
+static void               *MOVER_Thread     (void *pParams);
+static int                 MOVER_MoveFile   (MOVER *mover, char *buf,
+                                             const char *fileName);
+static int                 MOVER_CrcFile    (const char *path, char *buf,
+                                             unsigned int *crc);
+static int                 MOVER_WriteAll   (int fd, const char *buf,
+                                             size_t len);
+
+
+/**************************************************************************
+ Function:    MOVER_Start()
+
+ Description: Starts the mover thread.
+
+ Parameters:  mover    - pointer to the MOVER to initialize
+              srcDir   - staging directory
+              dstDir   - destination directory
+              rateMBps - copy rate limit in MB/s, 0 for no limit
+
+ Return:      0 - success
+              1 - directory path too long, or the queue could not be
+                  allocated
+              2 - thread creation failed
+**************************************************************************/
+int MOVER_Start (MOVER        *mover,
+                 const char   *srcDir,
+                 const char   *dstDir,
+                 unsigned int  rateMBps)
+{
+    unsigned int crc;
+    unsigned int i;
+    unsigned int bit;
+
+    memset (mover, 0, sizeof(MOVER));
+
+    if ((strlen(srcDir) >= MOVER_PATH_LEN) || (strlen(dstDir) >= MOVER_PATH_LEN))
+        return (1);
+
+    strcpy(mover->srcDir, srcDir);
+    strcpy(mover->dstDir, dstDir);
+    mover->rateMBps = rateMBps;
+
+    mover->queue = malloc(MOVER_MIN_FILES * MOVER_PATH_LEN);
+    if (mover->queue == NULL)
+        return (1);
+    mover->queueSize = MOVER_MIN_FILES;
+
+    /* CRC-32 (IEEE 802.3, reflected), as used by zlib and cksum -a crc32b */
+    for (i = 0; i < 256; i++)
+    {
+        crc = i;
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320) : (crc >> 1);
+        crcTable[i] = crc;
+    }
+
+    pthread_mutex_init(&(mover->lock), NULL);
+    pthread_cond_init(&(mover->ready), NULL);
+
+    if (pthread_create(&(mover->thread), NULL, MOVER_Thread, mover) != 0)
+    {
+        free(mover->queue);
+        mover->queue = NULL;
+        return (2);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    MOVER_Enqueue()
+
+ Description: Queues a closed file in the staging directory to be moved.
+              Does not wait for any I/O; the lock is only ever held to
+              update the queue.  A full queue is doubled, so files are
+              not turned away however far the mover falls behind.
+
+ Parameters:  mover    - pointer to a started MOVER
+              fileName - file name, relative to the staging directory
+
+ Return:      0 - success
+              1 - name too long, or the queue could not grow; the file
+                  stays in staging
+**************************************************************************/
+int MOVER_Enqueue (MOVER *mover, const char *fileName)
+{
+    char         (*grown)[MOVER_PATH_LEN];
+    unsigned int   i;
+    int            status = 0;
+
+    if (strlen(fileName) >= MOVER_PATH_LEN)
+        return (1);
+
+    pthread_mutex_lock(&(mover->lock));
+    if (mover->queueCount >= mover->queueSize)
+    {
+        /* the names are moved to the front of the new queue in order */
+        grown = malloc((size_t)mover->queueSize * 2 * MOVER_PATH_LEN);
+        if (grown == NULL)
+            status = 1;
+        else
+        {
+            for (i = 0; i < mover->queueCount; i++)
+                strcpy(grown[i], mover->queue[(mover->queueHead + i) %
+                                              mover->queueSize]);
+            free(mover->queue);
+            mover->queue      = grown;
+            mover->queueSize *= 2;
+            mover->queueHead  = 0;
+        }
+    }
+    if (status == 0)
+    {
+        strcpy(mover->queue[(mover->queueHead + mover->queueCount) %
+                            mover->queueSize], fileName);
+        mover->queueCount++;
+        pthread_cond_signal(&(mover->ready));
+    }
+    pthread_mutex_unlock(&(mover->lock));
+
+    return (status);
+}
+
+
+/**************************************************************************
+ Function:    MOVER_Stop()
+
+ Description: Waits for the queued files to be moved, then ends the mover
+              thread.
+
+ Parameters:  mover - pointer to a started MOVER
+
+ Return:      none
+**************************************************************************/
+void MOVER_Stop (MOVER *mover)
+{
+    pthread_mutex_lock(&(mover->lock));
+    mover->stop = 1;
+    pthread_cond_signal(&(mover->ready));
+    pthread_mutex_unlock(&(mover->lock));
+
+    pthread_join(mover->thread, NULL);
+
+    pthread_cond_destroy(&(mover->ready));
+    pthread_mutex_destroy(&(mover->lock));
+    free(mover->queue);
+    mover->queue = NULL;
+}
+
+
+/**************************************************************************
+ Function:    MOVER_Report()
+
+ Description: Prints the mover statistics.
+
+ Parameters:  mover - pointer to a stopped MOVER
+
+ Return:      none
+**************************************************************************/
+void MOVER_Report (MOVER *mover)
+{
+    printf("[mover] %lu file(s) moved to %s, %lu failed\n",
+           mover->filesMoved, mover->dstDir, mover->filesFailed);
+    if (mover->filesNotRemoved != 0)
+        printf("[mover] %lu moved file(s) could not be removed from %s\n",
+               mover->filesNotRemoved, mover->srcDir);
+
+    if (mover->moveNs != 0)
+    {
+        printf("[mover] %.1f MB in %.1f s, %.1f MB/s\n",
+               mover->bytesMoved / 1e6, mover->moveNs / 1e9,
+               ((double)mover->bytesMoved / 1e6) /
+               ((double)mover->moveNs / 1e9));
+    }
+}
+
+
+/**************************************************************************
+ Function:    MOVER_Crc32()
+
+ Description: Updates a CRC-32 with a block of data.  Start with crc = 0.
+              The table is built by MOVER_Start().
+
+ Parameters:  crc - CRC of the data so far
+              buf - next block of data
+              len - length of the block in bytes
+
+ Return:      updated CRC
+**************************************************************************/
+unsigned int MOVER_Crc32 (unsigned int crc, const void *buf, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)buf;
+
+    crc = ~crc;
+    while (len--)
+        crc = crcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    return (~crc);
+}
+
+
+/**************************************************************************
+ Function:    MOVER_Thread()
+
+ Description: Mover thread.  Drops to idle CPU and I/O priority, then
+              moves queued files one at a time until stopped with an
+              empty queue.
+
+ Parameters:  pParams - pointer to the MOVER
+
+ Return:      NULL
+**************************************************************************/
+static void *MOVER_Thread (void *pParams)
+{
+    MOVER *mover = (MOVER *)pParams;
+    char   fileName[MOVER_PATH_LEN];
+    char  *buf;
+    pid_t  tid   = (pid_t)syscall(SYS_gettid);
+    int    status;
+
+    /* both apply to this thread only on Linux */
+    setpriority(PRIO_PROCESS, tid, MOVER_NICE);
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid,
+            IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+
+    buf = malloc(MOVER_CHUNK_BYTES);
+
+    pthread_mutex_lock(&(mover->lock));
+
+    while (1)
+    {
+        while ((mover->queueCount == 0) && (!mover->stop))
+            pthread_cond_wait(&(mover->ready), &(mover->lock));
+
+        if (mover->queueCount == 0)
+            break;
+
+        strcpy(fileName, mover->queue[mover->queueHead]);
+        mover->queueHead = (mover->queueHead + 1) % mover->queueSize;
+        mover->queueCount--;
+        pthread_mutex_unlock(&(mover->lock));
+
+        status = (buf == NULL) ? 1 : MOVER_MoveFile(mover, buf, fileName);
+        if (status == 1)
+        {
+            printf("[mover] Failed to move %s, left in %s\n",
+                   fileName, mover->srcDir);
+            mover->filesFailed++;
+        }
+        else
+        {
+            if (status == 2)
+            {
+                printf("[mover] Moved %s, but could not remove it from %s\n",
+                       fileName, mover->srcDir);
+                mover->filesNotRemoved++;
+            }
+            mover->filesMoved++;
+        }
+
+        pthread_mutex_lock(&(mover->lock));
+    }
+
+    pthread_mutex_unlock(&(mover->lock));
+    free(buf);
+
+    return (NULL);
+}
+
+
+/**************************************************************************
+ Function:    MOVER_MoveFile()
+
+ Description: Copies one file to <dstDir>/<name>.part at no more than
+              rateMBps, reads the copy back and compares CRCs, then
+              renames it, writes <name>.crc32 and deletes the original.
+              Once the copy has been renamed the file counts as moved,
+              whether or not the original can be deleted.
+
+ Parameters:  mover    - pointer to the MOVER
+              buf      - MOVER_CHUNK_BYTES work buffer
+              fileName - file name, relative to the staging directory
+
+ Return:      0 - success
+              1 - failed; the original is kept
+              2 - moved, but the original could not be deleted
+**************************************************************************/
+static int MOVER_MoveFile (MOVER *mover, char *buf, const char *fileName)
+{
+    char                srcPath[2 * MOVER_PATH_LEN];
+    char                dstPath[2 * MOVER_PATH_LEN];
+    char                tmpPath[2 * MOVER_PATH_LEN + 8];
+    char                crcLine[MOVER_PATH_LEN + 16];
+    unsigned long long  start = DMARING_TimeNs();
+    unsigned long long  copied = 0;
+    unsigned long long  dueNs;
+    unsigned long long  nowNs;
+    struct timespec     pause;
+    unsigned int        crc = 0;
+    unsigned int        crcCopy;
+    ssize_t             count;
+    int                 src;
+    int                 dst;
+    int                 status = 0;
+
+    snprintf(srcPath, sizeof(srcPath), "%s/%s", mover->srcDir, fileName);
+    snprintf(dstPath, sizeof(dstPath), "%s/%s", mover->dstDir, fileName);
+    snprintf(tmpPath, sizeof(tmpPath), "%s.part", dstPath);
+
+    src = open(srcPath, O_RDONLY);
+    if (src < 0)
+        return (1);
+
+    dst = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dst < 0)
+    {
+        close(src);
+        return (1);
+    }
+
+    while (1)
+    {
+        count = read(src, buf, MOVER_CHUNK_BYTES);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            status = 1;
+            break;
+        }
+        if (count == 0)
+            break;
+
+        crc = MOVER_Crc32(crc, buf, count);
+        if (MOVER_WriteAll(dst, buf, count) != 0)
+        {
+            status = 1;
+            break;
+        }
+
+        posix_fadvise(src, (off_t)copied, count, POSIX_FADV_DONTNEED);
+        copied += count;
+
+        /* hold the average rate down to rateMBps */
+        if (mover->rateMBps != 0)
+        {
+            dueNs = start + (copied * 1000ULL) / mover->rateMBps;
+            nowNs = DMARING_TimeNs();
+            if (dueNs > nowNs)
+            {
+                pause.tv_sec  = (dueNs - nowNs) / 1000000000ULL;
+                pause.tv_nsec = (dueNs - nowNs) % 1000000000ULL;
+                nanosleep(&pause, NULL);
+            }
+        }
+    }
+
+    close(src);
+
+    if (fsync(dst) != 0)
+        status = 1;
+    posix_fadvise(dst, 0, 0, POSIX_FADV_DONTNEED);
+    if (close(dst) != 0)
+        status = 1;
+
+    if ((status == 0) && (MOVER_CrcFile(tmpPath, buf, &crcCopy) != 0))
+        status = 1;
+    if ((status == 0) && (crcCopy != crc))
+    {
+        printf("[mover] CRC mismatch on %s: %08x, copy %08x\n",
+               fileName, crc, crcCopy);
+        status = 1;
+    }
+
+    if (status != 0)
+    {
+        unlink(tmpPath);
+        return (1);
+    }
+
+    if (rename(tmpPath, dstPath) != 0)
+        return (1);
+
+    snprintf(tmpPath, sizeof(tmpPath), "%s.crc32", dstPath);
+    snprintf(crcLine, sizeof(crcLine), "%08x  %s\n", crc, fileName);
+    dst = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dst >= 0)
+    {
+        MOVER_WriteAll(dst, crcLine, strlen(crcLine));
+        close(dst);
+    }
+
+    mover->bytesMoved += copied;
+    mover->moveNs     += DMARING_TimeNs() - start;
+
+    return ((unlink(srcPath) != 0) ? 2 : 0);
+}
+
+
+/**************************************************************************
+ Function:    MOVER_CrcFile()
+
+ Description: Computes the CRC-32 of a whole file.
+
+ Parameters:  path - file to read
+              buf  - MOVER_CHUNK_BYTES work buffer
+              crc  - receives the CRC
+
+ Return:      0 - success
+              1 - open or read failed
+**************************************************************************/
+static int MOVER_CrcFile (const char *path, char *buf, unsigned int *crc)
+{
+    ssize_t count;
+    int     fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return (1);
+
+    *crc = 0;
+    while ((count = read(fd, buf, MOVER_CHUNK_BYTES)) != 0)
+    {
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            close(fd);
+            return (1);
+        }
+        *crc = MOVER_Crc32(*crc, buf, count);
+    }
+
+    close(fd);
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    MOVER_WriteAll()
+
+ Description: Writes a whole buffer, retrying after signals and partial
+              writes.
+
+ Parameters:  fd  - file descriptor
+              buf - data to write
+              len - bytes to write
+
+ Return:      0 - success
+              1 - write failed
+**************************************************************************/
+static int MOVER_WriteAll (int fd, const char *buf, size_t len)
+{
+    ssize_t count;
+
+    while (len > 0)
+    {
+        count = write(fd, buf, len);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return (1);
+        }
+        buf += count;
+        len -= count;
+    }
+
+    return (0);
+}
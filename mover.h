@@ -0,0 +1,98 @@
+/***********************************************************************
+*
+*   File: mover.h
+*
+*   Description: header file for mover.c, the background thread that
+*                migrates finished recordings from a local staging
+*                directory to the /smbtest share.
+*
+*                With STAGING_DIR set in NeXtRAD.ini the channel writers
+*                record to fast local storage, so SMB latency is no longer
+*                in the acquisition path.  Each file is queued with
+*                MOVER_Enqueue() once it is closed.  The mover copies it
+*                at idle I/O priority, throttled to a set rate, computes a
+*                CRC-32 while copying, reads the copy back to check it,
+*                and only then deletes the staged original.  A
+*                <name>.crc32 file is left next to each copy.  A file
+*                whose copy is in place but whose original could not be
+*                deleted counts as moved, and also as not removed: it
+*                must not be queued again, but staging will not empty.
+*
+*                The module uses only POSIX file I/O, so it can be tested
+*                with two local directories standing in for the share.
+*
+************************************************************************/
+
+#ifndef __MOVER_H__
+#define __MOVER_H__
+
+#include <stddef.h>
+#include <pthread.h>
+
+
+/* MOVER_PATH_LEN - longest directory or file path handled;
+ * MOVER_MIN_FILES - files the queue first has room for; it grows by
+ *                   doubling, so a mover behind the recording never
+ *                   turns a file away;
+ * MOVER_CHUNK_BYTES - size of each read/write while copying
+ */
+#define MOVER_PATH_LEN     256
+#define MOVER_MIN_FILES    64
+#define MOVER_CHUNK_BYTES  (1024 * 1024)
+
+
+/* MOVER - migration thread state
+ *     srcDir      = staging directory files are moved from
+ *     dstDir      = directory (share) files are moved to
+ *     rateMBps    = copy rate limit in MB/s, 0 for no limit
+ *     lock        = protects the queue and stop flag
+ *     ready       = signalled when a file is queued or stop is set
+ *     queue       = names of files waiting to be moved
+ *     queueSize   = names queue has room for
+ *     queueHead/Count = position and length of the queue
+ *     stop        = set by MOVER_Stop(); the queue is drained first
+ *     filesMoved  = files copied, verified and removed from staging
+ *     filesFailed = files left in staging after an error
+*     filesNotRemoved = files moved whose staged original could not be
+*                   deleted
+ *     bytesMoved  = bytes copied to dstDir
+ *     moveNs      = time spent moving, in ns
+ *     thread      = mover thread
+ */
+typedef struct MOVER
+        {
+            char                srcDir[MOVER_PATH_LEN];
+            char                dstDir[MOVER_PATH_LEN];
+            unsigned int        rateMBps;
+
+            pthread_mutex_t     lock;
+            pthread_cond_t      ready;
+            char              (*queue)[MOVER_PATH_LEN];
+            unsigned int        queueSize;
+            unsigned int        queueHead;
+            unsigned int        queueCount;
+            int                 stop;
+
+            unsigned long       filesMoved;
+            unsigned long       filesFailed;
+            unsigned long       filesNotRemoved;
+            unsigned long long  bytesMoved;
+            unsigned long long  moveNs;
+            pthread_t           thread;
+        } MOVER;
+
+
+/* function prototypes */
+int          MOVER_Start   (MOVER        *mover,
+                            const char   *srcDir,
+                            const char   *dstDir,
+                            unsigned int  rateMBps);
+int          MOVER_Enqueue (MOVER        *mover,
+                            const char   *fileName);
+void         MOVER_Stop    (MOVER        *mover);
+void         MOVER_Report  (MOVER        *mover);
+unsigned int MOVER_Crc32   (unsigned int  crc,
+                            const void   *buf,
+                            size_t        len);
+
+#endif /* __MOVER_H__ */
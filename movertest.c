@@ -0,0 +1,556 @@
+/**************************************************************************
+*
+*   File: movertest.c
+*
+*   Description: Test of the staging mover (mover.c), away from the radar,
+*                with two local directories standing in for staging and
+*                the share.  Three cases are run, each in directories made
+*                under -d:
+*
+*                    moves       - files of several sizes, one empty, are
+*                                  staged, queued and moved at -r MB/s.
+*                                  Each must end up under its own name
+*                                  with the same CRC-32, with a correct
+*                                  <name>.crc32 beside it and no .part
+*                                  left, and be gone from staging; the
+*                                  time spent moving must be no less than
+*                                  the rate limit allows
+*                    unwritable  - the destination is a path through a
+*                                  regular file, which cannot be written
+*                                  even by root.  Every file must count
+*                                  as failed and stay in staging intact
+*                    not removed - a staged file is renamed while it is
+*                                  being copied, so deleting it after the
+*                                  copy fails.  It must count as moved
+*                                  and as not removed, not as failed
+*
+*                Usage:
+*                    movertest [options]
+*                    -d dir     where to make the test directories (/tmp)
+*                    -r rate    MOVE_RATE_MBPS of the first case (20)
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "mover.h"
+#include "dmaring.h"
+
+
+/* MOVERTEST_FILES - files staged by the first case */
+#define MOVERTEST_FILES      4
+
+/* MOVERTEST_WAIT_MS - longest wait for the mover to start a copy */
+#define MOVERTEST_WAIT_MS    5000
+
+
+static int  MOVERTEST_Moves      (const char *base, unsigned int rateMBps);
+static int  MOVERTEST_Unwritable (const char *base);
+static int  MOVERTEST_NotRemoved (const char *base);
+static int  MOVERTEST_MakeDir    (const char *base, char *dir, size_t len);
+static int  MOVERTEST_Stage      (const char *dir, const char *name,
+                                  size_t bytes, unsigned int seed);
+static int  MOVERTEST_Crc        (const char *dir, const char *name,
+                                  unsigned int *crc,
+                                  unsigned long long *bytes);
+static int  MOVERTEST_CrcFile    (const char *dir, const char *name,
+                                  unsigned int crc);
+static int  MOVERTEST_Exists     (const char *dir, const char *name,
+                                  const char *suffix);
+static void MOVERTEST_Remove     (const char *dir, const char *name);
+static void MOVERTEST_Usage      (void);
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Runs the three cases and prints PASS or FAIL.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - every case passed
+              1 - bad command line, or a case failed
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    const char     *base     = "/tmp";
+    unsigned int    rateMBps = 20;
+    int             failed;
+    int             a;
+
+    for (a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "-d") == 0) && (a + 1 < argc))
+            base = argv[++a];
+        else if ((strcmp(argv[a], "-r") == 0) && (a + 1 < argc))
+            rateMBps = (unsigned int)atoi(argv[++a]);
+        else
+        {
+            MOVERTEST_Usage();
+            return (1);
+        }
+    }
+    if (rateMBps == 0)
+    {
+        MOVERTEST_Usage();
+        return (1);
+    }
+
+    failed  = MOVERTEST_Moves(base, rateMBps);
+    failed |= MOVERTEST_Unwritable(base);
+    failed |= MOVERTEST_NotRemoved(base);
+
+    printf("%s\n", failed ? "FAIL" : "PASS");
+
+    return (failed ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    MOVERTEST_Moves()
+
+ Description: Moves several files at a limited rate and checks each
+              arrived whole, with its .crc32 file, and left staging.
+
+ Parameters:  base     - where to make the directories
+              rateMBps - rate limit
+
+ Return:      0 - passed
+              1 - failed
+**************************************************************************/
+static int MOVERTEST_Moves (const char *base, unsigned int rateMBps)
+{
+    static const char  *name[MOVERTEST_FILES] = {"adc1.dat", "adc2.dat",
+                                                 "det1.dat", "pc1.dat"};
+    static const size_t size[MOVERTEST_FILES] = {3 * 1024 * 1024 + 123,
+                                                 1024 * 1024, 0,
+                                                 2 * 1024 * 1024 + 4095};
+    MOVER               mover;
+    char                src[MOVER_PATH_LEN];
+    char                dst[MOVER_PATH_LEN];
+    unsigned int        crc[MOVERTEST_FILES];
+    unsigned long long  total = 0;
+    unsigned long long  bytes;
+    unsigned long long  minNs;
+    int                 failed = 0;
+    int                 i;
+
+    if ((MOVERTEST_MakeDir(base, src, sizeof(src)) != 0) ||
+        (MOVERTEST_MakeDir(base, dst, sizeof(dst)) != 0) ||
+        (MOVER_Start(&mover, src, dst, rateMBps) != 0))
+    {
+        printf("moves:       FAIL, set-up failed\n");
+        return (1);
+    }
+
+    /* the CRC table is made by MOVER_Start() */
+    for (i = 0; i < MOVERTEST_FILES; i++)
+    {
+        failed |= MOVERTEST_Stage(src, name[i], size[i], i + 1);
+        failed |= MOVERTEST_Crc(src, name[i], &(crc[i]), &bytes);
+        failed |= MOVER_Enqueue(&mover, name[i]);
+        total  += size[i];
+    }
+    MOVER_Stop(&mover);
+
+    if ((mover.filesMoved != MOVERTEST_FILES) || (mover.filesFailed != 0) ||
+        (mover.filesNotRemoved != 0) || (mover.bytesMoved != total))
+    {
+        printf("moves:       FAIL, %lu moved, %lu failed, %lu not removed, "
+               "%llu of %llu bytes\n", mover.filesMoved, mover.filesFailed,
+               mover.filesNotRemoved, mover.bytesMoved, total);
+        failed = 1;
+    }
+
+    for (i = 0; i < MOVERTEST_FILES; i++)
+    {
+        if (MOVERTEST_Exists(src, name[i], "") ||
+            MOVERTEST_Exists(dst, name[i], ".part") ||
+            (MOVERTEST_Crc(dst, name[i], &(crc[i]), &bytes) != 0) ||
+            (bytes != size[i]) ||
+            (MOVERTEST_CrcFile(dst, name[i], crc[i]) != 0))
+        {
+            printf("moves:       FAIL, %s not moved whole\n", name[i]);
+            failed = 1;
+        }
+    }
+
+    /* each file's copy takes at least its size at the rate */
+    minNs = (total * 1000ULL) / rateMBps;
+    if (mover.moveNs < minNs)
+    {
+        printf("moves:       FAIL, %.1f MB in %.3f s, over %u MB/s\n",
+               total / 1e6, mover.moveNs / 1e9, rateMBps);
+        failed = 1;
+    }
+
+    if (!failed)
+        printf("moves:       ok, %lu file(s), %.1f MB at %.1f MB/s, limit "
+               "%u MB/s\n", mover.filesMoved, total / 1e6,
+               (total / 1e6) / (mover.moveNs / 1e9), rateMBps);
+
+    for (i = 0; i < MOVERTEST_FILES; i++)
+    {
+        MOVERTEST_Remove(src, name[i]);
+        MOVERTEST_Remove(dst, name[i]);
+    }
+    rmdir(src);
+    rmdir(dst);
+
+    return (failed);
+}
+
+
+/**************************************************************************
+ Function:    MOVERTEST_Unwritable()
+
+ Description: Moves files to a destination that cannot be written and
+              checks they fail and stay in staging.
+
+ Parameters:  base - where to make the directories
+
+ Return:      0 - passed
+              1 - failed
+**************************************************************************/
+static int MOVERTEST_Unwritable (const char *base)
+{
+    MOVER               mover;
+    char                src[MOVER_PATH_LEN];
+    char                dst[MOVER_PATH_LEN];
+    unsigned int        crc[2];
+    unsigned int        after;
+    unsigned long long  bytes;
+    int                 failed = 0;
+    int                 i;
+
+    /* the destination is src/share, a regular file */
+    if ((MOVERTEST_MakeDir(base, src, sizeof(src)) != 0) ||
+        (MOVERTEST_Stage(src, "share", 16, 0) != 0) ||
+        (snprintf(dst, sizeof(dst), "%s/share", src) >= (int)sizeof(dst)) ||
+        (MOVER_Start(&mover, src, dst, 0) != 0))
+    {
+        printf("unwritable:  FAIL, set-up failed\n");
+        return (1);
+    }
+
+    failed |= MOVERTEST_Stage(src, "adc1.dat", 100000, 7);
+    failed |= MOVERTEST_Stage(src, "adc2.dat", 0, 8);
+    failed |= MOVERTEST_Crc(src, "adc1.dat", &(crc[0]), &bytes);
+    failed |= MOVERTEST_Crc(src, "adc2.dat", &(crc[1]), &bytes);
+    failed |= MOVER_Enqueue(&mover, "adc1.dat");
+    failed |= MOVER_Enqueue(&mover, "adc2.dat");
+    MOVER_Stop(&mover);
+
+    if ((mover.filesFailed != 2) || (mover.filesMoved != 0) ||
+        (mover.filesNotRemoved != 0))
+    {
+        printf("unwritable:  FAIL, %lu moved, %lu failed, %lu not removed\n",
+               mover.filesMoved, mover.filesFailed, mover.filesNotRemoved);
+        failed = 1;
+    }
+    for (i = 0; i < 2; i++)
+    {
+        if ((MOVERTEST_Crc(src, i ? "adc2.dat" : "adc1.dat", &after,
+                           &bytes) != 0) || (after != crc[i]))
+        {
+            printf("unwritable:  FAIL, adc%d.dat not kept in staging\n", i + 1);
+            failed = 1;
+        }
+    }
+
+    if (!failed)
+        printf("unwritable:  ok, %lu file(s) failed and kept in staging\n",
+               mover.filesFailed);
+
+    MOVERTEST_Remove(src, "adc1.dat");
+    MOVERTEST_Remove(src, "adc2.dat");
+    MOVERTEST_Remove(src, "share");
+    rmdir(src);
+
+    return (failed);
+}
+
+
+/**************************************************************************
+ Function:    MOVERTEST_NotRemoved()
+
+ Description: Moves a file that disappears from staging while it is
+              being copied, so the copy succeeds and deleting the
+              original fails, and checks it is counted as moved and not
+              removed.  The copy is held to 2 MB/s, so the rename comes
+              well before it ends.
+
+ Parameters:  base - where to make the directories
+
+ Return:      0 - passed
+              1 - failed
+**************************************************************************/
+static int MOVERTEST_NotRemoved (const char *base)
+{
+    MOVER               mover;
+    char                src[MOVER_PATH_LEN];
+    char                dst[MOVER_PATH_LEN];
+    char                from[2 * MOVER_PATH_LEN];
+    char                to[2 * MOVER_PATH_LEN];
+    struct timespec     pause = {0, 1000000};
+    unsigned int        crc;
+    unsigned int        copy;
+    unsigned long long  bytes;
+    int                 waited;
+    int                 failed = 0;
+
+    if ((MOVERTEST_MakeDir(base, src, sizeof(src)) != 0) ||
+        (MOVERTEST_MakeDir(base, dst, sizeof(dst)) != 0) ||
+        (MOVER_Start(&mover, src, dst, 2) != 0))
+    {
+        printf("not removed: FAIL, set-up failed\n");
+        return (1);
+    }
+
+    failed |= MOVERTEST_Stage(src, "adc1.dat", 2 * 1024 * 1024, 9);
+    failed |= MOVERTEST_Crc(src, "adc1.dat", &crc, &bytes);
+    failed |= MOVER_Enqueue(&mover, "adc1.dat");
+
+    /* the .part appears as the copy starts; the mover holds the original
+     * open, so it reads on after the rename
+     */
+    for (waited = 0; (waited < MOVERTEST_WAIT_MS) &&
+                     !MOVERTEST_Exists(dst, "adc1.dat", ".part"); waited++)
+        nanosleep(&pause, NULL);
+    snprintf(from, sizeof(from), "%s/adc1.dat", src);
+    snprintf(to, sizeof(to), "%s/adc1.dat.aside", src);
+    if ((waited == MOVERTEST_WAIT_MS) || (rename(from, to) != 0))
+        failed = 1;
+    MOVER_Stop(&mover);
+
+    if ((mover.filesMoved != 1) || (mover.filesNotRemoved != 1) ||
+        (mover.filesFailed != 0))
+    {
+        printf("not removed: FAIL, %lu moved, %lu failed, %lu not removed\n",
+               mover.filesMoved, mover.filesFailed, mover.filesNotRemoved);
+        failed = 1;
+    }
+    if ((MOVERTEST_Crc(dst, "adc1.dat", &copy, &bytes) != 0) ||
+        (copy != crc) || (MOVERTEST_CrcFile(dst, "adc1.dat", crc) != 0))
+    {
+        printf("not removed: FAIL, adc1.dat not moved whole\n");
+        failed = 1;
+    }
+
+    if (!failed)
+        printf("not removed: ok, moved and counted as not removed\n");
+
+    MOVERTEST_Remove(src, "adc1.dat");
+    MOVERTEST_Remove(dst, "adc1.dat");
+    rmdir(src);
+    rmdir(dst);
+
+    return (failed);
+}
+
+
+/**************************************************************************
+ Function:    MOVERTEST_MakeDir()
+
+ Description: Makes a new, empty directory.
+
+ Parameters:  base - where to make it
+              dir  - receives its path
+              len  - size of dir
+
+ Return:      0 - success
+              1 - failed
+**************************************************************************/
+static int MOVERTEST_MakeDir (const char *base, char *dir, size_t len)
+{
+    if (snprintf(dir, len, "%s/movertest.XXXXXX", base) >= (int)len)
+        return (1);
+
+    return ((mkdtemp(dir) == NULL) ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    MOVERTEST_Stage()
+
+ Description: Writes a file of pseudo-random bytes.
+
+ Parameters:  dir   - directory
+              name  - file name
+              bytes - length
+              seed  - starts the bytes
+
+ Return:      0 - success
+              1 - failed
+**************************************************************************/
+static int MOVERTEST_Stage (const char *dir, const char *name, size_t bytes,
+                            unsigned int seed)
+{
+    char            path[2 * MOVER_PATH_LEN];
+    unsigned char  *buf;
+    size_t          i;
+    FILE           *fp;
+    int             status = 0;
+
+    buf = (unsigned char *)malloc(bytes + 1);
+    if (buf == NULL)
+        return (1);
+    for (i = 0; i < bytes; i++)
+    {
+        seed   = (seed * 1103515245U) + 12345U;
+        buf[i] = (unsigned char)(seed >> 16);
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    fp = fopen(path, "wb");
+    if ((fp == NULL) || (fwrite(buf, 1, bytes, fp) != bytes))
+        status = 1;
+    if ((fp != NULL) && (fclose(fp) != 0))
+        status = 1;
+    free(buf);
+
+    return (status);
+}
+
+
+/**************************************************************************
+ Function:    MOVERTEST_Crc()
+
+ Description: CRC-32 and length of a file.
+
+ Parameters:  dir   - directory
+              name  - file name
+              crc   - receives the CRC
+              bytes - receives the length
+
+ Return:      0 - success
+              1 - missing or unreadable
+**************************************************************************/
+static int MOVERTEST_Crc (const char *dir, const char *name,
+                          unsigned int *crc, unsigned long long *bytes)
+{
+    char    path[2 * MOVER_PATH_LEN];
+    char    buf[65536];
+    size_t  count;
+    FILE   *fp;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    fp = fopen(path, "rb");
+    if (fp == NULL)
+        return (1);
+
+    *crc   = 0;
+    *bytes = 0;
+    while ((count = fread(buf, 1, sizeof(buf), fp)) != 0)
+    {
+        *crc    = MOVER_Crc32(*crc, buf, count);
+        *bytes += count;
+    }
+    fclose(fp);
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    MOVERTEST_CrcFile()
+
+ Description: Checks a moved file's <name>.crc32 holds its CRC and name.
+
+ Parameters:  dir  - directory
+              name - file name
+              crc  - the file's CRC
+
+ Return:      0 - correct
+              1 - missing or wrong
+**************************************************************************/
+static int MOVERTEST_CrcFile (const char *dir, const char *name,
+                              unsigned int crc)
+{
+    char    path[2 * MOVER_PATH_LEN + 8];
+    char    want[MOVER_PATH_LEN + 16];
+    char    line[MOVER_PATH_LEN + 16];
+    FILE   *fp;
+    int     status = 1;
+
+    snprintf(path, sizeof(path), "%s/%s.crc32", dir, name);
+    snprintf(want, sizeof(want), "%08x  %s\n", crc, name);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return (1);
+    if ((fgets(line, sizeof(line), fp) != NULL) && (strcmp(line, want) == 0))
+        status = 0;
+    fclose(fp);
+
+    return (status);
+}
+
+
+/**************************************************************************
+ Function:    MOVERTEST_Exists()
+
+ Description: Checks whether a file exists.
+
+ Parameters:  dir    - directory
+              name   - file name
+              suffix - added to the name, or ""
+
+ Return:      1 - it exists
+              0 - it does not
+**************************************************************************/
+static int MOVERTEST_Exists (const char *dir, const char *name,
+                             const char *suffix)
+{
+    char        path[2 * MOVER_PATH_LEN + 8];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/%s%s", dir, name, suffix);
+
+    return ((stat(path, &st) == 0) ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    MOVERTEST_Remove()
+
+ Description: Deletes a file and whatever the mover or a case may have
+              left of it.
+
+ Parameters:  dir  - directory
+              name - file name
+
+ Return:      none
+**************************************************************************/
+static void MOVERTEST_Remove (const char *dir, const char *name)
+{
+    static const char *suffix[] = {"", ".part", ".crc32", ".aside"};
+    char               path[2 * MOVER_PATH_LEN + 8];
+    unsigned int       i;
+
+    for (i = 0; i < sizeof(suffix) / sizeof(suffix[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s%s", dir, name, suffix[i]);
+        unlink(path);
+    }
+}
+
+
+/**************************************************************************
+ Function:    MOVERTEST_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void MOVERTEST_Usage (void)
+{
+    printf("usage: movertest [-d dir] [-r rate]\n");
+}
@@ -0,0 +1,471 @@
+/**************************************************************************
+*
+*   File: nxmapbench.c
+*
+*   Description: Benchmark of the mapped nxrec reader (nxrec_map.h) on a
+*                large recording, away from the radar.
+*
+*                With -w the file is first written as the recorder writes
+*                it (nxrec header, prefixed range lines through the
+*                pwritev backend of recfile.c, then the PRI index), -w
+*                range lines of -s samples; 262144 lines of 4096 samples
+*                make a 4.3 GB file.  Otherwise the file must be an nxrec
+*                recording already.
+*
+*                Range lines are then read through NXREC_MapLine() in two
+*                patterns, each summed in full as processing would:
+*
+*                    random  - lines picked at random over the file
+*                    strided - -S PRIs apart, starting again one line on
+*                              at the end of the file, as corner turns
+*                              and Doppler blocks read
+*
+*                and each pattern three ways:
+*
+*                    plain    - the kernel's default read-ahead
+*                    random   - NXREC_MapAdvise(NXREC_ACCESS_RANDOM)
+*                    prefetch - as random, and NXREC_MapPrefetch() of the
+*                               line -d reads ahead before each read
+*
+*                The file is dropped from the page cache before each run
+*                and mapped afresh; the part still resident when the run
+*                starts is printed, since a file system that cannot drop
+*                it (tmpfs) measures memory rather than the disk.  The
+*                time per line read and summed is histogrammed.  Every
+*                line's prefix must give the PRI asked for.
+*
+*                Usage:
+*                    nxmapbench [options] file
+*                    -w lines   write file first, lines range lines (0:
+*                               read an existing recording)
+*                    -s samples SAMPLES_PER_PRI of a written file (4096)
+*                    -n reads   range lines read per run (20000)
+*                    -S stride  PRIs between strided reads (256)
+*                    -d depth   reads the prefetch is ahead (32)
+*                    -k         keep a written file
+*
+**************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "nxrec.h"
+#include "nxrec_map.h"
+#include "recfile.h"
+#include "lathist.h"
+#include "dmaring.h"
+
+
+/* NXMAPBENCH_BATCH - WRITE_BATCH of the written file */
+#define NXMAPBENCH_BATCH     16
+
+/* read modes */
+#define NXMAPBENCH_PLAIN     0
+#define NXMAPBENCH_RANDOM    1
+#define NXMAPBENCH_PREFETCH  2
+
+
+static int    NXMAPBENCH_Write    (const char *fileName, unsigned long lines,
+                                   unsigned int samples);
+static void   NXMAPBENCH_Drop     (const char *fileName);
+static double NXMAPBENCH_Resident (const NXREC_MAP *map);
+static int    NXMAPBENCH_Run      (const char *fileName, const char *pattern,
+                                   int mode, const unsigned long long *list,
+                                   unsigned long reads, unsigned int depth);
+static void   NXMAPBENCH_Usage    (void);
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Writes the file if asked to, makes the lists of lines to
+              read, and runs each pattern each way.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - success
+              1 - bad command line, the file could not be written or
+                  mapped, or a line read back wrong
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    NXREC_MAP           map;
+    const char         *fileName;
+    unsigned long long *list;
+    unsigned long long  numLines;
+    unsigned long long  seed    = 1;
+    unsigned long long  perPass;
+    unsigned long       lines   = 0;
+    unsigned long       reads   = 20000;
+    unsigned long       i;
+    unsigned int        samples = 4096;
+    unsigned int        stride  = 256;
+    unsigned int        depth   = 32;
+    int                 keep    = 0;
+    int                 status  = 0;
+    int                 mode;
+    int                 a;
+
+    for (a = 1; (a < argc) && (argv[a][0] == '-'); a++)
+    {
+        if ((strcmp(argv[a], "-w") == 0) && (a + 1 < argc))
+            lines = strtoul(argv[++a], NULL, 10);
+        else if ((strcmp(argv[a], "-s") == 0) && (a + 1 < argc))
+            samples = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-n") == 0) && (a + 1 < argc))
+            reads = strtoul(argv[++a], NULL, 10);
+        else if ((strcmp(argv[a], "-S") == 0) && (a + 1 < argc))
+            stride = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-d") == 0) && (a + 1 < argc))
+            depth = (unsigned int)atoi(argv[++a]);
+        else if (strcmp(argv[a], "-k") == 0)
+            keep = 1;
+        else
+        {
+            NXMAPBENCH_Usage();
+            return (1);
+        }
+    }
+    if ((a + 1 != argc) || (samples == 0) || (reads == 0) ||
+        (stride == 0))
+    {
+        NXMAPBENCH_Usage();
+        return (1);
+    }
+    fileName = argv[a];
+
+    if ((lines != 0) && (NXMAPBENCH_Write(fileName, lines, samples) != 0))
+    {
+        printf("ERROR: writing %s failed.\n", fileName);
+        unlink(fileName);
+        return (1);
+    }
+
+    if (NXREC_MapOpen(&map, fileName) != 0)
+    {
+        printf("ERROR: %s is not an nxrec recording.\n", fileName);
+        return (1);
+    }
+    numLines = map.numLines;
+    printf("%s: %llu lines of %u samples, %.2f GB, %s index\n", fileName,
+           numLines, map.hdr->samplesPerPri, map.size / 1e9,
+           (map.index != NULL) ? "with an" : "no");
+    NXREC_MapClose(&map);
+
+    list = (unsigned long long *)malloc(reads * sizeof(unsigned long long));
+    if ((numLines == 0) || (list == NULL))
+    {
+        printf("ERROR: nothing to read.\n");
+        free(list);
+        return (1);
+    }
+
+    for (i = 0; i < reads; i++)
+    {
+        seed    = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+        list[i] = (seed >> 33) % numLines;
+    }
+    for (mode = NXMAPBENCH_PLAIN; mode <= NXMAPBENCH_PREFETCH; mode++)
+        status |= NXMAPBENCH_Run(fileName, "random", mode, list, reads, depth);
+
+    /* perPass reads go down the file a stride apart; each pass starts a
+     * line after the last
+     */
+    perPass = (numLines + stride - 1) / stride;
+    for (i = 0; i < reads; i++)
+        list[i] = (((i % perPass) * stride) + ((i / perPass) % stride)) %
+                  numLines;
+    for (mode = NXMAPBENCH_PLAIN; mode <= NXMAPBENCH_PREFETCH; mode++)
+        status |= NXMAPBENCH_Run(fileName, "strided", mode, list, reads, depth);
+
+    free(list);
+    if ((lines != 0) && !keep)
+        unlink(fileName);
+
+    return (status);
+}
+
+
+/**************************************************************************
+ Function:    NXMAPBENCH_Write()
+
+ Description: Writes an nxrec file as the channel writer does: header,
+              lines with their prefixes in batches, then the PRI index.
+              Line n's prefix has PRI n, and its samples count up from n.
+              The file is synced, so it can be dropped from the page
+              cache.
+
+ Parameters:  fileName - file to write
+              lines    - range lines
+              samples  - complex samples per line
+
+ Return:      0 - success
+              1 - allocation, open or a write failed
+**************************************************************************/
+static int NXMAPBENCH_Write (const char *fileName, unsigned long lines,
+                             unsigned int samples)
+{
+    REC_FILE            file;
+    NXREC_HEADER        fields;
+    NXREC_LINE          prefix[NXMAPBENCH_BATCH];
+    NXREC_INDEX_ENTRY  *index;
+    NXREC_TRAILER      *trailer;
+    unsigned char      *header;
+    int16_t            *iq;
+    int16_t            *line;
+    unsigned int        headerBytes;
+    unsigned long long  start;
+    unsigned long       i;
+    unsigned int        j;
+    unsigned int        n;
+    int                 fd;
+    int                 status = 0;
+
+    memset (&fields, 0, sizeof(fields));
+    fields.samplesPerPri = samples;
+    fields.numPris       = (uint32_t)lines;
+    fields.sampleFormat  = NXREC_FMT_CI16;
+
+    header  = (unsigned char *)malloc(NXREC_MAX_HEADER);
+    iq      = (int16_t *)malloc((size_t)NXMAPBENCH_BATCH * samples * 4);
+    index   = (NXREC_INDEX_ENTRY *)malloc(lines * sizeof(NXREC_INDEX_ENTRY) +
+                                          sizeof(NXREC_TRAILER));
+    if ((header == NULL) || (iq == NULL) || (index == NULL))
+    {
+        free(header); free(iq); free(index);
+        return (1);
+    }
+    headerBytes = NXREC_BuildHeader(header, &fields, NULL);
+
+    if (RECFILE_Open(&file, fileName, REC_FILE_PWRITEV, NXMAPBENCH_BATCH, 0,
+                     headerBytes + (unsigned long long)lines *
+                     (sizeof(NXREC_LINE) + (size_t)samples * 4) +
+                     lines * sizeof(NXREC_INDEX_ENTRY) +
+                     sizeof(NXREC_TRAILER)) != 0)
+    {
+        free(header); free(iq); free(index);
+        return (1);
+    }
+
+    printf("writing %lu lines to %s\n", lines, fileName);
+    start  = DMARING_TimeNs();
+    status = RECFILE_WriteHeader(&file, header, headerBytes);
+    for (i = 0; (i < lines) && (status == 0); i++)
+    {
+        /* a batch's prefixes and lines must last until it is flushed,
+         * so each place in the batch has its own
+         */
+        if (file.numPending >= file.batchLines)
+            status = RECFILE_Flush(&file);
+        n    = file.numPending;
+        line = iq + (size_t)n * 2 * samples;
+        for (j = 0; j < 2 * samples; j++)
+            line[j] = (int16_t)(i + j);
+
+        prefix[n].sync     = NXREC_LINE_SYNC;
+        prefix[n].adcFlags = 0;
+        prefix[n].priIndex = i;
+        prefix[n].intrTime = 0;
+        prefix[n].pubTime  = DMARING_TimeNs();
+        status |= RECFILE_Append(&file, &(prefix[n]), sizeof(NXREC_LINE),
+                                 line, (size_t)samples * 4, i);
+
+        index[i].priIndex = i;
+        index[i].offset   = file.lineOffset;
+        index[i].intrTime = 0;
+        index[i].adcFlags = 0;
+        index[i].status   = 0;
+    }
+
+    trailer = (NXREC_TRAILER *)(index + lines);
+    memset (trailer, 0, sizeof(NXREC_TRAILER));
+    memcpy (trailer->magic, NXREC_INDEX_MAGIC, sizeof(trailer->magic));
+    trailer->indexOffset = file.appendEnd;
+    trailer->numEntries  = lines;
+    trailer->entryBytes  = sizeof(NXREC_INDEX_ENTRY);
+    if (status == 0)
+        status = RECFILE_WriteTrailer(&file, index,
+                                      lines * sizeof(NXREC_INDEX_ENTRY) +
+                                      sizeof(NXREC_TRAILER));
+    status |= RECFILE_Close(&file);
+
+    fd = open(fileName, O_WRONLY);
+    if ((fd < 0) || (fdatasync(fd) != 0))
+        status = 1;
+    if (fd >= 0)
+        close(fd);
+    if (status == 0)
+        printf("    %.1f s, %.1f MB/s to disk\n",
+               (DMARING_TimeNs() - start) / 1e9,
+               (double)file.bytesWritten * 1e3 / (DMARING_TimeNs() - start));
+
+    free(header);
+    free(iq);
+    free(index);
+
+    return (status ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    NXMAPBENCH_Drop()
+
+ Description: Asks the kernel to drop a file from the page cache.  Clean
+              pages go; a file system without a backing store keeps them.
+
+ Parameters:  fileName - the file
+
+ Return:      none
+**************************************************************************/
+static void NXMAPBENCH_Drop (const char *fileName)
+{
+    int fd = open(fileName, O_RDONLY);
+
+    if (fd < 0)
+        return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+
+/**************************************************************************
+ Function:    NXMAPBENCH_Resident()
+
+ Description: Measures how much of a mapped file is in memory.
+
+ Parameters:  map - pointer to an open NXREC_MAP
+
+ Return:      percentage of its pages resident, or -1 if mincore() failed
+**************************************************************************/
+static double NXMAPBENCH_Resident (const NXREC_MAP *map)
+{
+    unsigned char      *vec;
+    unsigned long long  pages = (map->size + map->pageBytes - 1) /
+                                map->pageBytes;
+    unsigned long long  resident = 0;
+    unsigned long long  i;
+
+    vec = (unsigned char *)malloc(pages);
+    if ((vec == NULL) ||
+        (mincore((void *)map->base, (size_t)map->size, vec) != 0))
+    {
+        free(vec);
+        return (-1.0);
+    }
+    for (i = 0; i < pages; i++)
+        resident += vec[i] & 1;
+    free(vec);
+
+    return (100.0 * resident / pages);
+}
+
+
+/**************************************************************************
+ Function:    NXMAPBENCH_Run()
+
+ Description: Drops the file from the page cache, maps it, reads and sums
+              the lines of a list one way, and prints the results.
+
+ Parameters:  fileName - the recording
+              pattern  - name of the list, for the report
+              mode     - NXMAPBENCH_PLAIN, _RANDOM or _PREFETCH
+              list     - record numbers to read, in order
+              reads    - entries of list
+              depth    - reads the prefetch is ahead
+
+ Return:      0 - success
+              1 - the file could not be mapped, or a line read back wrong
+**************************************************************************/
+static int NXMAPBENCH_Run (const char *fileName, const char *pattern,
+                           int mode, const unsigned long long *list,
+                           unsigned long reads, unsigned int depth)
+{
+    static const char  *modeName[] = {"plain", "random", "prefetch"};
+    NXREC_MAP           map;
+    NXREC_SPAN          span;
+    LAT_HIST            hist;
+    char                name[32];
+    unsigned long long  start;
+    unsigned long long  t;
+    unsigned long long  ns;
+    unsigned long long  bad = 0;
+    unsigned long       i;
+    unsigned long       ahead;
+    unsigned int        j;
+    double              resident;
+    long                sum = 0;
+
+    NXMAPBENCH_Drop(fileName);
+    if (NXREC_MapOpen(&map, fileName) != 0)
+    {
+        printf("ERROR: %s could not be mapped.\n", fileName);
+        return (1);
+    }
+    resident = NXMAPBENCH_Resident(&map);
+
+    snprintf (name, sizeof(name), "%s, %s", pattern, modeName[mode]);
+    LATHIST_Init(&hist, name);
+
+    if (mode != NXMAPBENCH_PLAIN)
+        NXREC_MapAdvise(&map, NXREC_ACCESS_RANDOM);
+    if (mode == NXMAPBENCH_PREFETCH)
+        for (ahead = 0; (ahead < depth) && (ahead < reads); ahead++)
+            NXREC_MapPrefetch(&map, list[ahead], 1, 1);
+
+    start = DMARING_TimeNs();
+    for (i = 0; i < reads; i++)
+    {
+        t = DMARING_TimeNs();
+        if ((mode == NXMAPBENCH_PREFETCH) && (i + depth < reads))
+            NXREC_MapPrefetch(&map, list[i + depth], 1, 1);
+
+        if ((NXREC_MapLine(&map, list[i], &span) != 0) ||
+            (span.prefix->priIndex != map.firstPri + list[i]))
+            bad++;
+        else if (span.iq != NULL)
+        {
+            for (j = 0; j < 2 * span.samples; j++)
+                sum += span.iq[j];
+        }
+        else
+        {
+            for (j = 0; j < span.packedBytes; j++)
+                sum += span.packed[j];
+        }
+        LATHIST_Record(&hist, DMARING_TimeNs() - t);
+    }
+    ns = DMARING_TimeNs() - start;
+
+    printf("%-18s %5.1f%% resident  %9.0f lines/s %8.1f MB/s  (sum %ld)\n",
+           name, resident, reads * 1e9 / ns,
+           (double)reads * map.hdr->recordBytes * 1e3 / ns, sum);
+    LATHIST_Print(&hist, "   ");
+    if (bad != 0)
+        printf("ERROR: %llu line(s) missing or with the wrong PRI.\n", bad);
+
+    NXREC_MapClose(&map);
+
+    return (bad != 0);
+}
+
+
+/**************************************************************************
+ Function:    NXMAPBENCH_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void NXMAPBENCH_Usage (void)
+{
+    printf("usage: nxmapbench [-w lines] [-s samples] [-n reads] [-S stride] "
+           "[-d depth] [-k] file\n");
+}
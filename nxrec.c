@@ -0,0 +1,476 @@
+/**************************************************************************
+*
+*   File: nxrec.c
+*
+*   Description: NeXtRAD recording format.  See nxrec.h.
+*
+*                The writer side only builds the header; the records are
+*                written by the channel writer thread (dmaring.c) through
+*                recfile.c, which gathers each NXREC_LINE prefix in front
+*                of the DMA buffer.  The index is built by the writer
+*                thread too, and added with RECFILE_WriteTrailer().
+*
+**************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "nxrec.h"
+#include "iqpack.h"
+
+
+/* NXREC_WALK_ENTRIES - initial index size when walking packed records */
+#define NXREC_WALK_ENTRIES   4096
+
+
+static int NXREC_PreadAll (int fd, void *buf, size_t len,
+                           unsigned long long offset);
+static int NXREC_WalkPacked (NXREC_FILE *file, unsigned long long fileSize);
+
+
+/**************************************************************************
+ Function:    NXREC_BuildHeader()
+
+ Description: Builds a file header: the fixed fields, with magic, version,
+              sizes, the NeXtRAD.ini text and the start times filled in,
+              followed by the ini text, zero padded to NXREC_ALIGN.
+
+ Parameters:  buf     - NXREC_MAX_HEADER bytes to build the header in
+              fields  - header fields describing the run (chanNum,
+                        samplesPerPri, numPris, waveformIndex, adcDelay,
+                        dacDelay, decimation, irqCoalesce, tuneFreqHz,
+                        clockFreqHz, sampleFormat, 0 meaning
+                        NXREC_FMT_CI16, for NXREC_FMT_CI16_BFP bfpBlock
+                        and bfpBits, for a segment of a segmented run
+                        segment, segmentPris and firstPri, and for a
+                        range-gated run rangeBins, numGates and gate);
+                        the rest are ignored
+              iniFile - path of the NeXtRAD.ini the run was set up from,
+                        or NULL; a file that cannot be read is recorded as
+                        empty
+
+ Return:      header length in bytes (headerBytes)
+**************************************************************************/
+unsigned int NXREC_BuildHeader (void               *buf,
+                                const NXREC_HEADER *fields,
+                                const char         *iniFile)
+{
+    NXREC_HEADER    *hdr = (NXREC_HEADER *)buf;
+    FILE            *fp;
+    size_t           room;
+    size_t           iniBytes = 0;
+    struct timespec  ts;
+
+    memset (buf, 0, NXREC_MAX_HEADER);
+    memcpy (hdr, fields, sizeof(NXREC_HEADER));
+
+    memcpy (hdr->magic, NXREC_MAGIC, sizeof(hdr->magic));
+    hdr->version      = NXREC_VERSION;
+    hdr->prefixBytes  = sizeof(NXREC_LINE);
+    hdr->sampleFormat = (fields->sampleFormat != 0) ? fields->sampleFormat :
+                                                      NXREC_FMT_CI16;
+    if (hdr->sampleFormat == NXREC_FMT_CI16_BFP)
+        hdr->lineBytes = BFP_LineBytes(fields->samplesPerPri,
+                                       fields->bfpBlock, fields->bfpBits);
+    else
+    {
+        hdr->lineBytes = fields->samplesPerPri * 2 * sizeof(int16_t);
+        hdr->bfpBlock  = 0;
+        hdr->bfpBits   = 0;
+    }
+    if (fields->numGates == 0)
+    {
+        hdr->rangeBins = fields->samplesPerPri;
+        memset (hdr->gate, 0, sizeof(hdr->gate));
+    }
+    hdr->recordBytes  = hdr->prefixBytes + hdr->lineBytes;
+    hdr->iniOffset    = sizeof(NXREC_HEADER);
+
+    /* leave room for the terminating NUL */
+    room = NXREC_MAX_HEADER - sizeof(NXREC_HEADER) - 1;
+    if ((iniFile != NULL) && ((fp = fopen(iniFile, "rb")) != NULL))
+    {
+        iniBytes = fread((char *)buf + hdr->iniOffset, 1, room, fp);
+        fclose(fp);
+    }
+    hdr->iniBytes = (uint32_t)iniBytes;
+
+    hdr->headerBytes = (uint32_t)(((hdr->iniOffset + iniBytes + 1) +
+                                   (NXREC_ALIGN - 1)) & ~(NXREC_ALIGN - 1));
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    hdr->startRealNs = ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    hdr->startMonoNs = ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+
+    return (hdr->headerBytes);
+}
+
+
+/**************************************************************************
+ Function:    NXREC_Open()
+
+ Description: Opens an nxrec file for reading and loads its header,
+              NeXtRAD.ini text and index.  Without an index the number of
+              records is worked out from the file length, or for packed
+              lines by walking the records.
+
+ Parameters:  file     - pointer to the NXREC_FILE to initialize
+              fileName - path of the recording
+
+ Return:      0 - success
+              1 - file failed to open or read
+              2 - not an nxrec file, or a version this reader does not
+                  know
+**************************************************************************/
+int NXREC_Open (NXREC_FILE *file, const char *fileName)
+{
+    struct stat         st;
+    NXREC_TRAILER       trailer;
+    unsigned long long  dataEnd;
+    int                 status;
+
+    memset (file, 0, sizeof(NXREC_FILE));
+
+    file->fd = open(fileName, O_RDONLY);
+    if (file->fd < 0)
+        return (1);
+
+    if ((fstat(file->fd, &st) != 0) ||
+        (NXREC_PreadAll(file->fd, &(file->hdr), sizeof(NXREC_HEADER), 0) != 0))
+    {
+        NXREC_Close(file);
+        return (1);
+    }
+
+    /* older headers end before the fields added since; what was read
+     * there is the start of the ini text
+     */
+    if (file->hdr.version < 2)
+    {
+        file->hdr.bfpBlock = 0;
+        file->hdr.bfpBits  = 0;
+    }
+    if (file->hdr.version < 3)
+    {
+        file->hdr.segment     = 0;
+        file->hdr.segmentPris = 0;
+        file->hdr.firstPri    = 0;
+    }
+    if (file->hdr.version < 4)
+    {
+        file->hdr.rangeBins = file->hdr.samplesPerPri;
+        file->hdr.numGates  = 0;
+        memset (file->hdr.gate, 0, sizeof(file->hdr.gate));
+    }
+
+    if ((memcmp(file->hdr.magic, NXREC_MAGIC, sizeof(file->hdr.magic)) != 0) ||
+        (file->hdr.version < 1) || (file->hdr.version > NXREC_VERSION) ||
+        (file->hdr.recordBytes == 0) ||
+        (file->hdr.headerBytes < file->hdr.iniOffset + file->hdr.iniBytes) ||
+        (file->hdr.recordBytes != file->hdr.prefixBytes + file->hdr.lineBytes) ||
+        (file->hdr.prefixBytes < sizeof(NXREC_LINE)) ||
+        (file->hdr.numGates > NXREC_MAX_GATES) ||
+        ((file->hdr.sampleFormat != NXREC_FMT_CI16) &&
+         (file->hdr.sampleFormat != NXREC_FMT_CI16_PACK) &&
+         (file->hdr.sampleFormat != NXREC_FMT_CI16_BFP)))
+    {
+        NXREC_Close(file);
+        return (2);
+    }
+
+    if (file->hdr.sampleFormat == NXREC_FMT_CI16_BFP)
+    {
+        status = BFP_Init(&(file->bfp), file->hdr.samplesPerPri,
+                          file->hdr.bfpBlock, file->hdr.bfpBits);
+        if ((status != 0) || (file->bfp.lineBytes != file->hdr.lineBytes))
+        {
+            NXREC_Close(file);
+            return ((status == 2) ? 1 : 2);
+        }
+        file->packBuf = (unsigned char *)malloc(file->hdr.lineBytes);
+        if (file->packBuf == NULL)
+        {
+            NXREC_Close(file);
+            return (1);
+        }
+    }
+
+    if (file->hdr.sampleFormat == NXREC_FMT_CI16_PACK)
+    {
+        file->packBuf = (unsigned char *)malloc(
+                            IQPACK_MaxBytes(file->hdr.samplesPerPri));
+        if (file->packBuf == NULL)
+        {
+            NXREC_Close(file);
+            return (1);
+        }
+    }
+
+    file->ini = (char *)malloc(file->hdr.iniBytes + 1);
+    if ((file->ini == NULL) ||
+        (NXREC_PreadAll(file->fd, file->ini, file->hdr.iniBytes,
+                        file->hdr.iniOffset) != 0))
+    {
+        NXREC_Close(file);
+        return (1);
+    }
+    file->ini[file->hdr.iniBytes] = '\0';
+
+    dataEnd = (unsigned long long)st.st_size;
+    if ((dataEnd >= sizeof(NXREC_TRAILER)) &&
+        (NXREC_PreadAll(file->fd, &trailer, sizeof(NXREC_TRAILER),
+                        dataEnd - sizeof(NXREC_TRAILER)) == 0) &&
+        NXREC_TrailerValid(&(file->hdr), &trailer, dataEnd))
+    {
+        file->index = (NXREC_INDEX_ENTRY *)malloc(
+                          (trailer.numEntries + 1) * sizeof(NXREC_INDEX_ENTRY));
+        if ((file->index == NULL) ||
+            (NXREC_PreadAll(file->fd, file->index,
+                            trailer.numEntries * sizeof(NXREC_INDEX_ENTRY),
+                            trailer.indexOffset) != 0))
+        {
+            NXREC_Close(file);
+            return (1);
+        }
+        file->numEntries = trailer.numEntries;
+        dataEnd          = trailer.indexOffset;
+    }
+
+    if (file->hdr.sampleFormat == NXREC_FMT_CI16_PACK)
+    {
+        if ((file->index == NULL) &&
+            (NXREC_WalkPacked(file, dataEnd) != 0))
+        {
+            NXREC_Close(file);
+            return (1);
+        }
+        if ((file->numEntries != 0) &&
+            (file->index[file->numEntries - 1].priIndex >= file->hdr.firstPri))
+            file->numLines = file->index[file->numEntries - 1].priIndex + 1 -
+                             file->hdr.firstPri;
+    }
+    else if (dataEnd > file->hdr.headerBytes)
+        file->numLines = (dataEnd - file->hdr.headerBytes) /
+                         file->hdr.recordBytes;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    NXREC_ReadLine()
+
+ Description: Reads one range line record.  The record is found through
+              the index if the file has one.  Packed lines are unpacked,
+              and block floating point lines decoded.
+
+ Parameters:  file   - pointer to an open NXREC_FILE
+              line   - record number, PRI hdr.firstPri + line
+              prefix - receives the record prefix, or NULL
+              iq     - receives samplesPerPri I/Q pairs, or NULL
+
+ Return:      0 - success
+              1 - line beyond the end of the file, or read failed
+              2 - the record was never written (no NXREC_LINE_SYNC), or
+                  its packed line is corrupt
+**************************************************************************/
+int NXREC_ReadLine (NXREC_FILE          *file,
+                    unsigned long long   line,
+                    NXREC_LINE          *prefix,
+                    int16_t             *iq)
+{
+    const NXREC_INDEX_ENTRY *entry;
+    unsigned long long       offset;
+    NXREC_LINE               local;
+    IQPACK_BLOCK             block;
+
+    if (line >= file->numLines)
+        return (1);
+
+    offset = file->hdr.headerBytes + (line * file->hdr.recordBytes);
+    if (file->index != NULL)
+    {
+        entry = NXREC_FindEntry(file->index, file->numEntries,
+                                file->hdr.firstPri + line);
+        if (entry == NULL)
+            return (2);
+        offset = entry->offset;
+    }
+
+    if (prefix == NULL)
+        prefix = &local;
+    if (NXREC_PreadAll(file->fd, prefix, sizeof(NXREC_LINE), offset) != 0)
+        return (1);
+
+    if (prefix->sync != NXREC_LINE_SYNC)
+        return (2);
+    if (iq == NULL)
+        return (0);
+
+    offset += file->hdr.prefixBytes;
+    if (file->packBuf == NULL)
+        return ((NXREC_PreadAll(file->fd, iq, file->hdr.lineBytes, offset) != 0) ?
+                    1 : 0);
+
+    if (file->hdr.sampleFormat == NXREC_FMT_CI16_BFP)
+    {
+        if (NXREC_PreadAll(file->fd, file->packBuf, file->hdr.lineBytes,
+                           offset) != 0)
+            return (1);
+        BFP_Decode(&(file->bfp), file->packBuf, iq);
+        return (0);
+    }
+
+    if (NXREC_PreadAll(file->fd, &block, sizeof(IQPACK_BLOCK), offset) != 0)
+        return (1);
+    if ((block.bytes < sizeof(IQPACK_BLOCK)) ||
+        (block.bytes > IQPACK_MaxBytes(file->hdr.samplesPerPri)))
+        return (2);
+    if (NXREC_PreadAll(file->fd, file->packBuf, block.bytes, offset) != 0)
+        return (1);
+
+    return ((IQPACK_Decode(file->packBuf, block.bytes, iq,
+                           file->hdr.samplesPerPri) != 0) ? 2 : 0);
+}
+
+
+/**************************************************************************
+ Function:    NXREC_Close()
+
+ Description: Closes a file opened with NXREC_Open().
+
+ Parameters:  file - pointer to the NXREC_FILE
+
+ Return:      none
+**************************************************************************/
+void NXREC_Close (NXREC_FILE *file)
+{
+    if (file->fd >= 0)
+        close(file->fd);
+    file->fd = -1;
+
+    free(file->ini);
+    file->ini = NULL;
+
+    free(file->index);
+    file->index      = NULL;
+    file->numEntries = 0;
+
+    free(file->packBuf);
+    file->packBuf = NULL;
+
+    BFP_Free(&(file->bfp));
+}
+
+
+/**************************************************************************
+ Function:    NXREC_WalkPacked()
+
+ Description: Builds the index of a packed file that has none (the run
+              was killed) by following the block lengths from the first
+              record.  Stops at the first record that is incomplete or not
+              a record.
+
+ Parameters:  file     - pointer to an NXREC_FILE with its header loaded
+              fileSize - length of the file
+
+ Return:      0 - success
+              1 - read or allocation failed
+**************************************************************************/
+static int NXREC_WalkPacked (NXREC_FILE *file, unsigned long long fileSize)
+{
+    NXREC_INDEX_ENTRY  *entry;
+    NXREC_LINE          prefix;
+    IQPACK_BLOCK        block;
+    unsigned long long  offset   = file->hdr.headerBytes;
+    unsigned long long  size     = 0;
+    unsigned int        maxBytes = IQPACK_MaxBytes(file->hdr.samplesPerPri);
+
+    while (offset + file->hdr.prefixBytes + sizeof(IQPACK_BLOCK) <= fileSize)
+    {
+        if ((NXREC_PreadAll(file->fd, &prefix, sizeof(NXREC_LINE), offset) != 0) ||
+            (NXREC_PreadAll(file->fd, &block, sizeof(IQPACK_BLOCK),
+                            offset + file->hdr.prefixBytes) != 0))
+            return (1);
+
+        if ((prefix.sync != NXREC_LINE_SYNC) ||
+            (block.samples != file->hdr.samplesPerPri) ||
+            (block.bytes < sizeof(IQPACK_BLOCK)) || (block.bytes > maxBytes) ||
+            (offset + file->hdr.prefixBytes + block.bytes > fileSize))
+            break;
+
+        if (file->numEntries == size)
+        {
+            size  = (size != 0) ? 2 * size : NXREC_WALK_ENTRIES;
+            entry = (NXREC_INDEX_ENTRY *)realloc(file->index, size *
+                                                 sizeof(NXREC_INDEX_ENTRY));
+            if (entry == NULL)
+                return (1);
+            file->index = entry;
+        }
+
+        entry = &(file->index[file->numEntries++]);
+        entry->priIndex = prefix.priIndex;
+        entry->offset   = offset;
+        entry->intrTime = prefix.intrTime;
+        entry->adcFlags = prefix.adcFlags;
+        entry->status   = 0;
+
+        offset += file->hdr.prefixBytes + block.bytes;
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    NXREC_PreadAll()
+
+ Description: Reads a buffer from a file offset with pread(), retrying
+              after signals and short reads.
+
+ Parameters:  fd     - file descriptor
+              buf    - receives the data
+              len    - bytes to read
+              offset - file offset
+
+ Return:      0 - success
+              1 - read failed or end of file reached
+**************************************************************************/
+static int NXREC_PreadAll (int                 fd,
+                           void               *buf,
+                           size_t              len,
+                           unsigned long long  offset)
+{
+    char    *p = (char *)buf;
+    ssize_t  count;
+
+    while (len > 0)
+    {
+        count = pread(fd, p, len, (off_t)offset);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return (1);
+        }
+        if (count == 0)
+            return (1);
+
+        p      += count;
+        len    -= count;
+        offset += count;
+    }
+
+    return (0);
+}
@@ -0,0 +1,394 @@
+/***********************************************************************
+*
+*   File: nxrec.h
+*
+*   Description: header file for nxrec.c, the NeXtRAD recording format
+*                (RECORD_FORMAT = 1 in NeXtRAD.ini) and its reader.
+*
+*                An nxrec file is a header followed by fixed-stride range
+*                line records:
+*
+*                    offset 0            NXREC_HEADER, then the text of
+*                                        NeXtRAD.ini; headerBytes long
+*                    headerBytes + n*R   record n: NXREC_LINE prefix, then
+*                                        samplesPerPri int16 I/Q pairs
+*                                        (lineBytes of coded samples with
+*                                        NXREC_FMT_CI16_BFP)
+*
+*                    indexOffset         NXREC_INDEX_ENTRY for each record
+*                                        written, in PRI order
+*                    end - 32            NXREC_TRAILER
+*
+*                R = recordBytes = prefixBytes + lineBytes.  headerBytes is
+*                a multiple of NXREC_ALIGN, so the records start aligned
+*                for O_DIRECT.  Record n holds PRI firstPri + n of the run.
+*                With the mmap output backend a PRI that was never written
+*                reads as zeros, and its prefix has no NXREC_LINE_SYNC.
+*
+*                A segmented recording (SEGMENT_PRIS in NeXtRAD.ini, see
+*                recseg.h) is a series of complete nxrec files, segment k
+*                holding PRIs from firstPri = k * segmentPris.  A whole
+*                file recording is segment 0 with segmentPris 0.
+*
+*                A range-gated recording (RANGE_GATESn in NeXtRAD.ini, see
+*                rgate.h) keeps only numGates windows of each rangeBins
+*                sample line.  Its samplesPerPri samples are the windows
+*                back to back, in the order of gate[]; sample n of window
+*                w is range bin gate[w].firstBin + n.  An ungated
+*                recording has numGates 0 and rangeBins = samplesPerPri.
+*
+*                With sampleFormat NXREC_FMT_CI16_PACK (COMPRESS_THREADS in
+*                NeXtRAD.ini) each record is the prefix followed by the
+*                line packed losslessly as an iqpack.c block, which starts
+*                with its own length and is padded to 8 bytes.  The
+*                records then vary in length, so recordBytes is only the
+*                unpacked size.  Records are
+*                found through the index, or by walking the block
+*                lengths from headerBytes.
+*
+*                With NXREC_FMT_CI16_BFP (BFP_BITS in NeXtRAD.ini) each
+*                line is coded in block floating point by bfp.c, lossily,
+*                with bfpBlock samples per exponent and bfpBits mantissa
+*                bits.  The records keep a fixed length.
+*
+*                The index and trailer are written when the run ends.  A
+*                file from a run that was killed has neither; readers then
+*                fall back to the fixed record stride and the file length.
+*                The index lets a reader find a PRI, its time and its
+*                status without touching the samples.
+*
+*                All fields are little-endian.  Readers must check magic
+*                and version, and must use headerBytes, prefixBytes and
+*                recordBytes from the header rather than sizeof().  Later
+*                versions may add fields to the end of either structure;
+*                version 2 added bfpBlock and bfpBits, version 3
+*                segment, segmentPris and firstPri, and version 4
+*                rangeBins, numGates and gate[].  Readers take those as 0
+*                in older files, except rangeBins, which is samplesPerPri.
+*
+*                The line samples are written straight from the DMA buffer
+*                with the prefix gathered in front of them, so the format
+*                costs no extra copy.
+*
+*                The reader side (NXREC_Open() and friends) has no
+*                dependency on the recorder and can be built into
+*                processing tools, C or C++.  nxrec_map.h is a header-only
+*                reader that maps the whole file instead.
+*
+************************************************************************/
+
+#ifndef __NXREC_H__
+#define __NXREC_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bfp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* NXREC_MAGIC - first 8 bytes of every nxrec file;
+ * NXREC_VERSION - format version written by this recorder
+ */
+#define NXREC_MAGIC          "NXRADREC"
+#define NXREC_VERSION        4
+
+/* NXREC_ALIGN - headerBytes is a multiple of this;
+ * NXREC_MAX_HEADER - largest header written (NeXtRAD.ini is truncated to
+ *                    fit)
+ */
+#define NXREC_ALIGN          4096
+#define NXREC_MAX_HEADER     (64 * 1024)
+
+/* NXREC_MAX_GATES - range windows a header can record */
+#define NXREC_MAX_GATES      8
+
+/* sample formats:
+ *     NXREC_FMT_CI16      - interleaved int16 I, Q
+ *     NXREC_FMT_CI16_PACK - NXREC_FMT_CI16 lines packed by iqpack.c
+ *     NXREC_FMT_CI16_BFP  - NXREC_FMT_CI16 lines coded by bfp.c (version 2)
+ */
+#define NXREC_FMT_CI16       1
+#define NXREC_FMT_CI16_PACK  2
+#define NXREC_FMT_CI16_BFP   3
+
+/* NXREC_LINE_SYNC - first word of every written record prefix ("LINE") */
+#define NXREC_LINE_SYNC      0x454E494CU
+
+/* NXREC_INDEX_MAGIC - first 8 bytes of the trailer */
+#define NXREC_INDEX_MAGIC    "NXRINDEX"
+
+/* NXREC_INDEX_ENTRY status bits:
+ *     NXREC_IDX_OVERRUN - the DMA engine may have refilled the line's
+ *                         buffer before it was saved; the samples may be
+ *                         torn
+ *     NXREC_IDX_WRITE   - the write of the line failed
+ */
+#define NXREC_IDX_OVERRUN    0x00000001U
+#define NXREC_IDX_WRITE      0x00000002U
+
+
+/* NXREC_GATE - one range window of a range-gated recording
+ *     firstBin = range bin of the window's first sample, counted from the
+ *                first sample of the DMA line
+ *     numBins  = complex samples in the window
+ */
+typedef struct NXREC_GATE
+        {
+            uint32_t    firstBin;
+            uint32_t    numBins;
+        } NXREC_GATE;
+
+
+/* NXREC_HEADER - fixed part of the file header
+ *     magic         = NXREC_MAGIC, not NUL terminated
+ *     version       = NXREC_VERSION
+ *     headerBytes   = offset of record 0
+ *     prefixBytes   = bytes of NXREC_LINE before each line's samples
+ *     lineBytes     = bytes of samples per line: unpacked, or as coded
+ *                     for NXREC_FMT_CI16_BFP
+ *     recordBytes   = prefixBytes + lineBytes; the record stride unless
+ *                     the lines are packed
+ *     samplesPerPri = complex samples per line as recorded; the sum of
+ *                     the windows' numBins if the line is range gated
+ *     sampleFormat  = NXREC_FMT_CI16, _CI16_PACK or _CI16_BFP
+ *     chanNum       = ADC channel, from 0
+ *     numPris       = PRIs the run was set up for, 0 = until stopped
+ *     waveformIndex = WAVEFORM_INDEX from NeXtRAD.ini
+ *     adcDelay      = ADC_DELAY from NeXtRAD.ini
+ *     dacDelay      = DAC_DELAY from NeXtRAD.ini
+ *     decimation    = total DDC decimation
+ *     irqCoalesce   = range lines per DMA interrupt
+ *     iniOffset     = offset in the header of the NeXtRAD.ini text
+ *     iniBytes      = length of that text (NUL terminated, not counted)
+ *     tuneFreqHz    = DDC tuning frequency
+ *     clockFreqHz   = ADC sample clock
+ *     startRealNs   = CLOCK_REALTIME when the file was opened, in ns
+ *     startMonoNs   = CLOCK_MONOTONIC at the same moment; line times are
+ *                     CLOCK_MONOTONIC, so add startRealNs - startMonoNs
+ *                     for wall-clock time
+ *     bfpBlock      = NXREC_FMT_CI16_BFP: complex samples per exponent
+ *     bfpBits       = NXREC_FMT_CI16_BFP: mantissa bits
+ *     segment       = number of this file in a segmented recording, from 0
+ *     segmentPris   = PRIs per segment, 0 if the run is not segmented
+ *     firstPri      = PRI number of record 0
+ *     rangeBins     = complex samples per line as acquired
+ *     numGates      = range windows kept, 0 = the whole line
+ *     gate          = the windows, in increasing order of firstBin
+ */
+typedef struct NXREC_HEADER
+        {
+            char        magic[8];
+            uint32_t    version;
+            uint32_t    headerBytes;
+            uint32_t    prefixBytes;
+            uint32_t    lineBytes;
+            uint32_t    recordBytes;
+            uint32_t    samplesPerPri;
+            uint32_t    sampleFormat;
+            int32_t     chanNum;
+            uint32_t    numPris;
+            int32_t     waveformIndex;
+            int32_t     adcDelay;
+            int32_t     dacDelay;
+            uint32_t    decimation;
+            uint32_t    irqCoalesce;
+            uint32_t    iniOffset;
+            uint32_t    iniBytes;
+            double      tuneFreqHz;
+            double      clockFreqHz;
+            uint64_t    startRealNs;
+            uint64_t    startMonoNs;
+            uint32_t    bfpBlock;
+            uint32_t    bfpBits;
+            uint32_t    segment;
+            uint32_t    segmentPris;
+            uint64_t    firstPri;
+            uint32_t    rangeBins;
+            uint32_t    numGates;
+            NXREC_GATE  gate[NXREC_MAX_GATES];
+        } NXREC_HEADER;
+
+
+/* NXREC_LINE - prefix of each range line record
+ *     sync     = NXREC_LINE_SYNC; anything else is an unwritten record
+ *     adcFlags = ADC interrupt flags sampled with the line
+ *     priIndex = PRI number since the start of the run
+ *     intrTime = CLOCK_MONOTONIC time of the line's link-end interrupt,
+ *                in ns, or 0 if not known
+ *     pubTime  = CLOCK_MONOTONIC time the line was handed to the writer
+ */
+typedef struct NXREC_LINE
+        {
+            uint32_t    sync;
+            uint32_t    adcFlags;
+            uint64_t    priIndex;
+            uint64_t    intrTime;
+            uint64_t    pubTime;
+        } NXREC_LINE;
+
+
+/* NXREC_INDEX_ENTRY - index entry for one record
+ *     priIndex = PRI number, as in the record prefix
+ *     offset   = file offset of the record (its prefix)
+ *     intrTime = as in the record prefix
+ *     adcFlags = as in the record prefix
+ *     status   = NXREC_IDX_* bits
+ */
+typedef struct NXREC_INDEX_ENTRY
+        {
+            uint64_t    priIndex;
+            uint64_t    offset;
+            uint64_t    intrTime;
+            uint32_t    adcFlags;
+            uint32_t    status;
+        } NXREC_INDEX_ENTRY;
+
+
+/* NXREC_TRAILER - last bytes of a file that has an index
+ *     magic       = NXREC_INDEX_MAGIC, not NUL terminated
+ *     indexOffset = file offset of the first index entry; also the end of
+ *                   the records
+ *     numEntries  = number of index entries
+ *     entryBytes  = bytes per index entry; a reader that finds a size it
+ *                   does not know ignores the index
+ *     reserved    = 0
+ */
+typedef struct NXREC_TRAILER
+        {
+            char        magic[8];
+            uint64_t    indexOffset;
+            uint64_t    numEntries;
+            uint32_t    entryBytes;
+            uint32_t    reserved;
+        } NXREC_TRAILER;
+
+
+/* NXREC_FILE - an nxrec file open for reading
+ *     fd         = file descriptor
+ *     hdr        = fixed header
+ *     ini        = NeXtRAD.ini text recorded with the file (NUL terminated)
+ *     numLines   = whole records in the file; for packed lines, the span
+ *                  of PRIs from firstPri to the last one written
+ *     index      = the file's index, or NULL if it has none; for packed
+ *                  lines without one, rebuilt by walking the records
+ *     numEntries = entries in index
+ *     packBuf    = a packed or coded line being read
+ *     bfp        = decoder for NXREC_FMT_CI16_BFP lines
+ */
+typedef struct NXREC_FILE
+        {
+            int                 fd;
+            NXREC_HEADER        hdr;
+            char               *ini;
+            unsigned long long  numLines;
+            NXREC_INDEX_ENTRY  *index;
+            unsigned long long  numEntries;
+            unsigned char      *packBuf;
+            BFP_CODER           bfp;
+        } NXREC_FILE;
+
+
+/**************************************************************************
+ Function:    NXREC_TrailerValid()
+
+ Description: Checks that a trailer read from the end of a file describes
+              an index this reader knows, fitting between the records and
+              the trailer.
+
+ Parameters:  hdr      - the file's header
+              trailer  - the last sizeof(NXREC_TRAILER) bytes of the file
+              fileSize - length of the file
+
+ Return:      1 - the file has a usable index
+              0 - it does not
+**************************************************************************/
+static inline int NXREC_TrailerValid (const NXREC_HEADER  *hdr,
+                                      const NXREC_TRAILER *trailer,
+                                      unsigned long long   fileSize)
+{
+    if ((fileSize < hdr->headerBytes + sizeof(NXREC_TRAILER)) ||
+        (memcmp(trailer->magic, NXREC_INDEX_MAGIC, sizeof(trailer->magic)) != 0) ||
+        (trailer->entryBytes != sizeof(NXREC_INDEX_ENTRY)) ||
+        (trailer->indexOffset < hdr->headerBytes) ||
+        (trailer->indexOffset > fileSize - sizeof(NXREC_TRAILER)))
+        return (0);
+
+    if ((trailer->numEntries > (fileSize - trailer->indexOffset) /
+                               trailer->entryBytes) ||
+        (trailer->indexOffset + (trailer->numEntries * trailer->entryBytes) +
+         sizeof(NXREC_TRAILER) != fileSize))
+        return (0);
+
+    return (1);
+}
+
+
+/**************************************************************************
+ Function:    NXREC_FindEntry()
+
+ Description: Finds a PRI's entry in an index.  Entry n normally holds the
+              PRI n after the first entry's; otherwise the index is
+              searched, since it is in PRI order.
+
+ Parameters:  index      - the index
+              numEntries - entries in the index
+              pri        - PRI number
+
+ Return:      pointer to the entry, or NULL if the PRI is not in the index
+**************************************************************************/
+static inline const NXREC_INDEX_ENTRY *NXREC_FindEntry (
+                                   const NXREC_INDEX_ENTRY *index,
+                                   unsigned long long       numEntries,
+                                   unsigned long long       pri)
+{
+    unsigned long long lo = 0;
+    unsigned long long hi = numEntries;
+    unsigned long long mid;
+
+    if (numEntries == 0)
+        return (NULL);
+
+    mid = pri - index[0].priIndex;
+    if ((pri >= index[0].priIndex) && (mid < numEntries) &&
+        (index[mid].priIndex == pri))
+        return (&(index[mid]));
+
+    while (lo < hi)
+    {
+        mid = lo + ((hi - lo) / 2);
+        if (index[mid].priIndex < pri)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if ((lo < numEntries) && (index[lo].priIndex == pri))
+        return (&(index[lo]));
+
+    return (NULL);
+}
+
+
+/* function prototypes - writer */
+unsigned int NXREC_BuildHeader (void               *buf,
+                                const NXREC_HEADER *fields,
+                                const char         *iniFile);
+
+/* function prototypes - reader */
+int          NXREC_Open        (NXREC_FILE         *file,
+                                const char         *fileName);
+int          NXREC_ReadLine    (NXREC_FILE         *file,
+                                unsigned long long  line,
+                                NXREC_LINE         *prefix,
+                                int16_t            *iq);
+void         NXREC_Close       (NXREC_FILE         *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NXREC_H__ */
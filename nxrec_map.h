@@ -0,0 +1,428 @@
+/***********************************************************************
+*
+*   File: nxrec_map.h
+*
+*   Description: header-only random-access reader for nxrec recordings
+*                (see nxrec.h).  The whole file is mapped read-only and
+*                each range line is returned in place, with no copy and no
+*                system call per line.  This makes it the reader to use
+*                for processing that jumps about in a long recording, for
+*                example corner turns or Doppler blocks at a PRI stride.
+*
+*                The lines of a range-gated recording hold only its
+*                windows (map->gate), back to back; see nxrec.h.
+*
+*                Include it in one or more C or C++ sources; nothing needs
+*                to be linked.  PRIs are found through the file's index
+*                when it has one, and by the fixed record stride when it
+*                does not.  Lines are numbered from the file's first
+*                record, PRI firstPri, so in a segment of a segmented
+*                recording line n is PRI firstPri + n.
+*
+*                The samples are returned as a pointer to interleaved
+*                int16 I, Q pairs, which has the same layout as an array
+*                of std::complex<int16_t> but is portable to C.  Packed
+*                lines (NXREC_FMT_CI16_PACK) are returned as their packed
+*                block instead, for the caller to unpack with
+*                IQPACK_Decode() (iqpack.c).  Packed files are only
+*                readable here if they have an index; NXREC_Open() can
+*                read those that do not.  Block floating point lines
+*                (NXREC_FMT_CI16_BFP) are returned coded too; decode them
+*                with BFP_Decode() (bfp.c), using a coder set up by
+*                BFP_Init() from samplesPerPri, bfpBlock and bfpBits.
+*
+*                The kernel reads the file in as it is touched.  For
+*                strided or random access, call NXREC_MapAdvise() with
+*                NXREC_ACCESS_RANDOM so that every fault does not pull in
+*                read-ahead that is never used.  Then call
+*                NXREC_MapPrefetch() on the lines needed next, so their
+*                reads overlap with the work on the current ones.
+*
+************************************************************************/
+
+#ifndef __NXREC_MAP_H__
+#define __NXREC_MAP_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "nxrec.h"
+
+
+/* access patterns for NXREC_MapAdvise() */
+#define NXREC_ACCESS_NORMAL      0
+#define NXREC_ACCESS_SEQUENTIAL  1
+#define NXREC_ACCESS_RANDOM      2
+
+
+/* NXREC_MAP - an nxrec file mapped for reading
+ *     base       = start of the mapping
+ *     size       = length of the file and the mapping
+ *     hdr        = header, in the mapping
+ *     ini        = NeXtRAD.ini text, in the mapping (iniBytes long, not
+ *                  NUL terminated)
+ *     firstPri   = PRI of record 0 (0 before version 3)
+ *     rangeBins  = complex samples per line as acquired (samplesPerPri
+ *                  before version 4)
+ *     numGates   = range windows kept, 0 = the whole line
+ *     gate       = the windows, in the mapping, or NULL if numGates is 0
+ *     numLines   = whole records in the file
+ *     index      = index, in the mapping, or NULL if the file has none
+ *     numEntries = entries in index
+ *     pageBytes  = system page size
+ */
+typedef struct NXREC_MAP
+        {
+            const unsigned char      *base;
+            unsigned long long        size;
+            const NXREC_HEADER       *hdr;
+            const char               *ini;
+            unsigned long long        firstPri;
+            uint32_t                  rangeBins;
+            uint32_t                  numGates;
+            const NXREC_GATE         *gate;
+            unsigned long long        numLines;
+            const NXREC_INDEX_ENTRY  *index;
+            unsigned long long        numEntries;
+            unsigned long             pageBytes;
+        } NXREC_MAP;
+
+
+/* NXREC_SPAN - one range line, in the mapping
+ *     prefix      = record prefix
+ *     iq          = samples: interleaved I, Q, 2 * samples values; NULL
+ *                   if the line is packed or coded
+ *     samples     = complex samples in the line
+ *     packed      = the packed block or coded line, or NULL if the line
+ *                   is plain NXREC_FMT_CI16
+ *     packedBytes = length of the packed block or coded line
+ */
+typedef struct NXREC_SPAN
+        {
+            const NXREC_LINE     *prefix;
+            const int16_t        *iq;
+            uint32_t              samples;
+            const unsigned char  *packed;
+            uint32_t              packedBytes;
+        } NXREC_SPAN;
+
+
+/**************************************************************************
+ Function:    NXREC_MapClose()
+
+ Description: Unmaps a file mapped with NXREC_MapOpen().  Spans taken from
+              it are no longer valid.
+
+ Parameters:  map - pointer to the NXREC_MAP
+
+ Return:      none
+**************************************************************************/
+static inline void NXREC_MapClose (NXREC_MAP *map)
+{
+    if (map->base != NULL)
+        munmap((void *)map->base, (size_t)map->size);
+
+    memset (map, 0, sizeof(NXREC_MAP));
+}
+
+
+/**************************************************************************
+ Function:    NXREC_MapOpen()
+
+ Description: Maps an nxrec file for reading and checks its header.  The
+              file descriptor is closed once the file is mapped.
+
+ Parameters:  map      - pointer to the NXREC_MAP to initialize
+              fileName - path of the recording
+
+ Return:      0 - success
+              1 - file failed to open or map
+              2 - not an nxrec file, or a version this reader does not
+                  know
+**************************************************************************/
+static inline int NXREC_MapOpen (NXREC_MAP *map, const char *fileName)
+{
+    const NXREC_HEADER  *hdr;
+    const NXREC_TRAILER *trailer;
+    struct stat          st;
+    unsigned long long   dataEnd;
+    void                *base;
+    int                  fd;
+
+    memset (map, 0, sizeof(NXREC_MAP));
+    map->pageBytes = (unsigned long)sysconf(_SC_PAGESIZE);
+
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+        return (1);
+
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return (1);
+    }
+    if ((unsigned long long)st.st_size < sizeof(NXREC_HEADER))
+    {
+        close(fd);
+        return (2);
+    }
+
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return (1);
+
+    map->base = (const unsigned char *)base;
+    map->size = (unsigned long long)st.st_size;
+    hdr       = (const NXREC_HEADER *)base;
+
+    if ((memcmp(hdr->magic, NXREC_MAGIC, sizeof(hdr->magic)) != 0) ||
+        (hdr->version < 1) || (hdr->version > NXREC_VERSION) ||
+        (hdr->recordBytes == 0) ||
+        (hdr->headerBytes < hdr->iniOffset + hdr->iniBytes) ||
+        (hdr->headerBytes > map->size) ||
+        (hdr->recordBytes != hdr->prefixBytes + hdr->lineBytes) ||
+        (hdr->prefixBytes < sizeof(NXREC_LINE)) ||
+        ((hdr->sampleFormat != NXREC_FMT_CI16) &&
+         (hdr->sampleFormat != NXREC_FMT_CI16_PACK) &&
+         ((hdr->sampleFormat != NXREC_FMT_CI16_BFP) || (hdr->version < 2))))
+    {
+        NXREC_MapClose(map);
+        return (2);
+    }
+
+    map->hdr = hdr;
+    map->ini = (const char *)map->base + hdr->iniOffset;
+
+    /* in older headers the ini text starts where the fields added since
+     * would be
+     */
+    if (hdr->version >= 3)
+        map->firstPri = hdr->firstPri;
+    map->rangeBins = hdr->samplesPerPri;
+    if (hdr->version >= 4)
+    {
+        if (hdr->numGates > NXREC_MAX_GATES)
+        {
+            NXREC_MapClose(map);
+            return (2);
+        }
+        map->rangeBins = hdr->rangeBins;
+        map->numGates  = hdr->numGates;
+        if (hdr->numGates != 0)
+            map->gate = hdr->gate;
+    }
+
+    dataEnd = map->size;
+    trailer = (const NXREC_TRAILER *)(map->base + map->size -
+                                      sizeof(NXREC_TRAILER));
+    if ((map->size >= hdr->headerBytes + sizeof(NXREC_TRAILER)) &&
+        NXREC_TrailerValid(hdr, trailer, map->size))
+    {
+        map->index      = (const NXREC_INDEX_ENTRY *)(map->base +
+                                                      trailer->indexOffset);
+        map->numEntries = trailer->numEntries;
+        dataEnd         = trailer->indexOffset;
+    }
+
+    if (hdr->sampleFormat != NXREC_FMT_CI16_PACK)
+        map->numLines = (dataEnd - hdr->headerBytes) / hdr->recordBytes;
+    else if ((map->numEntries != 0) &&
+             (map->index[map->numEntries - 1].priIndex >= map->firstPri))
+        map->numLines = map->index[map->numEntries - 1].priIndex + 1 -
+                        map->firstPri;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    NXREC_MapOffset()
+
+ Description: Returns the file offset of a PRI's record.
+
+ Parameters:  map  - pointer to an open NXREC_MAP
+              line - record number, PRI firstPri + line
+
+ Return:      file offset, or 0 if the PRI is not in the file
+**************************************************************************/
+static inline unsigned long long NXREC_MapOffset (const NXREC_MAP    *map,
+                                                  unsigned long long  line)
+{
+    const NXREC_INDEX_ENTRY *entry;
+
+    if (line >= map->numLines)
+        return (0);
+
+    if (map->index == NULL)
+        return (map->hdr->headerBytes + (line * map->hdr->recordBytes));
+
+    /* a packed record must at least hold its block header; the others
+     * are whole records
+     */
+    entry = NXREC_FindEntry(map->index, map->numEntries,
+                            map->firstPri + line);
+    if ((entry == NULL) ||
+        (entry->offset + ((map->hdr->sampleFormat == NXREC_FMT_CI16_PACK) ?
+                              map->hdr->prefixBytes + 8 :
+                              map->hdr->recordBytes) > map->size))
+        return (0);
+
+    return (entry->offset);
+}
+
+
+/**************************************************************************
+ Function:    NXREC_MapLine()
+
+ Description: Returns one range line, in place.
+
+ Parameters:  map  - pointer to an open NXREC_MAP
+              line - record number, PRI firstPri + line
+              span - receives the line
+
+ Return:      0 - success
+              1 - line beyond the end of the file
+              2 - the record was never written (no NXREC_LINE_SYNC, or
+                  missing from the index), or its packed block runs past
+                  the end of the file
+**************************************************************************/
+static inline int NXREC_MapLine (const NXREC_MAP    *map,
+                                 unsigned long long  line,
+                                 NXREC_SPAN         *span)
+{
+    unsigned long long   offset;
+    const unsigned char *data;
+    uint32_t             bytes;
+
+    if (line >= map->numLines)
+        return (1);
+
+    offset = NXREC_MapOffset(map, line);
+    if (offset == 0)
+        return (2);
+
+    data = map->base + offset + map->hdr->prefixBytes;
+
+    span->prefix      = (const NXREC_LINE *)(map->base + offset);
+    span->samples     = map->hdr->samplesPerPri;
+    span->iq          = (const int16_t *)data;
+    span->packed      = NULL;
+    span->packedBytes = 0;
+
+    /* a packed block starts with its length (IQPACK_BLOCK) */
+    if (map->hdr->sampleFormat == NXREC_FMT_CI16_PACK)
+    {
+        memcpy (&bytes, data, sizeof(bytes));
+        if ((unsigned long long)(data - map->base) + bytes > map->size)
+            return (2);
+        span->iq          = NULL;
+        span->packed      = data;
+        span->packedBytes = bytes;
+    }
+    else if (map->hdr->sampleFormat == NXREC_FMT_CI16_BFP)
+    {
+        span->iq          = NULL;
+        span->packed      = data;
+        span->packedBytes = map->hdr->lineBytes;
+    }
+
+    return ((span->prefix->sync == NXREC_LINE_SYNC) ? 0 : 2);
+}
+
+
+/**************************************************************************
+ Function:    NXREC_MapAdvise()
+
+ Description: Tells the kernel how the records are going to be read, so
+              it can size its read-ahead.
+
+ Parameters:  map     - pointer to an open NXREC_MAP
+              pattern - NXREC_ACCESS_NORMAL, _SEQUENTIAL or _RANDOM
+
+ Return:      0 - success
+              1 - madvise() failed
+**************************************************************************/
+static inline int NXREC_MapAdvise (const NXREC_MAP *map, int pattern)
+{
+    int advice = MADV_NORMAL;
+
+    if (pattern == NXREC_ACCESS_SEQUENTIAL)
+        advice = MADV_SEQUENTIAL;
+    else if (pattern == NXREC_ACCESS_RANDOM)
+        advice = MADV_RANDOM;
+
+    return ((madvise((void *)map->base, (size_t)map->size, advice) != 0) ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    NXREC_MapPrefetch()
+
+ Description: Starts reading lines in ahead of use, without waiting for
+              them: count lines from line first, stride PRIs apart.
+              Runs of adjacent lines are requested as one range.
+
+ Parameters:  map    - pointer to an open NXREC_MAP
+              first  - first record number
+              count  - number of lines
+              stride - PRIs between lines, 1 for consecutive lines
+
+ Return:      none
+**************************************************************************/
+static inline void NXREC_MapPrefetch (const NXREC_MAP    *map,
+                                      unsigned long long  first,
+                                      unsigned long long  count,
+                                      unsigned long long  stride)
+{
+    unsigned long long line;
+    unsigned long long offset;
+    unsigned long long start = 0;
+    unsigned long long end   = 0;
+    unsigned long long lineStart;
+    unsigned long long lineEnd;
+    unsigned long long i;
+
+    for (i = 0; i < count; i++)
+    {
+        line = first + (i * stride);
+        if (line >= map->numLines)
+            break;
+        offset = NXREC_MapOffset(map, line);
+        if (offset == 0)
+            continue;
+
+        /* a packed line is shorter than recordBytes; prefetching the
+         * unpacked length covers it
+         */
+        lineStart = offset & ~((unsigned long long)map->pageBytes - 1);
+        lineEnd   = offset + map->hdr->recordBytes;
+        if (lineEnd > map->size)
+            lineEnd = map->size;
+
+        /* extend the pending range while lines touch it */
+        if ((end != 0) && (lineStart <= end) && (lineEnd >= start))
+        {
+            if (lineEnd > end)
+                end = lineEnd;
+            continue;
+        }
+        if (end != 0)
+            madvise((void *)(map->base + start), (size_t)(end - start),
+                    MADV_WILLNEED);
+        start = lineStart;
+        end   = lineEnd;
+    }
+
+    if (end != 0)
+        madvise((void *)(map->base + start), (size_t)(end - start),
+                MADV_WILLNEED);
+}
+
+
+#endif /* __NXREC_MAP_H__ */
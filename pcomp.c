@@ -0,0 +1,756 @@
+/**************************************************************************
+*
+*   File: pcomp.c
+*
+*   Description: Real-time pulse compression.  See pcomp.h.
+*
+*                The feeder thread is the only consumer of the stage's
+*                queue.  It copies a line into a slot only when one is
+*                free, so when the workers fall behind it is the queue
+*                that fills and the ring that drops lines for the stage;
+*                neither the acquisition thread nor the writer ever
+*                waits on it.
+*
+*                Each worker filters into its slot's own FFT-size buffer,
+*                so the workers share nothing but the read-only plan and
+*                reference spectrum.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "pcomp.h"
+#include "iqk.h"
+
+
+/* PCOMP_REF_SPEC - what the reference spectrum is made from
+ *     plan       = FFT plan of the stage
+ *     ref        = reference samples
+ *     refSamples = samples in ref
+ *     window     = range window, FFT size points
+ */
+typedef struct PCOMP_REF_SPEC
+        {
+            const FFT_PLAN     *plan;
+            const float        *ref;
+            unsigned int        refSamples;
+            const float        *window;
+        } PCOMP_REF_SPEC;
+
+
+static int   PCOMP_MakeRefSpec  (void *out, size_t bytes,
+                                 const TCACHE_KEY *key, void *arg);
+static void *PCOMP_WorkerThread (void *pParams);
+static void *PCOMP_FeedThread   (void *pParams);
+static int   PCOMP_Output       (PULSE_COMP *pc, PCOMP_SLOT *slot,
+                                 const float *zeros);
+
+
+/**************************************************************************
+ Function:    PCOMP_LoadReference()
+
+ Description: Reads one waveform from WaveformTable.dat and turns it into
+              a matched filter reference at the ADC sample rate.  The
+              table is the text ddc_multichan loads into the DAC: a
+              declaration line, then one signed 32-bit word per line,
+              0xQQQQIIII.  The waveform is resampled by linear
+              interpolation and scaled to unit energy.
+
+ Parameters:  tablePath    - path of WaveformTable.dat
+              offset       - first word of the waveform (RAM_OFFSET_VEC)
+              length       - words in the waveform (RAM_LENGTH_VEC)
+              sampleRateHz - decimated complex sample rate of the lines
+              ref          - receives the reference, re, im interleaved
+              maxSamples   - most complex samples ref can hold
+              refSamples   - receives the samples in the reference
+
+ Return:      0 - success
+              1 - the table could not be opened
+              2 - the table ends before the waveform does, or the
+                  waveform is all zeros
+              3 - the resampled waveform is longer than maxSamples
+**************************************************************************/
+int PCOMP_LoadReference (const char    *tablePath,
+                         unsigned int   offset,
+                         unsigned int   length,
+                         double         sampleRateHz,
+                         float         *ref,
+                         unsigned int   maxSamples,
+                         unsigned int  *refSamples)
+{
+    FILE          *fp;
+    char           text[64];
+    char          *p;
+    float         *wave;
+    unsigned long  word = 0;
+    unsigned int   got  = 0;
+    unsigned int   count;
+    unsigned int   i;
+    unsigned int   i1;
+    unsigned int   k;
+    double         step;
+    double         t;
+    double         frac;
+    double         energy = 0.0;
+    float          scale;
+    uint32_t       w;
+
+    if ((length == 0) || (sampleRateHz <= 0.0))
+        return (2);
+
+    step  = PCOMP_TABLE_RATE_HZ / sampleRateHz;
+    count = (unsigned int)floor((length - 1) / step) + 1;
+    if (count > maxSamples)
+        return (3);
+
+    fp = fopen(tablePath, "r");
+    if (fp == NULL)
+        return (1);
+
+    wave = (float *)malloc(length * 2 * sizeof(float));
+    if (wave == NULL)
+    {
+        fclose(fp);
+        return (2);
+    }
+
+    while ((got < length) && (fgets(text, sizeof(text), fp) != NULL))
+    {
+        p = text;
+        while ((*p == ' ') || (*p == '\t'))
+            p++;
+        if ((*p != '-') && ((*p < '0') || (*p > '9')))
+            continue;
+
+        if (word++ < offset)
+            continue;
+        w = (uint32_t)strtol(p, NULL, 10);
+        wave[2*got]     = (float)(int16_t)(w & 0xffff);
+        wave[2*got + 1] = (float)(int16_t)(w >> 16);
+        got++;
+    }
+    fclose(fp);
+
+    if (got < length)
+    {
+        free(wave);
+        return (2);
+    }
+
+    for (k = 0; k < count; k++)
+    {
+        t    = k * step;
+        i    = (unsigned int)t;
+        i1   = (i + 1 < length) ? (i + 1) : i;
+        frac = t - i;
+        ref[2*k]     = (float)(wave[2*i] + (frac * (wave[2*i1] - wave[2*i])));
+        ref[2*k + 1] = (float)(wave[2*i + 1] + (frac * (wave[2*i1 + 1] - wave[2*i + 1])));
+        energy += ((double)ref[2*k] * ref[2*k]) + ((double)ref[2*k + 1] * ref[2*k + 1]);
+    }
+    free(wave);
+
+    if (energy == 0.0)
+        return (2);
+
+    scale = (float)(1.0 / sqrt(energy));
+    for (k = 0; k < 2 * count; k++)
+        ref[k] *= scale;
+
+    *refSamples = count;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    PCOMP_Init()
+
+ Description: Sets up the matched filter: the FFT plan and the conjugate
+              reference spectrum, tapered by the range window.  The
+              window spans the whole FFT band, centred on zero
+              frequency.  Both come from the table cache, made if it
+              does not have them.  PCOMP_Start() calls this; offline
+              tools call it on its own and filter with
+              PCOMP_FilterLine().
+
+ Parameters:  pc          - pointer to the PULSE_COMP to set up
+              samples     - complex samples per line
+              fftSize     - FFT size, a power of two at least samples;
+                            0 for the smallest that does not wrap
+              ref         - reference from PCOMP_LoadReference()
+              refSamples  - samples in the reference
+              rangeWindow - window code (win.h) for the range sidelobes
+              cache       - table cache (TCACHE_Open()) to get the tables
+                            from; it must outlive the stage
+
+ Return:      0 - success
+              1 - invalid FFT size or window
+              2 - allocation failed
+**************************************************************************/
+int PCOMP_Init (PULSE_COMP    *pc,
+                unsigned int   samples,
+                unsigned int   fftSize,
+                const float   *ref,
+                unsigned int   refSamples,
+                int            rangeWindow,
+                TABLE_CACHE   *cache)
+{
+    PCOMP_REF_SPEC  spec;
+    TCACHE_KEY      key;
+    int             status;
+
+    memset (pc, 0, sizeof(PULSE_COMP));
+
+    if (fftSize == 0)
+        fftSize = FFT_NextSize(samples + refSamples - 1);
+    if ((fftSize < samples) || (refSamples > fftSize))
+        return (1);
+    status = TCACHE_FftPlan(cache, &(pc->plan), fftSize);
+    if (status != 0)
+        return (status);
+
+    pc->samples     = samples;
+    pc->fftSize     = fftSize;
+    pc->refSamples  = refSamples;
+    pc->rangeWindow = rangeWindow;
+
+    spec.plan       = &(pc->plan);
+    spec.ref        = ref;
+    spec.refSamples = refSamples;
+    spec.window     = TCACHE_Window(cache, rangeWindow, fftSize);
+    if (spec.window == NULL)
+    {
+        PCOMP_Free(pc);
+        return (1);
+    }
+
+    memset (&key, 0, sizeof(key));
+    strcpy(key.kind, "pcref");
+    key.size   = fftSize;
+    key.window = rangeWindow;
+    key.length = refSamples;
+    key.source = TCACHE_Hash(ref, refSamples * 2 * sizeof(float));
+
+    pc->refSpec = (const float *)TCACHE_Get(cache, &key, fftSize * 2 * sizeof(float),
+                                            PCOMP_MakeRefSpec, &spec);
+    if (pc->refSpec == NULL)
+    {
+        PCOMP_Free(pc);
+        return (2);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    PCOMP_MakeRefSpec()
+
+ Description: TCACHE_BUILD for the reference spectrum: the conjugate of
+              the reference's spectrum, with the inverse FFT's 1/n,
+              tapered by the window centred on zero frequency.
+
+ Parameters:  out   - fftSize complex points
+              bytes - size of out
+              key   - the table's key
+              arg   - the PCOMP_REF_SPEC to make it from
+
+ Return:      0 - success
+**************************************************************************/
+static int PCOMP_MakeRefSpec (void *out, size_t bytes, const TCACHE_KEY *key,
+                              void *arg)
+{
+    const PCOMP_REF_SPEC *spec    = (const PCOMP_REF_SPEC *)arg;
+    unsigned int          fftSize = spec->plan->n;
+    float                *x       = (float *)out;
+    unsigned int          i;
+    float                 t;
+
+    (void)key;
+
+    memset (x, 0, bytes);
+    memcpy (x, spec->ref, spec->refSamples * 2 * sizeof(float));
+    FFT_Forward(spec->plan, x);
+    for (i = 0; i < fftSize; i++)
+    {
+        t = spec->window[(i + (fftSize / 2)) % fftSize] / fftSize;
+        x[2*i]     *= t;
+        x[2*i + 1] *= -t;
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    PCOMP_Start()
+
+ Description: Attaches a pulse compression stage to a channel's ring and
+              starts its workers and feeder.  Call before DMARING_Start().
+
+ Parameters:  pc          - pointer to the PULSE_COMP to set up
+              ring        - the channel's initialised ring
+              numWorkers  - workers to start (1 to PCOMP_MAX_WORKERS)
+              samples     - complex samples per line
+              fftSize     - FFT size, a power of two at least samples;
+                            0 for the smallest that does not wrap
+              ref         - reference from PCOMP_LoadReference()
+              refSamples  - samples in the reference
+              rangeWindow - window code (win.h) for the range sidelobes
+              cache       - table cache for PCOMP_Init()
+              rdop        - range-Doppler stage to pass the compressed
+                            lines to, in PRI order, or NULL
+              outfileName - pcN.dat to write, or NULL
+
+ Return:      0 - success
+              1 - invalid worker count, FFT size or window, or no queue
+                  left on the ring
+              2 - allocation, thread creation or file open failed
+**************************************************************************/
+int PCOMP_Start (PULSE_COMP    *pc,
+                 DMA_RING      *ring,
+                 unsigned int   numWorkers,
+                 unsigned int   samples,
+                 unsigned int   fftSize,
+                 const float   *ref,
+                 unsigned int   refSamples,
+                 int            rangeWindow,
+                 TABLE_CACHE   *cache,
+                 RANGE_DOPPLER *rdop,
+                 const char    *outfileName)
+{
+    unsigned int i;
+    int          status;
+
+    if ((numWorkers == 0) || (numWorkers > PCOMP_MAX_WORKERS))
+    {
+        memset (pc, 0, sizeof(PULSE_COMP));
+        return (1);
+    }
+
+    status = PCOMP_Init(pc, samples, fftSize, ref, refSamples, rangeWindow,
+                        cache);
+    if (status != 0)
+        return (status);
+
+    pc->ring     = ring;
+    pc->rdop     = rdop;
+    pc->numSlots = PCOMP_MAX_SLOTS;
+
+    /* touch the slot buffers now so they are not faulted in (and locked)
+     * during the run
+     */
+    for (i = 0; i < pc->numSlots; i++)
+    {
+        pc->slot[i].in  = (int16_t *)calloc(2 * samples, sizeof(int16_t));
+        pc->slot[i].out = (float *)calloc(2 * pc->fftSize, sizeof(float));
+        if ((pc->slot[i].in == NULL) || (pc->slot[i].out == NULL))
+        {
+            PCOMP_Free(pc);
+            return (2);
+        }
+    }
+
+    if (outfileName != NULL)
+    {
+        pc->outfile = fopen(outfileName, "wb");
+        if (pc->outfile == NULL)
+        {
+            PCOMP_Free(pc);
+            return (2);
+        }
+    }
+
+    pc->queue = DMARING_AddConsumer(ring);
+    if (pc->queue == NULL)
+    {
+        PCOMP_Free(pc);
+        return (1);
+    }
+
+    pc->numWorkers = numWorkers;
+    for (i = 0; i < numWorkers; i++)
+    {
+        pc->worker[i].pc    = pc;
+        pc->worker[i].index = i;
+        if (pthread_create(&(pc->worker[i].thread), NULL,
+                           PCOMP_WorkerThread, &(pc->worker[i])) != 0)
+        {
+            pc->numWorkers = i;
+            PCOMP_Stop(pc);
+            return (2);
+        }
+    }
+
+    if (pthread_create(&(pc->feeder), NULL, PCOMP_FeedThread, pc) != 0)
+    {
+        PCOMP_Stop(pc);
+        return (2);
+    }
+    pc->feederStarted = 1;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    PCOMP_Stop()
+
+ Description: Lets the feeder filter and output every line still queued,
+              then stops the threads, closes pcN.dat and frees the
+              buffers.  Call after the acquisition thread has published
+              its last line.
+
+ Parameters:  pc - pointer to the stage
+
+ Return:      0 - success
+              1 - a write to pcN.dat failed
+**************************************************************************/
+int PCOMP_Stop (PULSE_COMP *pc)
+{
+    unsigned int i;
+
+    __atomic_store_n(&(pc->stop), 1, __ATOMIC_RELEASE);
+    if (pc->feederStarted)
+        pthread_join(pc->feeder, NULL);
+    pc->feederStarted = 0;
+
+    __atomic_store_n(&(pc->stopWorkers), 1, __ATOMIC_RELEASE);
+    for (i = 0; i < pc->numWorkers; i++)
+        pthread_join(pc->worker[i].thread, NULL);
+
+    if ((pc->outfile != NULL) && (fclose(pc->outfile) != 0))
+        pc->writeError = 1;
+    pc->outfile = NULL;
+
+    PCOMP_Free(pc);
+
+    return (pc->writeError);
+}
+
+
+/**************************************************************************
+ Function:    PCOMP_Report()
+
+ Description: Prints the lines compressed, the time each worker takes per
+              line and the line rate the stage sustains against the PRF,
+              and the strongest return of the run.
+
+ Parameters:  pc      - pointer to a stopped stage
+              chanNum - ADC channel number
+              priNs   - nominal PRI in ns, 0 if not known
+
+ Return:      none
+**************************************************************************/
+void PCOMP_Report (PULSE_COMP *pc, int chanNum, unsigned int priNs)
+{
+    PCOMP_WORKER       *w;
+    unsigned long long  lines  = 0;
+    unsigned long long  busyNs = 0;
+    double              rate;
+    unsigned int        i;
+
+    printf("[dmaThread %d] pc: FFT %u (%s), reference %u samples, %s window, "
+           "%u worker(s), %llu lines, %llu lost, %lu overrun(s)\n", chanNum+1,
+           pc->fftSize, pc->plan.kernelName, pc->refSamples,
+           WIN_Name(pc->rangeWindow), pc->numWorkers, pc->output, pc->lost,
+           pc->overruns);
+
+    for (i = 0; i < pc->numWorkers; i++)
+    {
+        w = &(pc->worker[i]);
+        if (w->lines == 0)
+            continue;
+        printf("[dmaThread %d] pc: worker %u, %lu lines, %.1f us per line\n",
+               chanNum+1, i, w->lines, ((double)w->busyNs / w->lines) / 1e3);
+        lines  += w->lines;
+        busyNs += w->busyNs;
+    }
+
+    if (busyNs != 0)
+    {
+        rate = (pc->numWorkers * (double)lines) / ((double)busyNs / 1e9);
+        printf("[dmaThread %d] pc: sustains %.0f lines/s", chanNum+1, rate);
+        if (priNs != 0)
+            printf(" against a PRF of %.0f Hz%s", 1e9 / priNs,
+                   (rate < 1e9 / priNs) ? " - TOO SLOW, add workers" : "");
+        printf("\n");
+    }
+
+    if (pc->peakPow > 0.0f)
+        printf("[dmaThread %d] pc: strongest return %.1f dB at bin %u, PRI %llu\n",
+               chanNum+1, 10.0 * log10(pc->peakPow), pc->peakBin, pc->peakPri);
+}
+
+
+/**************************************************************************
+ Function:    PCOMP_FilterLine()
+
+ Description: Matched filters one line: zero pad, FFT, multiply by the
+              conjugate reference spectrum, inverse FFT, and find the
+              line's peak.  Uses only the read-only plan and reference
+              spectrum, so any number of threads can filter at once.
+
+ Parameters:  pc      - pointer to the stage, set up by PCOMP_Init()
+              in      - the line, interleaved int16 I, Q
+              x       - FFT size complex points out; the first samples
+                        are the compressed line
+              peakPow - receives the largest |x|^2 in the line
+              peakBin - receives the range bin of peakPow
+
+ Return:      none
+**************************************************************************/
+void PCOMP_FilterLine (const PULSE_COMP *pc, const int16_t *in, float *x,
+                       float *peakPow, unsigned int *peakBin)
+{
+    unsigned int  n   = pc->fftSize;
+    const float  *h   = pc->refSpec;
+    float         re;
+    float         im;
+    float         pow;
+    unsigned int  i;
+
+    IQK_ToComplex(in, x, pc->samples);
+    memset (x + (2 * pc->samples), 0, (n - pc->samples) * 2 * sizeof(float));
+
+    FFT_Forward(&(pc->plan), x);
+    for (i = 0; i < n; i++)
+    {
+        re = (x[2*i] * h[2*i])     - (x[2*i + 1] * h[2*i + 1]);
+        im = (x[2*i] * h[2*i + 1]) + (x[2*i + 1] * h[2*i]);
+        x[2*i]     = re;
+        x[2*i + 1] = im;
+    }
+    FFT_Inverse(&(pc->plan), x);
+
+    *peakPow = 0.0f;
+    *peakBin = 0;
+    for (i = 0; i < pc->samples; i++)
+    {
+        pow = (x[2*i] * x[2*i]) + (x[2*i + 1] * x[2*i + 1]);
+        if (pow > *peakPow)
+        {
+            *peakPow = pow;
+            *peakBin = i;
+        }
+    }
+}
+
+
+/**************************************************************************
+ Function:    PCOMP_WorkerThread()
+
+ Description: Matched filter worker.  Filters lines index, index + W,
+              index + 2W ... in turn, waiting for each to be fed.  Spins
+              briefly when idle, then sleeps in PCOMP_SLEEP_NS steps.
+
+ Parameters:  pParams - pointer to the worker's PCOMP_WORKER
+
+ Return:      NULL
+**************************************************************************/
+static void *PCOMP_WorkerThread (void *pParams)
+{
+    PCOMP_WORKER       *w    = (PCOMP_WORKER *)pParams;
+    PULSE_COMP         *pc   = w->pc;
+    PCOMP_SLOT         *slot;
+    struct timespec     idle  = {0, PCOMP_SLEEP_NS};
+    unsigned long long  seq   = w->index;
+    unsigned long long  start;
+    unsigned int        spins = 0;
+
+    while (1)
+    {
+        slot = &(pc->slot[seq % pc->numSlots]);
+        if ((__atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE) != PCOMP_QUEUED) ||
+            (__atomic_load_n(&(slot->seq), __ATOMIC_RELAXED) != seq))
+        {
+            if (__atomic_load_n(&(pc->stopWorkers), __ATOMIC_ACQUIRE))
+                break;
+            if (spins < PCOMP_SPINS)
+                spins++;
+            else
+                nanosleep(&idle, NULL);
+            continue;
+        }
+
+        spins = 0;
+        start = DMARING_TimeNs();
+        PCOMP_FilterLine(pc, slot->in, slot->out, &(slot->peakPow),
+                         &(slot->peakBin));
+        w->busyNs += DMARING_TimeNs() - start;
+        w->lines++;
+
+        __atomic_store_n(&(slot->state), PCOMP_DONE, __ATOMIC_RELEASE);
+        seq += pc->numWorkers;
+    }
+
+    return (NULL);
+}
+
+
+/**************************************************************************
+ Function:    PCOMP_FeedThread()
+
+ Description: Feeder.  Outputs finished lines in PRI order and copies new
+              lines from the queue into free slots, until stopped with
+              the queue and the pool empty.
+
+ Parameters:  pParams - pointer to the PULSE_COMP
+
+ Return:      NULL
+**************************************************************************/
+static void *PCOMP_FeedThread (void *pParams)
+{
+    PULSE_COMP       *pc = (PULSE_COMP *)pParams;
+    PCOMP_SLOT       *slot;
+    RANGE_LINE_DESC   desc;
+    struct timespec   idle  = {0, PCOMP_SLEEP_NS};
+    float            *zeros;
+    unsigned int      spins = 0;
+    int               busy;
+
+    zeros = (float *)calloc(2 * pc->samples, sizeof(float));
+    if (zeros == NULL)
+        pc->writeError = 1;
+
+    while (1)
+    {
+        busy = 0;
+
+        /* finished lines, oldest first */
+        while (pc->output < pc->fed)
+        {
+            slot = &(pc->slot[pc->output % pc->numSlots]);
+            if (__atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE) != PCOMP_DONE)
+                break;
+            if (PCOMP_Output(pc, slot, zeros) != 0)
+                pc->writeError = 1;
+            __atomic_store_n(&(slot->state), PCOMP_FREE, __ATOMIC_RELEASE);
+            pc->output++;
+            busy = 1;
+        }
+
+        /* new lines, while there is a slot for them */
+        while ((pc->fed - pc->output) < pc->numSlots)
+        {
+            if (SPSCQ_Pop(pc->queue, &desc) != 0)
+                break;
+
+            slot = &(pc->slot[pc->fed % pc->numSlots]);
+            memcpy (slot->in, desc.buf, pc->samples * 2 * sizeof(int16_t));
+            slot->overrun = DMARING_Refilled(pc->ring, desc.priIndex);
+            if (slot->overrun)
+                pc->overruns++;
+            slot->pri  = desc.priIndex;
+            slot->gap  = desc.priIndex - pc->nextPri;
+            pc->lost  += slot->gap;
+            pc->nextPri = desc.priIndex + 1;
+
+            __atomic_store_n(&(slot->seq), pc->fed, __ATOMIC_RELAXED);
+            __atomic_store_n(&(slot->state), PCOMP_QUEUED, __ATOMIC_RELEASE);
+            pc->fed++;
+            busy = 1;
+        }
+
+        if (busy)
+        {
+            spins = 0;
+            continue;
+        }
+        if (__atomic_load_n(&(pc->stop), __ATOMIC_ACQUIRE) &&
+            (SPSCQ_Depth(pc->queue) == 0) && (pc->output == pc->fed))
+            break;
+        if (spins < PCOMP_SPINS)
+            spins++;
+        else
+            nanosleep(&idle, NULL);
+    }
+
+    free(zeros);
+
+    return (NULL);
+}
+
+
+/**************************************************************************
+ Function:    PCOMP_Output()
+
+ Description: Takes a finished line into the run's statistics and writes
+              it to pcN.dat and the range-Doppler stage, after a zero
+              line for each line lost just before it.
+
+ Parameters:  pc    - pointer to the stage
+              slot  - the finished line
+              zeros - a line of zeros, or NULL if it could not be made
+
+ Return:      0 - success, or no output file
+              1 - a write failed
+**************************************************************************/
+static int PCOMP_Output (PULSE_COMP *pc, PCOMP_SLOT *slot, const float *zeros)
+{
+    size_t             lineBytes = pc->samples * 2 * sizeof(float);
+    unsigned long long i;
+
+    if (slot->peakPow > pc->peakPow)
+    {
+        pc->peakPow = slot->peakPow;
+        pc->peakBin = slot->peakBin;
+        pc->peakPri = slot->pri;
+    }
+
+    if (pc->rdop != NULL)
+    {
+        for (i = 0; (i < slot->gap) && (zeros != NULL); i++)
+            RDOP_AddLine(pc->rdop, zeros);
+        RDOP_AddLine(pc->rdop, slot->out);
+    }
+
+    if (pc->outfile == NULL)
+        return (0);
+
+    for (i = 0; i < slot->gap; i++)
+    {
+        if ((zeros == NULL) || (fwrite(zeros, 1, lineBytes, pc->outfile) != lineBytes))
+            return (1);
+    }
+
+    return ((fwrite(slot->out, 1, lineBytes, pc->outfile) != lineBytes) ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    PCOMP_Free()
+
+ Description: Frees the slot buffers and lets go of the FFT plan and
+              reference spectrum, which the table cache keeps.
+              PCOMP_Stop() does this for a started stage; offline tools
+              call it for one only set up with PCOMP_Init().
+
+ Parameters:  pc - pointer to the stage
+
+ Return:      none
+**************************************************************************/
+void PCOMP_Free (PULSE_COMP *pc)
+{
+    unsigned int i;
+
+    FFT_Free(&(pc->plan));
+    pc->refSpec = NULL;
+
+    for (i = 0; i < PCOMP_MAX_SLOTS; i++)
+    {
+        free(pc->slot[i].in);
+        free(pc->slot[i].out);
+        pc->slot[i].in  = NULL;
+        pc->slot[i].out = NULL;
+    }
+
+    if (pc->outfile != NULL)
+        fclose(pc->outfile);
+    pc->outfile = NULL;
+}
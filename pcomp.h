@@ -0,0 +1,255 @@
+/***********************************************************************
+*
+*   File: pcomp.h
+*
+*   Description: header file for pcomp.c, real-time pulse compression of
+*                the range lines a channel captures.
+*
+*                Set from NeXtRAD.ini:
+*                    PULSE_COMPRESS_THREADS - matched filter workers per
+*                                             channel; 0 = off
+*                    PULSE_COMPRESS_FFT     - FFT size; 0 = the smallest
+*                                             that holds a line and the
+*                                             reference without wrapping
+*                    PULSE_COMPRESS_OUTPUT  - 1 = write the compressed
+*                                             lines to pcN.dat
+*                    RANGE_WINDOW           - window (win.h) tapering the
+*                                             reference spectrum, for
+*                                             lower range sidelobes
+*
+*                The reference is the WAVEFORM_INDEX entry of
+*                WaveformTable.dat, the DAC table the transmitter plays:
+*                RAM_LENGTH_VEC samples from RAM_OFFSET_VEC, each a
+*                0xQQQQIIII word at PCOMP_TABLE_RATE_HZ.  It is resampled
+*                to the decimated ADC rate and scaled to unit energy, so
+*                noise comes out of the filter at the level it went in
+*                and a point target gains the pulse's compression ratio.
+*
+*                Each line is converted to complex float, zero padded to
+*                the FFT size, transformed, multiplied by the conjugate
+*                reference spectrum and transformed back.  Output bin k
+*                is the correlation of the line with the reference
+*                starting at sample k, i.e. range bin k.  With an FFT
+*                shorter than line + reference - 1 samples the last bins
+*                wrap round to the start of the line.
+*
+*                The stage is a consumer of the channel's DMA ring
+*                (DMARING_AddConsumer()).  Its feeder thread copies each
+*                line out of the DMA buffer into a pool slot, so the
+*                buffer is finished with at once, and collects the
+*                compressed lines in PRI order.  Workers take slots in a
+*                fixed rotation as iqpack.c's do.  Lines the stage lost
+*                (its queue overflowed because the workers fell behind)
+*                are written to pcN.dat as zeros, so the file stays
+*                aligned to the PRI count.
+*
+*                pcN.dat is raw complex float32 lines of SAMPLES_PER_PRI
+*                bins, I then Q, back to back.  The same lines, zero lines
+*                included, go on to the range-Doppler stage (rdop.c) when
+*                there is one.
+*
+*                PCOMP_Init(), PCOMP_FilterLine() and PCOMP_Free() are the
+*                matched filter on its own, for offline tools (rdbench.c).
+*
+*                The FFT plan and reference spectrum come from the table
+*                cache (tcache.c), keyed by FFT size, window and the
+*                reference samples, so they are only made when one of
+*                those changes and channels with the same set up share
+*                them.
+*
+************************************************************************/
+
+#ifndef __PCOMP_H__
+#define __PCOMP_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "dmaring.h"
+#include "fft.h"
+#include "win.h"
+#include "rdop.h"
+#include "tcache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* PCOMP_TABLE_RATE_HZ - sample rate of WaveformTable.dat, the DAC data
+ * rate it was made for (BasebandChripVector.m)
+ */
+#define PCOMP_TABLE_RATE_HZ  180e6
+
+/* PCOMP_MAX_WORKERS - matched filter workers per channel;
+ * PCOMP_MAX_SLOTS - lines a stage can hold between feeding and output
+ */
+#define PCOMP_MAX_WORKERS    16
+#define PCOMP_MAX_SLOTS      64
+
+/* PCOMP_SPINS - empty polls before an idle thread starts sleeping;
+ * PCOMP_SLEEP_NS - length of each sleep once idle
+ */
+#define PCOMP_SPINS          256
+#define PCOMP_SLEEP_NS       20000
+
+/* slot states */
+#define PCOMP_FREE           0
+#define PCOMP_QUEUED         1
+#define PCOMP_DONE           2
+
+
+/* PCOMP_SLOT - one line passing through the stage
+ *     seq      = feed number of the line in the slot
+ *     state    = PCOMP_FREE, _QUEUED or _DONE
+ *     pri      = PRI index of the line
+ *     gap      = lines lost just before this one
+ *     overrun  = the DMA buffer had been refilled before it was copied
+ *     in       = copy of the line: interleaved int16 I, Q
+ *     out      = FFT size complex points; the first samples are the
+ *                compressed line
+ *     peakPow  = largest |out|^2 in the line
+ *     peakBin  = range bin of peakPow
+ */
+typedef struct PCOMP_SLOT
+        {
+            unsigned long long  seq;
+            int                 state;
+            unsigned long long  pri;
+            unsigned long long  gap;
+            int                 overrun;
+            int16_t            *in;
+            float              *out;
+            float               peakPow;
+            unsigned int        peakBin;
+        } PCOMP_SLOT;
+
+
+/* PCOMP_WORKER - one matched filter worker
+ *     pc     = the worker's stage
+ *     index  = worker number; it filters lines index, index + W, ...
+ *     lines  = lines filtered
+ *     busyNs = time spent filtering, in ns
+ *     thread = worker thread
+ */
+typedef struct PCOMP_WORKER
+        {
+            struct PULSE_COMP  *pc;
+            unsigned int        index;
+            unsigned long       lines;
+            unsigned long long  busyNs;
+            pthread_t           thread;
+        } PCOMP_WORKER;
+
+
+/* PULSE_COMP - pulse compression stage for one channel
+ *     ring       = the channel's DMA ring
+ *     queue      = the stage's descriptor queue on the ring
+ *     samples    = complex samples per line
+ *     fftSize    = FFT size
+ *     refSamples = samples in the reference
+ *     rangeWindow = window code the reference spectrum is tapered with
+ *     plan       = FFT plan, shared by the workers
+ *     refSpec    = conjugate reference spectrum, tapered and scaled by
+ *                  1/FFT size; plan's tables and refSpec are held by the
+ *                  table cache
+ *     rdop       = range-Doppler stage fed the compressed lines, or NULL
+ *     outfile    = pcN.dat, or NULL
+ *     numWorkers = workers started
+ *     numSlots   = slots in use
+ *     slot       = line slots, used round robin by feed number
+ *     worker     = workers
+ *     feeder     = feeder thread
+ *     feederStarted = the feeder thread is running
+ *     stopWorkers = set by PCOMP_Stop() to end the workers, once the
+ *                   feeder has finished
+ *
+ *   owned by the feeder thread:
+ *     fed        = lines copied into slots
+ *     output     = lines collected, in PRI order
+ *     nextPri    = PRI expected next from the queue
+ *     lost       = lines the stage never saw
+ *     overruns   = lines refilled by the DMA engine before being copied
+ *     writeError = set if a write to outfile failed
+ *     peakPow    = largest |out|^2 of the run, and where it was
+ *     peakBin
+ *     peakPri
+ *     stop       = set by PCOMP_Stop() to have the feeder drain the
+ *                  stage and end
+ */
+typedef struct PULSE_COMP
+        {
+            DMA_RING           *ring;
+            SPSC_QUEUE         *queue;
+            unsigned int        samples;
+            unsigned int        fftSize;
+            unsigned int        refSamples;
+            int                 rangeWindow;
+            FFT_PLAN            plan;
+            const float        *refSpec;
+            RANGE_DOPPLER      *rdop;
+            FILE               *outfile;
+            unsigned int        numWorkers;
+            unsigned int        numSlots;
+            PCOMP_SLOT          slot[PCOMP_MAX_SLOTS];
+            PCOMP_WORKER        worker[PCOMP_MAX_WORKERS];
+            pthread_t           feeder;
+            int                 feederStarted;
+            int                 stopWorkers;
+
+            unsigned long long  fed;
+            unsigned long long  output;
+            unsigned long long  nextPri;
+            unsigned long long  lost;
+            unsigned long       overruns;
+            int                 writeError;
+            float               peakPow;
+            unsigned int        peakBin;
+            unsigned long long  peakPri;
+            int                 stop;
+        } PULSE_COMP;
+
+
+/* function prototypes */
+int  PCOMP_LoadReference (const char    *tablePath,
+                          unsigned int   offset,
+                          unsigned int   length,
+                          double         sampleRateHz,
+                          float         *ref,
+                          unsigned int   maxSamples,
+                          unsigned int  *refSamples);
+int  PCOMP_Init          (PULSE_COMP    *pc,
+                          unsigned int   samples,
+                          unsigned int   fftSize,
+                          const float   *ref,
+                          unsigned int   refSamples,
+                          int            rangeWindow,
+                          TABLE_CACHE   *cache);
+void PCOMP_FilterLine    (const PULSE_COMP *pc,
+                          const int16_t *in,
+                          float         *x,
+                          float         *peakPow,
+                          unsigned int  *peakBin);
+void PCOMP_Free          (PULSE_COMP    *pc);
+int  PCOMP_Start         (PULSE_COMP    *pc,
+                          DMA_RING      *ring,
+                          unsigned int   numWorkers,
+                          unsigned int   samples,
+                          unsigned int   fftSize,
+                          const float   *ref,
+                          unsigned int   refSamples,
+                          int            rangeWindow,
+                          TABLE_CACHE   *cache,
+                          RANGE_DOPPLER *rdop,
+                          const char    *outfileName);
+int  PCOMP_Stop          (PULSE_COMP    *pc);
+void PCOMP_Report        (PULSE_COMP    *pc,
+                          int            chanNum,
+                          unsigned int   priNs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PCOMP_H__ */
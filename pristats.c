@@ -0,0 +1,198 @@
+/**************************************************************************
+*
+*   File: pristats.c
+*
+*   Description: Per-PRI accounting of the acquisition loop.  See
+*                pristats.h.
+*
+*                A gap is an interrupt spacing more than half a PRI over
+*                the expected one (one PRI, or linesPerIrq PRIs with
+*                interrupt coalescing); the number of pulses missed in it
+*                is the spacing rounded to a whole number of PRIs, less
+*                the expected number.  A late service is a line
+*                still being picked up after the next link-end interrupt
+*                has arrived.  An occasional late service is absorbed by
+*                the DMA ring; a backlog that keeps growing means the PRF
+*                is more than the recorder can sustain.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pristats.h"
+
+
+/**************************************************************************
+ Function:    PRISTATS_Init()
+
+ Description: Resets a channel's accounting.
+
+ Parameters:  stats        - pointer to the PRI_STATS to initialize
+              priNs        - nominal PRI in ns, or 0 to estimate it from
+                             the first PRI_EST_LINES interrupts
+              badTrigMask  - ADC flag bits meaning a missed trigger
+              overflowMask - ADC flag bits meaning lost ADC data
+              linesPerIrq  - range lines per link-end interrupt
+
+ Return:      none
+**************************************************************************/
+void PRISTATS_Init (PRI_STATS          *stats,
+                    unsigned long long  priNs,
+                    unsigned int        badTrigMask,
+                    unsigned int        overflowMask,
+                    unsigned int        linesPerIrq)
+{
+    memset (stats, 0, sizeof(PRI_STATS));
+
+    stats->priNs        = priNs;
+    stats->priGiven     = (priNs != 0);
+    stats->badTrigMask  = badTrigMask;
+    stats->overflowMask = overflowMask;
+    stats->linesPerIrq  = linesPerIrq;
+    stats->minDelta     = ~0ULL;
+}
+
+
+/**************************************************************************
+ Function:    PRISTATS_IrqTime()
+
+ Description: Returns the time of a channel's index-th link-end interrupt
+              and how many interrupts have arrived after it.
+
+ Parameters:  log     - the channel's interrupt log
+              index   - interrupt number, counting from 0
+              backlog - receives the number of later interrupts already
+                        received
+
+ Return:      interrupt time in ns, or 0 if the stamp has been overwritten
+**************************************************************************/
+unsigned long long PRISTATS_IrqTime (PRI_IRQ_LOG   *log,
+                                     unsigned long  index,
+                                     unsigned long *backlog)
+{
+    unsigned long count = __atomic_load_n(&(log->count), __ATOMIC_ACQUIRE);
+
+    if (count <= index)
+    {
+        *backlog = 0;
+        return (0);
+    }
+
+    *backlog = count - index - 1;
+    if (*backlog >= PRI_IRQ_LOG_SIZE)
+        return (0);
+
+    return (log->stamp[index & PRI_IRQ_LOG_MASK]);
+}
+
+
+/**************************************************************************
+ Function:    PRISTATS_Line()
+
+ Description: Accounts for one serviced link-end interrupt, i.e. one range
+              line, or one group of linesPerIrq lines with coalescing.
+
+ Parameters:  stats       - pointer to the channel's PRI_STATS
+              intrTime    - time of the link-end interrupt, in ns, or 0 if
+                            not known
+              serviceTime - time dmaThread() picked the interrupt up, in ns
+              backlog     - interrupts waiting behind this one
+              adcFlags    - ADC interrupt flags sampled for it
+              lines       - range lines kept from it (fewer than
+                            linesPerIrq for the last group of a run)
+
+ Return:      none
+**************************************************************************/
+void PRISTATS_Line (PRI_STATS          *stats,
+                    unsigned long long  intrTime,
+                    unsigned long long  serviceTime,
+                    unsigned long       backlog,
+                    unsigned int        adcFlags,
+                    unsigned int        lines)
+{
+    unsigned long long delta;
+    unsigned long long latency;
+    unsigned long long expected;
+
+    stats->irqs++;
+    stats->lines += lines;
+
+    if (adcFlags & stats->badTrigMask)
+        stats->badTrigs++;
+    if (adcFlags & stats->overflowMask)
+        stats->overflows++;
+
+    if (backlog > 0)
+        stats->late++;
+    if (backlog > stats->maxBacklog)
+        stats->maxBacklog = backlog;
+
+    if (intrTime == 0)
+    {
+        stats->lostStamps++;
+        stats->lastIntr = 0;
+        return;
+    }
+
+    latency = serviceTime - intrTime;
+    stats->latSum += latency;
+    if (latency > stats->latMax)
+        stats->latMax = latency;
+
+    if (stats->lastIntr != 0)
+    {
+        delta = intrTime - stats->lastIntr;
+        if (delta < stats->minDelta)
+            stats->minDelta = delta;
+
+        expected = stats->priNs * stats->linesPerIrq;
+        if ((!stats->priGiven) &&
+            (stats->irqs <= PRI_EST_LINES))
+            stats->priNs = stats->minDelta / stats->linesPerIrq;
+        else if ((stats->priNs != 0) &&
+                 (delta > expected + (stats->priNs / 2)))
+        {
+            stats->gaps++;
+            stats->missed += ((delta + stats->priNs / 2) / stats->priNs) -
+                             stats->linesPerIrq;
+        }
+    }
+    stats->lastIntr = intrTime;
+}
+
+
+/**************************************************************************
+ Function:    PRISTATS_Report()
+
+ Description: Prints the run summary for a channel.
+
+ Parameters:  stats   - pointer to the channel's PRI_STATS
+              chanNum - ADC channel number
+
+ Return:      none
+**************************************************************************/
+void PRISTATS_Report (PRI_STATS *stats, int chanNum)
+{
+    unsigned long timed = stats->irqs - stats->lostStamps;
+
+    printf("[dmaThread %d] PRI: %lu lines, PRI %.2f us (%s)\n",
+           chanNum+1, stats->lines, stats->priNs / 1e3,
+           stats->priGiven ? "configured" : "estimated");
+    printf("[dmaThread %d] PRI: %lu gap(s), %lu pulse(s) missed, "
+           "%lu bad trigger(s), %lu overflow(s)\n", chanNum+1,
+           stats->gaps, stats->missed, stats->badTrigs, stats->overflows);
+    printf("[dmaThread %d] PRI: %lu late service(s), max backlog %lu\n",
+           chanNum+1, stats->late, stats->maxBacklog);
+
+    if (timed != 0)
+    {
+        printf("[dmaThread %d] PRI: interrupt-to-service latency mean %.1f"
+               " / max %.1f us\n", chanNum+1,
+               ((double)stats->latSum / timed) / 1e3, stats->latMax / 1e3);
+    }
+
+    if (stats->lostStamps != 0)
+        printf("[dmaThread %d] PRI: %lu interrupt(s) serviced too late to time\n",
+               chanNum+1, stats->lostStamps);
+}
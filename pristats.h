@@ -0,0 +1,154 @@
+/***********************************************************************
+*
+*   File: pristats.h
+*
+*   Description: header file for pristats.c, per-PRI accounting of the
+*                acquisition loop: missed pulses, late service and ADC
+*                error flags.
+*
+*                The DMA interrupt handler stamps each link-end interrupt
+*                into a per-channel PRI_IRQ_LOG.  When dmaThread() services
+*                the k-th interrupt it reads back that interrupt's time and
+*                how many later interrupts are already waiting, samples the
+*                ADC interrupt flags, and passes all of it to
+*                PRISTATS_Line().  The run summary from PRISTATS_Report()
+*                shows whether the recorder is keeping up with the PRF.
+*
+*                With interrupt coalescing there is one interrupt per group
+*                of linesPerIrq lines; PRISTATS_Line() is then called once
+*                per group and the expected interrupt spacing is that many
+*                PRIs.
+*
+*                No PTK716X calls are made here; flag bits are passed in
+*                as masks, so the accounting can be driven by a software
+*                stand-in for the interrupt path.
+*
+************************************************************************/
+
+#ifndef __PRISTATS_H__
+#define __PRISTATS_H__
+
+
+/* PRI_IRQ_LOG_SIZE - interrupt timestamps kept per channel; must be a
+ * power of 2 and larger than the deepest backlog expected (a backlog
+ * beyond the DMA ring depth has already lost data anyway)
+ */
+#define PRI_IRQ_LOG_SIZE    256
+#define PRI_IRQ_LOG_MASK    (PRI_IRQ_LOG_SIZE - 1)
+
+/* PRI_EST_LINES - interrupts used to estimate the PRI when it is not
+ * given; the smallest interrupt spacing seen over them, divided by the
+ * lines per interrupt, is taken as the PRI
+ */
+#define PRI_EST_LINES       16
+
+
+/* PRI_IRQ_LOG - link-end interrupt times for one channel
+ *     count = interrupts received (written by the interrupt handler only)
+ *     stamp = CLOCK_MONOTONIC time of interrupt n at [n % size], in ns
+ */
+typedef struct PRI_IRQ_LOG
+        {
+            unsigned long       count __attribute__((aligned(64)));
+            unsigned long long  stamp[PRI_IRQ_LOG_SIZE];
+        } PRI_IRQ_LOG;
+
+
+/* PRI_STATS - per-channel run accounting (acquisition thread only)
+ *     priNs        = nominal PRI in ns, given or estimated
+ *     priGiven     = priNs came from the configuration
+ *     badTrigMask  = ADC flag bits meaning a trigger was missed
+ *     overflowMask = ADC flag bits meaning data was lost in the ADC path
+ *     linesPerIrq  = range lines per link-end interrupt
+ *     irqs         = link-end interrupts accounted for
+ *     lines        = range lines accounted for
+ *     lastIntr     = time of the previous interrupt
+ *     minDelta     = smallest interrupt spacing seen, in ns
+ *     gaps         = interrupt spacings over the expected one plus 0.5 PRI
+ *     missed       = pulses missing inside those gaps
+ *     late         = interrupts serviced after the next one had arrived
+ *     maxBacklog   = most interrupts waiting behind one being serviced
+ *     latSum/Max   = interrupt-to-service latency, in ns
+ *     badTrigs     = interrupts with a bad-trigger flag set
+ *     overflows    = interrupts with an overflow flag set
+ *     lostStamps   = interrupts whose stamp had been overwritten
+ */
+typedef struct PRI_STATS
+        {
+            unsigned long long  priNs;
+            int                 priGiven;
+            unsigned int        badTrigMask;
+            unsigned int        overflowMask;
+            unsigned int        linesPerIrq;
+
+            unsigned long       irqs;
+            unsigned long       lines;
+            unsigned long long  lastIntr;
+            unsigned long long  minDelta;
+            unsigned long       gaps;
+            unsigned long       missed;
+            unsigned long       late;
+            unsigned long       maxBacklog;
+            unsigned long long  latSum;
+            unsigned long long  latMax;
+            unsigned long       badTrigs;
+            unsigned long       overflows;
+            unsigned long       lostStamps;
+        } PRI_STATS;
+
+
+/**************************************************************************
+ Function:    PRISTATS_IrqStamp()
+
+ Description: Records the time of a link-end interrupt.  Called from the
+              DMA interrupt handler, once per interrupt.
+
+ Parameters:  log - the channel's interrupt log
+              now - current CLOCK_MONOTONIC time in ns
+
+ Return:      none
+**************************************************************************/
+static inline void PRISTATS_IrqStamp (PRI_IRQ_LOG *log, unsigned long long now)
+{
+    unsigned long n = __atomic_load_n(&(log->count), __ATOMIC_RELAXED);
+
+    log->stamp[n & PRI_IRQ_LOG_MASK] = now;
+    __atomic_store_n(&(log->count), n + 1, __ATOMIC_RELEASE);
+}
+
+
+/**************************************************************************
+ Function:    PRISTATS_IrqCount()
+
+ Description: Returns the number of link-end interrupts stamped so far.
+
+ Parameters:  log - the channel's interrupt log
+
+ Return:      interrupts stamped
+**************************************************************************/
+static inline unsigned long PRISTATS_IrqCount (PRI_IRQ_LOG *log)
+{
+    return (__atomic_load_n(&(log->count), __ATOMIC_ACQUIRE));
+}
+
+
+/* function prototypes */
+void PRISTATS_Init   (PRI_STATS          *stats,
+                      unsigned long long  priNs,
+                      unsigned int        badTrigMask,
+                      unsigned int        overflowMask,
+                      unsigned int        linesPerIrq);
+unsigned long long
+     PRISTATS_IrqTime (PRI_IRQ_LOG       *log,
+                      unsigned long       index,
+                      unsigned long      *backlog);
+void PRISTATS_Line   (PRI_STATS          *stats,
+                      unsigned long long  intrTime,
+                      unsigned long long  serviceTime,
+                      unsigned long       backlog,
+                      unsigned int        adcFlags,
+                      unsigned int        lines);
+void PRISTATS_Report (PRI_STATS          *stats,
+                      int                 chanNum);
+
+#endif /* __PRISTATS_H__ */
@@ -0,0 +1,447 @@
+/**************************************************************************
+*
+*   File: rdbench.c
+*
+*   Description: Offline run of the range-Doppler stage (rdop.c) over a
+*                recording, to check its maps and time it away from the
+*                radar.  Reads a recording, adcN.dat or pcN.dat, as fast
+*                as it can, and prints the stage's report, the detector's
+*                if there is one (cfar.c), and the line rate the whole
+*                chain sustained.
+*
+*                An adcN.dat with an nxrec header (RECORD_FORMAT = 1) is
+*                read through nxrec.c, which skips the header and line
+*                prefixes and unpacks or decodes packed and block floating
+*                point lines; its samples per PRI come from the header.
+*                Records that were never written go in as zeros, so the
+*                CPIs stay aligned.  A file without the header is taken
+*                as raw lines (RECORD_FORMAT = 0) of the samples given.
+*
+*                adcN.dat lines are pulse compressed first, one line at a
+*                time on this thread, when a reference is given with -w;
+*                otherwise they go in as they are.  pcN.dat lines (-f) are
+*                already compressed.
+*
+*                Usage:
+*                    rdbench [options] file [samples]
+*                        file     adcN.dat, or pcN.dat with -f
+*                        samples  SAMPLES_PER_PRI of a raw recording;
+*                                 for an nxrec one, if given, it must
+*                                 match the header
+*                    -f                 file is pcN.dat (complex float32)
+*                    -w table offset length msps
+*                                       pulse compress with waveform words
+*                                       offset ... offset + length - 1 of
+*                                       WaveformTable.dat, the lines being
+*                                       at msps MSPS
+*                    -F size            pulse compression FFT size (0)
+*                    -r window          RANGE_WINDOW (2, uniform)
+*                    -c lines           DOPPLER_CPI (256)
+*                    -p factor          DOPPLER_PADDING_FACTOR (1)
+*                    -d window          DOPPLER_WINDOW (0, hanning)
+*                    -t workers         RANGE_DOPPLER_THREADS (1)
+*                    -n ns              PRI_NS, to compare against (0)
+*                    -o file            write the maps, as rdN.dat
+*                    -C dir             TABLE_CACHE_DIR
+*                    -D method guard train threshold
+*                                       CFAR_METHOD, CFAR_GUARD, CFAR_TRAIN
+*                                       and CFAR_THRESHOLD_DB (off)
+*                    -k rank            CFAR_OS_RANK (0)
+*                    -e file            write the detections, as detN.dat
+*
+*                The time to set the stages up is printed with the table
+*                cache's report; run twice with -C to compare a cold
+*                start (tables made) with a warm one (tables mapped).
+*
+*                Nothing is dropped: the reader waits for each map before
+*                adding the line that completes the next CPI.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "pcomp.h"
+#include "rdop.h"
+#include "dmaring.h"
+#include "iqk.h"
+#include "win.h"
+#include "tcache.h"
+#include "cfar.h"
+#include "nxrec.h"
+
+
+/* RDBENCH_MAX_REF - most reference samples -w can load */
+#define RDBENCH_MAX_REF      65536
+
+
+static void RDBENCH_Usage    (void);
+static int  RDBENCH_ReadLine (FILE *fp, NXREC_FILE *rec,
+                              unsigned long long line, int16_t *in,
+                              size_t inBytes);
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Sets up the stages from the command line, feeds them the
+              file's lines and reports.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - success
+              1 - bad command line, set up failed, or a write failed
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    RANGE_DOPPLER       rd;
+    PULSE_COMP          pc;
+    TABLE_CACHE         cache;
+    CFAR                cfar;
+    NXREC_FILE          rec;
+    FILE               *fp;
+    const char         *fileName;
+    const char         *table    = NULL;
+    const char         *outName  = NULL;
+    const char         *cacheDir = NULL;
+    const char         *detName  = NULL;
+    unsigned int        offset   = 0;
+    unsigned int        length   = 0;
+    double              msps     = 0.0;
+    int                 isFloat  = 0;
+    unsigned int        fftSize  = 0;
+    int                 rangeWin = WIN_UNIFORM;
+    unsigned int        cpi      = 256;
+    unsigned int        padding  = 1;
+    int                 dopWin   = WIN_HANNING;
+    unsigned int        workers  = 1;
+    unsigned int        priNs    = 0;
+    int                 method   = CFAR_OFF;
+    unsigned int        guard    = 2;
+    unsigned int        train    = 16;
+    unsigned int        rank     = 0;
+    float               threshold = 15.5f;
+    unsigned int        samples  = 0;
+    int                 isNxrec  = 0;
+    char                magic[8];
+    unsigned int        refSamples = 0;
+    float              *ref      = NULL;
+    int16_t            *in       = NULL;
+    float              *x        = NULL;
+    size_t              inBytes;
+    unsigned long long  lines    = 0;
+    unsigned long long  unwritten = 0;
+    unsigned long long  pcNs     = 0;
+    unsigned long long  start;
+    unsigned long long  setupNs;
+    unsigned long long  t;
+    double              secs;
+    float               peakPow;
+    unsigned int        peakBin;
+    int                 a;
+    int                 status;
+    int                 detStatus = 0;
+    int                 readStatus;
+
+    for (a = 1; (a < argc) && (argv[a][0] == '-'); a++)
+    {
+        if ((strcmp(argv[a], "-f") == 0))
+            isFloat = 1;
+        else if ((strcmp(argv[a], "-w") == 0) && (a + 4 < argc))
+        {
+            table  = argv[++a];
+            offset = (unsigned int)atoi(argv[++a]);
+            length = (unsigned int)atoi(argv[++a]);
+            msps   = atof(argv[++a]);
+        }
+        else if ((strcmp(argv[a], "-F") == 0) && (a + 1 < argc))
+            fftSize = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-r") == 0) && (a + 1 < argc))
+            rangeWin = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-c") == 0) && (a + 1 < argc))
+            cpi = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-p") == 0) && (a + 1 < argc))
+            padding = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-d") == 0) && (a + 1 < argc))
+            dopWin = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-t") == 0) && (a + 1 < argc))
+            workers = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-n") == 0) && (a + 1 < argc))
+            priNs = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-o") == 0) && (a + 1 < argc))
+            outName = argv[++a];
+        else if ((strcmp(argv[a], "-C") == 0) && (a + 1 < argc))
+            cacheDir = argv[++a];
+        else if ((strcmp(argv[a], "-D") == 0) && (a + 4 < argc))
+        {
+            method    = atoi(argv[++a]);
+            guard     = (unsigned int)atoi(argv[++a]);
+            train     = (unsigned int)atoi(argv[++a]);
+            threshold = (float)atof(argv[++a]);
+        }
+        else if ((strcmp(argv[a], "-k") == 0) && (a + 1 < argc))
+            rank = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-e") == 0) && (a + 1 < argc))
+            detName = argv[++a];
+        else
+        {
+            RDBENCH_Usage();
+            return (1);
+        }
+    }
+    if ((a + 1 != argc) && ((a + 2 != argc) || (atoi(argv[a + 1]) <= 0)))
+    {
+        RDBENCH_Usage();
+        return (1);
+    }
+    fileName = argv[a];
+    if (a + 2 == argc)
+        samples = (unsigned int)atoi(argv[a + 1]);
+
+    /* an nxrec file is read through its reader; only a file without the
+     * header is taken as raw lines
+     */
+    fp = fopen(fileName, "rb");
+    if (fp == NULL)
+    {
+        printf("ERROR: %s could not be opened.\n", fileName);
+        return (1);
+    }
+    if (!isFloat && (fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) &&
+        (memcmp(magic, NXREC_MAGIC, sizeof(magic)) == 0))
+    {
+        fclose(fp);
+        fp     = NULL;
+        status = NXREC_Open(&rec, fileName);
+        if (status != 0)
+        {
+            printf("ERROR: %s could not be read as an nxrec file (%d).\n",
+                   fileName, status);
+            return (1);
+        }
+        if ((samples != 0) && (samples != rec.hdr.samplesPerPri))
+        {
+            printf("ERROR: %s has %u samples per PRI, not %u.\n", fileName,
+                   rec.hdr.samplesPerPri, samples);
+            NXREC_Close(&rec);
+            return (1);
+        }
+        isNxrec = 1;
+        samples = rec.hdr.samplesPerPri;
+        printf("%s: nxrec, %llu lines of %u samples from PRI %llu, %u range "
+               "window(s)\n", fileName, rec.numLines, samples,
+               (unsigned long long)rec.hdr.firstPri, rec.hdr.numGates);
+    }
+    else
+        rewind(fp);
+    if (samples == 0)
+    {
+        printf("ERROR: %s has no nxrec header; give its samples per PRI.\n",
+               fileName);
+        fclose(fp);
+        return (1);
+    }
+
+    IQK_Init(1);
+    printf("IQ kernels: %s\n", IQK_Name());
+
+    start = DMARING_TimeNs();
+    if (TCACHE_Open(&cache, cacheDir) != 0)
+    {
+        printf("ERROR: table cache %s could not be made.\n", cacheDir);
+        return (1);
+    }
+
+    memset (&pc, 0, sizeof(pc));
+    if ((table != NULL) && !isFloat)
+    {
+        ref = (float *)malloc(RDBENCH_MAX_REF * 2 * sizeof(float));
+        if (ref == NULL)
+            return (1);
+        status = PCOMP_LoadReference(table, offset, length, msps * 1e6, ref,
+                                     RDBENCH_MAX_REF, &refSamples);
+        if (status != 0)
+        {
+            printf("ERROR: waveform could not be read from %s (%d).\n", table, status);
+            return (1);
+        }
+        status = PCOMP_Init(&pc, samples, fftSize, ref, refSamples, rangeWin,
+                            &cache);
+        if (status != 0)
+        {
+            printf("ERROR: pulse compression set up failed (%d).\n", status);
+            return (1);
+        }
+        printf("pc: FFT %u (%s), reference %u samples, %s window\n", pc.fftSize,
+               pc.plan.kernelName, refSamples, WIN_Name(rangeWin));
+    }
+
+    if (method != CFAR_OFF)
+    {
+        status = CFAR_Start(&cfar, method, samples, FFT_NextSize(cpi * padding),
+                            guard, train, rank, threshold, detName);
+        if (status != 0)
+        {
+            printf("ERROR: CFAR set up failed (%d).\n", status);
+            return (1);
+        }
+    }
+
+    status = RDOP_Start(&rd, workers, samples, cpi, padding, dopWin, &cache,
+                        (method != CFAR_OFF) ? &cfar : NULL, outName);
+    if (status != 0)
+    {
+        printf("ERROR: range-Doppler set up failed (%d).\n", status);
+        if (method != CFAR_OFF)
+            CFAR_Stop(&cfar);
+        return (1);
+    }
+    setupNs = DMARING_TimeNs() - start;
+    TCACHE_Report(&cache);
+    printf("set up in %.2f ms\n", setupNs / 1e6);
+
+    inBytes = isFloat ? (samples * 2 * sizeof(float)) : (samples * 2 * sizeof(int16_t));
+    in = (int16_t *)malloc(inBytes);
+    x  = (float *)malloc(((pc.fftSize > samples) ? pc.fftSize : samples) * 2 * sizeof(float));
+    if ((in == NULL) || (x == NULL))
+    {
+        printf("ERROR: line buffers could not be allocated.\n");
+        RDOP_Stop(&rd);
+        if (method != CFAR_OFF)
+            CFAR_Stop(&cfar);
+        return (1);
+    }
+
+    start = DMARING_TimeNs();
+    while ((readStatus = RDBENCH_ReadLine(fp, isNxrec ? &rec : NULL, lines,
+                                          in, inBytes)) != 1)
+    {
+        if (readStatus == 3)
+        {
+            printf("ERROR: line %llu of %s could not be read.\n", lines,
+                   fileName);
+            break;
+        }
+        if (readStatus == 2)
+            unwritten++;
+
+        if (isFloat)
+            memcpy (x, in, inBytes);
+        else if (pc.refSpec != NULL)
+        {
+            t = DMARING_TimeNs();
+            PCOMP_FilterLine(&pc, in, x, &peakPow, &peakBin);
+            pcNs += DMARING_TimeNs() - t;
+        }
+        else
+            IQK_ToComplex(in, x, samples);
+
+        if ((rd.lines + 1) % cpi == 0)
+            RDOP_Wait(&rd);
+        RDOP_AddLine(&rd, x);
+        lines++;
+    }
+    RDOP_Wait(&rd);
+    secs = (double)(DMARING_TimeNs() - start) / 1e9;
+    if (isNxrec)
+        NXREC_Close(&rec);
+    else
+        fclose(fp);
+
+    status = RDOP_Stop(&rd);
+    RDOP_Report(&rd, 0, priNs);
+    if (method != CFAR_OFF)
+    {
+        detStatus = CFAR_Stop(&cfar);
+        CFAR_Report(&cfar, 0);
+    }
+    if (pc.refSpec != NULL)
+        printf("pc: %.1f us per line\n", (lines != 0) ? ((double)pcNs / lines) / 1e3 : 0.0);
+    printf("%llu lines in %.3f s: %.0f lines/s", lines, secs,
+           (secs > 0.0) ? lines / secs : 0.0);
+    if (priNs != 0)
+        printf(" against a PRF of %.0f Hz", 1e9 / priNs);
+    printf("\n");
+    if (unwritten != 0)
+        printf("%llu record(s) never written, run as zeros\n", unwritten);
+
+    PCOMP_Free(&pc);
+    TCACHE_Close(&cache);
+    free(ref);
+    free(in);
+    free(x);
+
+    if (readStatus == 3)
+        return (1);
+    if (status != 0)
+    {
+        printf("ERROR: writing %s failed.\n", outName);
+        return (1);
+    }
+    if (detStatus != 0)
+    {
+        printf("ERROR: writing %s failed.\n", detName);
+        return (1);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RDBENCH_ReadLine()
+
+ Description: Reads the next range line, through the nxrec reader if the
+              file has a header, otherwise raw.
+
+ Parameters:  fp      - raw file, if rec is NULL
+              rec     - open nxrec file, or NULL
+              line    - record number, for an nxrec file
+              in      - receives the line
+              inBytes - bytes in a line
+
+ Return:      0 - line read
+              1 - end of the file
+              2 - the nxrec record was never written; in is zeroed
+              3 - the read failed
+**************************************************************************/
+static int RDBENCH_ReadLine (FILE               *fp,
+                             NXREC_FILE         *rec,
+                             unsigned long long  line,
+                             int16_t            *in,
+                             size_t              inBytes)
+{
+    int status;
+
+    if (rec == NULL)
+        return ((fread(in, 1, inBytes, fp) == inBytes) ? 0 : 1);
+
+    if (line >= rec->numLines)
+        return (1);
+
+    status = NXREC_ReadLine(rec, line, NULL, in);
+    if (status == 2)
+        memset (in, 0, inBytes);
+
+    return ((status == 1) ? 3 : status);
+}
+
+
+/**************************************************************************
+ Function:    RDBENCH_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void RDBENCH_Usage (void)
+{
+    printf("usage: rdbench [-f] [-w table offset length msps] [-F fftsize] [-r window]\n"
+           "               [-c cpi] [-p padding] [-d window] [-t workers] [-n pri_ns]\n"
+           "               [-o rdN.dat] [-C cache_dir] [-D method guard train threshold_db]\n"
+           "               [-k rank] [-e detN.dat] file [samples]\n");
+}
@@ -0,0 +1,510 @@
+/**************************************************************************
+*
+*   File: rdop.c
+*
+*   Description: Real-time range-Doppler maps.  See rdop.h.
+*
+*                Lines are added by one thread (pcomp.c's feeder, or an
+*                offline tool), which also drives the corner turn and
+*                posts each full CPI.  Only one CPI is processed at a
+*                time, so maps come out in order and one map buffer is
+*                enough.  The busy flag is the hand-over: the adding
+*                thread sets it when it posts a CPI and the worker that
+*                finishes the map clears it.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "rdop.h"
+#include "dmaring.h"
+#include "win.h"
+#include "iqk.h"
+
+
+static void  RDOP_Batch        (RANGE_DOPPLER *rd, RDOP_WORKER *w,
+                                unsigned int firstBin);
+static void  RDOP_Finish       (RANGE_DOPPLER *rd);
+static void *RDOP_WorkerThread (void *pParams);
+static void  RDOP_Free         (RANGE_DOPPLER *rd);
+
+
+/**************************************************************************
+ Function:    RDOP_Start()
+
+ Description: Sets up a range-Doppler stage and starts its workers.
+
+ Parameters:  rd            - pointer to the RANGE_DOPPLER to set up
+              numWorkers    - workers to start (1 to RDOP_MAX_WORKERS)
+              bins          - complex samples per line
+              cpiLines      - lines per CPI, at least 2
+              paddingFactor - Doppler FFT size as a multiple of cpiLines,
+                              rounded up to a power of two; 0 is taken
+                              as 1
+              window        - slow-time window code (win.h)
+              cache         - table cache to get the FFT plan and window
+                              from; it must outlive the stage
+              cfar          - detector to run on each map, started for
+                              bins x Doppler FFT size maps; or NULL.  It
+                              is the caller's to stop, after RDOP_Stop()
+              outfileName   - rdN.dat to write, or NULL
+
+ Return:      0 - success
+              1 - invalid worker count, size or window, or a detector
+                  for another map size
+              2 - allocation, thread creation or file open failed
+**************************************************************************/
+int RDOP_Start (RANGE_DOPPLER  *rd,
+                unsigned int    numWorkers,
+                unsigned int    bins,
+                unsigned int    cpiLines,
+                unsigned int    paddingFactor,
+                int             window,
+                TABLE_CACHE    *cache,
+                CFAR           *cfar,
+                const char     *outfileName)
+{
+    size_t       cpiFloats = (size_t)bins * cpiLines * 2;
+    unsigned int i;
+    int          status;
+
+    memset (rd, 0, sizeof(RANGE_DOPPLER));
+
+    if (paddingFactor == 0)
+        paddingFactor = 1;
+    if ((numWorkers == 0) || (numWorkers > RDOP_MAX_WORKERS) || (bins == 0) ||
+        (cpiLines < 2) || (cpiLines > FFT_MAX_SIZE / paddingFactor))
+        return (1);
+
+    rd->bins        = bins;
+    rd->cpiLines    = cpiLines;
+    rd->dopplerSize = FFT_NextSize(cpiLines * paddingFactor);
+    rd->window      = window;
+    rd->cfar        = cfar;
+    rd->peakDb      = IQK_DB_FLOOR;
+
+    if ((cfar != NULL) &&
+        ((cfar->rows != bins) || (cfar->cols != rd->dopplerSize)))
+        return (1);
+
+    status = TCACHE_FftPlan(cache, &(rd->plan), rd->dopplerSize);
+    if (status != 0)
+        return (status);
+
+    rd->dopWin = TCACHE_Window(cache, window, cpiLines);
+    if (rd->dopWin == NULL)
+    {
+        RDOP_Free(rd);
+        return (1);
+    }
+
+    /* calloc and fill now, so the CPIs and map are not faulted in (and
+     * locked) during the run
+     */
+    rd->cpi[0] = (float *)calloc(cpiFloats, sizeof(float));
+    rd->cpi[1] = (float *)calloc(cpiFloats, sizeof(float));
+    rd->map    = (float *)calloc((size_t)bins * rd->dopplerSize, sizeof(float));
+    if ((rd->cpi[0] == NULL) || (rd->cpi[1] == NULL) || (rd->map == NULL))
+    {
+        RDOP_Free(rd);
+        return (2);
+    }
+    memset (rd->cpi[0], 0, cpiFloats * sizeof(float));
+    memset (rd->cpi[1], 0, cpiFloats * sizeof(float));
+    memset (rd->map, 0, (size_t)bins * rd->dopplerSize * sizeof(float));
+
+    for (i = 0; i < numWorkers; i++)
+    {
+        rd->worker[i].work = (float *)calloc(2 * rd->dopplerSize, sizeof(float));
+        if (rd->worker[i].work == NULL)
+        {
+            RDOP_Free(rd);
+            return (2);
+        }
+    }
+
+    if (CTURN_Init(&(rd->turn), cpiLines, bins, 1) != 0)
+    {
+        RDOP_Free(rd);
+        return (2);
+    }
+    CTURN_Begin(&(rd->turn), rd->cpi[0]);
+
+    if (outfileName != NULL)
+    {
+        rd->outfile = fopen(outfileName, "wb");
+        if (rd->outfile == NULL)
+        {
+            RDOP_Free(rd);
+            return (2);
+        }
+    }
+
+    for (i = 0; i < numWorkers; i++)
+    {
+        rd->worker[i].rd    = rd;
+        rd->worker[i].index = i;
+        if (pthread_create(&(rd->worker[i].thread), NULL,
+                           RDOP_WorkerThread, &(rd->worker[i])) != 0)
+        {
+            rd->numWorkers = i;
+            RDOP_Stop(rd);
+            return (2);
+        }
+        rd->numWorkers = i + 1;
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RDOP_AddLine()
+
+ Description: Adds the next range line.  The line is copied, so its
+              buffer can be reused at once.  When it completes a CPI the
+              CPI goes to the workers, or is dropped if they are still
+              busy with the one before.
+
+ Parameters:  rd   - pointer to the stage
+              line - bins complex samples
+
+ Return:      none
+**************************************************************************/
+void RDOP_AddLine (RANGE_DOPPLER *rd, const float *line)
+{
+    rd->lines++;
+    if (CTURN_AddLine(&(rd->turn), line) != 1)
+        return;
+
+    rd->formed++;
+    if (__atomic_load_n(&(rd->busy), __ATOMIC_ACQUIRE))
+    {
+        rd->dropped++;
+        CTURN_Begin(&(rd->turn), rd->cpi[rd->fill]);
+        return;
+    }
+
+    rd->jobCpi     = rd->fill;
+    rd->jobNumber  = rd->formed - 1;
+    rd->jobStartNs = DMARING_TimeNs();
+    rd->pending    = rd->numWorkers;
+    __atomic_store_n(&(rd->busy), 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&(rd->job), rd->job + 1, __ATOMIC_RELEASE);
+
+    rd->fill ^= 1;
+    CTURN_Begin(&(rd->turn), rd->cpi[rd->fill]);
+}
+
+
+/**************************************************************************
+ Function:    RDOP_Wait()
+
+ Description: Waits for the CPI being processed, if any, to be finished.
+              An offline tool calls this before adding the line that
+              completes a CPI, so none is dropped however fast it reads.
+
+ Parameters:  rd - pointer to the stage
+
+ Return:      none
+**************************************************************************/
+void RDOP_Wait (RANGE_DOPPLER *rd)
+{
+    struct timespec idle  = {0, RDOP_SLEEP_NS};
+    unsigned int    spins = 0;
+
+    while (__atomic_load_n(&(rd->busy), __ATOMIC_ACQUIRE))
+    {
+        if (spins < RDOP_SPINS)
+            spins++;
+        else
+            nanosleep(&idle, NULL);
+    }
+}
+
+
+/**************************************************************************
+ Function:    RDOP_Stop()
+
+ Description: Lets the workers finish the CPI in hand, then stops them,
+              closes rdN.dat and frees the buffers.  A part-filled CPI is
+              discarded.  Call once no more lines will be added.
+
+ Parameters:  rd - pointer to the stage
+
+ Return:      0 - success
+              1 - a write to rdN.dat failed
+**************************************************************************/
+int RDOP_Stop (RANGE_DOPPLER *rd)
+{
+    unsigned int i;
+
+    RDOP_Wait(rd);
+
+    __atomic_store_n(&(rd->stop), 1, __ATOMIC_RELEASE);
+    for (i = 0; i < rd->numWorkers; i++)
+        pthread_join(rd->worker[i].thread, NULL);
+
+    if ((rd->outfile != NULL) && (fclose(rd->outfile) != 0))
+        rd->writeError = 1;
+    rd->outfile = NULL;
+
+    RDOP_Free(rd);
+
+    return (rd->writeError);
+}
+
+
+/**************************************************************************
+ Function:    RDOP_Report()
+
+ Description: Prints the maps made and dropped, the time each map took
+              against the time its CPI took to arrive, each worker's
+              time per range bin, and the strongest cell of the run.
+
+ Parameters:  rd      - pointer to a stopped stage
+              chanNum - ADC channel number
+              priNs   - nominal PRI in ns, 0 if not known
+
+ Return:      none
+**************************************************************************/
+void RDOP_Report (RANGE_DOPPLER *rd, int chanNum, unsigned int priNs)
+{
+    RDOP_WORKER  *w;
+    double        cpiMs = ((double)rd->cpiLines * priNs) / 1e6;
+    unsigned int  i;
+
+    printf("[dmaThread %d] rd: CPI %u lines, Doppler FFT %u (%s), %s window, "
+           "%u worker(s), %llu lines, %llu map(s), %llu dropped\n",
+           chanNum+1, rd->cpiLines, rd->dopplerSize, rd->plan.kernelName,
+           WIN_Name(rd->window),
+           rd->numWorkers, rd->lines, rd->maps, rd->dropped);
+
+    if (rd->maps != 0)
+    {
+        printf("[dmaThread %d] rd: %.2f ms per map (max %.2f ms)", chanNum+1,
+               ((double)rd->totalNs / rd->maps) / 1e6, (double)rd->maxNs / 1e6);
+        if (priNs != 0)
+            printf(" against a CPI of %.2f ms%s", cpiMs,
+                   ((double)rd->maxNs / 1e6 > cpiMs) ? " - TOO SLOW, add workers" : "");
+        printf("\n");
+    }
+
+    for (i = 0; i < rd->numWorkers; i++)
+    {
+        w = &(rd->worker[i]);
+        if (w->bins == 0)
+            continue;
+        printf("[dmaThread %d] rd: worker %u, %llu range bins, %.2f us per bin\n",
+               chanNum+1, i, w->bins, ((double)w->busyNs / w->bins) / 1e3);
+    }
+
+    if (rd->maps != 0)
+        printf("[dmaThread %d] rd: strongest cell %.1f dB at range bin %u, "
+               "Doppler bin %d, map %llu\n", chanNum+1, rd->peakDb, rd->peakBin,
+               (int)rd->peakDop - (int)(rd->dopplerSize / 2), rd->peakMap);
+}
+
+
+/**************************************************************************
+ Function:    RDOP_Batch()
+
+ Description: Makes the map rows of a batch of range bins: window the
+              slow-time vector, zero pad, FFT, and store the power in dB
+              with zero Doppler moved to the middle of the row.
+
+ Parameters:  rd       - pointer to the stage
+              w        - the worker, for its FFT buffer and peak
+              firstBin - first range bin of the batch
+
+ Return:      none
+**************************************************************************/
+static void RDOP_Batch (RANGE_DOPPLER *rd, RDOP_WORKER *w, unsigned int firstBin)
+{
+    unsigned int  n    = rd->dopplerSize;
+    unsigned int  half = n / 2;
+    unsigned int  endBin = firstBin + RDOP_BATCH_BINS;
+    float        *x    = w->work;
+    const float  *v;
+    float        *row;
+    unsigned int  b;
+    unsigned int  l;
+    unsigned int  k;
+
+    if (endBin > rd->bins)
+        endBin = rd->bins;
+
+    for (b = firstBin; b < endBin; b++)
+    {
+        v   = rd->cpi[rd->jobCpi] + ((size_t)b * rd->cpiLines * 2);
+        row = rd->map + ((size_t)b * n);
+
+        for (l = 0; l < rd->cpiLines; l++)
+        {
+            x[2*l]     = v[2*l]     * rd->dopWin[l];
+            x[2*l + 1] = v[2*l + 1] * rd->dopWin[l];
+        }
+        memset (x + (2 * rd->cpiLines), 0, (n - rd->cpiLines) * 2 * sizeof(float));
+
+        FFT_Forward(&(rd->plan), x);
+
+        /* negative Doppler, FFT bins n/2 ... n-1, first */
+        IQK_Power(x + n, row, half);
+        IQK_Power(x, row + half, half);
+        IQK_Db(row, row, n);
+
+        for (k = 0; k < n; k++)
+        {
+            if (row[k] > w->peakDb)
+            {
+                w->peakDb  = row[k];
+                w->peakBin = b;
+                w->peakDop = k;
+            }
+        }
+    }
+
+    w->bins += endBin - firstBin;
+}
+
+
+/**************************************************************************
+ Function:    RDOP_Finish()
+
+ Description: Run by the worker that finishes a map's last batch.  Takes
+              the map into the run's statistics, runs the detector on it,
+              writes it to rdN.dat and frees the stage for the next CPI.
+
+ Parameters:  rd - pointer to the stage
+
+ Return:      none
+**************************************************************************/
+static void RDOP_Finish (RANGE_DOPPLER *rd)
+{
+    size_t              mapFloats = (size_t)rd->bins * rd->dopplerSize;
+    unsigned long long  ns;
+    unsigned int        i;
+
+    for (i = 0; i < rd->numWorkers; i++)
+    {
+        if (rd->worker[i].peakDb > rd->peakDb)
+        {
+            rd->peakDb  = rd->worker[i].peakDb;
+            rd->peakBin = rd->worker[i].peakBin;
+            rd->peakDop = rd->worker[i].peakDop;
+            rd->peakMap = rd->maps;
+        }
+    }
+
+    if (rd->cfar != NULL)
+        CFAR_Detect(rd->cfar, rd->map, rd->jobNumber);
+
+    if ((rd->outfile != NULL) &&
+        (fwrite(rd->map, sizeof(float), mapFloats, rd->outfile) != mapFloats))
+        rd->writeError = 1;
+
+    ns = DMARING_TimeNs() - rd->jobStartNs;
+    rd->totalNs += ns;
+    if (ns > rd->maxNs)
+        rd->maxNs = ns;
+    rd->maps++;
+
+    __atomic_store_n(&(rd->busy), 0, __ATOMIC_RELEASE);
+}
+
+
+/**************************************************************************
+ Function:    RDOP_WorkerThread()
+
+ Description: Doppler worker.  For each CPI posted, makes range bin
+              batches index, index + W, ... of the map; the last worker
+              to finish its share finishes the map.  Spins briefly when
+              idle, then sleeps in RDOP_SLEEP_NS steps.
+
+ Parameters:  pParams - pointer to the worker's RDOP_WORKER
+
+ Return:      NULL
+**************************************************************************/
+static void *RDOP_WorkerThread (void *pParams)
+{
+    RDOP_WORKER        *w     = (RDOP_WORKER *)pParams;
+    RANGE_DOPPLER      *rd    = w->rd;
+    struct timespec     idle  = {0, RDOP_SLEEP_NS};
+    unsigned long long  done  = 0;
+    unsigned long long  job;
+    unsigned long long  start;
+    unsigned int        batch;
+    unsigned int        batches;
+    unsigned int        spins = 0;
+
+    batches = (rd->bins + RDOP_BATCH_BINS - 1) / RDOP_BATCH_BINS;
+
+    while (1)
+    {
+        job = __atomic_load_n(&(rd->job), __ATOMIC_ACQUIRE);
+        if (job == done)
+        {
+            if (__atomic_load_n(&(rd->stop), __ATOMIC_ACQUIRE))
+                break;
+            if (spins < RDOP_SPINS)
+                spins++;
+            else
+                nanosleep(&idle, NULL);
+            continue;
+        }
+
+        spins = 0;
+        start = DMARING_TimeNs();
+        w->peakDb = IQK_DB_FLOOR;
+        for (batch = w->index; batch < batches; batch += rd->numWorkers)
+            RDOP_Batch(rd, w, batch * RDOP_BATCH_BINS);
+        w->busyNs += DMARING_TimeNs() - start;
+        done = job;
+
+        if (__atomic_sub_fetch(&(rd->pending), 1, __ATOMIC_ACQ_REL) == 0)
+            RDOP_Finish(rd);
+    }
+
+    return (NULL);
+}
+
+
+/**************************************************************************
+ Function:    RDOP_Free()
+
+ Description: Frees the corner turn, CPIs, map and worker buffers, lets
+              go of the FFT plan and window, which the table cache keeps,
+              and closes rdN.dat if it is still open.
+
+ Parameters:  rd - pointer to the stage
+
+ Return:      none
+**************************************************************************/
+static void RDOP_Free (RANGE_DOPPLER *rd)
+{
+    unsigned int i;
+
+    FFT_Free(&(rd->plan));
+    CTURN_Free(&(rd->turn));
+    free(rd->cpi[0]);
+    free(rd->cpi[1]);
+    free(rd->map);
+    rd->dopWin = NULL;
+    rd->cpi[0] = NULL;
+    rd->cpi[1] = NULL;
+    rd->map    = NULL;
+
+    for (i = 0; i < RDOP_MAX_WORKERS; i++)
+    {
+        free(rd->worker[i].work);
+        rd->worker[i].work = NULL;
+    }
+
+    if (rd->outfile != NULL)
+        fclose(rd->outfile);
+    rd->outfile = NULL;
+}
@@ -0,0 +1,207 @@
+/***********************************************************************
+*
+*   File: rdop.h
+*
+*   Description: header file for rdop.c, real-time range-Doppler maps of
+*                the pulse compressed lines of a channel.
+*
+*                Set from NeXtRAD.ini [Processing], with the meanings
+*                experiment.ini's [processing] section gives them:
+*                    RANGE_DOPPLER_THREADS  - Doppler workers per channel;
+*                                             0 = off.  Needs pulse
+*                                             compression on
+*                    DOPPLER_CPI            - range lines per map
+*                    DOPPLER_PADDING_FACTOR - Doppler FFT size as a
+*                                             multiple of DOPPLER_CPI,
+*                                             rounded up to a power of 2
+*                    DOPPLER_WINDOW         - slow-time window (win.h)
+*                    RANGE_DOPPLER_OUTPUT   - 1 = write the maps to
+*                                             rdN.dat
+*                The range window is the pulse compression's
+*                (RANGE_WINDOW, pcomp.h).  The Doppler FFT plan and window
+*                come from the table cache (tcache.c).
+*
+*                pcomp.c's feeder hands over each compressed line in PRI
+*                order, lost lines as zero lines, so a CPI is always
+*                DOPPLER_CPI consecutive PRIs.  The lines are corner
+*                turned into the CPI as they arrive (cturn.c).  A full
+*                CPI is handed to the workers, which take batches of
+*                RDOP_BATCH_BINS range bins in a fixed rotation: window
+*                each bin's slow-time vector, zero pad it, FFT it and
+*                store its power in dB.  The worker that finishes the
+*                last batch runs the detector on the map, if there is one
+*                (cfar.h), and writes the map out.
+*
+*                There are two CPI buffers: one filling while the other
+*                is processed.  A CPI that fills while the one before it
+*                is still being processed is dropped and counted; the
+*                report gives the time a CPI takes against the time it
+*                takes to arrive.
+*
+*                rdN.dat is one map per CPI, back to back: SAMPLES_PER_PRI
+*                rows, one per range bin, of Doppler FFT size float32 dB
+*                values, negative Doppler first, zero Doppler at the
+*                middle of the row.
+*
+************************************************************************/
+
+#ifndef __RDOP_H__
+#define __RDOP_H__
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "fft.h"
+#include "cturn.h"
+#include "tcache.h"
+#include "cfar.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* RDOP_MAX_WORKERS - Doppler workers per channel;
+ * RDOP_BATCH_BINS - range bins a worker takes at a time
+ */
+#define RDOP_MAX_WORKERS     16
+#define RDOP_BATCH_BINS      64
+
+/* RDOP_SPINS - empty polls before an idle thread starts sleeping;
+ * RDOP_SLEEP_NS - length of each sleep once idle
+ */
+#define RDOP_SPINS           256
+#define RDOP_SLEEP_NS        20000
+
+
+/* RDOP_WORKER - one Doppler worker
+ *     rd       = the worker's stage
+ *     index    = worker number; it takes batches index, index + W, ...
+ *     bins     = range bins processed
+ *     busyNs   = time spent processing, in ns
+ *     peakDb   = strongest cell of its part of the current map, and
+ *     peakBin    where it was
+ *     peakDop
+ *     work     = Doppler FFT size complex points
+ *     thread   = worker thread
+ */
+typedef struct RDOP_WORKER
+        {
+            struct RANGE_DOPPLER *rd;
+            unsigned int        index;
+            unsigned long long  bins;
+            unsigned long long  busyNs;
+            float               peakDb;
+            unsigned int        peakBin;
+            unsigned int        peakDop;
+            float              *work;
+            pthread_t           thread;
+        } RDOP_WORKER;
+
+
+/* RANGE_DOPPLER - range-Doppler stage for one channel
+ *     bins        = range bins (complex samples) per line
+ *     cpiLines    = lines per CPI
+ *     dopplerSize = Doppler FFT size
+ *     window      = slow-time window code
+ *     numWorkers  = workers started
+ *     turn        = corner turn of the lines into the filling CPI
+ *     plan        = Doppler FFT plan, shared by the workers
+ *     dopWin      = cpiLines slow-time window weights; it and plan's
+ *                   tables are held by the table cache
+ *     cpi         = the two CPI buffers, bins x cpiLines complex
+ *     fill        = index of the CPI buffer filling
+ *     map         = bins x dopplerSize dB, the map being made
+ *     outfile     = rdN.dat, or NULL
+ *     cfar        = detector run on each map, or NULL
+ *     worker      = workers
+ *
+ *   the CPI being processed:
+ *     job         = number of the CPI posted to the workers
+ *     jobCpi      = its buffer
+ *     jobNumber   = its number, counting every CPI formed from 0
+ *     jobStartNs  = when it was posted
+ *     pending     = workers still working on it
+ *     busy        = set while a CPI is being processed
+ *
+ *   owned by the thread adding lines:
+ *     lines       = lines added
+ *     formed      = CPIs filled
+ *     dropped     = CPIs dropped because the workers were busy
+ *
+ *   owned by the worker finishing each map:
+ *     maps        = maps made
+ *     totalNs     = time from posting to finishing, summed over maps
+ *     maxNs       = longest time from posting to finishing
+ *     writeError  = set if a write to outfile failed
+ *     peakDb      = strongest cell of the run, and where it was
+ *     peakBin
+ *     peakDop
+ *     peakMap
+ *
+ *     stop        = set by RDOP_Stop() to end the workers
+ */
+typedef struct RANGE_DOPPLER
+        {
+            unsigned int        bins;
+            unsigned int        cpiLines;
+            unsigned int        dopplerSize;
+            int                 window;
+            unsigned int        numWorkers;
+            CORNER_TURN         turn;
+            FFT_PLAN            plan;
+            const float        *dopWin;
+            float              *cpi[2];
+            unsigned int        fill;
+            float              *map;
+            FILE               *outfile;
+            CFAR               *cfar;
+            RDOP_WORKER         worker[RDOP_MAX_WORKERS];
+
+            unsigned long long  job;
+            unsigned int        jobCpi;
+            unsigned long long  jobNumber;
+            unsigned long long  jobStartNs;
+            unsigned int        pending;
+            int                 busy;
+
+            unsigned long long  lines;
+            unsigned long long  formed;
+            unsigned long long  dropped;
+
+            unsigned long long  maps;
+            unsigned long long  totalNs;
+            unsigned long long  maxNs;
+            int                 writeError;
+            float               peakDb;
+            unsigned int        peakBin;
+            unsigned int        peakDop;
+            unsigned long long  peakMap;
+
+            int                 stop;
+        } RANGE_DOPPLER;
+
+
+/* function prototypes */
+int  RDOP_Start   (RANGE_DOPPLER  *rd,
+                   unsigned int    numWorkers,
+                   unsigned int    bins,
+                   unsigned int    cpiLines,
+                   unsigned int    paddingFactor,
+                   int             window,
+                   TABLE_CACHE    *cache,
+                   CFAR           *cfar,
+                   const char     *outfileName);
+void RDOP_AddLine (RANGE_DOPPLER  *rd,
+                   const float    *line);
+void RDOP_Wait    (RANGE_DOPPLER  *rd);
+int  RDOP_Stop    (RANGE_DOPPLER  *rd);
+void RDOP_Report  (RANGE_DOPPLER  *rd,
+                   int             chanNum,
+                   unsigned int    priNs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RDOP_H__ */
@@ -0,0 +1,256 @@
+/**************************************************************************
+*
+*   File: recbench.c
+*
+*   Description: Benchmark of the output backends (recfile.c), away from
+*                the radar.  Range lines are taken from a ring of buffers,
+*                as the DMA ring, and written the way the channel writer
+*                writes them: RECFILE_Append() for each line and
+*                RECFILE_Flush() every batch.
+*
+*                Each directory given is run with every OUTPUT_BACKEND, at
+*                the same line size:
+*
+*                    0 - fwrite() per line
+*                    1 - pwritev() per batch of -b lines
+*                    2 - O_DIRECT batches of -b lines, ASYNC_DEPTH 2, and
+*                        again at ASYNC_DEPTH -d
+*                    3 - copies into the preallocated, mapped file
+*
+*                For each the time per line (append and any flush) is
+*                histogrammed, and the rate is given twice: to the close,
+*                i.e. into the page cache (for O_DIRECT, onto the
+*                device), and to the file being on the disk
+*                (fdatasync()).  Give a local disk directory and a tmpfs
+*                one, e.g. /data /dev/shm, to see how much of the
+*                difference is system calls rather than the device.
+*                Where the file system refuses O_DIRECT the async backend
+*                goes through the page cache, which its row says.
+*
+*                Usage:
+*                    recbench [options] dir [dir ...]
+*                    -n lines   range lines per run (100000)
+*                    -s samples SAMPLES_PER_PRI (4096)
+*                    -b lines   WRITE_BATCH of the pwritev and async
+*                               runs (16)
+*                    -d depth   ASYNC_DEPTH of the second async run (8)
+*                    -k         keep the files (dir/recbench0.dat, ...,
+*                               recbench2-8.dat, ...)
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "recfile.h"
+#include "lathist.h"
+#include "dmaring.h"
+
+
+/* RECBENCH_BUFS - buffers the lines are taken from, as a full DMA ring */
+#define RECBENCH_BUFS        MAX_DMA_BUFS
+
+
+static void RECBENCH_Usage (void);
+static int  RECBENCH_Run   (const char *dir, int backend, unsigned int batch,
+                            unsigned int depth, unsigned long lines,
+                            unsigned int lineBytes, void **bufs, int keep);
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Sets up the line buffers from the command line and runs
+              every backend in each directory.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - success
+              1 - bad command line, or a run failed
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    void               *bufs[RECBENCH_BUFS];
+    unsigned long       lines   = 100000;
+    unsigned int        samples = 4096;
+    unsigned int        batch   = 16;
+    unsigned int        depth   = 8;
+    int                 keep    = 0;
+    int                 status  = 0;
+    unsigned int        i;
+    int                 a;
+
+    for (a = 1; (a < argc) && (argv[a][0] == '-'); a++)
+    {
+        if ((strcmp(argv[a], "-n") == 0) && (a + 1 < argc))
+            lines = strtoul(argv[++a], NULL, 10);
+        else if ((strcmp(argv[a], "-s") == 0) && (a + 1 < argc))
+            samples = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-b") == 0) && (a + 1 < argc))
+            batch = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-d") == 0) && (a + 1 < argc))
+            depth = (unsigned int)atoi(argv[++a]);
+        else if (strcmp(argv[a], "-k") == 0)
+            keep = 1;
+        else
+        {
+            RECBENCH_Usage();
+            return (1);
+        }
+    }
+    if ((a >= argc) || (lines == 0) || (samples == 0) ||
+        (batch == 0) || (batch > REC_FILE_MAX_BATCH) ||
+        (depth <= 2) || (depth > REC_FILE_MAX_ASYNC))
+    {
+        RECBENCH_Usage();
+        return (1);
+    }
+
+    for (i = 0; i < RECBENCH_BUFS; i++)
+    {
+        bufs[i] = malloc(samples * 4);
+        if (bufs[i] == NULL)
+            return (1);
+        memset (bufs[i], 0x5a + i, samples * 4);
+    }
+    printf("%lu lines of %u samples (%.1f MB) per run\n", lines, samples,
+           (double)lines * samples * 4 / 1e6);
+
+    for (; a < argc; a++)
+    {
+        status |= RECBENCH_Run(argv[a], REC_FILE_STDIO, 1, 0, lines,
+                               samples * 4, bufs, keep);
+        status |= RECBENCH_Run(argv[a], REC_FILE_PWRITEV, batch, 0, lines,
+                               samples * 4, bufs, keep);
+        status |= RECBENCH_Run(argv[a], REC_FILE_ASYNC, batch, 2, lines,
+                               samples * 4, bufs, keep);
+        status |= RECBENCH_Run(argv[a], REC_FILE_ASYNC, batch, depth, lines,
+                               samples * 4, bufs, keep);
+        status |= RECBENCH_Run(argv[a], REC_FILE_MMAP, 1, 0, lines,
+                               samples * 4, bufs, keep);
+    }
+
+    for (i = 0; i < RECBENCH_BUFS; i++)
+        free(bufs[i]);
+
+    return (status);
+}
+
+
+/**************************************************************************
+ Function:    RECBENCH_Run()
+
+ Description: Writes one file with one backend and prints the results.
+
+ Parameters:  dir       - directory to write in
+              backend   - REC_FILE_STDIO, _PWRITEV, _ASYNC or _MMAP
+              batch     - range lines per batch
+              depth     - ASYNC_DEPTH of the async backend
+              lines     - range lines to write
+              lineBytes - bytes per range line
+              bufs      - RECBENCH_BUFS range lines to take them from
+              keep      - leave the file in place
+
+ Return:      0 - success
+              1 - open, write or sync failed
+**************************************************************************/
+static int RECBENCH_Run (const char *dir, int backend, unsigned int batch,
+                         unsigned int depth, unsigned long lines,
+                         unsigned int lineBytes, void **bufs, int keep)
+{
+    static const char  *backendName[] = {"fwrite", "pwritev", "async", "mmap"};
+    static const char  *histName[]    = {"fwrite per line", "pwritev batches",
+                                         "async batches", "mmap copies"};
+    REC_FILE            file;
+    LAT_HIST            hist;
+    char                fileName[4096];
+    unsigned long long  start;
+    unsigned long long  t;
+    unsigned long long  closeNs;
+    unsigned long long  syncNs;
+    unsigned long       i;
+    int                 fd;
+    int                 directIo;
+    int                 status = 0;
+
+    if (backend == REC_FILE_ASYNC)
+        snprintf (fileName, sizeof(fileName), "%s/recbench%d-%u.dat", dir,
+                  backend, depth);
+    else
+        snprintf (fileName, sizeof(fileName), "%s/recbench%d.dat", dir,
+                  backend);
+    LATHIST_Init(&hist, histName[backend]);
+
+    if (RECFILE_Open(&file, fileName, backend, batch, depth,
+                     (unsigned long long)lines * lineBytes) != 0)
+    {
+        printf("ERROR: %s could not be opened.\n", fileName);
+        return (1);
+    }
+    directIo = file.directIo;
+
+    start = DMARING_TimeNs();
+    for (i = 0; (i < lines) && (status == 0); i++)
+    {
+        t = DMARING_TimeNs();
+        status = RECFILE_Append(&file, NULL, 0, bufs[i % RECBENCH_BUFS],
+                                lineBytes, i);
+        if ((status == 0) && (file.numPending >= file.batchLines))
+            status = RECFILE_Flush(&file);
+        LATHIST_Record(&hist, DMARING_TimeNs() - t);
+    }
+    if (status == 0)
+        status = RECFILE_Flush(&file);
+    status |= RECFILE_Close(&file);
+    closeNs = DMARING_TimeNs() - start;
+
+    /* what is still in the page cache goes to the device */
+    t  = DMARING_TimeNs();
+    fd = open(fileName, O_WRONLY);
+    if ((fd < 0) || (fdatasync(fd) != 0))
+        status = 1;
+    if (fd >= 0)
+        close(fd);
+    syncNs = DMARING_TimeNs() - t;
+
+    if (!keep)
+        unlink(fileName);
+    if (status != 0)
+    {
+        printf("ERROR: writing %s failed.\n", fileName);
+        return (1);
+    }
+
+    printf("%s backend %d (%s), batch %u", dir, backend, backendName[backend],
+           file.batchLines);
+    if (backend == REC_FILE_ASYNC)
+        printf(", depth %u, %s", depth,
+               directIo ? "O_DIRECT" : "page cache (no O_DIRECT here)");
+    printf(": %lu write calls\n", file.writeCalls);
+    printf("    to close %8.1f ms %8.1f MB/s    to disk %8.1f ms %8.1f MB/s\n",
+           closeNs / 1e6, (double)file.bytesWritten * 1e3 / closeNs,
+           (closeNs + syncNs) / 1e6,
+           (double)file.bytesWritten * 1e3 / (closeNs + syncNs));
+    LATHIST_Print(&hist, "   ");
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECBENCH_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void RECBENCH_Usage (void)
+{
+    printf("usage: recbench [-n lines] [-s samples] [-b batch] [-d depth] [-k] "
+           "dir [dir ...]\n");
+}
@@ -0,0 +1,1132 @@
+/**************************************************************************
+*
+*   File: recfile.c
+*
+*   Description: Output file for captured range lines.  See recfile.h.
+*
+*                The pwritev backend keeps pointers to the caller's buffers
+*                until the batch is flushed, so the caller must flush
+*                before those buffers can be reused.  With DMA buffers
+*                this means WRITE_BATCH must be smaller than the ring.
+*
+*                The async backend copies each line into a staging buffer
+*                as it is appended, so the DMA buffer is free again as soon
+*                as RECFILE_Append() returns.  O_DIRECT needs every write
+*                to start and end on a REC_FILE_ALIGN boundary; a batch is
+*                written up to the last whole block and the remainder is
+*                carried into the next staging buffer.  The final partial
+*                block is padded on close and the file truncated back to
+*                its true length.  If the file system refuses O_DIRECT
+*                (tmpfs, some network mounts) the file is opened without it
+*                and the same aligned writes go through the page cache.
+*
+*                The mmap backend leaves the file at its preallocated
+*                length while recording, so a reader can index a partial
+*                recording by PRI; unfilled lines read as zeros.  On close
+*                the file is cut back to the end of the last line written.
+*
+*                A line's prefix is treated as part of the line: it is
+*                written immediately in front of it by every backend, and
+*                the mmap backend places line n at headerBytes plus n
+*                times the prefix and line length.
+*
+**************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+
+#include "recfile.h"
+
+
+static int   RECFILE_PwriteAll   (int fd, const char *buf, size_t len,
+                                  unsigned long long offset);
+static int   RECFILE_AsyncOpen   (REC_FILE *file, const char *fileName);
+static int   RECFILE_AsyncAppend (REC_FILE *file, const char *buf, size_t len);
+static int   RECFILE_AsyncSubmit (REC_FILE *file);
+static void  RECFILE_AsyncIssue  (REC_FILE *file, unsigned int index);
+static void  RECFILE_AsyncWait   (REC_FILE *file, unsigned int index);
+static int   RECFILE_AsyncClose  (REC_FILE *file);
+static void  RECFILE_AsyncFree   (REC_FILE *file);
+#ifndef HAVE_LIBURING
+static void *RECFILE_WorkerThread (void *pParams);
+#endif
+static int   RECFILE_MmapOpen    (REC_FILE *file, const char *fileName,
+                                  unsigned long long fileBytes);
+static int   RECFILE_MmapAppend  (REC_FILE *file, const void *prefix,
+                                  size_t prefixLen, const void *buf,
+                                  size_t len, unsigned long long lineIndex);
+static int   RECFILE_MmapClose   (REC_FILE *file);
+static void *RECFILE_SyncThread   (void *pParams);
+
+
+/**************************************************************************
+ Function:    RECFILE_Open()
+
+ Description: Creates (or truncates) an output file.
+
+ Parameters:  file       - pointer to the REC_FILE to initialize
+              fileName   - path of the file
+              backend    - REC_FILE_STDIO, REC_FILE_PWRITEV,
+                           REC_FILE_ASYNC or REC_FILE_MMAP
+              batchLines - range lines per batch (1 to REC_FILE_MAX_BATCH,
+                           pwritev and async backends)
+              asyncDepth - staging buffers, i.e. most writes in flight
+                           plus the one being filled (2 to
+                           REC_FILE_MAX_ASYNC, async backend only)
+              fileBytes  - expected length of the recording, or 0 if not
+                           known; required by the mmap backend
+
+ Return:      0 - success
+              1 - invalid backend, batch size, depth or length
+              2 - file failed to open
+              3 - staging buffers, threads, io_uring or mapping setup
+                  failed
+**************************************************************************/
+int RECFILE_Open (REC_FILE           *file,
+                  const char         *fileName,
+                  int                 backend,
+                  unsigned int        batchLines,
+                  unsigned int        asyncDepth,
+                  unsigned long long  fileBytes)
+{
+    int status;
+
+    memset (file, 0, sizeof(REC_FILE));
+    file->fd      = -1;
+    file->backend = backend;
+
+    if (backend == REC_FILE_STDIO)
+    {
+        file->batchLines = 1;
+        file->fp = fopen(fileName, "wb");
+        if (file->fp == NULL)
+            return (2);
+    }
+    else if (backend == REC_FILE_PWRITEV)
+    {
+        if ((batchLines == 0) || (batchLines > REC_FILE_MAX_BATCH))
+            return (1);
+
+        file->batchLines = batchLines;
+        file->fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (file->fd < 0)
+            return (2);
+    }
+    else if (backend == REC_FILE_ASYNC)
+    {
+        if ((batchLines == 0) || (batchLines > REC_FILE_MAX_BATCH))
+            return (1);
+        if ((asyncDepth < 2) || (asyncDepth > REC_FILE_MAX_ASYNC))
+            return (1);
+
+        file->batchLines = batchLines;
+        file->numSlots   = asyncDepth;
+        status = RECFILE_AsyncOpen(file, fileName);
+        if (status != 0)
+            return (status);
+    }
+    else if (backend == REC_FILE_MMAP)
+    {
+        if (fileBytes == 0)
+            return (1);
+
+        file->batchLines = 1;
+        return (RECFILE_MmapOpen(file, fileName, fileBytes));
+    }
+    else
+        return (1);
+
+    /* reserve the blocks up front but keep the file size as written;
+     * not all file systems support this, which is not an error
+     */
+    if (fileBytes != 0)
+    {
+        fallocate((file->fp != NULL) ? fileno(file->fp) : file->fd,
+                  FALLOC_FL_KEEP_SIZE, 0, (off_t)fileBytes);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_WriteHeader()
+
+ Description: Writes a header at the start of the file.  Call once, before
+              the first RECFILE_Append().  For the async backend the
+              length must be a multiple of REC_FILE_ALIGN so the lines
+              that follow stay aligned; for the mmap backend the header
+              must fit in the preallocated length along with the lines.
+
+ Parameters:  file - pointer to an open REC_FILE
+              hdr  - header data; copied, so it may be freed on return
+              len  - header length in bytes
+
+ Return:      0 - success
+              1 - write failed, or the header does not fit
+**************************************************************************/
+int RECFILE_WriteHeader (REC_FILE *file, const void *hdr, size_t len)
+{
+    file->headerBytes = len;
+    file->appendEnd   = len;
+
+    /* staged, and written with the first batch */
+    if (file->backend == REC_FILE_ASYNC)
+        return (RECFILE_AsyncAppend(file, (const char *)hdr, len));
+
+    file->writeCalls++;
+
+    if (file->backend == REC_FILE_STDIO)
+    {
+        if (fwrite(hdr, 1, len, file->fp) != len)
+            return (1);
+    }
+    else if (file->backend == REC_FILE_PWRITEV)
+    {
+        if (RECFILE_PwriteAll(file->fd, (const char *)hdr, len, 0) != 0)
+            return (1);
+        file->offset = len;
+    }
+    else if (file->backend == REC_FILE_MMAP)
+    {
+        if (len > file->mapBytes)
+            return (1);
+        memcpy(file->map, hdr, len);
+        if (len > file->highWater)
+            __atomic_store_n(&(file->highWater), len, __ATOMIC_RELEASE);
+    }
+
+    file->bytesWritten += len;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_Append()
+
+ Description: Adds a range line, and the prefix written in front of it, to
+              the file.  The stdio backend writes them straight away.  The
+              pwritev backend only records the buffers in the current
+              batch; RECFILE_Flush() writes them.  The async backend
+              copies them into the current staging buffer.  The mmap
+              backend copies them into the mapping at the line's fixed
+              offset; the others write lines back to back.
+
+ Parameters:  file      - pointer to an open REC_FILE
+              prefix    - line prefix, or NULL; with the pwritev backend
+                          it must stay valid until the batch is flushed
+              prefixLen - prefix length in bytes, 0 if none
+              buf       - range line data
+              len       - range line length in bytes
+              lineIndex - range line (PRI) number since the start of the
+                          run
+
+ Return:      0 - success
+              1 - write failed, batch already full, or line beyond the
+                  end of the mapping
+**************************************************************************/
+int RECFILE_Append (REC_FILE           *file,
+                    void               *prefix,
+                    size_t              prefixLen,
+                    void               *buf,
+                    size_t              len,
+                    unsigned long long  lineIndex)
+{
+    int status;
+
+    if (file->backend == REC_FILE_MMAP)
+        return (RECFILE_MmapAppend(file, prefix, prefixLen, buf, len,
+                                   lineIndex));
+
+    if ((file->backend == REC_FILE_PWRITEV) &&
+        (file->numPending >= REC_FILE_MAX_BATCH))
+        return (1);
+
+    file->lineOffset  = file->appendEnd;
+    file->appendEnd  += prefixLen + len;
+
+    if (file->backend == REC_FILE_STDIO)
+    {
+        if (prefixLen != 0)
+        {
+            file->writeCalls++;
+            if (fwrite(prefix, 1, prefixLen, file->fp) != prefixLen)
+                return (1);
+        }
+        file->writeCalls++;
+        if (fwrite(buf, 1, len, file->fp) != len)
+            return (1);
+        file->bytesWritten += prefixLen + len;
+        return (0);
+    }
+
+    if (file->backend == REC_FILE_ASYNC)
+    {
+        file->numPending++;
+        file->bytesPending += prefixLen + len;
+        status = 0;
+        if (prefixLen != 0)
+            status = RECFILE_AsyncAppend(file, (const char *)prefix, prefixLen);
+        if (status == 0)
+            status = RECFILE_AsyncAppend(file, (const char *)buf, len);
+        return (status);
+    }
+
+    if (prefixLen != 0)
+    {
+        file->iov[file->numIov].iov_base = prefix;
+        file->iov[file->numIov].iov_len  = prefixLen;
+        file->numIov++;
+    }
+    file->iov[file->numIov].iov_base = buf;
+    file->iov[file->numIov].iov_len  = len;
+    file->numIov++;
+    file->numPending++;
+    file->bytesPending += prefixLen + len;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_WriteTrailer()
+
+ Description: Adds a trailer after the last line.  Call once, after the
+              last RECFILE_Append() and before RECFILE_Close().  The
+              pwritev backend flushes its batch first.  The mmap backend
+              keeps a copy and writes it on close, after the file has been
+              cut back to the lines written.
+
+ Parameters:  file - pointer to an open REC_FILE
+              buf  - trailer data; copied, so it may be freed on return
+              len  - trailer length in bytes
+
+ Return:      0 - success
+              1 - write or allocation failed
+**************************************************************************/
+int RECFILE_WriteTrailer (REC_FILE *file, const void *buf, size_t len)
+{
+    file->appendEnd += len;
+
+    if (file->backend == REC_FILE_ASYNC)
+        return (RECFILE_AsyncAppend(file, (const char *)buf, len));
+
+    if (file->backend == REC_FILE_MMAP)
+    {
+        file->trailer = (char *)malloc(len);
+        if (file->trailer == NULL)
+            return (1);
+        memcpy(file->trailer, buf, len);
+        file->trailerLen = len;
+        return (0);
+    }
+
+    file->writeCalls++;
+
+    if (file->backend == REC_FILE_STDIO)
+    {
+        if (fwrite(buf, 1, len, file->fp) != len)
+            return (1);
+    }
+    else
+    {
+        if (RECFILE_Flush(file) != 0)
+            return (1);
+        if (RECFILE_PwriteAll(file->fd, (const char *)buf, len,
+                              file->offset) != 0)
+            return (1);
+        file->offset += len;
+    }
+
+    file->bytesWritten += len;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_Flush()
+
+ Description: Writes the current batch with pwritev(), retrying until all
+              of it is on disk.  Does nothing for the stdio backend, whose
+              lines are already written (and buffered by stdio).  The
+              async backend submits the staged batch and returns without
+              waiting for it; an error is reported by a later call.
+
+ Parameters:  file - pointer to an open REC_FILE
+
+ Return:      0 - success
+              1 - write failed
+**************************************************************************/
+int RECFILE_Flush (REC_FILE *file)
+{
+    struct iovec *iov    = file->iov;
+    int           iovCnt = file->numIov;
+    ssize_t       count;
+
+    if (file->backend == REC_FILE_ASYNC)
+        return (RECFILE_AsyncSubmit(file));
+
+    if ((file->backend == REC_FILE_STDIO) ||
+        (file->backend == REC_FILE_MMAP) || (iovCnt == 0))
+        return (0);
+
+    while (iovCnt > 0)
+    {
+        count = pwritev(file->fd, iov, iovCnt, (off_t)file->offset);
+        file->writeCalls++;
+
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return (1);
+        }
+
+        file->offset       += count;
+        file->bytesWritten += count;
+
+        /* skip the buffers written in full; trim a partly written one */
+        while ((iovCnt > 0) && ((size_t)count >= iov->iov_len))
+        {
+            count -= iov->iov_len;
+            iov++;
+            iovCnt--;
+        }
+        if (iovCnt > 0)
+        {
+            iov->iov_base  = (char *)iov->iov_base + count;
+            iov->iov_len  -= count;
+        }
+    }
+
+    file->numIov       = 0;
+    file->numPending   = 0;
+    file->bytesPending = 0;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_Close()
+
+ Description: Writes any partial batch and closes the file.
+
+ Parameters:  file - pointer to an open REC_FILE
+
+ Return:      0 - success
+              1 - final write or close failed
+**************************************************************************/
+int RECFILE_Close (REC_FILE *file)
+{
+    int status = 0;
+
+    if (file->backend == REC_FILE_STDIO)
+    {
+        if (file->fp != NULL)
+        {
+            if (fclose(file->fp) != 0)
+                status = 1;
+            file->fp = NULL;
+        }
+        return (status);
+    }
+
+    if (file->backend == REC_FILE_ASYNC)
+        return (RECFILE_AsyncClose(file));
+
+    if (file->backend == REC_FILE_MMAP)
+        return (RECFILE_MmapClose(file));
+
+    if (file->fd >= 0)
+    {
+        status = RECFILE_Flush(file);
+        if (close(file->fd) != 0)
+            status = 1;
+        file->fd = -1;
+    }
+
+    return (status);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_PwriteAll()
+
+ Description: Writes a buffer at a file offset with pwrite(), retrying
+              after signals and partial writes.
+
+ Parameters:  fd     - file descriptor
+              buf    - data to write
+              len    - bytes to write
+              offset - file offset
+
+ Return:      0 - success
+              1 - write failed
+**************************************************************************/
+static int RECFILE_PwriteAll (int                 fd,
+                              const char         *buf,
+                              size_t              len,
+                              unsigned long long  offset)
+{
+    ssize_t count;
+
+    while (len > 0)
+    {
+        count = pwrite(fd, buf, len, (off_t)offset);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return (1);
+        }
+
+        buf    += count;
+        len    -= count;
+        offset += count;
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_AsyncOpen()
+
+ Description: Opens the file for the async backend, allocates the staging
+              buffers and starts the io_uring instance or worker threads.
+
+ Parameters:  file     - pointer to the REC_FILE, with batchLines and
+                         numSlots set
+              fileName - path of the file
+
+ Return:      0 - success
+              2 - file failed to open
+              3 - staging buffers, threads or io_uring setup failed
+**************************************************************************/
+static int RECFILE_AsyncOpen (REC_FILE *file, const char *fileName)
+{
+    unsigned int i;
+
+    file->fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (file->fd >= 0)
+        file->directIo = 1;
+    else if (errno == EINVAL)
+        file->fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file->fd < 0)
+        return (2);
+
+    for (i = 0; i < file->numSlots; i++)
+    {
+        if (posix_memalign((void **)&(file->slot[i].buf), REC_FILE_ALIGN,
+                           REC_FILE_SLOT_BYTES) != 0)
+        {
+            file->slot[i].buf = NULL;
+            RECFILE_AsyncFree(file);
+            return (3);
+        }
+
+        /* fault the buffer in now rather than on the first append */
+        memset(file->slot[i].buf, 0, REC_FILE_SLOT_BYTES);
+    }
+
+    pthread_mutex_init(&(file->lock), NULL);
+    pthread_cond_init(&(file->workDone), NULL);
+    pthread_cond_init(&(file->workReady), NULL);
+
+#ifdef HAVE_LIBURING
+    if (io_uring_queue_init(file->numSlots, &(file->uring), 0) != 0)
+    {
+        RECFILE_AsyncFree(file);
+        return (3);
+    }
+#else
+    for (i = 0; i < file->numSlots; i++)
+    {
+        if (pthread_create(&(file->worker[i]), NULL, RECFILE_WorkerThread,
+                           file) != 0)
+        {
+            pthread_mutex_lock(&(file->lock));
+            file->workerStop = 1;
+            pthread_cond_broadcast(&(file->workReady));
+            pthread_mutex_unlock(&(file->lock));
+            while (i > 0)
+                pthread_join(file->worker[--i], NULL);
+            RECFILE_AsyncFree(file);
+            return (3);
+        }
+    }
+#endif
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_AsyncAppend()
+
+ Description: Copies data (a header, line prefix or range line) into the
+              staging buffers, submitting a buffer early if it does not
+              fit.
+
+ Parameters:  file - pointer to an open async REC_FILE
+              buf  - data
+              len  - length in bytes
+
+ Return:      0 - success
+              1 - an earlier write failed
+**************************************************************************/
+static int RECFILE_AsyncAppend (REC_FILE *file, const char *buf, size_t len)
+{
+    REC_FILE_SLOT *slot;
+    size_t         room;
+    size_t         count;
+
+    while (len > 0)
+    {
+        slot = &(file->slot[file->curSlot]);
+        room = REC_FILE_SLOT_BYTES - slot->len;
+
+        if (room == 0)
+        {
+            RECFILE_AsyncSubmit(file);
+            continue;
+        }
+
+        count = (len < room) ? len : room;
+        memcpy(slot->buf + slot->len, buf, count);
+        slot->len += count;
+        buf       += count;
+        len       -= count;
+    }
+
+    return (__atomic_load_n(&(file->writeError), __ATOMIC_RELAXED));
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_AsyncSubmit()
+
+ Description: Submits the whole blocks of the current staging buffer and
+              moves the remainder to the next buffer, which becomes the
+              current one.  Waits only if that buffer's previous write is
+              still in flight.  Less than one block is left in place.
+
+ Parameters:  file - pointer to an open async REC_FILE
+
+ Return:      0 - success
+              1 - an earlier write failed
+**************************************************************************/
+static int RECFILE_AsyncSubmit (REC_FILE *file)
+{
+    REC_FILE_SLOT *cur  = &(file->slot[file->curSlot]);
+    REC_FILE_SLOT *next;
+    unsigned int   nextIndex;
+    size_t         aligned = cur->len & ~((size_t)REC_FILE_ALIGN - 1);
+
+    file->numPending   = 0;
+    file->bytesPending = 0;
+
+    if (aligned == 0)
+        return (__atomic_load_n(&(file->writeError), __ATOMIC_RELAXED));
+
+    nextIndex = (file->curSlot + 1) % file->numSlots;
+    next      = &(file->slot[nextIndex]);
+    RECFILE_AsyncWait(file, nextIndex);
+
+    next->len = cur->len - aligned;
+    memcpy(next->buf, cur->buf + aligned, next->len);
+
+    cur->len     = aligned;
+    cur->offset  = file->offset;
+    file->offset += aligned;
+    RECFILE_AsyncIssue(file, file->curSlot);
+
+    file->curSlot = nextIndex;
+
+    return (__atomic_load_n(&(file->writeError), __ATOMIC_RELAXED));
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_AsyncIssue()
+
+ Description: Starts the write of a staging buffer, either as an io_uring
+              request or by queueing it for a worker thread.
+
+ Parameters:  file  - pointer to an open async REC_FILE
+              index - staging buffer to write
+
+ Return:      none
+**************************************************************************/
+static void RECFILE_AsyncIssue (REC_FILE *file, unsigned int index)
+{
+    REC_FILE_SLOT *slot = &(file->slot[index]);
+#ifdef HAVE_LIBURING
+    struct io_uring_sqe *sqe;
+
+    slot->busy = 1;
+    file->writeCalls++;
+
+    /* the ring has an entry per slot and a slot is never submitted
+     * twice, so an entry is always free
+     */
+    sqe = io_uring_get_sqe(&(file->uring));
+    io_uring_prep_write(sqe, file->fd, slot->buf, slot->len, slot->offset);
+    io_uring_sqe_set_data(sqe, (void *)(unsigned long)index);
+    if (io_uring_submit(&(file->uring)) < 0)
+    {
+        file->writeError = 1;
+        slot->busy = 0;
+    }
+#else
+    pthread_mutex_lock(&(file->lock));
+    slot->busy = 1;
+    file->writeCalls++;
+    file->queue[(file->queueHead + file->queueCount) % REC_FILE_MAX_ASYNC] = index;
+    file->queueCount++;
+    pthread_cond_signal(&(file->workReady));
+    pthread_mutex_unlock(&(file->lock));
+#endif
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_AsyncWait()
+
+ Description: Waits for the write of a staging buffer to complete.  With
+              io_uring this also reaps any other completions that arrive
+              first.
+
+ Parameters:  file  - pointer to an open async REC_FILE
+              index - staging buffer to wait for
+
+ Return:      none
+**************************************************************************/
+static void RECFILE_AsyncWait (REC_FILE *file, unsigned int index)
+{
+#ifdef HAVE_LIBURING
+    struct io_uring_cqe *cqe;
+    REC_FILE_SLOT       *done;
+    int                  status;
+
+    while (file->slot[index].busy)
+    {
+        status = io_uring_wait_cqe(&(file->uring), &cqe);
+        if (status == -EINTR)
+            continue;
+        if (status < 0)
+        {
+            /* nothing more will complete; give the slots back */
+            file->writeError = 1;
+            for (status = 0; status < (int)file->numSlots; status++)
+                file->slot[status].busy = 0;
+            break;
+        }
+
+        done = &(file->slot[(unsigned long)io_uring_cqe_get_data(cqe)]);
+        if (cqe->res < 0)
+            file->writeError = 1;
+        else if ((size_t)cqe->res < done->len)
+        {
+            /* short write; finish it synchronously */
+            if (RECFILE_PwriteAll(file->fd, done->buf + cqe->res,
+                                  done->len - cqe->res,
+                                  done->offset + cqe->res) != 0)
+                file->writeError = 1;
+            else
+                file->bytesWritten += done->len;
+        }
+        else
+            file->bytesWritten += done->len;
+
+        done->busy = 0;
+        io_uring_cqe_seen(&(file->uring), cqe);
+    }
+#else
+    pthread_mutex_lock(&(file->lock));
+    while (file->slot[index].busy)
+        pthread_cond_wait(&(file->workDone), &(file->lock));
+    pthread_mutex_unlock(&(file->lock));
+#endif
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_AsyncClose()
+
+ Description: Submits the staged data, waits for every write, writes the
+              final partial block padded to REC_FILE_ALIGN and truncates
+              the file to the bytes actually appended.
+
+ Parameters:  file - pointer to an open async REC_FILE
+
+ Return:      0 - success
+              1 - a write, the truncate or the close failed
+**************************************************************************/
+static int RECFILE_AsyncClose (REC_FILE *file)
+{
+    REC_FILE_SLOT *tail;
+    unsigned int   i;
+    int            status = 0;
+
+    if (file->fd < 0)
+        return (0);
+
+    RECFILE_AsyncSubmit(file);
+    for (i = 0; i < file->numSlots; i++)
+        RECFILE_AsyncWait(file, i);
+
+    tail = &(file->slot[file->curSlot]);
+    if (tail->len > 0)
+    {
+        memset(tail->buf + tail->len, 0, REC_FILE_ALIGN - tail->len);
+        file->writeCalls++;
+        if (RECFILE_PwriteAll(file->fd, tail->buf, REC_FILE_ALIGN,
+                              file->offset) != 0)
+            status = 1;
+        else
+            file->bytesWritten += tail->len;
+
+        if (ftruncate(file->fd, (off_t)(file->offset + tail->len)) != 0)
+            status = 1;
+        file->offset += tail->len;
+        tail->len     = 0;
+    }
+
+    if (file->writeError)
+        status = 1;
+
+#ifndef HAVE_LIBURING
+    pthread_mutex_lock(&(file->lock));
+    file->workerStop = 1;
+    pthread_cond_broadcast(&(file->workReady));
+    pthread_mutex_unlock(&(file->lock));
+    for (i = 0; i < file->numSlots; i++)
+        pthread_join(file->worker[i], NULL);
+#endif
+
+    pthread_cond_destroy(&(file->workReady));
+    pthread_cond_destroy(&(file->workDone));
+    pthread_mutex_destroy(&(file->lock));
+    RECFILE_AsyncFree(file);
+
+    return (status);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_AsyncFree()
+
+ Description: Releases the async backend's resources and closes the file.
+              The worker threads must already have exited.
+
+ Parameters:  file - pointer to an async REC_FILE
+
+ Return:      none
+**************************************************************************/
+static void RECFILE_AsyncFree (REC_FILE *file)
+{
+    unsigned int i;
+
+#ifdef HAVE_LIBURING
+    if (file->uring.ring_fd > 0)
+        io_uring_queue_exit(&(file->uring));
+#endif
+
+    for (i = 0; i < file->numSlots; i++)
+    {
+        free(file->slot[i].buf);
+        file->slot[i].buf = NULL;
+    }
+
+    if (file->fd >= 0)
+    {
+        close(file->fd);
+        file->fd = -1;
+    }
+}
+
+
+#ifndef HAVE_LIBURING
+/**************************************************************************
+ Function:    RECFILE_WorkerThread()
+
+ Description: Async backend worker thread.  Takes queued staging buffers
+              and writes each one with pwrite().  One worker per staging
+              buffer, so every submitted write can be in flight at once.
+
+ Parameters:  pParams - pointer to the REC_FILE
+
+ Return:      NULL
+**************************************************************************/
+static void *RECFILE_WorkerThread (void *pParams)
+{
+    REC_FILE      *file = (REC_FILE *)pParams;
+    REC_FILE_SLOT *slot;
+    int            status;
+
+    pthread_mutex_lock(&(file->lock));
+
+    while (1)
+    {
+        while ((file->queueCount == 0) && (!file->workerStop))
+            pthread_cond_wait(&(file->workReady), &(file->lock));
+
+        if (file->queueCount == 0)
+            break;
+
+        slot = &(file->slot[file->queue[file->queueHead]]);
+        file->queueHead = (file->queueHead + 1) % REC_FILE_MAX_ASYNC;
+        file->queueCount--;
+        pthread_mutex_unlock(&(file->lock));
+
+        status = RECFILE_PwriteAll(file->fd, slot->buf, slot->len,
+                                   slot->offset);
+
+        pthread_mutex_lock(&(file->lock));
+        if (status != 0)
+            file->writeError = 1;
+        else
+            file->bytesWritten += slot->len;
+        slot->busy = 0;
+        pthread_cond_broadcast(&(file->workDone));
+    }
+
+    pthread_mutex_unlock(&(file->lock));
+
+    return (NULL);
+}
+#endif
+
+
+/**************************************************************************
+ Function:    RECFILE_MmapOpen()
+
+ Description: Opens the file for the mmap backend, preallocates it to
+              fileBytes, maps it and starts the writeback thread.
+
+ Parameters:  file      - pointer to the REC_FILE
+              fileName  - path of the file
+              fileBytes - length of the recording
+
+ Return:      0 - success
+              2 - file failed to open
+              3 - sizing, mapping or thread creation failed
+**************************************************************************/
+static int RECFILE_MmapOpen (REC_FILE           *file,
+                             const char         *fileName,
+                             unsigned long long  fileBytes)
+{
+    file->fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file->fd < 0)
+        return (2);
+
+    /* fall back to a sparse file where fallocate() is not supported */
+    if (fallocate(file->fd, 0, 0, (off_t)fileBytes) != 0)
+    {
+        if (ftruncate(file->fd, (off_t)fileBytes) != 0)
+        {
+            close(file->fd);
+            file->fd = -1;
+            return (3);
+        }
+    }
+
+    file->map = mmap(NULL, fileBytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     file->fd, 0);
+    if (file->map == MAP_FAILED)
+    {
+        file->map = NULL;
+        close(file->fd);
+        file->fd = -1;
+        return (3);
+    }
+    file->mapBytes = fileBytes;
+    madvise(file->map, fileBytes, MADV_SEQUENTIAL);
+
+    /* if the process has locked its memory, the mapping must not be
+     * locked too: it would pin the whole recording and stop the sync
+     * thread from releasing written regions
+     */
+    munlock(file->map, fileBytes);
+
+    if (pthread_create(&(file->syncer), NULL, RECFILE_SyncThread, file) != 0)
+    {
+        munmap(file->map, fileBytes);
+        file->map = NULL;
+        close(file->fd);
+        file->fd = -1;
+        return (3);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_MmapAppend()
+
+ Description: Copies a range line and its prefix to their place in the
+              mapping.
+
+ Parameters:  file      - pointer to an open mmap REC_FILE
+              prefix    - line prefix, or NULL
+              prefixLen - prefix length in bytes, 0 if none
+              buf       - range line data
+              len       - range line length in bytes
+              lineIndex - range line (PRI) number
+
+ Return:      0 - success
+              1 - line lies beyond the end of the mapping
+**************************************************************************/
+static int RECFILE_MmapAppend (REC_FILE           *file,
+                               const void         *prefix,
+                               size_t              prefixLen,
+                               const void         *buf,
+                               size_t              len,
+                               unsigned long long  lineIndex)
+{
+    unsigned long long offset = file->headerBytes +
+                                (lineIndex * (prefixLen + len));
+    unsigned long long end    = offset + prefixLen + len;
+
+    if (end > file->mapBytes)
+        return (1);
+
+    file->lineOffset = offset;
+    if (prefixLen != 0)
+        memcpy(file->map + offset, prefix, prefixLen);
+    memcpy(file->map + offset + prefixLen, buf, len);
+    file->bytesWritten += prefixLen + len;
+
+    if (end > file->highWater)
+    {
+        __atomic_store_n(&(file->highWater), end, __ATOMIC_RELEASE);
+        file->appendEnd = end;
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_MmapClose()
+
+ Description: Stops the writeback thread, unmaps the file and truncates it
+              to the end of the last line written, then adds the trailer
+              if there is one.
+
+ Parameters:  file - pointer to an open mmap REC_FILE
+
+ Return:      0 - success
+              1 - unmap, truncate or close failed
+**************************************************************************/
+static int RECFILE_MmapClose (REC_FILE *file)
+{
+    int status = 0;
+
+    if (file->fd < 0)
+        return (0);
+
+    __atomic_store_n(&(file->syncStop), 1, __ATOMIC_RELEASE);
+    pthread_join(file->syncer, NULL);
+
+    if (munmap(file->map, file->mapBytes) != 0)
+        status = 1;
+    file->map = NULL;
+
+    if (ftruncate(file->fd, (off_t)file->highWater) != 0)
+        status = 1;
+
+    if (file->trailer != NULL)
+    {
+        file->writeCalls++;
+        if (RECFILE_PwriteAll(file->fd, file->trailer, file->trailerLen,
+                              file->highWater) != 0)
+            status = 1;
+        else
+            file->bytesWritten += file->trailerLen;
+        free(file->trailer);
+        file->trailer = NULL;
+    }
+
+    if (close(file->fd) != 0)
+        status = 1;
+    file->fd = -1;
+
+    return (status);
+}
+
+
+/**************************************************************************
+ Function:    RECFILE_SyncThread()
+
+ Description: mmap backend writeback thread.  Every REC_FILE_SYNC_BYTES
+              filled, starts writeback of the new window without waiting,
+              then waits for the previous window to reach the disk and
+              drops it from the mapping and the page cache.  This keeps
+              dirty memory to about two windows per channel instead of
+              letting it build up until the kernel flushes it in a burst.
+
+ Parameters:  pParams - pointer to the REC_FILE
+
+ Return:      NULL
+**************************************************************************/
+static void *RECFILE_SyncThread (void *pParams)
+{
+    REC_FILE           *file  = (REC_FILE *)pParams;
+    struct timespec     idle  = {0, 10000000};
+    unsigned long long  page  = (unsigned long long)sysconf(_SC_PAGESIZE);
+    unsigned long long  released = 0;
+    unsigned long long  filled;
+
+    while (!__atomic_load_n(&(file->syncStop), __ATOMIC_ACQUIRE))
+    {
+        /* only whole pages below the last line written are finished */
+        filled  = __atomic_load_n(&(file->highWater), __ATOMIC_ACQUIRE);
+        filled &= ~(page - 1);
+
+        if ((filled - file->synced) < REC_FILE_SYNC_BYTES)
+        {
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        sync_file_range(file->fd, (off_t)file->synced,
+                        (off_t)(filled - file->synced),
+                        SYNC_FILE_RANGE_WRITE);
+
+        if (file->synced > released)
+        {
+            sync_file_range(file->fd, (off_t)released,
+                            (off_t)(file->synced - released),
+                            SYNC_FILE_RANGE_WAIT_BEFORE |
+                            SYNC_FILE_RANGE_WRITE |
+                            SYNC_FILE_RANGE_WAIT_AFTER);
+            madvise(file->map + released, file->synced - released,
+                    MADV_DONTNEED);
+            posix_fadvise(file->fd, (off_t)released,
+                          (off_t)(file->synced - released),
+                          POSIX_FADV_DONTNEED);
+            released = file->synced;
+        }
+
+        file->synced = filled;
+        file->writeCalls++;
+    }
+
+    return (NULL);
+}
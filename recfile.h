@@ -0,0 +1,214 @@
+/***********************************************************************
+*
+*   File: recfile.h
+*
+*   Description: header file for recfile.c, the output file used by the
+*                channel writer threads to save range lines (adcN.dat).
+*
+*                Four backends are provided, selected by OUTPUT_BACKEND in
+*                NeXtRAD.ini:
+*
+*                REC_FILE_STDIO   - one fwrite() per range line through
+*                                   stdio (the original behaviour)
+*                REC_FILE_PWRITEV - range lines are collected into batches
+*                                   of WRITE_BATCH lines and each batch is
+*                                   written with a single pwritev(), taken
+*                                   directly from the DMA buffers
+*                REC_FILE_ASYNC   - range lines are copied into page-aligned
+*                                   staging buffers and written with
+*                                   O_DIRECT, keeping up to ASYNC_DEPTH
+*                                   writes in flight.  Uses io_uring when
+*                                   built with HAVE_LIBURING, otherwise a
+*                                   pool of pwrite() worker threads.  The
+*                                   page cache is bypassed, so long runs do
+*                                   not build up dirty pages that are later
+*                                   flushed in bursts.
+*                REC_FILE_MMAP    - the file is preallocated to the full
+*                                   run length (NUM_PRIS range lines, or
+*                                   a segment's) and mapped; each line is
+*                                   copied to its fixed offset, PRI index
+*                                   in the file x line size (after any
+*                                   header and counting its prefix).
+*                                   A background thread starts writeback
+*                                   of filled regions and releases them.
+*
+*                When the run length is known, the other backends also
+*                preallocate the file (without changing its size) so it
+*                is laid out in few extents.
+*
+*                A file may start with a header (RECFILE_WriteHeader()),
+*                and each line may carry a prefix that is written in front
+*                of it (the nxrec format, see nxrec.h).  The pwritev
+*                backend gathers the prefix and the line into the same
+*                write, so the line is still taken straight from the DMA
+*                buffer.
+*
+*                A trailer (RECFILE_WriteTrailer()) can be added after the
+*                last line, e.g. the nxrec PRI index.  The mmap backend
+*                holds it until the file has been cut back to the lines
+*                written, and then writes it there.
+*
+************************************************************************/
+
+#ifndef __RECFILE_H__
+#define __RECFILE_H__
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+
+/* output backends */
+#define REC_FILE_STDIO       0
+#define REC_FILE_PWRITEV     1
+#define REC_FILE_ASYNC       2
+#define REC_FILE_MMAP        3
+
+/* REC_FILE_MAX_BATCH - most range lines in one batched write */
+#define REC_FILE_MAX_BATCH   64
+
+/* REC_FILE_MAX_ASYNC - most staging buffers (writes in flight) for the
+ * async backend;
+ * REC_FILE_ALIGN - O_DIRECT alignment of buffers, offsets and lengths;
+ * REC_FILE_SLOT_BYTES - size of each staging buffer
+ */
+#define REC_FILE_MAX_ASYNC   16
+#define REC_FILE_ALIGN       4096
+#define REC_FILE_SLOT_BYTES  (1024 * 1024)
+
+/* REC_FILE_SYNC_BYTES - mmap backend writeback window; once this much
+ * has been filled past the last window, writeback of it is started and
+ * the window before it is waited for and dropped from memory
+ */
+#define REC_FILE_SYNC_BYTES  (8 * 1024 * 1024)
+
+
+/* REC_FILE_SLOT - async backend staging buffer
+ *     buf    = page-aligned buffer, REC_FILE_SLOT_BYTES long
+ *     len    = bytes filled, or bytes being written once submitted
+ *     offset = file offset of the write
+ *     busy   = write submitted and not yet complete
+ */
+typedef struct REC_FILE_SLOT
+        {
+            char               *buf;
+            size_t              len;
+            unsigned long long  offset;
+            int                 busy;
+        } REC_FILE_SLOT;
+
+
+/* REC_FILE - output file state
+ *     backend      = REC_FILE_STDIO, REC_FILE_PWRITEV, REC_FILE_ASYNC or
+ *                    REC_FILE_MMAP
+ *     fd           = file descriptor (all but the stdio backend)
+ *     fp           = stdio stream (stdio backend)
+ *     offset       = file offset of the next batch
+ *     headerBytes  = length of the file header, 0 if none
+ *     appendEnd    = file offset after the last line appended
+ *     lineOffset   = file offset of the last line appended (its prefix)
+ *     batchLines   = range lines per batch
+ *     iov          = prefixes and lines of the current batch
+ *     numIov       = entries of iov in use
+ *     numPending   = lines in the current batch
+ *     bytesPending = bytes in the current batch
+ *     writeCalls   = write system/library calls made
+ *     bytesWritten = bytes written so far
+ *
+ *   async backend only:
+ *     directIo     = file was opened with O_DIRECT
+ *     numSlots     = staging buffers in use (writes in flight)
+ *     slot         = staging buffers
+ *     curSlot      = staging buffer being filled
+ *     writeError   = set by a failed write completion
+ *     lock         = protects the slots, queue and statistics below
+ *     workDone     = signalled when a write completes
+ *     workReady    = signalled when a write is queued (thread pool)
+ *     queue        = slots waiting for a worker (thread pool)
+ *     queueHead/Count = position and length of the queue
+ *     workerStop   = tells the workers to exit
+ *     worker       = pwrite() worker threads
+ *     uring        = io_uring instance (HAVE_LIBURING builds)
+ *
+ *   mmap backend only:
+ *     map          = mapping of the whole preallocated file
+ *     mapBytes     = length of the mapping
+ *     highWater    = end of the furthest line copied in
+ *     synced       = bytes up to which writeback has been started
+ *     syncStop     = tells the sync thread to exit
+ *     syncer       = writeback thread
+ *     trailer      = copy of the trailer, written on close
+ *     trailerLen   = length of the trailer
+ */
+typedef struct REC_FILE
+        {
+            int                 backend;
+            int                 fd;
+            FILE               *fp;
+            unsigned long long  offset;
+            unsigned long long  headerBytes;
+            unsigned long long  appendEnd;
+            unsigned long long  lineOffset;
+            unsigned int        batchLines;
+            struct iovec        iov[2 * REC_FILE_MAX_BATCH];
+            unsigned int        numIov;
+            unsigned int        numPending;
+            size_t              bytesPending;
+            unsigned long       writeCalls;
+            unsigned long long  bytesWritten;
+
+            int                 directIo;
+            unsigned int        numSlots;
+            REC_FILE_SLOT       slot[REC_FILE_MAX_ASYNC];
+            unsigned int        curSlot;
+            int                 writeError;
+            pthread_mutex_t     lock;
+            pthread_cond_t      workDone;
+            pthread_cond_t      workReady;
+            unsigned int        queue[REC_FILE_MAX_ASYNC];
+            unsigned int        queueHead;
+            unsigned int        queueCount;
+            int                 workerStop;
+            pthread_t           worker[REC_FILE_MAX_ASYNC];
+#ifdef HAVE_LIBURING
+            struct io_uring     uring;
+#endif
+
+            char               *map;
+            unsigned long long  mapBytes;
+            unsigned long long  highWater;
+            unsigned long long  synced;
+            int                 syncStop;
+            pthread_t           syncer;
+            char               *trailer;
+            size_t              trailerLen;
+        } REC_FILE;
+
+
+/* function prototypes */
+int  RECFILE_Open        (REC_FILE     *file,
+                          const char   *fileName,
+                          int           backend,
+                          unsigned int  batchLines,
+                          unsigned int  asyncDepth,
+                          unsigned long long fileBytes);
+int  RECFILE_WriteHeader (REC_FILE     *file,
+                          const void   *hdr,
+                          size_t        len);
+int  RECFILE_Append      (REC_FILE     *file,
+                          void         *prefix,
+                          size_t        prefixLen,
+                          void         *buf,
+                          size_t        len,
+                          unsigned long long lineIndex);
+int  RECFILE_WriteTrailer (REC_FILE    *file,
+                          const void   *buf,
+                          size_t        len);
+int  RECFILE_Flush       (REC_FILE     *file);
+int  RECFILE_Close       (REC_FILE     *file);
+
+#endif /* __RECFILE_H__ */
@@ -0,0 +1,503 @@
+/**************************************************************************
+*
+*   File: recseg.c
+*
+*   Description: Segmented recording.  See recseg.h.
+*
+*                RECSEG_FILES REC_FILEs take turns: while the writer
+*                appends to one, the finisher opens the next segments in
+*                the others.  When the writer reaches the next segment it
+*                flushes and indexes the current one, hands it to the
+*                finisher and carries on in the file opened ahead; the
+*                finisher closes the old one and then opens another
+*                segment ahead.  With two segments open ahead, a slow
+*                close is absorbed as long as closes and opens keep up on
+*                average.  The lock is only held to change file states,
+*                never across file I/O.
+*
+*                A segment is only passed to the done callback once it is
+*                closed, so the mover never copies a file that is still
+*                being written.  Files opened ahead for segments the run
+*                never reached are removed again.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "recseg.h"
+#include "dmaring.h"
+
+
+static void               *RECSEG_Finisher (void *pParams);
+static unsigned int        RECSEG_Ready    (REC_SEG *seg);
+static int                 RECSEG_OpenFile (REC_SEG *seg, unsigned int i,
+                                            unsigned int segment);
+static void                RECSEG_Name     (REC_SEG *seg, unsigned int segment,
+                                            char *buf, int fullPath);
+
+
+/**************************************************************************
+ Function:    RECSEG_Open()
+
+ Description: Opens segment 0 and starts the finisher thread, which opens
+              the following segments ahead of the writer.
+
+ Parameters:  seg         - pointer to the REC_SEG to initialize
+              chanNum     - ADC channel number
+              dir         - directory to record into
+              baseName    - file name stem, e.g. "adc0"
+              backend     - REC_FILE_* output backend
+              batchLines  - range lines per batch
+              asyncDepth  - async backend staging buffers
+              segPris     - PRIs per segment
+              numPris     - PRIs in the run, 0 = until stopped
+              recordBytes - bytes per record (unpacked), for preallocation
+              fields      - nxrec header fields (as for NXREC_BuildHeader()),
+                            or NULL for raw range lines
+              iniFile     - NeXtRAD.ini recorded in each nxrec header
+              done        - callback for each closed segment, or NULL
+
+ Return:      0 - success
+              1 - bad parameters, or segment 0 failed to open
+              2 - thread creation failed
+**************************************************************************/
+int RECSEG_Open (REC_SEG            *seg,
+                 int                 chanNum,
+                 const char         *dir,
+                 const char         *baseName,
+                 int                 backend,
+                 unsigned int        batchLines,
+                 unsigned int        asyncDepth,
+                 unsigned long long  segPris,
+                 unsigned long long  numPris,
+                 unsigned int        recordBytes,
+                 const NXREC_HEADER *fields,
+                 const char         *iniFile,
+                 RECSEG_DONE_FN      done)
+{
+    memset (seg, 0, sizeof(REC_SEG));
+
+    if ((segPris == 0) || (strlen(dir) >= RECSEG_PATH_LEN) ||
+        (strlen(baseName) >= sizeof(seg->baseName)))
+        return (1);
+
+    seg->chanNum     = chanNum;
+    strcpy(seg->dir, dir);
+    strcpy(seg->baseName, baseName);
+    seg->backend     = backend;
+    seg->batchLines  = batchLines;
+    seg->asyncDepth  = asyncDepth;
+    seg->segPris     = segPris;
+    seg->numPris     = numPris;
+    seg->recordBytes = recordBytes;
+    seg->iniFile     = iniFile;
+    seg->done        = done;
+
+    if (fields != NULL)
+    {
+        seg->fields = *fields;
+        seg->nxrec  = 1;
+        seg->header = malloc(NXREC_MAX_HEADER);
+        if (seg->header == NULL)
+            return (1);
+    }
+
+    if (RECSEG_OpenFile(seg, 0, 0) != 0)
+    {
+        free(seg->header);
+        seg->header = NULL;
+        return (1);
+    }
+    seg->state[0] = RECSEG_ACTIVE;
+    seg->cur      = 0;
+    seg->nextSeg  = 1;
+
+    pthread_mutex_init(&(seg->lock), NULL);
+    pthread_cond_init(&(seg->changed), NULL);
+
+    if (pthread_create(&(seg->finisher), NULL, RECSEG_Finisher, seg) != 0)
+    {
+        RECFILE_Close(&(seg->file[0]));
+        pthread_mutex_destroy(&(seg->lock));
+        pthread_cond_destroy(&(seg->changed));
+        free(seg->header);
+        seg->header = NULL;
+        return (2);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECSEG_File()
+
+ Description: Returns the segment file being written.
+
+ Parameters:  seg - pointer to an open REC_SEG
+
+ Return:      pointer to the file
+**************************************************************************/
+REC_FILE *RECSEG_File (REC_SEG *seg)
+{
+    return (&(seg->file[seg->cur]));
+}
+
+
+/**************************************************************************
+ Function:    RECSEG_Next()
+
+ Description: Waits until the next segment has been opened ahead.  The
+              current segment stays the one written to until
+              RECSEG_Switch().  If the next segment cannot be opened, or
+              lies past the end of the run, the caller carries on in the
+              current one.  Writer thread only.
+
+ Parameters:  seg - pointer to an open REC_SEG
+              pri - first PRI of the next segment, recorded if it cannot
+                    be had
+
+ Return:      pointer to the next segment's file, or NULL if there is none
+**************************************************************************/
+REC_FILE *RECSEG_Next (REC_SEG *seg, unsigned long long pri)
+{
+    REC_FILE           *next  = NULL;
+    unsigned long long  start = 0;
+    unsigned long long  waitNs;
+    unsigned int        i;
+
+    pthread_mutex_lock(&(seg->lock));
+    while (1)
+    {
+        i = RECSEG_Ready(seg);
+        if (i < RECSEG_FILES)
+            next = &(seg->file[i]);
+        if ((next != NULL) || seg->openFailed ||
+            ((seg->numPris != 0) &&
+             ((unsigned long long)seg->nextSeg * seg->segPris >= seg->numPris)))
+            break;
+
+        if (start == 0)
+            start = DMARING_TimeNs();
+        pthread_cond_wait(&(seg->changed), &(seg->lock));
+    }
+
+    if (start != 0)
+    {
+        waitNs = DMARING_TimeNs() - start;
+        seg->waits++;
+        if (waitNs > seg->maxWaitNs)
+            seg->maxWaitNs = waitNs;
+    }
+    if ((next == NULL) && (seg->stoppedAt == 0))
+        seg->stoppedAt = pri;
+    pthread_mutex_unlock(&(seg->lock));
+
+    return (next);
+}
+
+
+/**************************************************************************
+ Function:    RECSEG_Switch()
+
+ Description: Hands the current segment to the finisher to be closed and
+              makes the one opened ahead current.  Call after a
+              successful RECSEG_Next(), once the current segment has been
+              flushed and its index written.  Writer thread only.
+
+ Parameters:  seg - pointer to an open REC_SEG
+
+ Return:      pointer to the new current file
+**************************************************************************/
+REC_FILE *RECSEG_Switch (REC_SEG *seg)
+{
+    unsigned int i;
+
+    pthread_mutex_lock(&(seg->lock));
+    i = RECSEG_Ready(seg);
+    seg->state[seg->cur] = RECSEG_DONE;
+    seg->state[i]        = RECSEG_ACTIVE;
+    seg->cur             = i;
+    pthread_cond_broadcast(&(seg->changed));
+    pthread_mutex_unlock(&(seg->lock));
+
+    return (&(seg->file[i]));
+}
+
+
+/**************************************************************************
+ Function:    RECSEG_Close()
+
+ Description: Hands the last segment to the finisher, then waits for it to
+              close every segment and exit.  Segments opened ahead and
+              never written are removed.  Call once the writer has stopped
+              and the last segment's index has been written.
+
+ Parameters:  seg - pointer to an open REC_SEG
+
+ Return:      0 - every segment was written and closed
+              1 - a segment failed to open, write or close
+**************************************************************************/
+int RECSEG_Close (REC_SEG *seg)
+{
+    pthread_mutex_lock(&(seg->lock));
+    seg->state[seg->cur] = RECSEG_DONE;
+    seg->stop            = 1;
+    pthread_cond_broadcast(&(seg->changed));
+    pthread_mutex_unlock(&(seg->lock));
+
+    pthread_join(seg->finisher, NULL);
+
+    pthread_mutex_destroy(&(seg->lock));
+    pthread_cond_destroy(&(seg->changed));
+    free(seg->header);
+    seg->header = NULL;
+
+    return ((seg->failed != 0) ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    RECSEG_Report()
+
+ Description: Prints a channel's segment statistics.
+
+ Parameters:  seg - pointer to a closed REC_SEG
+
+ Return:      none
+**************************************************************************/
+void RECSEG_Report (REC_SEG *seg)
+{
+    printf("[dmaThread %d] segments: %lu closed, %llu PRIs each, %lu failed, "
+           "longest close %.1f ms\n", seg->chanNum+1, seg->closed,
+           seg->segPris, seg->failed, seg->maxCloseNs / 1e6);
+
+    if (seg->waits != 0)
+        printf("[dmaThread %d] segments: writer waited %lu time(s) for the "
+               "next segment, longest %.1f ms\n", seg->chanNum+1, seg->waits,
+               seg->maxWaitNs / 1e6);
+
+    if (seg->stoppedAt != 0)
+        printf("[dmaThread %d] segments: no segment after PRI %llu could be "
+               "opened; the rest of the run is in the last one\n",
+               seg->chanNum+1, seg->stoppedAt);
+}
+
+
+/**************************************************************************
+ Function:    RECSEG_Finisher()
+
+ Description: Finisher thread.  Closes each segment the writer has
+              finished with and passes it to the done callback, and keeps
+              the next segments open ahead of the writer.  Closing comes
+              first, so a finished segment reaches the mover as soon as
+              possible.  Once stopped, it closes and removes any segment
+              opened ahead but never used, and exits.
+
+ Parameters:  pParams - pointer to the REC_SEG
+
+ Return:      NULL
+**************************************************************************/
+static void *RECSEG_Finisher (void *pParams)
+{
+    REC_SEG            *seg = (REC_SEG *)pParams;
+    char                name[2 * RECSEG_PATH_LEN];
+    unsigned long long  start;
+    unsigned long long  closeNs;
+    unsigned int        segment;
+    unsigned int        i;
+    int                 status;
+
+    pthread_mutex_lock(&(seg->lock));
+    while (1)
+    {
+        /* close a segment the writer has moved on from */
+        for (i = 0; i < RECSEG_FILES; i++)
+        {
+            if (seg->state[i] == RECSEG_DONE)
+                break;
+        }
+        if (i < RECSEG_FILES)
+        {
+            pthread_mutex_unlock(&(seg->lock));
+
+            start   = DMARING_TimeNs();
+            status  = RECFILE_Close(&(seg->file[i]));
+            closeNs = DMARING_TimeNs() - start;
+
+            RECSEG_Name(seg, seg->fileSeg[i], name, 0);
+            if (seg->done != NULL)
+                seg->done(seg->chanNum, name, status);
+
+            pthread_mutex_lock(&(seg->lock));
+            seg->closed++;
+            if (status != 0)
+                seg->failed++;
+            seg->bytesWritten += seg->file[i].bytesWritten;
+            seg->writeCalls   += seg->file[i].writeCalls;
+            if (closeNs > seg->maxCloseNs)
+                seg->maxCloseNs = closeNs;
+            seg->state[i] = RECSEG_FREE;
+            pthread_cond_broadcast(&(seg->changed));
+            continue;
+        }
+
+        if (seg->stop)
+            break;
+
+        /* open a segment ahead, unless it is past the end of the run */
+        for (i = 0; i < RECSEG_FILES; i++)
+        {
+            if (seg->state[i] == RECSEG_FREE)
+                break;
+        }
+        if ((i < RECSEG_FILES) && !seg->openFailed &&
+            ((seg->numPris == 0) ||
+             ((unsigned long long)seg->nextSeg * seg->segPris < seg->numPris)))
+        {
+            segment = seg->nextSeg;
+            pthread_mutex_unlock(&(seg->lock));
+
+            status = RECSEG_OpenFile(seg, i, segment);
+
+            pthread_mutex_lock(&(seg->lock));
+            if (status != 0)
+            {
+                seg->openFailed = 1;
+                seg->failed++;
+            }
+            else
+            {
+                seg->state[i] = RECSEG_READY;
+                seg->nextSeg++;
+            }
+            pthread_cond_broadcast(&(seg->changed));
+            continue;
+        }
+
+        pthread_cond_wait(&(seg->changed), &(seg->lock));
+    }
+
+    /* the writer is gone; nothing else touches the files now */
+    pthread_mutex_unlock(&(seg->lock));
+
+    for (i = 0; i < RECSEG_FILES; i++)
+    {
+        if (seg->state[i] != RECSEG_READY)
+            continue;
+        RECFILE_Close(&(seg->file[i]));
+        RECSEG_Name(seg, seg->fileSeg[i], name, 1);
+        unlink(name);
+        seg->state[i] = RECSEG_FREE;
+    }
+
+    return (NULL);
+}
+
+
+/**************************************************************************
+ Function:    RECSEG_Ready()
+
+ Description: Finds the file holding the earliest segment opened ahead.
+              Call with the lock held.
+
+ Parameters:  seg - pointer to the REC_SEG
+
+ Return:      index of the file, or RECSEG_FILES if none is ready
+**************************************************************************/
+static unsigned int RECSEG_Ready (REC_SEG *seg)
+{
+    unsigned int ready = RECSEG_FILES;
+    unsigned int i;
+
+    for (i = 0; i < RECSEG_FILES; i++)
+    {
+        if ((seg->state[i] == RECSEG_READY) &&
+            ((ready == RECSEG_FILES) || (seg->fileSeg[i] < seg->fileSeg[ready])))
+            ready = i;
+    }
+
+    return (ready);
+}
+
+
+/**************************************************************************
+ Function:    RECSEG_OpenFile()
+
+ Description: Opens a segment file, preallocated for its PRIs, and writes
+              its nxrec header.
+
+ Parameters:  seg     - pointer to the REC_SEG
+              i       - file to open it in
+              segment - segment number
+
+ Return:      0 - success
+              1 - the file failed to open, or the header to write
+**************************************************************************/
+static int RECSEG_OpenFile (REC_SEG *seg, unsigned int i, unsigned int segment)
+{
+    char                path[2 * RECSEG_PATH_LEN];
+    unsigned long long  firstPri    = (unsigned long long)segment * seg->segPris;
+    unsigned long long  lines       = seg->segPris;
+    unsigned int        headerBytes = 0;
+
+    /* the last segment of a run of known length may be short */
+    if ((seg->numPris != 0) && (seg->numPris - firstPri < lines))
+        lines = seg->numPris - firstPri;
+
+    RECSEG_Name(seg, segment, path, 1);
+
+    if (seg->nxrec)
+    {
+        seg->fields.segment     = segment;
+        seg->fields.segmentPris = (uint32_t)seg->segPris;
+        seg->fields.firstPri    = firstPri;
+        headerBytes = NXREC_BuildHeader(seg->header, &(seg->fields),
+                                        seg->iniFile);
+    }
+
+    if (RECFILE_Open(&(seg->file[i]), path, seg->backend, seg->batchLines,
+                     seg->asyncDepth,
+                     headerBytes + (lines * seg->recordBytes)) != 0)
+        return (1);
+
+    if (seg->nxrec &&
+        (RECFILE_WriteHeader(&(seg->file[i]), seg->header, headerBytes) != 0))
+    {
+        RECFILE_Close(&(seg->file[i]));
+        unlink(path);
+        return (1);
+    }
+
+    seg->fileSeg[i] = segment;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RECSEG_Name()
+
+ Description: Builds a segment's file name, <baseName>_<segment>.dat.
+
+ Parameters:  seg      - pointer to the REC_SEG
+              segment  - segment number
+              buf      - receives the name, 2 * RECSEG_PATH_LEN bytes
+              fullPath - 1 to put the directory in front of it
+
+ Return:      none
+**************************************************************************/
+static void RECSEG_Name (REC_SEG      *seg,
+                         unsigned int  segment,
+                         char         *buf,
+                         int           fullPath)
+{
+    if (fullPath)
+        sprintf(buf, "%s/%s_%05u.dat", seg->dir, seg->baseName, segment);
+    else
+        sprintf(buf, "%s_%05u.dat", seg->baseName, segment);
+}
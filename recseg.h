@@ -0,0 +1,174 @@
+/***********************************************************************
+*
+*   File: recseg.h
+*
+*   Description: header file for recseg.c, segmented recording: a
+*                channel's range lines split over a series of files of a
+*                fixed number of PRIs each instead of one adcN.dat.
+*
+*                Set from NeXtRAD.ini:
+*                    SEGMENT_PRIS    - PRIs per segment
+*                    SEGMENT_MB      - largest segment size, in MB
+*                    SEGMENT_SECONDS - largest segment duration (needs
+*                                      PRI_NS)
+*                The smallest of those that are set wins.
+*
+*                Segment k of channel c is adc<c>_<k>.dat, k counted from
+*                0 and written with five digits, and holds PRIs
+*                k * segPris to (k + 1) * segPris - 1.  With
+*                RECORD_FORMAT = 1 each segment is a complete nxrec file,
+*                with its own header, index and trailer; the header's
+*                firstPri and segment say where it sits in the run.
+*
+*                A finisher thread per channel keeps the channel writer
+*                (dmaring.c) away from everything but its own appends.  It
+*                opens segments, writes their headers and preallocates
+*                them before the writer gets there, and once the writer has
+*                moved on it closes the finished segment (draining the
+*                async backend, or cutting back and unmapping the mmap
+*                one) and passes it to a done callback, which queues it
+*                for the mover.  The writer therefore only waits for the
+*                finisher if segments are filled faster than they can be
+*                closed and opened.
+*
+************************************************************************/
+
+#ifndef __RECSEG_H__
+#define __RECSEG_H__
+
+#include <pthread.h>
+
+#include "recfile.h"
+#include "nxrec.h"
+
+
+/* RECSEG_PATH_LEN - longest directory or segment path handled;
+ * RECSEG_FILES - segment files in rotation: the one being written and
+ *                the next ones, opened ahead
+ */
+#define RECSEG_PATH_LEN      256
+#define RECSEG_FILES         3
+
+/* segment file states:
+ *     RECSEG_FREE    - not open
+ *     RECSEG_READY   - opened ahead, waiting for the writer
+ *     RECSEG_ACTIVE  - being written
+ *     RECSEG_DONE    - finished by the writer, waiting to be closed
+ */
+#define RECSEG_FREE          0
+#define RECSEG_READY         1
+#define RECSEG_ACTIVE        2
+#define RECSEG_DONE          3
+
+
+/* RECSEG_DONE_FN - called on the finisher thread for each segment closed,
+ * with the channel, the segment's file name relative to the recording
+ * directory, and nonzero if the segment failed to open, write or close
+ */
+typedef void (*RECSEG_DONE_FN) (int chanNum, const char *fileName, int failed);
+
+
+/* REC_SEG - segmented output of one channel
+ *
+ *   set up by RECSEG_Open():
+ *     chanNum      = ADC channel number
+ *     dir          = directory the segments are recorded into
+ *     baseName     = file name stem, e.g. "adc0"
+ *     backend      = REC_FILE_* output backend of every segment
+ *     batchLines   = range lines per batch (RECFILE_Open())
+ *     asyncDepth   = async backend staging buffers (RECFILE_Open())
+ *     segPris      = PRIs per segment
+ *     numPris      = PRIs in the run, 0 = until stopped
+ *     recordBytes  = bytes per record, for preallocation; the unpacked
+ *                    size for packed lines
+ *     fields       = nxrec header fields for every segment
+ *     nxrec        = 1 if the segments are nxrec files, 0 if raw
+ *     iniFile      = NeXtRAD.ini recorded in each header
+ *     header       = header being built, NXREC_MAX_HEADER bytes
+ *     done         = callback for each closed segment, or NULL
+ *
+ *   shared with the finisher, under lock:
+ *     changed      = signalled when a file changes state or stop is set
+ *     file         = segment files in rotation
+ *     fileSeg      = segment number held by each file
+ *     state        = RECSEG_FREE, _READY, _ACTIVE or _DONE for each file
+ *     cur          = file being written
+ *     nextSeg      = segment the finisher opens next
+ *     openFailed   = a segment could not be opened ahead; no more are
+ *                    tried
+ *     stop         = set by RECSEG_Close(); the finisher closes what is
+ *                    left and exits
+ *
+ *   statistics:
+ *     closed       = segments closed
+ *     failed       = segments that failed to open, write or close
+ *     bytesWritten = bytes written to the closed segments
+ *     writeCalls   = write calls made for them
+ *     maxCloseNs   = longest time taken to close a segment, in ns
+ *     waits        = times the writer found the next segment not ready
+ *     maxWaitNs    = longest such wait, in ns
+ *     stoppedAt    = first PRI written past the end of a segment because
+ *                    the next could not be opened, or 0
+ *     finisher     = finisher thread
+ */
+typedef struct REC_SEG
+        {
+            int                 chanNum;
+            char                dir[RECSEG_PATH_LEN];
+            char                baseName[64];
+            int                 backend;
+            unsigned int        batchLines;
+            unsigned int        asyncDepth;
+            unsigned long long  segPris;
+            unsigned long long  numPris;
+            unsigned int        recordBytes;
+            NXREC_HEADER        fields;
+            int                 nxrec;
+            const char         *iniFile;
+            void               *header;
+            RECSEG_DONE_FN      done;
+
+            pthread_mutex_t     lock;
+            pthread_cond_t      changed;
+            REC_FILE            file[RECSEG_FILES];
+            unsigned int        fileSeg[RECSEG_FILES];
+            int                 state[RECSEG_FILES];
+            unsigned int        cur;
+            unsigned int        nextSeg;
+            int                 openFailed;
+            int                 stop;
+
+            unsigned long       closed;
+            unsigned long       failed;
+            unsigned long long  bytesWritten;
+            unsigned long       writeCalls;
+            unsigned long long  maxCloseNs;
+            unsigned long       waits;
+            unsigned long long  maxWaitNs;
+            unsigned long long  stoppedAt;
+            pthread_t           finisher;
+        } REC_SEG;
+
+
+/* function prototypes */
+int       RECSEG_Open    (REC_SEG            *seg,
+                          int                 chanNum,
+                          const char         *dir,
+                          const char         *baseName,
+                          int                 backend,
+                          unsigned int        batchLines,
+                          unsigned int        asyncDepth,
+                          unsigned long long  segPris,
+                          unsigned long long  numPris,
+                          unsigned int        recordBytes,
+                          const NXREC_HEADER *fields,
+                          const char         *iniFile,
+                          RECSEG_DONE_FN      done);
+REC_FILE *RECSEG_File    (REC_SEG            *seg);
+REC_FILE *RECSEG_Next    (REC_SEG            *seg,
+                          unsigned long long  pri);
+REC_FILE *RECSEG_Switch  (REC_SEG            *seg);
+int       RECSEG_Close   (REC_SEG            *seg);
+void      RECSEG_Report  (REC_SEG            *seg);
+
+#endif /* __RECSEG_H__ */
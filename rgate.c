@@ -0,0 +1,158 @@
+/**************************************************************************
+*
+*   File: rgate.c
+*
+*   Description: Range-gated recording.  See rgate.h.
+*
+*                The windows are checked once, when NeXtRAD.ini is read,
+*                so the gather itself is only the copies: memcpy() moves
+*                each window with the widest loads and stores the CPU has,
+*                and the windows of a line are in increasing order, so the
+*                DMA buffer is read front to back.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rgate.h"
+
+
+/**************************************************************************
+ Function:    RGATE_Parse()
+
+ Description: Reads a channel's range windows from NeXtRAD.ini text: a
+              comma separated list of inclusive bin ranges, e.g.
+              "1000-1999, 3000-3499".  A single bin may be given on its
+              own.
+
+ Parameters:  gate        - pointer to the RANGE_GATE to set up
+              text        - text to parse; empty for the whole line
+              lineSamples - complex samples in the DMA line
+
+ Return:      0 - success
+              1 - the text is malformed or has too many windows
+              2 - a window runs past the end of the line, or the windows
+                  are not in increasing order without overlap
+**************************************************************************/
+int RGATE_Parse (RANGE_GATE *gate, const char *text, unsigned int lineSamples)
+{
+    const char    *p = text;
+    char          *end;
+    unsigned long  first;
+    unsigned long  last;
+    unsigned long  nextBin = 0;
+    unsigned int   i;
+
+    memset (gate, 0, sizeof(RANGE_GATE));
+    gate->lineSamples = lineSamples;
+    gate->samples     = lineSamples;
+
+    while (*p != '\0')
+    {
+        while ((*p == ' ') || (*p == '\t') || (*p == ','))
+            p++;
+        if (*p == '\0')
+            break;
+
+        if ((*p < '0') || (*p > '9'))
+            return (1);
+        first = strtoul(p, &end, 10);
+        p     = end;
+        last  = first;
+
+        while ((*p == ' ') || (*p == '\t'))
+            p++;
+        if (*p == '-')
+        {
+            p++;
+            while ((*p == ' ') || (*p == '\t'))
+                p++;
+            if ((*p < '0') || (*p > '9'))
+                return (1);
+            last = strtoul(p, &end, 10);
+            p    = end;
+        }
+
+        if ((*p != '\0') && (*p != ',') && (*p != ' ') && (*p != '\t'))
+            return (1);
+        if (gate->numWindows >= RGATE_MAX_WINDOWS)
+            return (1);
+        if ((last < first) || (first < nextBin) || (last >= lineSamples))
+            return (2);
+
+        gate->window[gate->numWindows].firstBin = (uint32_t)first;
+        gate->window[gate->numWindows].numBins  = (uint32_t)(last - first + 1);
+        gate->numWindows++;
+        nextBin = last + 1;
+    }
+
+    if (gate->numWindows != 0)
+    {
+        gate->samples = 0;
+        for (i = 0; i < gate->numWindows; i++)
+            gate->samples += gate->window[i].numBins;
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RGATE_Gather()
+
+ Description: Copies the windows of one range line, back to back.
+
+ Parameters:  gate - pointer to a RANGE_GATE with windows
+              line - the DMA line: interleaved I, Q, gate->lineSamples long
+              out  - receives gate->samples I/Q pairs
+
+ Return:      none
+**************************************************************************/
+void RGATE_Gather (const RANGE_GATE *gate, const int16_t *line, int16_t *out)
+{
+    const NXREC_GATE *w;
+    unsigned int      i;
+
+    for (i = 0; i < gate->numWindows; i++)
+    {
+        w = &(gate->window[i]);
+        memcpy (out, line + (2 * (size_t)w->firstBin),
+                (size_t)w->numBins * 2 * sizeof(int16_t));
+        out += 2 * (size_t)w->numBins;
+    }
+}
+
+
+/**************************************************************************
+ Function:    RGATE_Report()
+
+ Description: Prints a channel's range windows, the share of each line
+              they keep and the gather rate.
+
+ Parameters:  gate    - pointer to the RANGE_GATE
+              chanNum - ADC channel number
+
+ Return:      none
+**************************************************************************/
+void RGATE_Report (const RANGE_GATE *gate, int chanNum)
+{
+    unsigned int i;
+
+    if (gate->numWindows == 0)
+        return;
+
+    printf("[dmaThread %d] gate: %u window(s):", chanNum+1, gate->numWindows);
+    for (i = 0; i < gate->numWindows; i++)
+        printf(" %u-%u", gate->window[i].firstBin,
+               gate->window[i].firstBin + gate->window[i].numBins - 1);
+    printf(", %u of %u samples per line (%.1f%%)\n", gate->samples,
+           gate->lineSamples, (100.0 * gate->samples) / gate->lineSamples);
+
+    if (gate->gatherNs != 0)
+        printf("[dmaThread %d] gate: %llu lines gathered at %.1f MB/s\n",
+               chanNum+1, gate->lines,
+               ((double)gate->lines * gate->samples * 2 * sizeof(int16_t)) /
+               ((double)gate->gatherNs / 1e9) / 1e6);
+}
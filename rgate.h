@@ -0,0 +1,88 @@
+/***********************************************************************
+*
+*   File: rgate.h
+*
+*   Description: header file for rgate.c, range-gated recording: only
+*                chosen windows of range bins are kept from each range
+*                line, instead of all SAMPLES_PER_PRI samples.
+*
+*                Set from NeXtRAD.ini, one key per channel:
+*                    RANGE_GATES0 - windows kept from adc0's lines, e.g.
+*                                   "1000-1999, 3000-3499"
+*                    RANGE_GATES1 ... RANGE_GATES3 likewise
+*
+*                A window is an inclusive range of bins, counted from 0 at
+*                the first sample of the DMA line.  Up to RGATE_MAX_WINDOWS
+*                windows are allowed per channel, in increasing order and
+*                not overlapping.  A channel with no windows keeps its
+*                whole line.
+*
+*                The kept samples are the windows back to back, so a gated
+*                line is simply a shorter line: compression, block
+*                floating point and every reader work on it unchanged.
+*                The windows are recorded in the nxrec header (numGates,
+*                gate[]) so that sample n of a line can be put back at its
+*                range bin.
+*
+*                Every window is a contiguous run of I/Q pairs in the DMA
+*                buffer, so the gather is one block copy per window.  A
+*                single window needs no copy at all; the writer writes it
+*                straight from the DMA buffer.
+*
+************************************************************************/
+
+#ifndef __RGATE_H__
+#define __RGATE_H__
+
+#include <stdint.h>
+
+#include "nxrec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* RGATE_MAX_WINDOWS - windows per channel; as many as an nxrec header
+ * records
+ */
+#define RGATE_MAX_WINDOWS    NXREC_MAX_GATES
+
+
+/* RANGE_GATE - range windows kept from one channel's lines
+ *     numWindows  = windows in use, 0 = the whole line is kept
+ *     window      = first bin and number of bins of each window
+ *     lineSamples = complex samples in the DMA line
+ *     samples     = complex samples kept per line
+ *
+ *   statistics:
+ *     lines       = lines gathered
+ *     gatherNs    = time spent gathering them, in ns (kept by the caller)
+ */
+typedef struct RANGE_GATE
+        {
+            unsigned int        numWindows;
+            NXREC_GATE          window[RGATE_MAX_WINDOWS];
+            unsigned int        lineSamples;
+            unsigned int        samples;
+
+            unsigned long long  lines;
+            unsigned long long  gatherNs;
+        } RANGE_GATE;
+
+
+/* function prototypes */
+int  RGATE_Parse   (RANGE_GATE        *gate,
+                    const char        *text,
+                    unsigned int       lineSamples);
+void RGATE_Gather  (const RANGE_GATE  *gate,
+                    const int16_t     *line,
+                    int16_t           *out);
+void RGATE_Report  (const RANGE_GATE  *gate,
+                    int                chanNum);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RGATE_H__ */
@@ -0,0 +1,276 @@
+/**************************************************************************
+*
+*   File: rtsched.c
+*
+*   Description: Real-time scheduling, CPU pinning and memory locking.
+*                See rtsched.h.
+*
+*                Memory is locked with MCL_ONFAULT where the C library
+*                has it.  Pages are then locked as they are first touched,
+*                rather than the whole address space being faulted in at
+*                once.  Each buffer the acquisition path uses is touched
+*                before the trigger is armed: the DMA buffers by their
+*                fill, the async staging buffers by recfile.c, and the
+*                thread stacks by RTSCHED_PrefaultStack().  The mmap
+*                output backend unlocks its file mapping, which is far
+*                larger than memory is meant to hold.
+*
+**************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "rtsched.h"
+
+
+/* JITTER_PROBE - arguments and result of one jitter probe run */
+typedef struct JITTER_PROBE
+        {
+            int             priority;
+            int             cpu;
+            unsigned int    loops;
+            unsigned int    periodUs;
+            LAT_HIST       *hist;
+            int             status;
+        } JITTER_PROBE;
+
+
+static void *RTSCHED_JitterThread (void *pParams);
+
+
+/**************************************************************************
+ Function:    RTSCHED_SetThread()
+
+ Description: Sets a thread's scheduling and CPU affinity.  Either may be
+              left unchanged.
+
+ Parameters:  thread   - thread to change
+              priority - SCHED_FIFO priority (1 to 99), or 0 to leave the
+                         scheduling policy alone
+              cpu      - CPU to pin the thread to, or -1 for no pinning
+
+ Return:      0 - success
+              1 - SCHED_FIFO could not be set (needs CAP_SYS_NICE)
+              2 - affinity could not be set
+**************************************************************************/
+int RTSCHED_SetThread (pthread_t thread, int priority, int cpu)
+{
+    struct sched_param param;
+    cpu_set_t          cpuSet;
+
+    if (cpu >= 0)
+    {
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu, &cpuSet);
+        if (pthread_setaffinity_np(thread, sizeof(cpuSet), &cpuSet) != 0)
+            return (2);
+    }
+
+    if (priority > 0)
+    {
+        memset (&param, 0, sizeof(param));
+        param.sched_priority = priority;
+        if (pthread_setschedparam(thread, SCHED_FIFO, &param) != 0)
+            return (1);
+    }
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    RTSCHED_ParseCpuList()
+
+ Description: Parses a comma separated list of CPU numbers, e.g. "2,3,4,5".
+
+ Parameters:  list    - text to parse; empty for no CPUs
+              cpus    - receives the CPU numbers
+              maxCpus - size of cpus
+
+ Return:      number of CPUs parsed, or -1 if the list is malformed
+**************************************************************************/
+int RTSCHED_ParseCpuList (const char *list, int *cpus, int maxCpus)
+{
+    const char *p = list;
+    char       *end;
+    long        cpu;
+    int         count = 0;
+
+    while (*p != '\0')
+    {
+        while ((*p == ' ') || (*p == ','))
+            p++;
+        if (*p == '\0')
+            break;
+
+        cpu = strtol(p, &end, 10);
+        if ((end == p) || (cpu < 0) || (cpu >= CPU_SETSIZE) ||
+            (count >= maxCpus))
+            return (-1);
+
+        cpus[count++] = (int)cpu;
+        p = end;
+    }
+
+    return (count);
+}
+
+
+/**************************************************************************
+ Function:    RTSCHED_LockMemory()
+
+ Description: Locks the process's current and future pages in memory so
+              the acquisition path never takes a major page fault.
+
+ Parameters:  none
+
+ Return:      0 - success
+              1 - mlockall() failed (needs CAP_IPC_LOCK or a large enough
+                  RLIMIT_MEMLOCK)
+**************************************************************************/
+int RTSCHED_LockMemory (void)
+{
+    int flags = MCL_CURRENT | MCL_FUTURE;
+
+#ifdef MCL_ONFAULT
+    flags |= MCL_ONFAULT;
+#endif
+
+    return ((mlockall(flags) != 0) ? 1 : 0);
+}
+
+
+/**************************************************************************
+ Function:    RTSCHED_PrefaultStack()
+
+ Description: Touches RTSCHED_STACK_PREFAULT bytes of the calling thread's
+              stack so later calls do not fault it in.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+void RTSCHED_PrefaultStack (void)
+{
+    volatile unsigned char stack[RTSCHED_STACK_PREFAULT];
+    size_t                 i;
+
+    for (i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
+}
+
+
+/**************************************************************************
+ Function:    RTSCHED_Prefault()
+
+ Description: Touches every page of a buffer, without changing its
+              contents.
+
+ Parameters:  buf - start of the buffer
+              len - length in bytes
+
+ Return:      none
+**************************************************************************/
+void RTSCHED_Prefault (void *buf, size_t len)
+{
+    volatile unsigned char *p    = (volatile unsigned char *)buf;
+    size_t                  page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t                  i;
+
+    for (i = 0; i < len; i += page)
+        p[i] = p[i];
+}
+
+
+/**************************************************************************
+ Function:    RTSCHED_JitterProbe()
+
+ Description: Runs a periodic thread with the given scheduling and records
+              how late each wake-up is relative to its absolute deadline.
+
+ Parameters:  priority - SCHED_FIFO priority, or 0 for default scheduling
+              cpu      - CPU to pin the probe to, or -1
+              loops    - number of wake-ups
+              periodUs - period in us
+              hist     - histogram to record the lateness into
+
+ Return:      0 - success
+              1 - scheduling could not be applied (the probe still ran)
+              2 - probe thread could not be started
+**************************************************************************/
+int RTSCHED_JitterProbe (int           priority,
+                         int           cpu,
+                         unsigned int  loops,
+                         unsigned int  periodUs,
+                         LAT_HIST     *hist)
+{
+    JITTER_PROBE probe;
+    pthread_t    thread;
+
+    probe.priority = priority;
+    probe.cpu      = cpu;
+    probe.loops    = loops;
+    probe.periodUs = periodUs;
+    probe.hist     = hist;
+    probe.status   = 0;
+
+    if (pthread_create(&thread, NULL, RTSCHED_JitterThread, &probe) != 0)
+        return (2);
+    pthread_join(thread, NULL);
+
+    return (probe.status);
+}
+
+
+/**************************************************************************
+ Function:    RTSCHED_JitterThread()
+
+ Description: Jitter probe thread.  Applies the probe's scheduling, then
+              sleeps to each deadline with clock_nanosleep(TIMER_ABSTIME)
+              and records the lateness of the wake-up.
+
+ Parameters:  pParams - pointer to the JITTER_PROBE
+
+ Return:      NULL
+**************************************************************************/
+static void *RTSCHED_JitterThread (void *pParams)
+{
+    JITTER_PROBE       *probe = (JITTER_PROBE *)pParams;
+    struct timespec     deadline;
+    struct timespec     now;
+    long long           late;
+    unsigned int        i;
+
+    if (RTSCHED_SetThread(pthread_self(), probe->priority, probe->cpu) != 0)
+        probe->status = 1;
+
+    RTSCHED_PrefaultStack();
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    for (i = 0; i < probe->loops; i++)
+    {
+        deadline.tv_nsec += probe->periodUs * 1000L;
+        while (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_nsec -= 1000000000L;
+            deadline.tv_sec++;
+        }
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        late = ((long long)(now.tv_sec - deadline.tv_sec) * 1000000000LL) +
+               (now.tv_nsec - deadline.tv_nsec);
+        LATHIST_Record(probe->hist, (late > 0) ? (unsigned long long)late : 0);
+    }
+
+    return (NULL);
+}
@@ -0,0 +1,55 @@
+/***********************************************************************
+*
+*   File: rtsched.h
+*
+*   Description: header file for rtsched.c, real-time scheduling, CPU
+*                pinning and memory locking for the recorder threads.
+*
+*                Set from NeXtRAD.ini:
+*                    RT_PRIORITY - SCHED_FIFO priority of each dmaThread()
+*                    ACQ_CPUS    - CPU for each channel's dmaThread()
+*                    WRITER_CPUS - CPUs for the channel writer threads
+*                    LOCK_MEMORY - mlockall() the process
+*                    JITTER_TEST - run the wake-up jitter probe at startup
+*
+*                The jitter probe is a periodic thread that sleeps to
+*                absolute deadlines and histograms how late each wake-up
+*                is.  It is run once with default scheduling and once
+*                with the acquisition settings, to show what the RT
+*                settings buy on the machine in use.
+*
+************************************************************************/
+
+#ifndef __RTSCHED_H__
+#define __RTSCHED_H__
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "lathist.h"
+
+
+/* RTSCHED_STACK_PREFAULT - bytes of stack touched by
+ * RTSCHED_PrefaultStack(), enough for the deepest acquisition call chain
+ */
+#define RTSCHED_STACK_PREFAULT   (256 * 1024)
+
+
+/* function prototypes */
+int  RTSCHED_SetThread     (pthread_t      thread,
+                            int            priority,
+                            int            cpu);
+int  RTSCHED_ParseCpuList  (const char    *list,
+                            int           *cpus,
+                            int            maxCpus);
+int  RTSCHED_LockMemory    (void);
+void RTSCHED_PrefaultStack (void);
+void RTSCHED_Prefault      (void          *buf,
+                            size_t         len);
+int  RTSCHED_JitterProbe   (int            priority,
+                            int            cpu,
+                            unsigned int   loops,
+                            unsigned int   periodUs,
+                            LAT_HIST      *hist);
+
+#endif /* __RTSCHED_H__ */
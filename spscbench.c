@@ -0,0 +1,301 @@
+/**************************************************************************
+*
+*   File: spscbench.c
+*
+*   Description: Micro-benchmark of the SPSC range line queue (spscq.h),
+*                away from the radar and the disk.
+*
+*                Three runs are made over a ring of DMA-sized buffers of
+*                4096-sample range lines (or -s samples):
+*
+*                    push/pop   - one thread pushes and pops in turn: the
+*                                 bare cost of the two calls
+*                    throughput - a producer thread pushes as fast as the
+*                                 queue takes lines, a consumer thread
+*                                 pops them and copies each line out, as
+*                                 the writer does
+*                    latency    - the producer pushes at a set line rate
+*                                 (-r), like the DMA interrupts, and the
+*                                 consumer histograms push-to-pop time
+*
+*                Usage:
+*                    spscbench [options]
+*                    -n lines   lines per threaded run (1000000)
+*                    -s samples samples per range line (4096)
+*                    -r rate    lines/s of the latency run (20000)
+*                    -P cpu     CPU for the producer (not pinned)
+*                    -C cpu     CPU for the consumer (not pinned)
+*                    -q         consumer pops only, without copying lines
+*
+*                Pin the two threads to separate cores for numbers that
+*                mean anything; on a single core the threaded runs
+*                measure the scheduler.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "spscq.h"
+#include "lathist.h"
+#include "rtsched.h"
+#include "dmaring.h"
+
+
+/* SPSCBENCH_BUFS - buffers in the line ring, as a full DMA ring */
+#define SPSCBENCH_BUFS       MAX_DMA_BUFS
+
+
+/* SPSC_BENCH - one threaded run
+ *     q        = the queue under test
+ *     bufs     = SPSCBENCH_BUFS range lines
+ *     copy     = line the consumer copies each range line into, or NULL
+ *     lineBytes = bytes per range line
+ *     lines    = lines to pass through the queue
+ *     periodNs = time between pushes, or 0 to push as fast as possible
+ *     cpu      = producer's and consumer's CPU, or -1
+ *     full     = times the producer found the queue full and spun
+ *     hist     = push-to-pop time of each line
+ */
+typedef struct SPSC_BENCH
+        {
+            SPSC_QUEUE          q;
+            void               *bufs[SPSCBENCH_BUFS];
+            unsigned char      *copy;
+            unsigned int        lineBytes;
+            unsigned long       lines;
+            unsigned long long  periodNs;
+            int                 cpu[2];
+            unsigned long       full;
+            LAT_HIST            hist;
+        } SPSC_BENCH;
+
+
+static void  SPSCBENCH_Usage    (void);
+static double SPSCBENCH_Run     (SPSC_BENCH *bench);
+static void *SPSCBENCH_Consumer (void *pParams);
+
+
+/**************************************************************************
+ Function:    main()
+
+ Description: Sets up the line ring from the command line and runs the
+              three measurements.
+
+ Parameters:  argc, argv - see the usage above
+
+ Return:      0 - success
+              1 - bad command line or set up failed
+**************************************************************************/
+int main (int argc, char *argv[])
+{
+    static SPSC_BENCH   bench;
+    RANGE_LINE_DESC     desc;
+    unsigned long       lines    = 1000000;
+    unsigned int        samples  = 4096;
+    unsigned int        rate     = 20000;
+    int                 copyLine = 1;
+    unsigned long long  start;
+    unsigned long long  ns;
+    unsigned long       i;
+    double              secs;
+    int                 a;
+
+    bench.cpu[0] = -1;
+    bench.cpu[1] = -1;
+    for (a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "-n") == 0) && (a + 1 < argc))
+            lines = strtoul(argv[++a], NULL, 10);
+        else if ((strcmp(argv[a], "-s") == 0) && (a + 1 < argc))
+            samples = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-r") == 0) && (a + 1 < argc))
+            rate = (unsigned int)atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-P") == 0) && (a + 1 < argc))
+            bench.cpu[0] = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "-C") == 0) && (a + 1 < argc))
+            bench.cpu[1] = atoi(argv[++a]);
+        else if (strcmp(argv[a], "-q") == 0)
+            copyLine = 0;
+        else
+        {
+            SPSCBENCH_Usage();
+            return (1);
+        }
+    }
+    if ((lines == 0) || (samples == 0) || (rate == 0))
+    {
+        SPSCBENCH_Usage();
+        return (1);
+    }
+
+    /* the lines are touched here so that no run pays for page faults */
+    bench.lineBytes = samples * 4;
+    for (i = 0; i < SPSCBENCH_BUFS; i++)
+    {
+        bench.bufs[i] = malloc(bench.lineBytes);
+        if (bench.bufs[i] == NULL)
+            return (1);
+        memset (bench.bufs[i], (int)i, bench.lineBytes);
+    }
+    if (copyLine)
+    {
+        bench.copy = (unsigned char *)malloc(bench.lineBytes);
+        if (bench.copy == NULL)
+            return (1);
+        memset (bench.copy, 0, bench.lineBytes);
+    }
+    printf("SPSC queue: %d slots, %u-sample lines (%u bytes), %d buffers\n",
+           SPSCQ_SIZE, samples, bench.lineBytes, SPSCBENCH_BUFS);
+
+    /* the bare calls, on one thread; the slots stay in the cache */
+    SPSCQ_Init(&bench.q);
+    memset (&desc, 0, sizeof(desc));
+    start = DMARING_TimeNs();
+    for (i = 0; i < 10 * lines; i++)
+    {
+        desc.bufIndex = (unsigned int)(i % SPSCBENCH_BUFS);
+        desc.buf      = bench.bufs[desc.bufIndex];
+        desc.priIndex = i;
+        SPSCQ_Push(&bench.q, &desc);
+        SPSCQ_Pop(&bench.q, &desc);
+    }
+    ns = DMARING_TimeNs() - start;
+    printf("push/pop    %.1f ns per pair, one thread\n", (double)ns / (10 * lines));
+
+    bench.lines    = lines;
+    bench.periodNs = 0;
+    secs = SPSCBENCH_Run(&bench);
+    if (secs < 0.0)
+        return (1);
+    printf("throughput  %lu lines in %.3f s: %.0f lines/s, %.2f GB/s of lines, "
+           "queue full %lu times\n", lines, secs, lines / secs,
+           (lines / secs) * bench.lineBytes / 1e9, bench.full);
+    LATHIST_Print(&bench.hist, "throughput ");
+
+    bench.lines    = (unsigned long)rate * 2;
+    if (bench.lines > lines)
+        bench.lines = lines;
+    bench.periodNs = 1000000000ULL / rate;
+    secs = SPSCBENCH_Run(&bench);
+    if (secs < 0.0)
+        return (1);
+    printf("latency     %lu lines at %u lines/s, queue full %lu times\n",
+           bench.lines, rate, bench.full);
+    LATHIST_Print(&bench.hist, "latency    ");
+
+    for (i = 0; i < SPSCBENCH_BUFS; i++)
+        free(bench.bufs[i]);
+    free(bench.copy);
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    SPSCBENCH_Run()
+
+ Description: Passes bench->lines lines from this thread, as producer, to
+              a consumer thread.  Each push is stamped; if the queue is
+              full the producer spins until there is room, as a
+              consumer that keeps up never lets happen in the recorder.
+
+ Parameters:  bench - run settings; receives the results
+
+ Return:      seconds from the first push to the consumer's last pop, or
+              -1.0 if the consumer thread could not be started
+**************************************************************************/
+static double SPSCBENCH_Run (SPSC_BENCH *bench)
+{
+    RANGE_LINE_DESC     desc;
+    pthread_t           consumer;
+    unsigned long long  start;
+    unsigned long long  next;
+    unsigned long       i;
+
+    SPSCQ_Init(&bench->q);
+    LATHIST_Init(&bench->hist, "push to pop");
+    bench->full = 0;
+
+    if (pthread_create(&consumer, NULL, SPSCBENCH_Consumer, bench) != 0)
+    {
+        printf("ERROR: consumer thread could not be started.\n");
+        return (-1.0);
+    }
+    if (RTSCHED_SetThread(consumer, 0, bench->cpu[1]) != 0)
+        printf("Warning: consumer not pinned to CPU %d\n", bench->cpu[1]);
+    if (RTSCHED_SetThread(pthread_self(), 0, bench->cpu[0]) != 0)
+        printf("Warning: producer not pinned to CPU %d\n", bench->cpu[0]);
+
+    memset (&desc, 0, sizeof(desc));
+    start = DMARING_TimeNs();
+    next  = start;
+    for (i = 0; i < bench->lines; i++)
+    {
+        if (bench->periodNs != 0)
+        {
+            next += bench->periodNs;
+            while (DMARING_TimeNs() < next)
+                SPSCQ_CpuRelax();
+        }
+        desc.bufIndex  = (unsigned int)(i % SPSCBENCH_BUFS);
+        desc.buf       = bench->bufs[desc.bufIndex];
+        desc.priIndex  = i;
+        desc.timestamp = DMARING_TimeNs();
+        while (SPSCQ_Push(&bench->q, &desc) != 0)
+        {
+            bench->full++;
+            SPSCQ_CpuRelax();
+        }
+    }
+    pthread_join(consumer, NULL);
+
+    return ((double)(DMARING_TimeNs() - start) / 1e9);
+}
+
+
+/**************************************************************************
+ Function:    SPSCBENCH_Consumer()
+
+ Description: Consumer thread: pops bench->lines lines, histograms the
+              time since each was pushed and copies each line out.
+
+ Parameters:  pParams - pointer to the SPSC_BENCH
+
+ Return:      NULL
+**************************************************************************/
+static void *SPSCBENCH_Consumer (void *pParams)
+{
+    SPSC_BENCH         *bench = (SPSC_BENCH *)pParams;
+    RANGE_LINE_DESC     desc;
+    unsigned long       i;
+
+    for (i = 0; i < bench->lines; i++)
+    {
+        while (SPSCQ_Pop(&bench->q, &desc) != 0)
+            SPSCQ_CpuRelax();
+        LATHIST_Record(&bench->hist, DMARING_TimeNs() - desc.timestamp);
+        if (bench->copy != NULL)
+            memcpy (bench->copy, desc.buf, bench->lineBytes);
+    }
+
+    return (NULL);
+}
+
+
+/**************************************************************************
+ Function:    SPSCBENCH_Usage()
+
+ Description: Prints the command line.
+
+ Parameters:  none
+
+ Return:      none
+**************************************************************************/
+static void SPSCBENCH_Usage (void)
+{
+    printf("usage: spscbench [-n lines] [-s samples] [-r lines_per_s] [-P cpu] [-C cpu] [-q]\n");
+}
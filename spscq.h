@@ -0,0 +1,191 @@
+/***********************************************************************
+*
+*   File: spscq.h
+*
+*   Description: Lock-free single-producer/single-consumer queue of range
+*                line descriptors.
+*
+*                The acquisition thread publishes one RANGE_LINE_DESC per
+*                captured range line; a downstream stage (writer, viewer,
+*                processing) consumes them.  Neither side takes a lock or
+*                makes a system call, so consumers can never stall the
+*                interrupt-driven capture loop.  The producer's and the
+*                consumer's indices live on separate cache lines so the
+*                two threads do not false-share.
+*
+*                Each queue has exactly one producer thread and one
+*                consumer thread.  A stage that needs its own view of
+*                the stream gets its own queue.
+*
+************************************************************************/
+
+#ifndef __SPSCQ_H__
+#define __SPSCQ_H__
+
+/* Make this header file easier to include in C++ code */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* SPSCQ_CACHE_LINE - cache line size used to pad the queue indices */
+#define SPSCQ_CACHE_LINE   64
+
+/* SPSCQ_SIZE - number of descriptors per queue; must be a power of 2.
+ * It only needs to cover the DMA ring depth: a consumer more than a
+ * full ring behind is reading buffers that have already been refilled.
+ */
+#define SPSCQ_SIZE         128
+#define SPSCQ_MASK         (SPSCQ_SIZE - 1)
+
+
+/* RANGE_LINE_DESC - describes one captured range line
+ *     buf       = user-space address of the DMA buffer holding the line
+ *     bufIndex  = index of that buffer in the channel's DMA ring
+ *     chanNum   = ADC channel number
+ *     priIndex  = range line number since the start of the run
+ *     timestamp = CLOCK_MONOTONIC time the line was published, in ns
+ *     intrTime  = CLOCK_MONOTONIC time of the line's link-end interrupt,
+ *                 in ns (0 if not known)
+ *     adcFlags  = ADC interrupt flags sampled when the line was serviced
+ */
+typedef struct RANGE_LINE_DESC
+        {
+            void               *buf;
+            unsigned int        bufIndex;
+            int                 chanNum;
+            unsigned long long  priIndex;
+            unsigned long long  timestamp;
+            unsigned long long  intrTime;
+            unsigned int        adcFlags;
+        } RANGE_LINE_DESC;
+
+
+/* SPSC_QUEUE - queue storage and indices
+ *     head       = next slot the producer fills (producer-owned)
+ *     tailCache  = producer's last view of tail
+ *     tail       = next slot the consumer reads (consumer-owned)
+ *     headCache  = consumer's last view of head
+ *     slot       = descriptor storage
+ */
+typedef struct SPSC_QUEUE
+        {
+            unsigned long   head      __attribute__((aligned(SPSCQ_CACHE_LINE)));
+            unsigned long   tailCache;
+            unsigned long   tail      __attribute__((aligned(SPSCQ_CACHE_LINE)));
+            unsigned long   headCache;
+            RANGE_LINE_DESC slot[SPSCQ_SIZE] __attribute__((aligned(SPSCQ_CACHE_LINE)));
+        } SPSC_QUEUE;
+
+
+/* SPSCQ_CpuRelax() - hint to the CPU that the caller is spin-waiting */
+#if defined(__i386__) || defined(__x86_64__)
+#define SPSCQ_CpuRelax()   __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define SPSCQ_CpuRelax()   __asm__ __volatile__ ("yield" ::: "memory")
+#else
+#define SPSCQ_CpuRelax()   __asm__ __volatile__ ("" ::: "memory")
+#endif
+
+
+/**************************************************************************
+ Function:    SPSCQ_Init()
+
+ Description: Empties a queue.  Must not be called while either side is
+              using it.
+
+ Parameters:  q - pointer to the queue
+
+ Return:      none
+**************************************************************************/
+static inline void SPSCQ_Init (SPSC_QUEUE *q)
+{
+    q->head      = 0;
+    q->tailCache = 0;
+    q->tail      = 0;
+    q->headCache = 0;
+}
+
+
+/**************************************************************************
+ Function:    SPSCQ_Push()
+
+ Description: Appends a descriptor.  Producer side only.
+
+ Parameters:  q    - pointer to the queue
+              desc - descriptor to copy into the queue
+
+ Return:      0 - descriptor queued
+              1 - queue full, descriptor dropped
+**************************************************************************/
+static inline int SPSCQ_Push (SPSC_QUEUE *q, const RANGE_LINE_DESC *desc)
+{
+    unsigned long head = __atomic_load_n(&(q->head), __ATOMIC_RELAXED);
+
+    if ((head - q->tailCache) >= SPSCQ_SIZE)
+    {
+        q->tailCache = __atomic_load_n(&(q->tail), __ATOMIC_ACQUIRE);
+        if ((head - q->tailCache) >= SPSCQ_SIZE)
+            return (1);
+    }
+
+    q->slot[head & SPSCQ_MASK] = *desc;
+    __atomic_store_n(&(q->head), head + 1, __ATOMIC_RELEASE);
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    SPSCQ_Pop()
+
+ Description: Removes the oldest descriptor.  Consumer side only.
+
+ Parameters:  q    - pointer to the queue
+              desc - receives the descriptor
+
+ Return:      0 - descriptor returned
+              1 - queue empty
+**************************************************************************/
+static inline int SPSCQ_Pop (SPSC_QUEUE *q, RANGE_LINE_DESC *desc)
+{
+    unsigned long tail = __atomic_load_n(&(q->tail), __ATOMIC_RELAXED);
+
+    if (tail == q->headCache)
+    {
+        q->headCache = __atomic_load_n(&(q->head), __ATOMIC_ACQUIRE);
+        if (tail == q->headCache)
+            return (1);
+    }
+
+    *desc = q->slot[tail & SPSCQ_MASK];
+    __atomic_store_n(&(q->tail), tail + 1, __ATOMIC_RELEASE);
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    SPSCQ_Depth()
+
+ Description: Returns the number of queued descriptors.  Safe to call
+              from either side; the result is a snapshot.
+
+ Parameters:  q - pointer to the queue
+
+ Return:      number of descriptors waiting
+**************************************************************************/
+static inline unsigned long SPSCQ_Depth (SPSC_QUEUE *q)
+{
+    unsigned long tail = __atomic_load_n(&(q->tail), __ATOMIC_ACQUIRE);
+    unsigned long head = __atomic_load_n(&(q->head), __ATOMIC_ACQUIRE);
+
+    return (head - tail);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SPSCQ_H__ */
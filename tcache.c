@@ -0,0 +1,495 @@
+/**************************************************************************
+*
+*   File: tcache.c
+*
+*   Description: Store of the processing stages' set up tables, kept in
+*                files between runs.  See tcache.h.
+*
+*                A file is a TCACHE_HEADER then the table.  The header is
+*                64 bytes, so a mapped table starts 64 byte aligned, as
+*                malloc()ed ones are at least 16.
+*
+**************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "tcache.h"
+#include "dmaring.h"
+#include "win.h"
+
+
+/* TCACHE_MAGIC - first bytes of every table file */
+#define TCACHE_MAGIC         "NXTCACHE"
+
+
+/* TCACHE_HEADER - start of a table file
+ *     magic    = TCACHE_MAGIC
+ *     version  = TCACHE_VERSION of the code that wrote it
+ *     reserved = 0
+ *     key      = the table's key
+ *     bytes    = size of the table after the header
+ */
+typedef struct TCACHE_HEADER
+        {
+            char                magic[8];
+            uint32_t            version;
+            uint32_t            reserved[3];
+            TCACHE_KEY          key;
+            uint64_t            bytes;
+        } TCACHE_HEADER;
+
+
+static const void         *TCACHE_Load      (const char *path,
+                                             const TCACHE_KEY *key, size_t bytes,
+                                             void **map, size_t *mapBytes);
+static int                 TCACHE_Save      (const char *path,
+                                             const TCACHE_KEY *key,
+                                             const void *data, size_t bytes);
+static int                 TCACHE_BuildFft  (void *out, size_t bytes,
+                                             const TCACHE_KEY *key, void *arg);
+static int                 TCACHE_BuildWin  (void *out, size_t bytes,
+                                             const TCACHE_KEY *key, void *arg);
+
+
+/**************************************************************************
+ Function:    TCACHE_Open()
+
+ Description: Sets up a cache, making its directory if need be.
+
+ Parameters:  tc  - pointer to the TABLE_CACHE to set up
+              dir - directory to keep the tables in; NULL or empty to
+                    make them in memory every run
+
+ Return:      0 - success
+              1 - directory path too long
+              2 - directory could not be made, or is not a directory
+**************************************************************************/
+int TCACHE_Open (TABLE_CACHE *tc, const char *dir)
+{
+    struct stat st;
+
+    memset (tc, 0, sizeof(TABLE_CACHE));
+    pthread_mutex_init(&(tc->lock), NULL);
+
+    if ((dir == NULL) || (dir[0] == '\0'))
+        return (0);
+    if (strlen(dir) >= TCACHE_PATH_LEN)
+        return (1);
+    strcpy(tc->dir, dir);
+
+    if ((mkdir(dir, 0775) != 0) && (errno != EEXIST))
+        return (2);
+    if ((stat(dir, &st) != 0) || !S_ISDIR(st.st_mode))
+        return (2);
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    TCACHE_Get()
+
+ Description: Returns the table for a key: the one already held, else
+              the one in the directory if it matches, else a new one
+              made by build, which is then saved to the directory.
+
+ Parameters:  tc    - the cache
+              key   - what the table is made from; zero it before
+                      setting the fields, as it is compared whole
+              bytes - size of the table
+              build - makes the table if need be
+              arg   - passed to build
+
+ Return:      the table, read-only and held until TCACHE_Close(); NULL
+              if build failed, allocation failed or the cache is full
+**************************************************************************/
+const void *TCACHE_Get (TABLE_CACHE       *tc,
+                        const TCACHE_KEY  *key,
+                        size_t             bytes,
+                        TCACHE_BUILD       build,
+                        void              *arg)
+{
+    TCACHE_TABLE        *t;
+    char                 path[TCACHE_PATH_LEN + 64];
+    void                *out;
+    unsigned long long   start;
+    unsigned int         i;
+
+    pthread_mutex_lock(&(tc->lock));
+
+    for (i = 0; i < tc->numTables; i++)
+    {
+        t = &(tc->table[i]);
+        if ((t->bytes == bytes) && (memcmp(&(t->key), key, sizeof(TCACHE_KEY)) == 0))
+        {
+            pthread_mutex_unlock(&(tc->lock));
+            return (t->data);
+        }
+    }
+    if (tc->numTables == TCACHE_MAX_TABLES)
+    {
+        pthread_mutex_unlock(&(tc->lock));
+        return (NULL);
+    }
+    t = &(tc->table[tc->numTables]);
+    memset (t, 0, sizeof(TCACHE_TABLE));
+
+    if (tc->dir[0] != '\0')
+    {
+        snprintf(path, sizeof(path), "%s/%.8s_%u_%d_%u_%016llx.tbl", tc->dir,
+                 key->kind, key->size, key->window, key->length,
+                 (unsigned long long)key->source);
+
+        start   = DMARING_TimeNs();
+        t->data = TCACHE_Load(path, key, bytes, &(t->map), &(t->mapBytes));
+        if (t->data != NULL)
+        {
+            tc->loadNs += DMARING_TimeNs() - start;
+            tc->loaded++;
+        }
+    }
+
+    if (t->data == NULL)
+    {
+        start = DMARING_TimeNs();
+        out   = malloc(bytes);
+        if ((out == NULL) || (build(out, bytes, key, arg) != 0))
+        {
+            free(out);
+            pthread_mutex_unlock(&(tc->lock));
+            return (NULL);
+        }
+        if ((tc->dir[0] != '\0') && (TCACHE_Save(path, key, out, bytes) != 0))
+            tc->saveErrors++;
+        tc->buildNs += DMARING_TimeNs() - start;
+        tc->built++;
+        t->data = out;
+    }
+
+    t->key   = *key;
+    t->bytes = bytes;
+    tc->numTables++;
+
+    pthread_mutex_unlock(&(tc->lock));
+
+    return (t->data);
+}
+
+
+/**************************************************************************
+ Function:    TCACHE_FftPlan()
+
+ Description: Sets up an FFT plan on the cache's tables for size n.
+
+ Parameters:  tc   - the cache
+              plan - pointer to the FFT_PLAN to set up
+              n    - transform size, as for FFT_Init()
+
+ Return:      0 - success
+              1 - n is not a supported size
+              2 - the tables could not be made
+**************************************************************************/
+int TCACHE_FftPlan (TABLE_CACHE *tc, FFT_PLAN *plan, unsigned int n)
+{
+    TCACHE_KEY   key;
+    const float *tables;
+
+    memset (plan, 0, sizeof(FFT_PLAN));
+    if ((n < FFT_MIN_SIZE) || (n > FFT_MAX_SIZE) || ((n & (n - 1)) != 0))
+        return (1);
+
+    memset (&key, 0, sizeof(key));
+    strcpy(key.kind, "fft");
+    key.size = n;
+
+    tables = (const float *)TCACHE_Get(tc, &key,
+                                       (FFT_TWIDDLE_FLOATS(n) * sizeof(float)) +
+                                       (n * sizeof(unsigned int)),
+                                       TCACHE_BuildFft, NULL);
+    if (tables == NULL)
+        return (2);
+
+    return (FFT_InitShared(plan, n, tables,
+                           (const unsigned int *)(tables + FFT_TWIDDLE_FLOATS(n))));
+}
+
+
+/**************************************************************************
+ Function:    TCACHE_Window()
+
+ Description: Returns the window of a type and length (WIN_Make()).
+
+ Parameters:  tc   - the cache
+              type - window code (win.h)
+              n    - points
+
+ Return:      the window, held until TCACHE_Close(); NULL if type is not
+              a window or it could not be made
+**************************************************************************/
+const float *TCACHE_Window (TABLE_CACHE *tc, int type, unsigned int n)
+{
+    TCACHE_KEY key;
+
+    memset (&key, 0, sizeof(key));
+    strcpy(key.kind, "win");
+    key.size   = n;
+    key.window = type;
+
+    return ((const float *)TCACHE_Get(tc, &key, n * sizeof(float),
+                                      TCACHE_BuildWin, NULL));
+}
+
+
+/**************************************************************************
+ Function:    TCACHE_Hash()
+
+ Description: 64-bit FNV-1a hash of a block of data, for TCACHE_KEY
+              source.
+
+ Parameters:  data  - the data
+              bytes - its length
+
+ Return:      the hash
+**************************************************************************/
+uint64_t TCACHE_Hash (const void *data, size_t bytes)
+{
+    const unsigned char *p    = (const unsigned char *)data;
+    uint64_t             hash = 0xcbf29ce484222325ULL;
+    size_t               i;
+
+    for (i = 0; i < bytes; i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return (hash);
+}
+
+
+/**************************************************************************
+ Function:    TCACHE_Report()
+
+ Description: Prints how many tables were loaded and made, and the time
+              each took: the warm and cold start up costs.
+
+ Parameters:  tc - the cache
+
+ Return:      none
+**************************************************************************/
+void TCACHE_Report (TABLE_CACHE *tc)
+{
+    if (tc->dir[0] == '\0')
+    {
+        printf("[tcache] %u table(s) made in %.2f ms, none kept (no TABLE_CACHE_DIR)\n",
+               tc->built, tc->buildNs / 1e6);
+        return;
+    }
+
+    printf("[tcache] %s: %u table(s) loaded in %.2f ms, %u made in %.2f ms\n",
+           tc->dir, tc->loaded, tc->loadNs / 1e6, tc->built, tc->buildNs / 1e6);
+    if (tc->saveErrors != 0)
+        printf("[tcache] %u table(s) could not be saved\n", tc->saveErrors);
+}
+
+
+/**************************************************************************
+ Function:    TCACHE_Close()
+
+ Description: Releases every table.  Nothing may use them afterwards.
+
+ Parameters:  tc - the cache
+
+ Return:      none
+**************************************************************************/
+void TCACHE_Close (TABLE_CACHE *tc)
+{
+    unsigned int i;
+
+    for (i = 0; i < tc->numTables; i++)
+    {
+        if (tc->table[i].map != NULL)
+            munmap(tc->table[i].map, tc->table[i].mapBytes);
+        else
+            free((void *)tc->table[i].data);
+    }
+    tc->numTables = 0;
+    pthread_mutex_destroy(&(tc->lock));
+}
+
+
+/**************************************************************************
+ Function:    TCACHE_Load()
+
+ Description: Maps a table file if its header matches the key.  The
+              pages are read in now (MAP_POPULATE) so the run does not
+              fault on them.
+
+ Parameters:  path     - the file
+              key      - key it must have
+              bytes    - size the table must be
+              map      - set to the start of the mapping
+              mapBytes - set to its size
+
+ Return:      the table in the mapping; NULL if there is no file or it
+              does not match
+**************************************************************************/
+static const void *TCACHE_Load (const char       *path,
+                                const TCACHE_KEY *key,
+                                size_t            bytes,
+                                void            **map,
+                                size_t           *mapBytes)
+{
+    const TCACHE_HEADER *header;
+    struct stat          st;
+    size_t               size = sizeof(TCACHE_HEADER) + bytes;
+    void                *p;
+    int                  fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return (NULL);
+    if ((fstat(fd, &st) != 0) || ((size_t)st.st_size != size))
+    {
+        close(fd);
+        return (NULL);
+    }
+    p = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return (NULL);
+
+    header = (const TCACHE_HEADER *)p;
+    if ((memcmp(header->magic, TCACHE_MAGIC, sizeof(header->magic)) != 0) ||
+        (header->version != TCACHE_VERSION) || (header->bytes != bytes) ||
+        (memcmp(&(header->key), key, sizeof(TCACHE_KEY)) != 0))
+    {
+        munmap(p, size);
+        return (NULL);
+    }
+
+    *map      = p;
+    *mapBytes = size;
+
+    return ((const char *)p + sizeof(TCACHE_HEADER));
+}
+
+
+/**************************************************************************
+ Function:    TCACHE_Save()
+
+ Description: Writes a table file, under a temporary name renamed into
+              place once it is all written.
+
+ Parameters:  path  - the file
+              key   - the table's key
+              data  - the table
+              bytes - its size
+
+ Return:      0 - success
+              1 - the file could not be written
+**************************************************************************/
+static int TCACHE_Save (const char       *path,
+                        const TCACHE_KEY *key,
+                        const void       *data,
+                        size_t            bytes)
+{
+    TCACHE_HEADER  header;
+    char           tmpPath[TCACHE_PATH_LEN + 80];
+    const char    *p;
+    size_t         left;
+    ssize_t        n;
+    int            fd;
+    int            status = 0;
+
+    memset (&header, 0, sizeof(header));
+    memcpy (header.magic, TCACHE_MAGIC, sizeof(header.magic));
+    header.version = TCACHE_VERSION;
+    header.key     = *key;
+    header.bytes   = bytes;
+
+    snprintf(tmpPath, sizeof(tmpPath), "%s.%d.part", path, (int)getpid());
+    fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return (1);
+
+    if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header))
+        status = 1;
+    p    = (const char *)data;
+    left = bytes;
+    while ((status == 0) && (left > 0))
+    {
+        n = write(fd, p, left);
+        if (n <= 0)
+            status = 1;
+        else
+        {
+            p    += n;
+            left -= (size_t)n;
+        }
+    }
+    if (close(fd) != 0)
+        status = 1;
+
+    if ((status == 0) && (rename(tmpPath, path) != 0))
+        status = 1;
+    if (status != 0)
+        unlink(tmpPath);
+
+    return (status);
+}
+
+
+/**************************************************************************
+ Function:    TCACHE_BuildFft()
+
+ Description: TCACHE_BUILD for an FFT plan's tables: the twiddle factors
+              then the bit-reversal permutation.
+
+ Parameters:  see TCACHE_BUILD; key->size is the transform size
+
+ Return:      0 - success
+              1 - not a supported size
+**************************************************************************/
+static int TCACHE_BuildFft (void *out, size_t bytes, const TCACHE_KEY *key,
+                            void *arg)
+{
+    float *twiddle = (float *)out;
+
+    (void)bytes;
+    (void)arg;
+
+    return (FFT_MakeTables(key->size, twiddle,
+                           (unsigned int *)(twiddle + FFT_TWIDDLE_FLOATS(key->size))));
+}
+
+
+/**************************************************************************
+ Function:    TCACHE_BuildWin()
+
+ Description: TCACHE_BUILD for a window.
+
+ Parameters:  see TCACHE_BUILD; key->window and key->size are the window
+              code and length
+
+ Return:      0 - success
+              1 - not a window code
+**************************************************************************/
+static int TCACHE_BuildWin (void *out, size_t bytes, const TCACHE_KEY *key,
+                            void *arg)
+{
+    (void)bytes;
+    (void)arg;
+
+    return (WIN_Make(key->window, key->size, (float *)out));
+}
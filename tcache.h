@@ -0,0 +1,157 @@
+/***********************************************************************
+*
+*   File: tcache.h
+*
+*   Description: header file for tcache.c, the store of the tables the
+*                processing stages are set up from: FFT plans, windows
+*                and pulse compression reference spectra.
+*
+*                Set from NeXtRAD.ini:
+*                    TABLE_CACHE_DIR - directory the tables are kept in
+*                                      between runs; empty = made afresh
+*                                      every run
+*
+*                A table is asked for by its key (TCACHE_KEY) with a
+*                function that makes it.  The first time a key is asked
+*                for the table is looked for in the directory, as
+*                <kind>_<size>_<window>_<length>_<source>.tbl, and
+*                mapped read-only if its header matches the key;
+*                otherwise it is made and saved there for the next run.
+*                Later asks for the same key, from any channel, get the
+*                same copy.  The cache owns every table it hands out;
+*                they last until TCACHE_Close().
+*
+*                Tables are only valid for the code that made them:
+*                TCACHE_VERSION is in every header, and goes up whenever
+*                a table's layout or contents change (e.g. fft.c's
+*                twiddle order), so old files are made again rather than
+*                misread.  Files are written under a temporary name and
+*                renamed, so a run killed mid-write cannot leave a short
+*                table behind.
+*
+*                Any number of threads can ask at once.  The cache is
+*                meant for set up, before DMARING_Start(): a miss makes
+*                the table while holding the cache's lock.
+*
+************************************************************************/
+
+#ifndef __TCACHE_H__
+#define __TCACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "fft.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* TCACHE_VERSION - layout version of the tables; see above */
+#define TCACHE_VERSION       1
+
+/* TCACHE_PATH_LEN - longest directory or file path handled;
+ * TCACHE_MAX_TABLES - different tables a cache can hold
+ */
+#define TCACHE_PATH_LEN      256
+#define TCACHE_MAX_TABLES    64
+
+
+/* TCACHE_KEY - what a table was made from; every field goes in the file
+ * name and header, and unused ones are 0
+ *     kind   = short name of the table: "fft", "win", "pcref" ...
+ *     size   = transform or window size
+ *     window = window code (win.h)
+ *     length = samples of input, e.g. the reference
+ *     pad    = 0
+ *     source = TCACHE_Hash() of any input data, e.g. the reference
+ *              samples, so the table is made again when they change
+ */
+typedef struct TCACHE_KEY
+        {
+            char                kind[8];
+            uint32_t            size;
+            int32_t             window;
+            uint32_t            length;
+            uint32_t            pad;
+            uint64_t            source;
+        } TCACHE_KEY;
+
+
+/* TCACHE_BUILD - makes a table of the given bytes for key into out;
+ * returns 0 on success
+ */
+typedef int (*TCACHE_BUILD) (void *out, size_t bytes, const TCACHE_KEY *key,
+                             void *arg);
+
+
+/* TCACHE_TABLE - one table held by the cache
+ *     key      = its key
+ *     data     = the table
+ *     bytes    = size of the table
+ *     map      = start of the file's mapping, or NULL if data was made
+ *                in memory
+ *     mapBytes = size of the mapping
+ */
+typedef struct TCACHE_TABLE
+        {
+            TCACHE_KEY          key;
+            const void         *data;
+            size_t              bytes;
+            void               *map;
+            size_t              mapBytes;
+        } TCACHE_TABLE;
+
+
+/* TABLE_CACHE - the store
+ *     dir        = directory of the files; empty for none
+ *     lock       = protects everything below
+ *     table      = tables held
+ *     numTables  = entries of table used
+ *     loaded     = tables mapped from files
+ *     built      = tables made
+ *     saveErrors = made tables that could not be saved
+ *     loadNs     = time spent mapping tables
+ *     buildNs    = time spent making (and saving) tables
+ */
+typedef struct TABLE_CACHE
+        {
+            char                dir[TCACHE_PATH_LEN];
+            pthread_mutex_t     lock;
+            TCACHE_TABLE        table[TCACHE_MAX_TABLES];
+            unsigned int        numTables;
+
+            unsigned int        loaded;
+            unsigned int        built;
+            unsigned int        saveErrors;
+            unsigned long long  loadNs;
+            unsigned long long  buildNs;
+        } TABLE_CACHE;
+
+
+/* function prototypes */
+int         TCACHE_Open    (TABLE_CACHE        *tc,
+                            const char         *dir);
+const void *TCACHE_Get     (TABLE_CACHE        *tc,
+                            const TCACHE_KEY   *key,
+                            size_t              bytes,
+                            TCACHE_BUILD        build,
+                            void               *arg);
+int         TCACHE_FftPlan (TABLE_CACHE        *tc,
+                            FFT_PLAN           *plan,
+                            unsigned int        n);
+const float *TCACHE_Window (TABLE_CACHE        *tc,
+                            int                 type,
+                            unsigned int        n);
+uint64_t    TCACHE_Hash    (const void         *data,
+                            size_t              bytes);
+void        TCACHE_Report  (TABLE_CACHE        *tc);
+void        TCACHE_Close   (TABLE_CACHE        *tc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TCACHE_H__ */
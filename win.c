@@ -0,0 +1,87 @@
+/**************************************************************************
+*
+*   File: win.c
+*
+*   Description: Window functions.  See win.h.
+*
+*                Each window is worked out in double precision from the
+*                usual cosine series over k = 0 ... n - 1, with the ends
+*                at k = 0 and k = n - 1.
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <math.h>
+
+#include "win.h"
+
+
+/**************************************************************************
+ Function:    WIN_Make()
+
+ Description: Fills in a window.
+
+ Parameters:  type - WIN_HANNING, _HAMMING, _UNIFORM or _BLACKMAN
+              n    - points
+              w    - receives the n weights
+
+ Return:      0 - success
+              1 - type is not a window code
+**************************************************************************/
+int WIN_Make (int type, unsigned int n, float *w)
+{
+    unsigned int i;
+    double       a;
+
+    if ((type < WIN_HANNING) || (type > WIN_BLACKMAN))
+        return (1);
+
+    for (i = 0; i < n; i++)
+    {
+        a = (n > 1) ? ((2.0 * M_PI * i) / (n - 1)) : 0.0;
+
+        switch (type)
+        {
+            case WIN_HANNING:
+                w[i] = (float)(0.5 - (0.5 * cos(a)));
+                break;
+            case WIN_HAMMING:
+                w[i] = (float)(0.54 - (0.46 * cos(a)));
+                break;
+            case WIN_BLACKMAN:
+                w[i] = (float)(0.42 - (0.5 * cos(a)) + (0.08 * cos(2.0 * a)));
+                break;
+            default:
+                w[i] = 1.0f;
+                break;
+        }
+    }
+
+    /* a one point window is just its peak */
+    if ((n == 1) && (type != WIN_UNIFORM))
+        w[0] = 1.0f;
+
+    return (0);
+}
+
+
+/**************************************************************************
+ Function:    WIN_Name()
+
+ Description: Names a window code, for reports.
+
+ Parameters:  type - window code
+
+ Return:      "hanning", "hamming", "uniform", "blackman" or "unknown"
+**************************************************************************/
+const char *WIN_Name (int type)
+{
+    switch (type)
+    {
+        case WIN_HANNING:  return ("hanning");
+        case WIN_HAMMING:  return ("hamming");
+        case WIN_UNIFORM:  return ("uniform");
+        case WIN_BLACKMAN: return ("blackman");
+        default:           return ("unknown");
+    }
+}
@@ -0,0 +1,43 @@
+/***********************************************************************
+*
+*   File: win.h
+*
+*   Description: header file for win.c, the window functions the
+*                processing stages taper with.
+*
+*                The window codes are the ones experiment.ini and the
+*                offline processing use (HANNING = 0 ... BLACKMAN = 3), so
+*                the same numbers can be copied into NeXtRAD.ini.
+*
+*                Windows are symmetric, peak 1 in the middle, and not
+*                normalised: a tapered signal loses the window's coherent
+*                gain, mean(w), in amplitude.
+*
+************************************************************************/
+
+#ifndef __WIN_H__
+#define __WIN_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* window codes */
+#define WIN_HANNING          0
+#define WIN_HAMMING          1
+#define WIN_UNIFORM          2
+#define WIN_BLACKMAN         3
+
+
+/* function prototypes */
+int         WIN_Make (int            type,
+                      unsigned int   n,
+                      float         *w);
+const char *WIN_Name (int            type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __WIN_H__ */